@@ -0,0 +1,98 @@
+/*
+ * File: bench_blas.c
+ *
+ * Purpose: The Jacobi iteration on a BLAS library, libitmv_bench_blas.so:
+ *          each iteration is one dgemv (dtrmv for an upper triangular A),
+ *          threaded by the library itself. Built against OpenBLAS or any
+ *          CBLAS by default, against MKL with -DITMV_MKL (see Makefile).
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "itmv_bench.h"
+#ifdef ITMV_MKL
+#include "mkl.h"
+#else
+#include <cblas.h>
+#endif
+
+static double *blas_A, *blas_x, *blas_d, *blas_y;
+
+/* The library schedules the rows itself, so there is one mapping. */
+static int blas_mapping(const char *name) {
+  return strcmp(name, "block") == 0 || strcmp(name, "gemv") == 0 ? 0 : -1;
+}
+
+static void blas_teardown(void) {
+  free(blas_A);
+  free(blas_x);
+  free(blas_d);
+  free(blas_y);
+  blas_A = blas_x = blas_d = blas_y = NULL;
+}
+
+static int blas_setup(const bench_config *cfg) {
+  int n = cfg->n;
+
+  blas_A = malloc((long)n * n * sizeof(double));
+  blas_x = malloc(n * sizeof(double));
+  blas_d = malloc(n * sizeof(double));
+  blas_y = malloc(n * sizeof(double));
+  if (blas_A == NULL || blas_x == NULL || blas_d == NULL || blas_y == NULL) {
+    blas_teardown();
+    return 0;
+  }
+  bench_initialize(blas_A, blas_x, blas_d, blas_y, n, cfg->matrix_type);
+  return 1;
+}
+
+/*-------------------------------------------------------------------
+ * At most t iterations of {y=d+Ax; x=y}, stopping once no entry moved by
+ * BENCH_ERROR_THRESHOLD. dtrmv works in place, so for an upper triangular
+ * A y takes a copy of x first and d is added after.
+ */
+static int blas_run(const bench_config *cfg, bench_result *res) {
+  int i, k, n = cfg->n;
+  double start, error;
+
+#ifdef ITMV_MKL
+  mkl_set_num_threads(cfg->threads);
+#elif defined(OPENBLAS_VERSION)
+  openblas_set_num_threads(cfg->threads);
+#endif
+  memset(blas_x, 0, n * sizeof(double));
+  start = bench_now();
+  for (k = 0; k < cfg->iterations;) {
+    if (cfg->matrix_type == BENCH_UPPER_TRIANGULAR) {
+      memcpy(blas_y, blas_x, n * sizeof(double));
+      cblas_dtrmv(CblasRowMajor, CblasUpper, CblasNoTrans, CblasNonUnit, n,
+                  blas_A, n, blas_y, 1);
+      cblas_daxpy(n, 1.0, blas_d, 1, blas_y, 1);
+    } else {
+      memcpy(blas_y, blas_d, n * sizeof(double));
+      cblas_dgemv(CblasRowMajor, CblasNoTrans, n, n, 1.0, blas_A, n, blas_x,
+                  1, 1.0, blas_y, 1);
+    }
+    error = 0;
+    for (i = 0; i < n; i++) {
+      error = fmax(error, fabs(blas_y[i] - blas_x[i]));
+    }
+    memcpy(blas_x, blas_y, n * sizeof(double));
+    k++;
+    if (error < BENCH_ERROR_THRESHOLD) {
+      break;
+    }
+  }
+  res->seconds = bench_now() - start;
+  res->iterations_done = k;
+  res->checksum = bench_checksum(blas_y, n);
+  res->imbalance = 0;
+  res->wait_fraction = 0;
+  return 1;
+}
+
+static const bench_backend blas_backend = {"blas", blas_mapping, blas_setup,
+                                           blas_run, blas_teardown};
+
+const bench_backend *itmv_bench_backend(void) { return &blas_backend; }
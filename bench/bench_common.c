@@ -0,0 +1,56 @@
+/*
+ * File: bench_common.c
+ *
+ * Purpose: The test matrix and helpers shared by the driver and every
+ *          implementation.
+ */
+
+#include "itmv_bench.h"
+#include <time.h>
+
+/*-------------------------------------------------------------------
+ * Function:  bench_initialize
+ * Purpose:   Build the test matrix of the test harnesses:
+ *            A[i][j] = -1/n off the diagonal (above it for an upper
+ *            triangular A), 0 on it; d chosen so that x converges to all
+ *            ones; x = y = 0. Below the diagonal of an upper triangular A
+ *            is left alone.
+ */
+void bench_initialize(double A[], double x[], double d[], double y[], int n,
+                      int matrix_type) {
+  int i, j;
+
+  for (i = 0; i < n; i++) {
+    x[i] = 0;
+    y[i] = 0;
+    if (matrix_type == BENCH_UPPER_TRIANGULAR)
+      d[i] = (2.0 * n - 1.0 * i - 1.0) / n;
+    else
+      d[i] = (2.0 * n - 1.0) / n;
+  }
+  for (i = 0; i < n; i++) {
+    for (j = matrix_type == BENCH_UPPER_TRIANGULAR ? i : 0; j < n; j++) {
+      A[(long)i * n + j] = i == j ? 0.0 : -1.0 / n;
+    }
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Return the sum of y, to compare implementations run for the same
+ * number of iterations.
+ */
+double bench_checksum(const double y[], int n) {
+  double sum = 0;
+  int i;
+
+  for (i = 0; i < n; i++) {
+    sum += y[i];
+  }
+  return sum;
+}
+
+double bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
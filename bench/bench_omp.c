@@ -0,0 +1,118 @@
+/*
+ * File: bench_omp.c
+ *
+ * Purpose: The OpenMP driver (../omp/itmv_mult_omp.c) as an itmv_bench
+ *          implementation, libitmv_bench_omp.so. Defines the globals the
+ *          test harness would.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "affinity.h"
+#include "itmv_bench.h"
+#include "itmv_mult_omp.h"
+
+/*Global variables*/
+double *matrix_A;
+double *vector_x;
+double *vector_d;
+double *vector_y;
+double *panel_x;
+double *panel_d;
+double *panel_y;
+int rhs_count;
+int matrix_type;
+int band_lower;
+int band_upper;
+int matrix_dim;
+int no_iterations;
+int thread_count;
+int thread_mapping = BLOCK_MAPPING;
+int cyclic_blocksize;
+int color_count = 2;
+double relax_omega = 1.0;
+int krylov_method = KRYLOV_AUTO;
+int acceleration = ACCEL_NONE;
+int anderson_depth = 3;
+char *ooc_path = NULL;
+int ooc_panel_rows = 64;
+int ooc_readers = 1;
+struct itmv_op *matrix_op = NULL;
+char *autotune_profile = NULL;
+
+static const struct {
+  const char *name;
+  int mapping;
+} openmp_mappings[] = {
+    {"block", BLOCK_MAPPING},     {"cyclic", BLOCK_CYCLIC},
+    {"dynamic", BLOCK_DYNAMIC},   {"guided", BLOCK_GUIDED},
+    {"autotune", BLOCK_AUTOTUNE}, {"taskloop", BLOCK_TASKLOOP},
+    {"taskdep", BLOCK_TASKDEP},   {"async", ASYNC_JACOBI},
+    {"gs", GAUSS_SEIDEL},         {"krylov", KRYLOV},
+};
+
+static int openmp_mapping(const char *name) {
+  size_t i;
+
+  for (i = 0; i < sizeof(openmp_mappings) / sizeof(openmp_mappings[0]); i++) {
+    if (strcmp(name, openmp_mappings[i].name) == 0)
+      return openmp_mappings[i].mapping;
+  }
+  return -1;
+}
+
+static void openmp_teardown(void) {
+  free(matrix_A);
+  free(vector_x);
+  free(vector_d);
+  free(vector_y);
+  matrix_A = vector_x = vector_d = vector_y = NULL;
+}
+
+static int openmp_setup(const bench_config *cfg) {
+  int n = cfg->n;
+
+  matrix_A = malloc((long)n * n * sizeof(double));
+  vector_x = malloc(n * sizeof(double));
+  vector_d = malloc(n * sizeof(double));
+  vector_y = malloc(n * sizeof(double));
+  if (matrix_A == NULL || vector_x == NULL || vector_d == NULL ||
+      vector_y == NULL) {
+    openmp_teardown();
+    return 0;
+  }
+  affinity_first_touch(matrix_A, (long)n * n, cfg->threads);
+  bench_initialize(matrix_A, vector_x, vector_d, vector_y, n,
+                   cfg->matrix_type);
+  return 1;
+}
+
+static int openmp_run(const bench_config *cfg, bench_result *res) {
+  double start;
+
+  if (cfg->threads < 1 || cfg->threads > THREAD_COUNT_MAX) return 0;
+  matrix_dim = cfg->n;
+  matrix_type = cfg->matrix_type;
+  no_iterations = cfg->iterations;
+  thread_mapping = cfg->mapping;
+  cyclic_blocksize = cfg->chunksize;
+  thread_count = cfg->threads;
+  memset(vector_x, 0, matrix_dim * sizeof(double));
+  memset(vector_y, 0, matrix_dim * sizeof(double));
+
+  start = bench_now();
+  parallel_itmv_mult(thread_count, thread_mapping, cyclic_blocksize);
+  res->seconds = bench_now() - start;
+  if (run_error != NULL) return 0;
+
+  res->iterations_done = iterations_done;
+  res->checksum = bench_checksum(vector_y, matrix_dim);
+  thread_stats_summary(thread_count, res->seconds, &res->imbalance,
+                       &res->wait_fraction);
+  return 1;
+}
+
+static const bench_backend openmp_backend = {
+    "omp", openmp_mapping, openmp_setup, openmp_run, openmp_teardown};
+
+const bench_backend *itmv_bench_backend(void) { return &openmp_backend; }
@@ -0,0 +1,167 @@
+/*
+ * File: bench_pth.c
+ *
+ * Purpose: The pthreads driver (../pthreads/itmv_mult_pth.c) as an
+ *          itmv_bench implementation, libitmv_bench_pth.so. Defines the
+ *          globals the test harness would, and runs the team the way its
+ *          parallel_itmv_mult does.
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "affinity.h"
+#include "cs140barrier.h"
+#include "itmv_bench.h"
+#include "itmv_mult_pth.h"
+
+/*Global variables*/
+double *matrix_A;
+double *vector_x;
+double *vector_d;
+double *vector_y;
+double *panel_x;
+double *panel_d;
+double *panel_y;
+int rhs_count;
+int matrix_type;
+int band_lower;
+int band_upper;
+int matrix_dim;
+int no_iterations;
+int thread_count;
+int thread_mapping = BLOCK_MAPPING;
+int cyclic_blocksize;
+int color_count = 2;
+double relax_omega = 1.0;
+int krylov_method = KRYLOV_AUTO;
+int acceleration = ACCEL_NONE;
+int anderson_depth = 3;
+char *ooc_path = NULL;
+int ooc_panel_rows = 64;
+int ooc_readers = 1;
+struct itmv_op *matrix_op = NULL;
+
+extern cs140barrier mybarrier; /*defined in itmv_mult_pth.c*/
+
+static const struct {
+  const char *name;
+  int mapping;
+} pth_mappings[] = {
+    {"block", BLOCK_MAPPING},       {"cyclic", BLOCK_CYCLIC},
+    {"dynamic", BLOCK_DYNAMIC},     {"guided", BLOCK_GUIDED},
+    {"stealing", BLOCK_STEALING},   {"dataflow", BLOCK_DATAFLOW},
+    {"async", ASYNC_JACOBI},        {"gs", GAUSS_SEIDEL},
+    {"krylov", KRYLOV},
+};
+
+static int pth_mapping(const char *name) {
+  size_t i;
+
+  for (i = 0; i < sizeof(pth_mappings) / sizeof(pth_mappings[0]); i++) {
+    if (strcmp(name, pth_mappings[i].name) == 0) return pth_mappings[i].mapping;
+  }
+  return -1;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  thread_work
+ * Purpose:   Run one thread of the team on its mapping, as the harness
+ *            does.
+ */
+static void *thread_work(void *rank) {
+  extern void work_blockcyclic(long);
+  extern void work_block(long);
+  extern void work_dataflow(long);
+  extern void work_scheduled(long);
+  extern void work_async(long);
+  extern void work_gauss_seidel(long);
+  extern void work_krylov(long);
+  long my_rank = (long)rank;
+
+  affinity_bind_self(my_rank);
+  if (thread_mapping == BLOCK_CYCLIC) {
+    work_blockcyclic(my_rank);
+  } else if (thread_mapping == BLOCK_DATAFLOW) {
+    work_dataflow(my_rank);
+  } else if (thread_mapping == ASYNC_JACOBI) {
+    work_async(my_rank);
+  } else if (thread_mapping == GAUSS_SEIDEL) {
+    work_gauss_seidel(my_rank);
+  } else if (thread_mapping == KRYLOV) {
+    work_krylov(my_rank);
+  } else if (thread_mapping == BLOCK_DYNAMIC ||
+             thread_mapping == BLOCK_GUIDED ||
+             thread_mapping == BLOCK_STEALING) {
+    work_scheduled(my_rank);
+  } else {
+    work_block(my_rank);
+  }
+  return NULL;
+}
+
+static void pth_teardown(void) {
+  free(matrix_A);
+  free(vector_x);
+  free(vector_d);
+  free(vector_y);
+  matrix_A = vector_x = vector_d = vector_y = NULL;
+}
+
+static int pth_setup(const bench_config *cfg) {
+  int n = cfg->n;
+
+  matrix_A = malloc((long)n * n * sizeof(double));
+  vector_x = malloc(n * sizeof(double));
+  vector_d = malloc(n * sizeof(double));
+  vector_y = malloc(n * sizeof(double));
+  if (matrix_A == NULL || vector_x == NULL || vector_d == NULL ||
+      vector_y == NULL) {
+    pth_teardown();
+    return 0;
+  }
+  affinity_first_touch(matrix_A, (long)n * n, cfg->threads);
+  bench_initialize(matrix_A, vector_x, vector_d, vector_y, n,
+                   cfg->matrix_type);
+  return 1;
+}
+
+static int pth_run(const bench_config *cfg, bench_result *res) {
+  pthread_t handles[THREAD_COUNT_MAX];
+  double start;
+  long i;
+
+  if (cfg->threads < 1 || cfg->threads > THREAD_COUNT_MAX) return 0;
+  matrix_dim = cfg->n;
+  matrix_type = cfg->matrix_type;
+  no_iterations = cfg->iterations;
+  thread_mapping = cfg->mapping;
+  cyclic_blocksize = cfg->chunksize;
+  thread_count = cfg->threads;
+  run_error = NULL;
+  memset(vector_x, 0, matrix_dim * sizeof(double));
+  memset(vector_y, 0, matrix_dim * sizeof(double));
+
+  start = bench_now();
+  cs140barrier_init(&mybarrier, thread_count);
+  for (i = 0; i < thread_count; i++) {
+    pthread_create(&handles[i], NULL, thread_work, (void *)i);
+  }
+  for (i = 0; i < thread_count; i++) {
+    pthread_join(handles[i], NULL);
+  }
+  cs140barrier_destroy(&mybarrier);
+  res->seconds = bench_now() - start;
+  if (run_error != NULL) return 0;
+
+  res->iterations_done = iterations_done;
+  res->checksum = bench_checksum(vector_y, matrix_dim);
+  thread_stats_summary(thread_count, res->seconds, &res->imbalance,
+                       &res->wait_fraction);
+  return 1;
+}
+
+static const bench_backend pth_backend = {"pth", pth_mapping, pth_setup,
+                                          pth_run, pth_teardown};
+
+const bench_backend *itmv_bench_backend(void) { return &pth_backend; }
@@ -0,0 +1,82 @@
+/*
+ * File: bench_seq.c
+ *
+ * Purpose: The sequential Jacobi iteration, built into itmv_bench as the
+ *          baseline.
+ */
+
+#include "itmv_bench.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+static double *seq_A, *seq_x, *seq_d, *seq_y;
+
+static int seq_mapping(const char *name) {
+  return strcmp(name, "block") == 0 ? 0 : -1;
+}
+
+static void seq_teardown(void) {
+  free(seq_A);
+  free(seq_x);
+  free(seq_d);
+  free(seq_y);
+  seq_A = seq_x = seq_d = seq_y = NULL;
+}
+
+static int seq_setup(const bench_config *cfg) {
+  int n = cfg->n;
+
+  seq_A = malloc((long)n * n * sizeof(double));
+  seq_x = malloc(n * sizeof(double));
+  seq_d = malloc(n * sizeof(double));
+  seq_y = malloc(n * sizeof(double));
+  if (seq_A == NULL || seq_x == NULL || seq_d == NULL || seq_y == NULL) {
+    seq_teardown();
+    return 0;
+  }
+  bench_initialize(seq_A, seq_x, seq_d, seq_y, n, cfg->matrix_type);
+  return 1;
+}
+
+/*-------------------------------------------------------------------
+ * At most t iterations of {y=d+Ax; x=y}, stopping once no entry moved by
+ * BENCH_ERROR_THRESHOLD.
+ */
+static int seq_run(const bench_config *cfg, bench_result *res) {
+  int i, j, k, n = cfg->n;
+  double start, y, error;
+  const double *a;
+
+  memset(seq_x, 0, n * sizeof(double));
+  start = bench_now();
+  for (k = 0; k < cfg->iterations;) {
+    error = 0;
+    for (i = 0; i < n; i++) {
+      a = seq_A + (long)i * n;
+      y = seq_d[i];
+      for (j = cfg->matrix_type == BENCH_UPPER_TRIANGULAR ? i : 0; j < n;
+           j++) {
+        y += a[j] * seq_x[j];
+      }
+      seq_y[i] = y;
+      error = fmax(error, fabs(y - seq_x[i]));
+    }
+    memcpy(seq_x, seq_y, n * sizeof(double));
+    k++;
+    if (error < BENCH_ERROR_THRESHOLD) {
+      break;
+    }
+  }
+  res->seconds = bench_now() - start;
+  res->iterations_done = k;
+  res->checksum = bench_checksum(seq_y, n);
+  res->imbalance = 0;
+  res->wait_fraction = 0;
+  return 1;
+}
+
+static const bench_backend seq_backend = {"seq", seq_mapping, seq_setup,
+                                          seq_run, seq_teardown};
+
+const bench_backend *bench_seq_backend(void) { return &seq_backend; }
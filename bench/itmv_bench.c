@@ -0,0 +1,859 @@
+/*
+ * File:     itmv_bench.c
+ *
+ * Purpose:  One benchmark driver for every implementation of the Jacobi
+ *           iteration y = d + Ax: sequential, pthreads, OpenMP and BLAS.
+ *           Runs the product of the given implementations, dimensions,
+ *           thread counts and mappings, each for a number of repetitions,
+ *           and writes the timings as JSON together with the host and
+ *           compiler they were taken on. A one-line summary of every
+ *           configuration goes to stderr.
+ *
+ * Usage:    itmv_bench [--impl seq,pth,omp,blas] [--n 1024,...]
+ *                      [--t iterations] [--type full,upper]
+ *                      [--mapping block,cyclic,...] [--chunk size]
+ *                      [--threads 1,2,...] [--reps r] [--warmup w]
+ *                      [--output file.json] [--lib-dir dir]
+ *                      [--save-baseline file] [--check file]
+ *                      [--threshold fraction]
+ *                      [--scaling strong|weak] [--csv file.csv]
+ *
+ *           Comma-separated lists are swept. The mappings each
+ *           implementation understands are those of its driver (see
+ *           bench_pth.c, bench_omp.c); a configuration an implementation
+ *           does not support is skipped with a warning.
+ *
+ *           Regression check: --save-baseline records the median time of
+ *           every configuration, with a bootstrap 95% confidence interval,
+ *           one line each:
+ *             impl n type mapping chunk threads t median ci_low ci_high
+ *           and --check compares a new run against such a file. A
+ *           configuration regressed when even the low end of its new
+ *           interval is more than the threshold (default 5%) slower than
+ *           the baseline median. A table of every configuration goes to
+ *           stderr, and the exit status is 2 if any regressed. Record the
+ *           baseline on the machine that will be checked, with enough
+ *           --reps (10 or more) for a tight interval.
+ *
+ *           Scaling study: --scaling sweeps the thread counts (by default
+ *           every count from 1 to the number of online cores) and compares
+ *           each configuration with the sequential implementation at the
+ *           same n and type. Speedup is the sequential time per iteration
+ *           over the parallel one, efficiency the speedup over the threads.
+ *           Strong scaling keeps n fixed (default 4096); weak scaling grows
+ *           it with the threads as n * sqrt(threads), rounded to a multiple
+ *           of 16, so the work per thread stays that of n (default 1024) on
+ *           one thread. A table per implementation, type and mapping, with
+ *           the thread count of the highest speedup marked, goes to stderr,
+ *           and --csv writes every row.
+ */
+
+#include <dlfcn.h>
+#include <getopt.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/utsname.h>
+#include <time.h>
+#include <unistd.h>
+#include "itmv_bench.h"
+
+#ifndef BENCH_CFLAGS
+#define BENCH_CFLAGS ""
+#endif
+
+#define LIST_MAX 32
+#define REPS_MAX 1000
+
+/* Bootstrap resamples for the confidence interval of a median. */
+#define BOOTSTRAP_SAMPLES 2000
+#define BOOTSTRAP_SEED 140
+#define BASELINE_MAX 1024
+#define SCALING_MAX 1024
+
+#define SCALING_NONE 0
+#define SCALING_STRONG 1
+#define SCALING_WEAK 2
+
+const bench_backend *bench_seq_backend(void);
+
+/* Options, lists split in place. */
+char *impls[LIST_MAX], *mappings[LIST_MAX], *type_names[LIST_MAX];
+int dims[LIST_MAX], threads[LIST_MAX], types[LIST_MAX];
+int impl_count, mapping_count, dim_count, thread_count, type_count;
+int iterations = 1024, chunksize = 16, reps = 5, warmup = 1;
+char *lib_dir = NULL;
+
+/* One configuration of a baseline file, and how the last run compared. */
+typedef struct {
+  char key[128];
+  double median, ci_low, ci_high;
+  double new_median, new_low, new_high;
+  int status;
+} baseline_case;
+
+#define CASE_UNCHANGED 0
+#define CASE_REGRESSED 1
+#define CASE_IMPROVED 2
+#define CASE_NEW 3
+#define CASE_MISSING 4
+
+baseline_case baseline[BASELINE_MAX];
+int baseline_count;
+/* Configurations run but not in the baseline. */
+baseline_case extra[BASELINE_MAX];
+int extra_count;
+double threshold = 0.05;
+FILE *save_file = NULL;
+
+/* One configuration of a scaling study. */
+typedef struct {
+  char impl[16], mapping[32];
+  int type, base_n, n, threads, iterations;
+  double per_iteration, seq_per_iteration;
+} scaling_row;
+
+/* Sequential time per iteration, for each n and type measured so far. */
+typedef struct {
+  int n, type;
+  double per_iteration;
+} seq_time;
+
+int scaling = SCALING_NONE;
+scaling_row scaling_rows[SCALING_MAX];
+int scaling_count;
+seq_time seq_times[SCALING_MAX];
+int seq_time_count;
+
+void usage(void) {
+  fprintf(stderr,
+          "itmv_bench [--impl seq,pth,omp,blas] [--n 1024,...] "
+          "[--t iterations]\n"
+          "           [--type full,upper] [--mapping block,cyclic,...] "
+          "[--chunk size]\n"
+          "           [--threads 1,2,...] [--reps r] [--warmup w] "
+          "[--output file.json]\n"
+          "           [--lib-dir dir] [--save-baseline file] [--check file] "
+          "[--threshold fraction]\n"
+          "           [--scaling strong|weak] [--csv file.csv]\n");
+}
+
+/*-------------------------------------------------------------------
+ * Split a comma-separated list in place. Return the number of items, or
+ * -1 if there are more than LIST_MAX.
+ */
+int split_list(char *list, char *items[]) {
+  int count = 0;
+  char *item;
+
+  for (item = strtok(list, ","); item != NULL; item = strtok(NULL, ",")) {
+    if (count == LIST_MAX) return -1;
+    items[count++] = item;
+  }
+  return count;
+}
+
+/*-------------------------------------------------------------------
+ * Split a comma-separated list of positive integers. Return the number
+ * of items, or -1 if one is not a positive integer or there are too many.
+ */
+int split_ints(char *list, int values[]) {
+  char *items[LIST_MAX], *end;
+  int count = split_list(list, items), i;
+  long v;
+
+  for (i = 0; i < count; i++) {
+    v = strtol(items[i], &end, 10);
+    if (*end != '\0' || v <= 0 || v > INT_MAX) return -1;
+    values[i] = v;
+  }
+  return count;
+}
+
+/*-------------------------------------------------------------------
+ * Write s as a JSON string.
+ */
+void json_string(FILE *f, const char *s) {
+  fputc('"', f);
+  for (; *s != '\0'; s++) {
+    if (*s == '"' || *s == '\\')
+      fprintf(f, "\\%c", *s);
+    else if ((unsigned char)*s < 0x20)
+      fprintf(f, "\\u%04x", *s);
+    else
+      fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+/*-------------------------------------------------------------------
+ * Write a per-thread counter summary as a JSON number, or null if the
+ * mapping does not count it and it reads 0.
+ */
+void json_counter(FILE *f, double x) {
+  if (x > 0)
+    fprintf(f, "%.4f", x);
+  else
+    fputs("null", f);
+}
+
+/*-------------------------------------------------------------------
+ * Write the host, compiler and options of this run as the head of the JSON
+ * object.
+ */
+void json_metadata(FILE *f) {
+  struct utsname u;
+  char host[256] = "unknown", date[32];
+  time_t now = time(NULL);
+
+  gethostname(host, sizeof(host) - 1);
+  host[sizeof(host) - 1] = '\0';
+  if (uname(&u) != 0) {
+    strcpy(u.sysname, "unknown");
+    strcpy(u.release, "unknown");
+    strcpy(u.machine, "unknown");
+  }
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+  fprintf(f, "{\n  \"host\": {\"name\": ");
+  json_string(f, host);
+  fprintf(f, ", \"system\": ");
+  json_string(f, u.sysname);
+  fprintf(f, ", \"release\": ");
+  json_string(f, u.release);
+  fprintf(f, ", \"machine\": ");
+  json_string(f, u.machine);
+  fprintf(f, ", \"cpus\": %ld},\n  \"compiler\": {\"version\": ",
+          sysconf(_SC_NPROCESSORS_ONLN));
+  json_string(f, __VERSION__);
+  fprintf(f, ", \"flags\": ");
+  json_string(f, BENCH_CFLAGS);
+  fprintf(f, "},\n  \"date\": \"%s\",\n", date);
+  fprintf(f,
+          "  \"options\": {\"t\": %d, \"chunk\": %d, \"reps\": %d, "
+          "\"warmup\": %d, \"scaling\": \"%s\"},\n  \"runs\": [",
+          iterations, chunksize, reps, warmup,
+          scaling == SCALING_STRONG ? "strong"
+          : scaling == SCALING_WEAK ? "weak"
+                                    : "none");
+}
+
+/*-------------------------------------------------------------------
+ * Find implementation name: built in, or loaded from
+ * lib_dir/libitmv_bench_<name>.so. Return NULL if it cannot be loaded.
+ */
+const bench_backend *load_backend(const char *name) {
+  char path[PATH_MAX];
+  void *lib;
+  bench_entry entry;
+
+  if (strcmp(name, "seq") == 0) return bench_seq_backend();
+  snprintf(path, sizeof(path), "%s/libitmv_bench_%s.so", lib_dir, name);
+  lib = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (lib == NULL) {
+    fprintf(stderr, "itmv_bench: %s\n", dlerror());
+    return NULL;
+  }
+  entry = (bench_entry)dlsym(lib, BENCH_ENTRY);
+  if (entry == NULL) {
+    fprintf(stderr, "itmv_bench: %s: no %s\n", path, BENCH_ENTRY);
+    dlclose(lib);
+    return NULL;
+  }
+  return entry();
+}
+
+int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/*-------------------------------------------------------------------
+ * Return the median of the count values in sorted.
+ */
+double sorted_median(const double sorted[], int count) {
+  return count % 2 ? sorted[count / 2]
+                   : (sorted[count / 2 - 1] + sorted[count / 2]) / 2;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  bootstrap_median
+ * Purpose:   Percentile bootstrap 95% confidence interval of the median
+ *            of count samples: the median of BOOTSTRAP_SAMPLES resamples
+ *            with replacement, cut at 2.5% and 97.5%. The seed is fixed so
+ *            the same samples always give the same interval.
+ * Out args:  low, high
+ */
+void bootstrap_median(const double samples[], int count, double *low,
+                      double *high) {
+  static double medians[BOOTSTRAP_SAMPLES];
+  double resample[REPS_MAX];
+  unsigned int seed = BOOTSTRAP_SEED;
+  int b, i;
+
+  for (b = 0; b < BOOTSTRAP_SAMPLES; b++) {
+    for (i = 0; i < count; i++) {
+      resample[i] = samples[rand_r(&seed) % count];
+    }
+    qsort(resample, count, sizeof(double), compare_doubles);
+    medians[b] = sorted_median(resample, count);
+  }
+  qsort(medians, BOOTSTRAP_SAMPLES, sizeof(double), compare_doubles);
+  *low = medians[(int)(0.025 * BOOTSTRAP_SAMPLES)];
+  *high = medians[(int)(0.975 * BOOTSTRAP_SAMPLES) - 1];
+}
+
+/*-------------------------------------------------------------------
+ * Function:  load_baseline
+ * Purpose:   Read a baseline file written by --save-baseline. Blank lines
+ *            and lines starting with # are skipped.
+ * Return:    0 successful, -1 if it cannot be read or a line is malformed
+ */
+int load_baseline(const char *path) {
+  char line[512], impl[16], type[8], mapping[32];
+  int n, chunk, threads, t, lineno = 0;
+  baseline_case *c;
+  FILE *f = fopen(path, "r");
+
+  if (f == NULL) {
+    perror(path);
+    return -1;
+  }
+  while (fgets(line, sizeof(line), f) != NULL) {
+    lineno++;
+    if (line[strspn(line, " \t\r\n")] == '\0' || line[0] == '#') continue;
+    if (baseline_count == BASELINE_MAX) {
+      fprintf(stderr, "%s: more than %d cases\n", path, BASELINE_MAX);
+      fclose(f);
+      return -1;
+    }
+    c = &baseline[baseline_count];
+    if (sscanf(line, "%15s %d %7s %31s %d %d %d %lf %lf %lf", impl, &n, type,
+               mapping, &chunk, &threads, &t, &c->median, &c->ci_low,
+               &c->ci_high) != 10) {
+      fprintf(stderr, "%s:%d: malformed line\n", path, lineno);
+      fclose(f);
+      return -1;
+    }
+    snprintf(c->key, sizeof(c->key), "%s %d %s %s %d %d %d", impl, n, type,
+             mapping, chunk, threads, t);
+    c->status = CASE_MISSING;
+    baseline_count++;
+  }
+  fclose(f);
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  baseline_compare
+ * Purpose:   Classify the new median and interval of configuration key
+ *            against the baseline: regressed if its low end is more than
+ *            threshold above the baseline median, improved if its high end
+ *            is more than threshold below it.
+ */
+void baseline_compare(const char *key, double median, double low,
+                      double high) {
+  baseline_case *c = NULL;
+  int i;
+
+  for (i = 0; i < baseline_count && c == NULL; i++) {
+    if (strcmp(baseline[i].key, key) == 0) c = &baseline[i];
+  }
+  if (c == NULL) {
+    if (extra_count == BASELINE_MAX) return;
+    c = &extra[extra_count++];
+    snprintf(c->key, sizeof(c->key), "%s", key);
+    c->median = c->ci_low = c->ci_high = 0;
+    c->status = CASE_NEW;
+  } else if (low > c->median * (1 + threshold)) {
+    c->status = CASE_REGRESSED;
+  } else if (high < c->median * (1 - threshold)) {
+    c->status = CASE_IMPROVED;
+  } else {
+    c->status = CASE_UNCHANGED;
+  }
+  c->new_median = median;
+  c->new_low = low;
+  c->new_high = high;
+}
+
+void print_case(const baseline_case *c) {
+  static const char *status[] = {"ok", "REGRESSED", "improved", "new",
+                                 "not run"};
+
+  fprintf(stderr, "%-40s ", c->key);
+  if (c->status == CASE_NEW)
+    fprintf(stderr, "%10s ", "-");
+  else
+    fprintf(stderr, "%10.6f ", c->median);
+  if (c->status == CASE_MISSING)
+    fprintf(stderr, "%10s %23s %8s ", "-", "-", "-");
+  else if (c->status == CASE_NEW)
+    fprintf(stderr, "%10.6f [%10.6f,%10.6f] %8s ", c->new_median, c->new_low,
+            c->new_high, "-");
+  else
+    fprintf(stderr, "%10.6f [%10.6f,%10.6f] %+7.1f%% ", c->new_median,
+            c->new_low, c->new_high, 100 * (c->new_median / c->median - 1));
+  fprintf(stderr, "%s\n", status[c->status]);
+}
+
+/*-------------------------------------------------------------------
+ * Function:  report_baseline
+ * Purpose:   Print the comparison of every configuration as a table.
+ * Return:    the number of regressed configurations
+ */
+int report_baseline(void) {
+  int i, regressed = 0, improved = 0;
+
+  fprintf(stderr, "\n%-40s %10s %10s %23s %8s %s\n",
+          "impl n type mapping chunk threads t", "baseline", "median",
+          "95% CI", "change", "status");
+  for (i = 0; i < baseline_count; i++) {
+    print_case(&baseline[i]);
+    regressed += baseline[i].status == CASE_REGRESSED;
+    improved += baseline[i].status == CASE_IMPROVED;
+  }
+  for (i = 0; i < extra_count; i++) {
+    print_case(&extra[i]);
+  }
+  fprintf(stderr,
+          "Regression check: %d of %d cases regressed by more than %.1f%%, "
+          "%d improved, %d new\n",
+          regressed, baseline_count, 100 * threshold, improved, extra_count);
+  return regressed;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  measure
+ * Purpose:   Run one configuration warmup times untimed and reps times
+ *            timed.
+ * Out args:  seconds, res (of the last run)
+ * Return:    1 successful, 0 if a run failed
+ */
+int measure(const bench_backend *b, const bench_config *cfg,
+            double seconds[], bench_result *res) {
+  int r;
+
+  for (r = 0; r < warmup; r++) {
+    if (!b->run(cfg, res)) return 0;
+  }
+  for (r = 0; r < reps; r++) {
+    if (!b->run(cfg, res)) return 0;
+    seconds[r] = res->seconds;
+  }
+  return 1;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  seq_per_iteration
+ * Purpose:   The median time per iteration of the sequential
+ *            implementation on n and type, measured the first time it is
+ *            asked for. Call it while no other implementation is set up, as
+ *            both hold a matrix.
+ * Return:    the time, or 0 if it could not be measured
+ */
+double seq_per_iteration(int n, int type) {
+  const bench_backend *b = bench_seq_backend();
+  double seconds[REPS_MAX], t = 0;
+  bench_config cfg;
+  bench_result res;
+  int i;
+
+  for (i = 0; i < seq_time_count; i++) {
+    if (seq_times[i].n == n && seq_times[i].type == type)
+      return seq_times[i].per_iteration;
+  }
+  cfg.n = n;
+  cfg.matrix_type = type;
+  cfg.mapping = 0;
+  cfg.chunksize = chunksize;
+  cfg.threads = 1;
+  cfg.iterations = iterations;
+  if (!b->setup(&cfg)) return 0;
+  if (measure(b, &cfg, seconds, &res) && res.iterations_done > 0) {
+    qsort(seconds, reps, sizeof(double), compare_doubles);
+    t = sorted_median(seconds, reps) / res.iterations_done;
+  }
+  b->teardown();
+  if (t > 0 && seq_time_count < SCALING_MAX) {
+    seq_times[seq_time_count].n = n;
+    seq_times[seq_time_count].type = type;
+    seq_times[seq_time_count++].per_iteration = t;
+  }
+  return t;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  weak_n
+ * Purpose:   The dimension with the work per thread of base_n on one
+ *            thread: the work grows as n^2, so n grows as sqrt(threads).
+ *            Rounded to a multiple of 16 so the chunks divide it.
+ */
+int weak_n(int base_n, int threads) {
+  int n = (int)(base_n * sqrt((double)threads) / 16 + 0.5) * 16;
+
+  return n < 16 ? 16 : n;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  report_scaling
+ * Purpose:   Print the scaling rows as one table per implementation, type,
+ *            mapping and base n, marking the thread count of the highest
+ *            speedup, and write them all to csv if it is not NULL.
+ * Return:    0 successful, -1 if csv cannot be written
+ */
+int report_scaling(const char *csv) {
+  static int printed[SCALING_MAX];
+  const scaling_row *r, *g;
+  double speedup, best;
+  int i, j, best_j;
+  FILE *f;
+
+  for (i = 0; i < scaling_count; i++) {
+    if (printed[i]) continue;
+    g = &scaling_rows[i];
+    best = 0;
+    best_j = i;
+    for (j = i; j < scaling_count; j++) {
+      r = &scaling_rows[j];
+      if (strcmp(r->impl, g->impl) || strcmp(r->mapping, g->mapping) ||
+          r->type != g->type || r->base_n != g->base_n)
+        continue;
+      speedup = r->seq_per_iteration / r->per_iteration;
+      if (speedup > best) {
+        best = speedup;
+        best_j = j;
+      }
+    }
+    fprintf(stderr, "\n%s scaling: %s %s %s, n = %d%s\n",
+            scaling == SCALING_WEAK ? "Weak" : "Strong", g->impl,
+            g->type == BENCH_UPPER_TRIANGULAR ? "upper" : "full", g->mapping,
+            g->base_n, scaling == SCALING_WEAK ? " per thread" : "");
+    fprintf(stderr, "%8s %8s %14s %14s %8s %10s\n", "threads", "n",
+            "sec/iteration", "seq sec/iter", "speedup", "efficiency");
+    for (j = i; j < scaling_count; j++) {
+      r = &scaling_rows[j];
+      if (strcmp(r->impl, g->impl) || strcmp(r->mapping, g->mapping) ||
+          r->type != g->type || r->base_n != g->base_n)
+        continue;
+      printed[j] = 1;
+      speedup = r->seq_per_iteration / r->per_iteration;
+      fprintf(stderr, "%8d %8d %14.9f %14.9f %8.3f %10.3f%s\n", r->threads,
+              r->n, r->per_iteration, r->seq_per_iteration, speedup,
+              speedup / r->threads, j == best_j ? "  *" : "");
+    }
+    fprintf(stderr, "Highest speedup %.3f at %d threads\n", best,
+            scaling_rows[best_j].threads);
+  }
+
+  if (csv == NULL) return 0;
+  if ((f = fopen(csv, "w")) == NULL) {
+    perror(csv);
+    return -1;
+  }
+  fprintf(f,
+          "scaling,impl,type,mapping,chunk,base_n,n,threads,iterations,"
+          "seconds_per_iteration,seq_seconds_per_iteration,speedup,"
+          "efficiency\n");
+  for (i = 0; i < scaling_count; i++) {
+    r = &scaling_rows[i];
+    speedup = r->seq_per_iteration / r->per_iteration;
+    fprintf(f, "%s,%s,%s,%s,%d,%d,%d,%d,%d,%.9g,%.9g,%.6f,%.6f\n",
+            scaling == SCALING_WEAK ? "weak" : "strong", r->impl,
+            r->type == BENCH_UPPER_TRIANGULAR ? "upper" : "full", r->mapping,
+            chunksize, r->base_n, r->n, r->threads, r->iterations,
+            r->per_iteration, r->seq_per_iteration, speedup,
+            speedup / r->threads);
+  }
+  if (fclose(f) != 0) {
+    perror(csv);
+    return -1;
+  }
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  bench_one
+ * Purpose:   Time one configuration reps times after warmup untimed runs
+ *            and append it to the JSON runs. In a scaling study seq is the
+ *            sequential time per iteration at the same n and type, and the
+ *            configuration is also added to the scaling rows.
+ * Return:    1 written, 0 if a run failed
+ */
+int bench_one(FILE *f, int *first, const bench_backend *b, const char *mapping,
+              const bench_config *cfg, int base_n, double seq) {
+  double seconds[REPS_MAX], sum = 0, median, low, high, flops, per_iteration;
+  const char *type =
+      cfg->matrix_type == BENCH_UPPER_TRIANGULAR ? "upper" : "full";
+  char key[128];
+  bench_result res;
+  scaling_row *row;
+  int r;
+
+  if (!measure(b, cfg, seconds, &res)) return 0;
+  for (r = 0; r < reps; r++) {
+    sum += seconds[r];
+  }
+
+  fprintf(f, "%s\n    {\"impl\": \"%s\", \"n\": %d, \"type\": \"%s\", "
+          "\"mapping\": ",
+          *first ? "" : ",", b->name, cfg->n, type);
+  json_string(f, mapping);
+  fprintf(f, ", \"threads\": %d, \"iterations\": %d, \"seconds\": [",
+          cfg->threads, res.iterations_done);
+  for (r = 0; r < reps; r++) {
+    fprintf(f, "%s%.9f", r ? ", " : "", seconds[r]);
+  }
+  bootstrap_median(seconds, reps, &low, &high);
+  qsort(seconds, reps, sizeof(double), compare_doubles);
+  median = sorted_median(seconds, reps);
+  flops = (cfg->matrix_type == BENCH_UPPER_TRIANGULAR
+               ? (double)cfg->n * (cfg->n + 1)
+               : 2.0 * cfg->n * cfg->n) *
+          res.iterations_done;
+  fprintf(f,
+          "],\n     \"min\": %.9f, \"median\": %.9f, \"mean\": %.9f, "
+          "\"median_ci\": [%.9f, %.9f], \"gflops\": %.4f, "
+          "\"checksum\": %.12g, \"imbalance\": ",
+          seconds[0], median, sum / reps, low, high, flops / median / 1e9,
+          res.checksum);
+  json_counter(f, res.imbalance);
+  fprintf(f, ", \"wait_fraction\": ");
+  json_counter(f, res.wait_fraction);
+  per_iteration = median / (res.iterations_done > 0 ? res.iterations_done : 1);
+  if (seq > 0) {
+    fprintf(f, ",\n     \"seq_seconds_per_iteration\": %.9g, "
+            "\"speedup\": %.4f, \"efficiency\": %.4f",
+            seq, seq / per_iteration, seq / per_iteration / cfg->threads);
+    if (scaling_count < SCALING_MAX) {
+      row = &scaling_rows[scaling_count++];
+      snprintf(row->impl, sizeof(row->impl), "%s", b->name);
+      snprintf(row->mapping, sizeof(row->mapping), "%s", mapping);
+      row->type = cfg->matrix_type;
+      row->base_n = base_n;
+      row->n = cfg->n;
+      row->threads = cfg->threads;
+      row->iterations = res.iterations_done;
+      row->per_iteration = per_iteration;
+      row->seq_per_iteration = seq;
+    }
+  }
+  fprintf(f, "}");
+  *first = 0;
+
+  snprintf(key, sizeof(key), "%s %d %s %s %d %d %d", b->name, cfg->n, type,
+           mapping, cfg->chunksize, cfg->threads, cfg->iterations);
+  if (save_file != NULL) {
+    fprintf(save_file, "%s %.9f %.9f %.9f\n", key, median, low, high);
+  }
+  baseline_compare(key, median, low, high);
+
+  fprintf(stderr,
+          "%s n=%d %s %s chunk=%d threads=%d: median %f sec, %.4f GFLOPS, "
+          "%d iterations\n",
+          b->name, cfg->n, type, mapping, cfg->chunksize, cfg->threads, median,
+          flops / median / 1e9, res.iterations_done);
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  static struct option options[] = {
+      {"impl", required_argument, NULL, 'i'},
+      {"n", required_argument, NULL, 'n'},
+      {"t", required_argument, NULL, 't'},
+      {"type", required_argument, NULL, 'y'},
+      {"mapping", required_argument, NULL, 'm'},
+      {"chunk", required_argument, NULL, 'c'},
+      {"threads", required_argument, NULL, 'p'},
+      {"reps", required_argument, NULL, 'r'},
+      {"warmup", required_argument, NULL, 'w'},
+      {"output", required_argument, NULL, 'o'},
+      {"lib-dir", required_argument, NULL, 'L'},
+      {"save-baseline", required_argument, NULL, 's'},
+      {"check", required_argument, NULL, 'k'},
+      {"threshold", required_argument, NULL, 'T'},
+      {"scaling", required_argument, NULL, 'S'},
+      {"csv", required_argument, NULL, 'v'},
+      {NULL, 0, NULL, 0}};
+  char default_impl[] = "seq", default_mapping[] = "block";
+  char default_type[] = "full";
+  char exe[PATH_MAX], *slash, *output = NULL, *save = NULL, *check = NULL;
+  char *csv = NULL;
+  const bench_backend *b;
+  bench_config cfg;
+  FILE *f = stdout;
+  int opt, i, j, k, m, y, first = 1, status = 0, dims_given = 0;
+  int threads_given = 0;
+  long cores;
+  double seq = 0;
+  ssize_t len;
+
+  dims[0] = 1024;
+  threads[0] = 1;
+  dim_count = thread_count = 1;
+  impls[0] = default_impl;
+  mappings[0] = default_mapping;
+  type_names[0] = default_type;
+  impl_count = mapping_count = type_count = 1;
+  while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (opt) {
+    case 'i': impl_count = split_list(optarg, impls); break;
+    case 'n':
+      dim_count = split_ints(optarg, dims);
+      dims_given = 1;
+      break;
+    case 't': iterations = atoi(optarg); break;
+    case 'y': type_count = split_list(optarg, type_names); break;
+    case 'm': mapping_count = split_list(optarg, mappings); break;
+    case 'c': chunksize = atoi(optarg); break;
+    case 'p':
+      thread_count = split_ints(optarg, threads);
+      threads_given = 1;
+      break;
+    case 'r': reps = atoi(optarg); break;
+    case 'w': warmup = atoi(optarg); break;
+    case 'o': output = optarg; break;
+    case 'L': lib_dir = optarg; break;
+    case 's': save = optarg; break;
+    case 'k': check = optarg; break;
+    case 'T': threshold = atof(optarg); break;
+    case 'S':
+      if (strcmp(optarg, "strong") == 0)
+        scaling = SCALING_STRONG;
+      else if (strcmp(optarg, "weak") == 0)
+        scaling = SCALING_WEAK;
+      else
+        scaling = -1;
+      break;
+    case 'v': csv = optarg; break;
+    default: usage(); return 1;
+    }
+  }
+  for (y = 0; y < type_count; y++) {
+    if (strcmp(type_names[y], "upper") == 0)
+      types[y] = BENCH_UPPER_TRIANGULAR;
+    else if (strcmp(type_names[y], "full") == 0)
+      types[y] = 0;
+    else
+      type_count = -1;
+  }
+  if (optind < argc || impl_count <= 0 || dim_count <= 0 ||
+      mapping_count <= 0 || thread_count <= 0 || type_count <= 0 ||
+      iterations <= 0 || chunksize < 0 || reps <= 0 || reps > REPS_MAX ||
+      warmup < 0 || threshold < 0 || scaling < 0 ||
+      (csv != NULL && scaling == SCALING_NONE)) {
+    usage();
+    return 1;
+  }
+  if (scaling != SCALING_NONE) {
+    if (!dims_given) dims[0] = scaling == SCALING_STRONG ? 4096 : 1024;
+    if (!threads_given) {
+      /* Every count up to the cores, or powers of two and the cores. */
+      cores = sysconf(_SC_NPROCESSORS_ONLN);
+      if (cores < 1) cores = 1;
+      thread_count = 0;
+      for (i = 1; i <= cores && thread_count < LIST_MAX - 1; i++) {
+        if (cores <= LIST_MAX || (i & (i - 1)) == 0)
+          threads[thread_count++] = i;
+      }
+      if (threads[thread_count - 1] != cores) threads[thread_count++] = cores;
+    }
+  }
+  if (lib_dir == NULL) {
+    /* Look next to the executable. */
+    len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    exe[len > 0 ? len : 0] = '\0';
+    slash = strrchr(exe, '/');
+    if (slash != NULL) {
+      *slash = '\0';
+      lib_dir = exe;
+    } else {
+      lib_dir = ".";
+    }
+  }
+  if (check != NULL && load_baseline(check) != 0) {
+    return 1;
+  }
+  if (output != NULL && (f = fopen(output, "w")) == NULL) {
+    perror(output);
+    return 1;
+  }
+  if (save != NULL) {
+    if ((save_file = fopen(save, "w")) == NULL) {
+      perror(save);
+      return 1;
+    }
+    fprintf(save_file,
+            "# itmv_bench baseline, %d repetitions: impl n type mapping "
+            "chunk threads t median ci_low ci_high\n",
+            reps);
+  }
+
+  json_metadata(f);
+  for (i = 0; i < impl_count; i++) {
+    if ((b = load_backend(impls[i])) == NULL) {
+      status = 1;
+      continue;
+    }
+    for (y = 0; y < type_count; y++) {
+      for (j = 0; j < dim_count; j++) {
+        for (k = 0; k < thread_count; k++) {
+          /* seq has no threads to scale: its one row checks the baseline. */
+          if (scaling != SCALING_NONE && b == bench_seq_backend() &&
+              threads[k] > 1)
+            continue;
+          cfg.n = scaling == SCALING_WEAK ? weak_n(dims[j], threads[k])
+                                          : dims[j];
+          cfg.matrix_type = types[y];
+          cfg.chunksize = chunksize;
+          cfg.threads = threads[k];
+          cfg.iterations = iterations;
+          if (scaling != SCALING_NONE &&
+              (seq = seq_per_iteration(cfg.n, cfg.matrix_type)) <= 0) {
+            fprintf(stderr, "itmv_bench: seq n=%d: baseline failed\n", cfg.n);
+            status = 1;
+            continue;
+          }
+          if (!b->setup(&cfg)) {
+            fprintf(stderr, "itmv_bench: %s n=%d: out of memory\n", b->name,
+                    cfg.n);
+            status = 1;
+            continue;
+          }
+          for (m = 0; m < mapping_count; m++) {
+            cfg.mapping = b->mapping(mappings[m]);
+            if (cfg.mapping < 0) {
+              fprintf(stderr, "itmv_bench: %s has no mapping %s, skipped\n",
+                      b->name, mappings[m]);
+              continue;
+            }
+            if (!bench_one(f, &first, b, mappings[m], &cfg, dims[j], seq)) {
+              fprintf(stderr, "itmv_bench: %s n=%d threads=%d: run failed\n",
+                      b->name, cfg.n, cfg.threads);
+              status = 1;
+            }
+          }
+          b->teardown();
+        }
+      }
+    }
+  }
+  fprintf(f, "\n  ]\n}\n");
+  if (f != stdout && fclose(f) != 0) {
+    perror(output);
+    return 1;
+  }
+  if (save_file != NULL && fclose(save_file) != 0) {
+    perror(save);
+    return 1;
+  }
+  if (scaling != SCALING_NONE && report_scaling(csv) != 0) {
+    status = 1;
+  }
+  if (check != NULL && report_baseline() > 0 && status == 0) {
+    status = 2;
+  }
+  return status;
+}
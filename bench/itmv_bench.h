@@ -0,0 +1,63 @@
+/*
+ * File: itmv_bench.h
+ *
+ * Purpose: Interface between the benchmark driver itmv_bench and its
+ *          implementations of the Jacobi iteration y = d + Ax. The
+ *          sequential one is built into the driver; the pthreads, OpenMP
+ *          and BLAS ones are shared libraries libitmv_bench_<impl>.so,
+ *          loaded on demand, since the pthreads and OpenMP drivers define
+ *          the same globals and cannot be linked into one program.
+ *
+ *          Every implementation runs on the test matrix of the test
+ *          harnesses (bench_initialize), so x converges to all ones.
+ */
+
+#ifndef _ITMV_BENCH_CS140
+#define _ITMV_BENCH_CS140
+
+#define BENCH_UPPER_TRIANGULAR 1
+
+/* Threshold on max |y_i - x_i| at which every implementation stops. */
+#define BENCH_ERROR_THRESHOLD 1e-3
+
+/* Name of the function each shared library exports. */
+#define BENCH_ENTRY "itmv_bench_backend"
+
+typedef struct {
+  int n;
+  int matrix_type;
+  int mapping;   /* the implementation's own code, from its mapping() */
+  int chunksize;
+  int threads;
+  int iterations; /* at most t iterations */
+} bench_config;
+
+typedef struct {
+  double seconds;       /* wall time of the iteration alone */
+  int iterations_done;
+  double checksum;      /* sum of the final y */
+  double imbalance;     /* max/mean per-thread compute time, 0 if unknown */
+  double wait_fraction; /* mean barrier wait over wall time, 0 if unknown */
+} bench_result;
+
+typedef struct {
+  const char *name;
+  /* Mapping code for a mapping name, or -1 if not supported. */
+  int (*mapping)(const char *name);
+  /* Allocate and build the test matrix. Return 0 if out of memory. */
+  int (*setup)(const bench_config *cfg);
+  /* Reset x and run once. Return 0 on failure. */
+  int (*run)(const bench_config *cfg, bench_result *res);
+  void (*teardown)(void);
+} bench_backend;
+
+typedef const bench_backend *(*bench_entry)(void);
+
+void bench_initialize(double A[], double x[], double d[], double y[], int n,
+                      int matrix_type);
+
+double bench_checksum(const double y[], int n);
+
+double bench_now(void);
+
+#endif
@@ -0,0 +1,322 @@
+/*
+ * File:     itmv_kernel_bench.c
+ *
+ * Purpose:  Time the row kernels of itmv_kernels.h alone, on one thread,
+ *           with A sized to stay in L1, L2 or the last level cache, or to
+ *           stream from DRAM. Each block of rows is swept repeatedly, so
+ *           after the first sweep A is wherever its size lets it stay.
+ *           Reports cycles per row, flops per cycle and bytes per cycle,
+ *           medians over the repetitions, and checks every kernel against
+ *           the scalar one.
+ *
+ *           Cycles are core cycles from the perf_event hardware counter
+ *           when the kernel allows it, otherwise time stamp counter ticks
+ *           (x86), otherwise nanoseconds; the header says which.
+ *
+ * Usage:    itmv_kernel_bench [--kernel scalar,unroll4,simd,rows4]
+ *                             [--scenario L1,L2,LLC,DRAM] [--n 512,...]
+ *                             [--type full|upper] [--reps r]
+ *
+ *           Without --n each scenario uses the largest square A that fits
+ *           half of its cache (twice the last level cache for DRAM);
+ *           with --n, A has n columns and as many rows as fit.
+ */
+
+#include <getopt.h>
+#include <linux/perf_event.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include "itmv_kernels.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define LIST_MAX 16
+#define REPS_MAX 101
+/* Multiply-adds per timed measurement, so short sweeps are repeated. */
+#define MEASURE_ENTRIES 2000000L
+#define CHECK_THRESHOLD 1e-10
+
+#define CLOCK_PERF 0
+#define CLOCK_TSC 1
+#define CLOCK_NS 2
+
+int clock_source = CLOCK_NS;
+int perf_fd = -1;
+
+/*-------------------------------------------------------------------
+ * Pick the most precise cycle counter available.
+ */
+void cycles_open(void) {
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CPU_CYCLES;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  perf_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  if (perf_fd >= 0) {
+    clock_source = CLOCK_PERF;
+    return;
+  }
+#if defined(__x86_64__) || defined(__i386__)
+  clock_source = CLOCK_TSC;
+#endif
+}
+
+unsigned long long cycles_now(void) {
+  unsigned long long count = 0;
+  struct timespec ts;
+
+  if (clock_source == CLOCK_PERF) {
+    if (read(perf_fd, &count, sizeof(count)) != sizeof(count)) count = 0;
+    return count;
+  }
+#if defined(__x86_64__) || defined(__i386__)
+  if (clock_source == CLOCK_TSC) {
+    unsigned int aux;
+    return __rdtscp(&aux);
+  }
+#endif
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+double seconds_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*-------------------------------------------------------------------
+ * Return the size in bytes of a cache level from sysconf, or fallback if
+ * the system does not say.
+ */
+long cache_size(int name, long fallback) {
+  long size = sysconf(name);
+  return size > 0 ? size : fallback;
+}
+
+int compare_doubles(const void *a, const void *b) {
+  double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+int split_list(char *list, char *items[]) {
+  int count = 0;
+  char *item;
+
+  for (item = strtok(list, ","); item != NULL; item = strtok(NULL, ",")) {
+    if (count == LIST_MAX) return -1;
+    items[count++] = item;
+  }
+  return count;
+}
+
+void *alloc_doubles(long count) {
+  void *p = NULL;
+  if (posix_memalign(&p, 64, (count > 0 ? count : 1) * sizeof(double)) != 0)
+    return NULL;
+  return p;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  bench_kernel
+ * Purpose:   Time kernel on rows [0, rows) of A, n columns, reps times.
+ * Out args:  cycles: median cycles per sweep
+ *            seconds: median seconds per sweep
+ */
+void bench_kernel(row_kernel kernel, const double *A, const double *x,
+                  const double *d, double *y, int rows, int n, int upper,
+                  int reps, double *cycles, double *seconds) {
+  double c[REPS_MAX], s[REPS_MAX], entries;
+  unsigned long long c0;
+  double s0;
+  long sweeps, k;
+  int r;
+
+  entries = upper ? (double)rows * n - (double)rows * (rows - 1) / 2
+                  : (double)rows * n;
+  sweeps = MEASURE_ENTRIES / entries;
+  if (sweeps < 1) sweeps = 1;
+  kernel(A, x, d, y, 0, rows, n, upper); /* warm the caches */
+  for (r = 0; r < reps; r++) {
+    s0 = seconds_now();
+    c0 = cycles_now();
+    for (k = 0; k < sweeps; k++) {
+      kernel(A, x, d, y, 0, rows, n, upper);
+    }
+    c[r] = (double)(cycles_now() - c0) / sweeps;
+    s[r] = (seconds_now() - s0) / sweeps;
+  }
+  qsort(c, reps, sizeof(double), compare_doubles);
+  qsort(s, reps, sizeof(double), compare_doubles);
+  *cycles = c[reps / 2];
+  *seconds = s[reps / 2];
+}
+
+void usage(void) {
+  fprintf(stderr,
+          "itmv_kernel_bench [--kernel scalar,unroll4,simd,rows4] "
+          "[--scenario L1,L2,LLC,DRAM]\n"
+          "                  [--n 512,...] [--type full|upper] [--reps r]\n");
+}
+
+int main(int argc, char *argv[]) {
+  static struct option options[] = {
+      {"kernel", required_argument, NULL, 'k'},
+      {"scenario", required_argument, NULL, 's'},
+      {"n", required_argument, NULL, 'n'},
+      {"type", required_argument, NULL, 'y'},
+      {"reps", required_argument, NULL, 'r'},
+      {NULL, 0, NULL, 0}};
+  static const char *clock_names[] = {"core cycles (perf_event)",
+                                      "time stamp counter ticks",
+                                      "nanoseconds (no cycle counter)"};
+  char all_kernels[] = "scalar,unroll4,simd,rows4",
+       all_scenarios[] = "L1,L2,LLC,DRAM";
+  char *kernel_names[LIST_MAX], *scenarios[LIST_MAX], *dim_names[LIST_MAX];
+  char *kernel_list = all_kernels, *scenario_list = all_scenarios;
+  char *dim_list = NULL;
+  int kernel_count, scenario_count, dim_count = 1, upper = 0, reps = 7;
+  int opt, s, m, k, q, n, rows, status = 0;
+  long l1, l2, llc, ws;
+  long dims[LIST_MAX];
+  row_kernel kernels[LIST_MAX];
+  double *A, *x, *d, *y, *yref, cycles, seconds, entries, bytes, err;
+
+  while ((opt = getopt_long(argc, argv, "", options, NULL)) != -1) {
+    switch (opt) {
+    case 'k': kernel_list = optarg; break;
+    case 's': scenario_list = optarg; break;
+    case 'n': dim_list = optarg; break;
+    case 'y':
+      upper = strcmp(optarg, "upper") == 0 ? 1
+              : strcmp(optarg, "full") == 0 ? 0
+                                             : -1;
+      break;
+    case 'r': reps = atoi(optarg); break;
+    default: usage(); return 1;
+    }
+  }
+  kernel_count = split_list(kernel_list, kernel_names);
+  scenario_count = split_list(scenario_list, scenarios);
+  if (dim_list != NULL) dim_count = split_list(dim_list, dim_names);
+  if (optind < argc || kernel_count <= 0 || scenario_count <= 0 ||
+      dim_count <= 0 || upper < 0 || reps <= 0 || reps > REPS_MAX) {
+    usage();
+    return 1;
+  }
+  for (k = 0; k < kernel_count; k++) {
+    kernels[k] = NULL;
+    for (q = 0; q < row_kernel_count; q++) {
+      if (strcmp(kernel_names[k], row_kernels[q].name) == 0)
+        kernels[k] = row_kernels[q].kernel;
+    }
+    if (kernels[k] == NULL) {
+      fprintf(stderr, "itmv_kernel_bench: no kernel %s\n", kernel_names[k]);
+      return 1;
+    }
+  }
+  for (m = 0; dim_list != NULL && m < dim_count; m++) {
+    dims[m] = atol(dim_names[m]);
+    if (dims[m] <= 0) {
+      usage();
+      return 1;
+    }
+  }
+
+  l1 = cache_size(_SC_LEVEL1_DCACHE_SIZE, 32L << 10);
+  l2 = cache_size(_SC_LEVEL2_CACHE_SIZE, 1L << 20);
+  llc = cache_size(_SC_LEVEL3_CACHE_SIZE, l2 > (32L << 20) ? l2 : 32L << 20);
+  cycles_open();
+  printf("Caches: L1 %ld KiB, L2 %ld KiB, LLC %ld KiB. Clock: %s. %s A, "
+         "median of %d\n",
+         l1 >> 10, l2 >> 10, llc >> 10, clock_names[clock_source],
+         upper ? "upper triangular" : "full", reps);
+  printf("%-8s %-5s %6s %6s %10s %10s %11s %11s %8s\n", "kernel", "cache",
+         "n", "rows", "A KiB", "cycles/row", "flops/cycle", "bytes/cycle",
+         "GFLOPS");
+
+  for (s = 0; s < scenario_count; s++) {
+    if (strcmp(scenarios[s], "L1") == 0)
+      ws = l1 / 2;
+    else if (strcmp(scenarios[s], "L2") == 0)
+      ws = l2 / 2;
+    else if (strcmp(scenarios[s], "LLC") == 0)
+      ws = llc / 2;
+    else if (strcmp(scenarios[s], "DRAM") == 0)
+      ws = 2 * llc;
+    else {
+      fprintf(stderr, "itmv_kernel_bench: no scenario %s\n", scenarios[s]);
+      return 1;
+    }
+    for (m = 0; m < dim_count; m++) {
+      if (dim_list == NULL) {
+        /* The largest square A, a multiple of 16 wide, within ws. */
+        n = (int)sqrt(ws / sizeof(double)) / 16 * 16;
+        if (n < 16) n = 16;
+        rows = n;
+      } else {
+        n = dims[m];
+        rows = ws / sizeof(double) / n;
+        if (rows < 4) rows = 4;
+        if (rows > n) rows = n;
+      }
+      A = alloc_doubles((long)rows * n);
+      x = alloc_doubles(n);
+      d = alloc_doubles(rows);
+      y = alloc_doubles(rows);
+      yref = alloc_doubles(rows);
+      if (A == NULL || x == NULL || d == NULL || y == NULL || yref == NULL) {
+        fprintf(stderr, "itmv_kernel_bench: out of memory for n=%d\n", n);
+        return 1;
+      }
+      for (long e = 0; e < (long)rows * n; e++) {
+        A[e] = ((e * 37) % 101 - 50) / (50.0 * n);
+      }
+      for (k = 0; k < n; k++) {
+        x[k] = 1 + (k % 7) / 7.0;
+      }
+      for (k = 0; k < rows; k++) {
+        d[k] = 1 - (k % 5) / 5.0;
+      }
+      kernel_scalar(A, x, d, yref, 0, rows, n, upper);
+
+      entries = upper ? (double)rows * n - (double)rows * (rows - 1) / 2
+                      : (double)rows * n;
+      /* A's entries, x, and d and y once per row. */
+      bytes = (entries + n + 2.0 * rows) * sizeof(double);
+      for (k = 0; k < kernel_count; k++) {
+        memset(y, 0, rows * sizeof(double));
+        bench_kernel(kernels[k], A, x, d, y, rows, n, upper, reps, &cycles,
+                     &seconds);
+        err = 0;
+        for (q = 0; q < rows; q++) {
+          err = fmax(err, fabs(y[q] - yref[q]));
+        }
+        printf("%-8s %-5s %6d %6d %10.1f %10.2f %11.3f %11.3f %8.3f%s\n",
+               kernel_names[k], scenarios[s], n, rows,
+               (double)rows * n * sizeof(double) / 1024, cycles / rows,
+               2 * entries / cycles, bytes / cycles,
+               2 * entries / seconds / 1e9,
+               err > CHECK_THRESHOLD ? "  MISMATCH" : "");
+        if (err > CHECK_THRESHOLD) status = 1;
+      }
+      free(A);
+      free(x);
+      free(d);
+      free(y);
+      free(yref);
+    }
+  }
+  if (perf_fd >= 0) close(perf_fd);
+  return status;
+}
@@ -0,0 +1,124 @@
+/*
+ * File: itmv_kernels.c
+ *
+ * Purpose: The row kernel variants of itmv_kernels.h.
+ */
+
+#include "itmv_kernels.h"
+
+const row_kernel_info row_kernels[] = {
+    {"scalar", kernel_scalar},
+    {"unroll4", kernel_unroll4},
+    {"simd", kernel_simd},
+    {"rows4", kernel_rows4},
+};
+const int row_kernel_count = sizeof(row_kernels) / sizeof(row_kernels[0]);
+
+/*-------------------------------------------------------------------
+ * The drivers' kernel: one accumulator, one row at a time.
+ */
+void kernel_scalar(const double *A, const double *x, const double *d,
+                   double *y, int first, int rows, int n, int upper) {
+  int i, j;
+  double sum;
+  const double *a;
+
+  for (i = first; i < first + rows; i++) {
+    a = A + (long)i * n;
+    sum = d[i];
+    for (j = upper ? i : 0; j < n; j++) {
+      sum += a[j] * x[j];
+    }
+    y[i] = sum;
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Four independent accumulators, so consecutive multiply-adds do not wait
+ * on each other's latency.
+ */
+void kernel_unroll4(const double *A, const double *x, const double *d,
+                    double *y, int first, int rows, int n, int upper) {
+  int i, j;
+  double s0, s1, s2, s3;
+  const double *a;
+
+  for (i = first; i < first + rows; i++) {
+    a = A + (long)i * n;
+    s0 = s1 = s2 = s3 = 0;
+    for (j = upper ? i : 0; j + 3 < n; j += 4) {
+      s0 += a[j] * x[j];
+      s1 += a[j + 1] * x[j + 1];
+      s2 += a[j + 2] * x[j + 2];
+      s3 += a[j + 3] * x[j + 3];
+    }
+    for (; j < n; j++) {
+      s0 += a[j] * x[j];
+    }
+    y[i] = d[i] + ((s0 + s1) + (s2 + s3));
+  }
+}
+
+/*-------------------------------------------------------------------
+ * The compiler's vector reduction (OpenMP simd, no intrinsics), which
+ * keeps one accumulator per lane.
+ */
+void kernel_simd(const double *A, const double *x, const double *d,
+                 double *y, int first, int rows, int n, int upper) {
+  int i, j;
+  double sum;
+  const double *a;
+
+  for (i = first; i < first + rows; i++) {
+    a = A + (long)i * n;
+    sum = 0;
+#pragma omp simd reduction(+ : sum)
+    for (j = upper ? i : 0; j < n; j++) {
+      sum += a[j] * x[j];
+    }
+    y[i] = d[i] + sum;
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Four rows at a time, so each x[j] loaded serves four rows. For an upper
+ * triangular A the three leading columns the rows do not share are done
+ * row by row first.
+ */
+void kernel_rows4(const double *A, const double *x, const double *d,
+                  double *y, int first, int rows, int n, int upper) {
+  int i, j, r, start;
+  double s0, s1, s2, s3;
+  const double *a0, *a1, *a2, *a3;
+
+  for (i = first; i + 3 < first + rows; i += 4) {
+    a0 = A + (long)i * n;
+    a1 = a0 + n;
+    a2 = a1 + n;
+    a3 = a2 + n;
+    s0 = s1 = s2 = s3 = 0;
+    start = 0;
+    if (upper) {
+      for (j = i; j < i + 3 && j < n; j++) {
+        s0 += a0[j] * x[j];
+        if (j >= i + 1) s1 += a1[j] * x[j];
+        if (j >= i + 2) s2 += a2[j] * x[j];
+      }
+      start = i + 3;
+    }
+    for (j = start; j < n; j++) {
+      s0 += a0[j] * x[j];
+      s1 += a1[j] * x[j];
+      s2 += a2[j] * x[j];
+      s3 += a3[j] * x[j];
+    }
+    y[i] = d[i] + s0;
+    y[i + 1] = d[i + 1] + s1;
+    y[i + 2] = d[i + 2] + s2;
+    y[i + 3] = d[i + 3] + s3;
+  }
+  r = first + rows - i;
+  if (r > 0) {
+    kernel_scalar(A, x, d, y, i, r, n, upper);
+  }
+}
@@ -0,0 +1,36 @@
+/*
+ * File: itmv_kernels.h
+ *
+ * Purpose: Variants of the row kernel y[i] = d[i] + A[i]x of the drivers
+ *          (mv_row in ../pthreads/itmv_mult_pth.c), on a block of rows, for
+ *          itmv_kernel_bench to time in isolation before one is wired into
+ *          the drivers. Every variant gives the scalar kernel's result up
+ *          to rounding; with upper set a row i starts at column i, as for
+ *          an upper triangular A.
+ */
+
+#ifndef _ITMV_KERNELS_CS140
+#define _ITMV_KERNELS_CS140
+
+typedef void (*row_kernel)(const double *A, const double *x, const double *d,
+                           double *y, int first, int rows, int n, int upper);
+
+typedef struct {
+  const char *name;
+  row_kernel kernel;
+} row_kernel_info;
+
+/* All variants, the scalar reference first. */
+extern const row_kernel_info row_kernels[];
+extern const int row_kernel_count;
+
+void kernel_scalar(const double *A, const double *x, const double *d,
+                   double *y, int first, int rows, int n, int upper);
+void kernel_unroll4(const double *A, const double *x, const double *d,
+                    double *y, int first, int rows, int n, int upper);
+void kernel_simd(const double *A, const double *x, const double *d,
+                 double *y, int first, int rows, int n, int upper);
+void kernel_rows4(const double *A, const double *x, const double *d,
+                  double *y, int first, int rows, int n, int upper);
+
+#endif
@@ -0,0 +1,20 @@
+#!/bin/bash  
+# Next line shows the job name you can find when querying the job status
+#SBATCH --job-name="itmvbench"
+# Next line is the output file name of the execution log
+#SBATCH --output="job_itmvbench.%j.out"
+# Next line shows where to ask for machine nodes
+#SBATCH --partition=shared
+#Next line asks for 1 machine node and  8 core per node 
+#SBATCH --nodes=1
+#SBATCH --ntasks-per-node=8
+#SBATCH --export=ALL
+# Next line limits the job execution time at most 10 minute.
+#SBATCH -t 00:10:00
+#SBATCH --account=csb175
+
+
+./itmv_bench --impl seq,pth,omp,blas --n 1024,4096 --threads 1,2,4,8 --mapping block,cyclic,dynamic --output bench_$SLURM_JOB_ID.json
+./itmv_bench --impl seq,pth,omp,blas --type upper --n 1024,4096 --threads 1,2,4,8 --mapping block,cyclic,dynamic --output bench_upper_$SLURM_JOB_ID.json
+./itmv_bench --impl pth,omp --type full,upper --mapping block,cyclic,dynamic --t 256 --scaling strong --n 4096 --output scaling_strong_$SLURM_JOB_ID.json --csv scaling_strong_$SLURM_JOB_ID.csv
+./itmv_bench --impl pth,omp --type full,upper --mapping block,cyclic,dynamic --t 256 --scaling weak --n 1024 --output scaling_weak_$SLURM_JOB_ID.json --csv scaling_weak_$SLURM_JOB_ID.csv
@@ -0,0 +1,199 @@
+/*
+ * File: affinity.c
+ *
+ * Purpose: Resolve the thread pinning policies of the itmv drivers into
+ *          CPU lists. Binding threads to them is up to each driver. See
+ *          affinity.h.
+ */
+
+#define _GNU_SOURCE
+#include "affinity.h"
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The CPUs thread i is pinned to are affinity_cpus[i % affinity_count]. */
+cpu_info affinity_cpus[CPU_SETSIZE];
+int affinity_count = 0;
+const char *affinity_spec = "none";
+
+/*-------------------------------------------------------------------
+ * Read an integer topology attribute of a CPU from sysfs.
+ * Return the value, or fallback if the file cannot be read.
+ */
+int read_topology(int cpu, const char *name, int fallback) {
+  char path[128];
+  int value;
+  FILE *f;
+
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/%s",
+           cpu, name);
+  f = fopen(path, "r");
+  if (f == NULL) return fallback;
+  if (fscanf(f, "%d", &value) != 1) value = fallback;
+  fclose(f);
+  return value;
+}
+
+int compare_compact(const void *a, const void *b) {
+  const cpu_info *p = a, *q = b;
+  if (p->package != q->package) return p->package - q->package;
+  if (p->core != q->core) return p->core - q->core;
+  return p->id - q->id;
+}
+
+int compare_scatter(const void *a, const void *b) {
+  const cpu_info *p = a, *q = b;
+  if (p->smt != q->smt) return p->smt - q->smt;
+  if (p->core != q->core) return p->core - q->core;
+  if (p->package != q->package) return p->package - q->package;
+  return p->id - q->id;
+}
+
+/*-------------------------------------------------------------------
+ * Parse an explicit CPU list such as "0,2,4-7" into out, keeping the
+ * order given. Every CPU must be in the allowed set.
+ * Return 0 if successful, otherwise -1.
+ */
+int parse_cpu_list(const char *spec, cpu_set_t *allowed, cpu_info *all,
+                   int nall, cpu_info *out, int *count) {
+  const char *p = spec;
+  char *end;
+  long first, last, c;
+  int i;
+
+  while (*p) {
+    first = strtol(p, &end, 10);
+    if (end == p) return -1;
+    last = first;
+    if (*end == '-') {
+      p = end + 1;
+      last = strtol(p, &end, 10);
+      if (end == p || last < first) return -1;
+    }
+    for (c = first; c <= last; c++) {
+      if (c >= CPU_SETSIZE || !CPU_ISSET(c, allowed)) {
+        printf("Affinity: cpu %ld is not in this process's cpuset\n", c);
+        return -1;
+      }
+      for (i = 0; i < nall && all[i].id != c; i++)
+        ;
+      if (*count < CPU_SETSIZE) out[(*count)++] = all[i];
+    }
+    if (*end == ',') end++;
+    else if (*end != '\0') return -1;
+    p = end;
+  }
+  return *count > 0 ? 0 : -1;
+}
+
+/*-------------------------------------------------------------------
+ * Resolve a policy other than none into an ordered list of CPUs.
+ * Touches no globals, so it is safe to call from several threads.
+ *
+ * Return:   0 successful, otherwise -1.
+ */
+int resolve_policy(const char *spec, cpu_info *out, int *count) {
+  cpu_set_t allowed;
+  cpu_info all[CPU_SETSIZE];
+  int nall = 0, i, j, c;
+
+  *count = 0;
+  /* The process mask already reflects the cgroup cpuset and any taskset. */
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return -1;
+  for (c = 0; c < CPU_SETSIZE; c++) {
+    if (!CPU_ISSET(c, &allowed)) continue;
+    all[nall].id = c;
+    all[nall].package = read_topology(c, "physical_package_id", 0);
+    all[nall].core = read_topology(c, "core_id", c);
+    all[nall].smt = 0;
+    for (j = 0; j < nall; j++) {
+      if (all[j].package == all[nall].package && all[j].core == all[nall].core)
+        all[nall].smt++;
+    }
+    nall++;
+  }
+
+  if (strcmp(spec, "compact") == 0) {
+    memcpy(out, all, nall * sizeof(cpu_info));
+    *count = nall;
+    qsort(out, *count, sizeof(cpu_info), compare_compact);
+  } else if (strcmp(spec, "scatter") == 0) {
+    memcpy(out, all, nall * sizeof(cpu_info));
+    *count = nall;
+    qsort(out, *count, sizeof(cpu_info), compare_scatter);
+  } else if (strcmp(spec, "physical") == 0) {
+    for (i = 0; i < nall; i++) {
+      if (all[i].smt == 0) out[(*count)++] = all[i];
+    }
+    qsort(out, *count, sizeof(cpu_info), compare_scatter);
+  } else if (parse_cpu_list(spec, &allowed, all, nall, out, count) != 0) {
+    *count = 0;
+    return -1;
+  }
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Build the CPU list for a policy.
+ *
+ * Argument:  spec -- compact, scatter, physical, none, or a CPU list.
+ *                    NULL means none.
+ *
+ * Return:   0 successful, otherwise -1 meaning the spec is invalid or
+ *           names CPUs outside the cpuset.
+ */
+int affinity_init(const char *spec) {
+  affinity_count = 0;
+  affinity_spec = spec ? spec : "none";
+  if (strcmp(affinity_spec, "none") == 0) return 0;
+
+  if (resolve_policy(affinity_spec, affinity_cpus, &affinity_count) != 0) {
+    printf("Affinity: invalid policy or cpu list \"%s\"\n", affinity_spec);
+    return -1;
+  }
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Resolve a policy into CPU ids without changing the process-wide
+ * policy, for callers that pin several thread teams differently.
+ *
+ * Argument:  spec -- as for affinity_init.
+ *            cpus -- out: the CPU ids in pinning order.
+ *            max -- room in cpus.
+ *
+ * Return:   the number of CPUs stored, 0 for none, or -1 if the spec is
+ *           invalid.
+ */
+int affinity_cpu_list(const char *spec, int cpus[], int max) {
+  cpu_info *list;
+  int count, i;
+
+  if (spec == NULL || strcmp(spec, "none") == 0) return 0;
+  list = malloc(CPU_SETSIZE * sizeof(cpu_info));
+  if (resolve_policy(spec, list, &count) != 0) {
+    printf("Affinity: invalid policy or cpu list \"%s\"\n", spec);
+    free(list);
+    return -1;
+  }
+  if (count > max) count = max;
+  for (i = 0; i < count; i++) cpus[i] = list[i].id;
+  free(list);
+  return count;
+}
+
+/*-------------------------------------------------------------------
+ * Return 1 if threads are to be pinned, otherwise 0.
+ */
+int affinity_enabled(void) { return affinity_count > 0; }
+
+/*-------------------------------------------------------------------
+ * Return the CPU thread rank is pinned to, or -1 if not pinned.
+ */
+int affinity_cpu(int rank) {
+  if (affinity_count == 0) return -1;
+  return affinity_cpus[rank % affinity_count].id;
+}
+
@@ -0,0 +1,60 @@
+/*
+ * File: affinity.h
+ *
+ * Purpose: Pin the itmv threads to CPUs. A policy string picks an ordered
+ *          list of CPUs out of those this process may run on (the cgroup
+ *          cpuset), and thread i is pinned to entry i of that list,
+ *          wrapping around when there are more threads than entries.
+ *
+ *          compact  -- fill a physical core's SMT siblings before moving on
+ *          scatter  -- one thread per physical core, spread over sockets,
+ *                      before using any SMT sibling
+ *          physical -- one thread per physical core, siblings never used
+ *          0,2,4-7  -- an explicit list of CPU ids, used in that order
+ *          none     -- do not pin (the default)
+ *
+ *          affinity.c resolves the policy. Binding is done by each driver:
+ *          affinity_pth.c pins every pthread itself, and affinity_omp.c
+ *          hands the list to the OpenMP runtime as OMP_PLACES with
+ *          OMP_PROC_BIND=close.
+ */
+
+#ifndef _AFFINITY_CS140
+#define _AFFINITY_CS140
+
+/* Where one CPU sits in the machine. smt is its rank among the CPUs of the
+ * same physical core that we are allowed to use. */
+typedef struct {
+  int id;
+  int package;
+  int core;
+  int smt;
+} cpu_info;
+
+/* The CPUs thread i is pinned to are affinity_cpus[i % affinity_count]. */
+extern cpu_info affinity_cpus[];
+extern int affinity_count;
+extern const char *affinity_spec;
+
+int affinity_init(const char *spec);
+
+int affinity_cpu_list(const char *spec, int cpus[], int max);
+
+int affinity_enabled(void);
+
+int affinity_cpu(int rank);
+
+/* Provided by affinity_pth.c and affinity_omp.c. */
+int affinity_bind_cpu(int cpu);
+
+void affinity_print(int nthreads);
+
+void affinity_first_touch(double *a, long len, int nthreads);
+
+/* affinity_pth.c only. */
+int affinity_bind_self(int rank);
+
+/* affinity_omp.c only. */
+int affinity_export_omp(char *argv[]);
+
+#endif
@@ -0,0 +1,205 @@
+/*
+ * File: itmv_band.c
+ *
+ * Purpose: Band storage and kernel of itmv_band.h.
+ */
+
+#include "itmv_band.h"
+#include <string.h>
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_band_detect
+ * Purpose:   Find the bandwidth of the n x n dense matrix A: the largest
+ *            i - j and j - i of a nonzero A[i][j].
+ * Out args:  kl, ku
+ */
+void itmv_band_detect(const double A[], int n, int *kl, int *ku) {
+  int i, j;
+
+  *kl = *ku = 0;
+  for (i = 0; i < n; i++) {
+    /* Only the columns outside the band found so far can widen it. */
+    for (j = 0; j < i - *kl; j++) {
+      if (A[(long)i * n + j] != 0) {
+        *kl = i - j;
+        break;
+      }
+    }
+    for (j = n - 1; j > i + *ku; j--) {
+      if (A[(long)i * n + j] != 0) {
+        *ku = j - i;
+        break;
+      }
+    }
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_band_detect_csr
+ * Purpose:   itmv_band_detect for an n x n CSR matrix (itmv_load.h), whose
+ *            columns are sorted in each row.
+ * Out args:  kl, ku
+ */
+void itmv_band_detect_csr(int n, const int64_t row_ptr[],
+                          const int32_t col_idx[], int *kl, int *ku) {
+  int i;
+
+  *kl = *ku = 0;
+  for (i = 0; i < n; i++) {
+    if (row_ptr[i + 1] == row_ptr[i]) continue;
+    if (i - col_idx[row_ptr[i]] > *kl) *kl = i - col_idx[row_ptr[i]];
+    if (col_idx[row_ptr[i + 1] - 1] - i > *ku)
+      *ku = col_idx[row_ptr[i + 1] - 1] - i;
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_band_worth
+ * Return:    1 if a matrix of bandwidth kl, ku should be stored banded,
+ *            otherwise 0
+ */
+int itmv_band_worth(int n, int kl, int ku) {
+  return (long)(kl + ku + 1) * BAND_WORTH_RATIO <= n;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_band_from_dense
+ * Purpose:   Copy the band of the n x n dense matrix A to band, which has
+ *            ITMV_BAND_SIZE(n, kl, ku) doubles. Entries outside the band
+ *            are dropped.
+ */
+void itmv_band_from_dense(const double A[], int n, int kl, int ku,
+                          double band[]) {
+  int i, o;
+
+  for (o = -kl; o <= ku; o++) {
+    for (i = 0; i < n; i++) {
+      band[(long)(o + kl) * n + i] =
+          i + o >= 0 && i + o < n ? A[(long)i * n + i + o] : 0;
+    }
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_band_from_csr
+ * Purpose:   itmv_band_from_dense for an n x n CSR matrix.
+ */
+void itmv_band_from_csr(int n, const int64_t row_ptr[],
+                        const int32_t col_idx[], const double values[],
+                        int kl, int ku, double band[]) {
+  int i, o;
+  int64_t p;
+
+  memset(band, 0, ITMV_BAND_SIZE(n, kl, ku) * sizeof(double));
+  for (i = 0; i < n; i++) {
+    for (p = row_ptr[i]; p < row_ptr[i + 1]; p++) {
+      o = col_idx[p] - i;
+      if (o >= -kl && o <= ku) band[(long)(o + kl) * n + i] = values[p];
+    }
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_band_to_dense
+ * Purpose:   Expand band to the n x n dense matrix A.
+ */
+void itmv_band_to_dense(const double band[], int n, int kl, int ku,
+                        double A[]) {
+  int i, j;
+
+  for (i = 0; i < n; i++) {
+    for (j = 0; j < n; j++) {
+      A[(long)i * n + j] = itmv_band_entry(band, n, kl, ku, i, j);
+    }
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_band_span
+ * Purpose:   The columns first <= j < last row i has in the band, and
+ *            base such that A[i][j] = band[base + j * n] for them.
+ * Out args:  first, last, base
+ */
+void itmv_band_span(int n, int kl, int ku, int i, int *first, int *last,
+                    long *base) {
+  *first = i - kl > 0 ? i - kl : 0;
+  *last = i + ku + 1 < n ? i + ku + 1 : n;
+  *base = (long)(kl - i) * n + i;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_band_entry
+ * Return:    A[i][j], 0 outside the band
+ */
+double itmv_band_entry(const double band[], int n, int kl, int ku, int i,
+                       int j) {
+  int o = j - i;
+
+  if (o < -kl || o > ku) return 0;
+  return band[(long)(o + kl) * n + i];
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_band_row
+ * Return:    A[i]x for one row, in column order, for the mappings that
+ *            work row by row.
+ */
+double itmv_band_row(const double band[], int n, int kl, int ku, int i,
+                     const double x[]) {
+  int j, first, last;
+  long base;
+  double sum = 0;
+
+  itmv_band_span(n, kl, ku, i, &first, &last, &base);
+  for (j = first; j < last; j++) {
+    sum += band[base + (long)j * n] * x[j];
+  }
+  return sum;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_band_rows
+ * Purpose:   y[i] = d[i] + A[i]x for rows start <= i < end, a tile of
+ *            BAND_TILE rows at a time, each tile one diagonal at a time
+ *            with unit stride through the diagonal, x and y. Adding the
+ *            diagonals from the lowest keeps the column order of the dense
+ *            kernel.
+ */
+void itmv_band_rows(const double *restrict band, int n, int kl, int ku,
+                    const double *restrict x, const double *restrict d,
+                    double *restrict y, int start, int end) {
+  int t, tend, o, i, lo, hi;
+  const double *b;
+
+  for (t = start; t < end; t = tend) {
+    tend = end - t > BAND_TILE ? t + BAND_TILE : end;
+    for (i = t; i < tend; i++) {
+      y[i] = d[i];
+    }
+    for (o = -kl; o <= ku; o++) {
+      b = band + (long)(o + kl) * n;
+      lo = t > -o ? t : -o;
+      hi = tend < n - o ? tend : n - o;
+      for (i = lo; i < hi; i++) {
+        y[i] += b[i] * x[i + o];
+      }
+    }
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_band_entries
+ * Return:    the entries rows start <= i < end have in the band, for
+ *            counting flops
+ */
+long itmv_band_entries(int n, int kl, int ku, int start, int end) {
+  long count = 0;
+  int i, first, last;
+  long base;
+
+  for (i = start; i < end; i++) {
+    itmv_band_span(n, kl, ku, i, &first, &last, &base);
+    count += last - first;
+  }
+  return count;
+}
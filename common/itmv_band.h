@@ -0,0 +1,70 @@
+/*
+ * File: itmv_band.h
+ *
+ * Purpose: Diagonal (DIA) storage of a banded matrix, with kl diagonals
+ *          below the main one and ku above, for matrix_type BANDED. The
+ *          kl+ku+1 diagonals are stored one after the other, n doubles
+ *          each, aligned on the row index:
+ *
+ *            band[(o + kl) * n + i] = A[i][i + o],  -kl <= o <= ku
+ *
+ *          with zeros where i + o falls outside the matrix, as in LAPACK's
+ *          band storage. A block of rows then reads every diagonal and x
+ *          as contiguous runs, so itmv_band_rows streams them with unit
+ *          stride; it works through the rows in tiles of BAND_TILE so the
+ *          tile of y and its halo of x, rows - kl to rows + ku, stay in
+ *          cache across the diagonals. Rows are summed in column order,
+ *          so y comes out bit for bit as from the dense A.
+ *
+ *          The bandwidth is found from a dense or CSR matrix with
+ *          itmv_band_detect(_csr); itmv_band_worth tells whether band
+ *          storage saves enough over dense to be used.
+ */
+
+#ifndef _ITMV_BAND_CS140
+#define _ITMV_BAND_CS140
+
+#include <stdint.h>
+
+/* Rows per tile of itmv_band_rows. */
+#define BAND_TILE 512
+
+/* Band storage is chosen when kl+ku+1 <= n / BAND_WORTH_RATIO. */
+#define BAND_WORTH_RATIO 4
+
+/* Doubles of band storage for n rows. */
+#define ITMV_BAND_SIZE(n, kl, ku) ((long)((kl) + (ku) + 1) * (n))
+
+void itmv_band_detect(const double A[], int n, int *kl, int *ku);
+
+void itmv_band_detect_csr(int n, const int64_t row_ptr[],
+                          const int32_t col_idx[], int *kl, int *ku);
+
+int itmv_band_worth(int n, int kl, int ku);
+
+void itmv_band_from_dense(const double A[], int n, int kl, int ku,
+                          double band[]);
+
+void itmv_band_from_csr(int n, const int64_t row_ptr[],
+                        const int32_t col_idx[], const double values[],
+                        int kl, int ku, double band[]);
+
+void itmv_band_to_dense(const double band[], int n, int kl, int ku,
+                        double A[]);
+
+void itmv_band_span(int n, int kl, int ku, int i, int *first, int *last,
+                    long *base);
+
+double itmv_band_entry(const double band[], int n, int kl, int ku, int i,
+                       int j);
+
+double itmv_band_row(const double band[], int n, int kl, int ku, int i,
+                     const double x[]);
+
+void itmv_band_rows(const double band[], int n, int kl, int ku,
+                    const double x[], const double d[], double y[],
+                    int start, int end);
+
+long itmv_band_entries(int n, int kl, int ku, int start, int end);
+
+#endif
@@ -0,0 +1,723 @@
+/*
+ * File:     itmv_common_test.c
+ *
+ * Purpose:  unit tests for the modules in common/ that do not depend on
+ *           the threading model. Tests that run a driver on them stay in
+ *           ../pthreads and ../omp.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "itmv_band.h"
+#include "itmv_load.h"
+#include "itmv_mmap.h"
+#include "itmv_op.h"
+#include "itmv_trace.h"
+#include "minunit.h"
+
+void print_error(char *msgheader, char *msg) {
+  printf("%s error msg: %s\n", msgheader, msg);
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_load_parallel
+ * Purpose:   Run fn(arg, c) for every chunk, one after another. The
+ *            drivers' harnesses test their own threaded versions; here
+ *            only the parser's chunk boundaries are under test.
+ */
+void itmv_load_parallel(int chunks, void (*fn)(void *arg, int chunk),
+                        void *arg) {
+  int c;
+
+  for (c = 0; c < chunks; c++) {
+    fn(arg, c);
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Fill A with the drivers' n x n test matrix, -1/n off the diagonal and
+ * 0 on it, and d with the right-hand side that makes x = 1 its solution.
+ */
+void test_matrix(double A[], double d[], int n) {
+  int i, j;
+
+  for (i = 0; i < n; i++) {
+    d[i] = (2.0 * n - 1.0) / n;
+    for (j = 0; j < n; j++) {
+      A[i * n + j] = i == j ? 0 : -1.0 / n;
+    }
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Write a CSR matrix file, check it validates with the expected number of
+ * nonzeros, then flip one payload byte and check that opening it with
+ * ITMV_MAP_VERIFY reports the checksum mismatch.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_mmap_corrupt_test(char *testmsg, int n) {
+  char path[] = "/tmp/itmv_mmap_XXXXXX";
+  double *A, *d;
+  itmv_mapped m;
+  int fd, err;
+  unsigned char byte;
+  FILE *f;
+  char *msg = NULL;
+
+  A = malloc(n * n * sizeof(double));
+  d = malloc(n * sizeof(double));
+  if (A == NULL || d == NULL) {
+    msg = "Failed space allocation";
+    print_error(testmsg, msg);
+    free(A);
+    free(d);
+    return msg;
+  }
+  test_matrix(A, d, n);
+  fd = mkstemp(path);
+  if (fd >= 0) {
+    close(fd);
+  }
+  err = itmv_write_file(path, A, d, n, ITMV_CSR, 64);
+  if (err == 0) {
+    err = itmv_map_open(path, ITMV_MAP_VERIFY, &m);
+  }
+  if (err != 0) {
+    msg = "A fresh CSR file did not validate";
+  } else {
+    if (m.header->nnz != (uint64_t)n * (n - 1)) {
+      msg = "CSR file has the wrong number of nonzeros";
+    }
+    itmv_map_close(&m);
+  }
+
+  if (msg == NULL) {
+    f = fopen(path, "r+b");
+    fseek(f, ITMV_HEADER_SIZE + 64, SEEK_SET);
+    byte = fgetc(f);
+    fseek(f, ITMV_HEADER_SIZE + 64, SEEK_SET);
+    fputc(byte ^ 0x10, f);
+    fclose(f);
+    err = itmv_map_open(path, ITMV_MAP_VERIFY, &m);
+    printf("%s: corrupted file: %s\n", testmsg, itmv_map_strerror(err));
+    if (err != ITMV_ERR_CHECKSUM) {
+      msg = "A corrupted file was not detected";
+      if (err == 0) {
+        itmv_map_close(&m);
+      }
+    }
+  }
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+
+  unlink(path);
+  free(A);
+  free(d);
+  return msg;
+}
+
+char *itmv_test1() {
+  return itmv_mmap_corrupt_test("Test 1: n=32 CSR file checksum", 32);
+}
+
+/*-------------------------------------------------------------------
+ * Write text to a temporary file and load it into the given structure
+ * with the given number of threads.
+ * Return the itmv_load_file result.
+ */
+int load_text(const char *text, int structure, int threads, itmv_loaded *m) {
+  char path[] = "/tmp/itmv_load_XXXXXX";
+  int fd, err;
+
+  fd = mkstemp(path);
+  if (fd < 0) {
+    return ITMV_ERR_IO;
+  }
+  if (write(fd, text, strlen(text)) != (ssize_t)strlen(text)) {
+    close(fd);
+    unlink(path);
+    return ITMV_ERR_IO;
+  }
+  close(fd);
+  err = itmv_load_file(path, structure, threads, m);
+  unlink(path);
+  return err;
+}
+
+/*-------------------------------------------------------------------
+ * Load small hand-written files of every understood kind into every
+ * storage, compare against the expected values, and check that malformed
+ * input is rejected.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_load_formats_test(char *testmsg) {
+  /* 3x3 with blank lines, mixed separators and exponents. */
+  const char *csv = "1,2,0\n\n4.5, -5e-1 ,6\r\n0;8\t9\n";
+  const double csv_dense[] = {1, 2, 0, 4.5, -0.5, 6, 0, 8, 9};
+  const int64_t csv_row_ptr[] = {0, 2, 5, 7};
+  const int32_t csv_col_idx[] = {0, 1, 0, 1, 2, 1, 2};
+  /* Symmetric, lower triangle given, out of order. */
+  const char *mtx = "%%MatrixMarket matrix coordinate real symmetric\n"
+                    "% comment\n3 3 4\n3 3 4.25\n2 1 -1\n1 1 2\n3 1 .5\n";
+  const double mtx_dense[] = {2, -1, 0.5, -1, 0, 0, 0.5, 0, 4.25};
+  const double mtx_packed[] = {2, -1, 0.5, 0, 0, 4.25};
+  const int64_t mtx_row_ptr[] = {0, 3, 4, 6};
+  const int32_t mtx_col_idx[] = {0, 1, 2, 0, 0, 2};
+  const double mtx_values[] = {2, -1, 0.5, -1, 0.5, 4.25};
+  /* Column-major 2x3. */
+  const char *array = "%%MatrixMarket matrix array real general\n"
+                      "2 3\n1\n2\n3\n4\n5\n6\n";
+  const double array_dense[] = {1, 3, 5, 2, 4, 6};
+  itmv_loaded m;
+  char *msg = NULL;
+  int i, err;
+
+  if ((err = load_text(csv, ITMV_DENSE, 3, &m)) != 0 || m.rows != 3 ||
+      m.cols != 3) {
+    msg = "CSV to dense failed";
+  } else {
+    for (i = 0; i < 9; i++) {
+      if (m.values[i] != csv_dense[i]) msg = "CSV to dense: wrong value";
+    }
+  }
+  if (err == 0) itmv_load_free(&m);
+
+  if (msg == NULL) {
+    if ((err = load_text(csv, ITMV_CSR, 3, &m)) != 0 || m.nnz != 7) {
+      msg = "CSV to CSR failed";
+    } else {
+      for (i = 0; i < 4; i++) {
+        if (m.row_ptr[i] != csv_row_ptr[i]) msg = "CSV to CSR: wrong row_ptr";
+      }
+      for (i = 0; i < 7; i++) {
+        if (m.col_idx[i] != csv_col_idx[i]) msg = "CSV to CSR: wrong col_idx";
+      }
+    }
+    if (err == 0) itmv_load_free(&m);
+  }
+
+  if (msg == NULL) {
+    if ((err = load_text(mtx, ITMV_DENSE, 3, &m)) != 0) {
+      msg = "Symmetric MatrixMarket to dense failed";
+    } else {
+      for (i = 0; i < 9; i++) {
+        if (m.values[i] != mtx_dense[i]) msg = "MatrixMarket: wrong value";
+      }
+    }
+    if (err == 0) itmv_load_free(&m);
+  }
+
+  if (msg == NULL) {
+    if ((err = load_text(mtx, ITMV_PACKED_UPPER, 3, &m)) != 0 || m.nnz != 6) {
+      msg = "Symmetric MatrixMarket to packed upper failed";
+    } else {
+      for (i = 0; i < 6; i++) {
+        if (m.values[i] != mtx_packed[i]) msg = "Packed: wrong value";
+      }
+      if (m.values[ITMV_PACKED_INDEX(1, 2, 3)] != 0 ||
+          m.values[ITMV_PACKED_INDEX(2, 2, 3)] != 4.25) {
+        msg = "Packed: ITMV_PACKED_INDEX is off";
+      }
+    }
+    if (err == 0) itmv_load_free(&m);
+  }
+
+  if (msg == NULL) {
+    if ((err = load_text(mtx, ITMV_CSR, 3, &m)) != 0 || m.nnz != 6) {
+      msg = "Symmetric MatrixMarket to CSR failed";
+    } else {
+      for (i = 0; i < 4; i++) {
+        if (m.row_ptr[i] != mtx_row_ptr[i]) msg = "CSR: wrong row_ptr";
+      }
+      for (i = 0; i < 6; i++) {
+        if (m.col_idx[i] != mtx_col_idx[i] || m.values[i] != mtx_values[i])
+          msg = "CSR: rows not sorted by column";
+      }
+    }
+    if (err == 0) itmv_load_free(&m);
+  }
+
+  if (msg == NULL) {
+    if ((err = load_text(array, ITMV_DENSE, 3, &m)) != 0 || m.rows != 2 ||
+        m.cols != 3) {
+      msg = "MatrixMarket array to dense failed";
+    } else {
+      for (i = 0; i < 6; i++) {
+        if (m.values[i] != array_dense[i]) msg = "Array: wrong value";
+      }
+    }
+    if (err == 0) itmv_load_free(&m);
+  }
+
+  if (msg == NULL) {
+    err = load_text("1,2\n3,x\n", ITMV_DENSE, 3, &m);
+    printf("%s: bad number: %s\n", testmsg, itmv_map_strerror(err));
+    if (err != ITMV_ERR_PARSE) msg = "A bad number was not rejected";
+  }
+  if (msg == NULL &&
+      load_text("1,2\n3\n", ITMV_DENSE, 3, &m) != ITMV_ERR_PARSE) {
+    msg = "A short row was not rejected";
+  }
+  if (msg == NULL &&
+      load_text("%%MatrixMarket matrix coordinate real general\n2 2 1\n2 1 "
+                "1\n",
+                ITMV_PACKED_UPPER, 3, &m) != ITMV_ERR_FORMAT) {
+    msg = "A lower entry was stored as packed upper";
+  }
+  if (msg == NULL &&
+      load_text("%%MatrixMarket matrix coordinate real general\n2 2 2\n1 1 "
+                "1\n",
+                ITMV_CSR, 3, &m) != ITMV_ERR_PARSE) {
+    msg = "A missing entry was not detected";
+  }
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+  return msg;
+}
+
+char *itmv_test2() {
+  return itmv_load_formats_test("Test 2: text matrix formats");
+}
+
+/*-------------------------------------------------------------------
+ * Load files with fewer bytes than ITMV_LOAD_THREADS_MAX threads, so the
+ * chunk boundaries all fall at the start of the file or inside its first
+ * line, into dense and CSR storage.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_load_tiny_test(char *testmsg) {
+  const double small[] = {1, 2, 3, 4};
+  int i, err;
+  itmv_loaded m;
+  char *msg = NULL;
+
+  if ((err = load_text("5\n", ITMV_DENSE, ITMV_LOAD_THREADS_MAX, &m)) != 0 ||
+      m.rows != 1 || m.cols != 1 || m.values[0] != 5) {
+    msg = "A one-entry file failed to load";
+  }
+  if (err == 0) itmv_load_free(&m);
+
+  if (msg == NULL) {
+    if ((err = load_text("7", ITMV_DENSE, ITMV_LOAD_THREADS_MAX, &m)) != 0 ||
+        m.rows != 1 || m.values[0] != 7) {
+      msg = "A file without a newline failed to load";
+    }
+    if (err == 0) itmv_load_free(&m);
+  }
+
+  if (msg == NULL) {
+    if ((err = load_text("1,2\n3,4\n", ITMV_CSR, ITMV_LOAD_THREADS_MAX,
+                         &m)) != 0 ||
+        m.rows != 2 || m.nnz != 4) {
+      msg = "A 2x2 file to CSR failed";
+    } else {
+      for (i = 0; i < 4; i++) {
+        if (m.values[i] != small[i]) msg = "A 2x2 file: wrong value";
+      }
+    }
+    if (err == 0) itmv_load_free(&m);
+  }
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+  return msg;
+}
+
+
+char *itmv_test3() {
+  return itmv_load_tiny_test("Test 3: tiny files loaded with 64 threads");
+}
+
+/*-------------------------------------------------------------------
+ * Count the occurrences of pattern in text.
+ */
+int count_matches(const char *text, const char *pattern) {
+  int count = 0;
+
+  while ((text = strstr(text, pattern)) != NULL) {
+    count++;
+    text += strlen(pattern);
+  }
+  return count;
+}
+
+/*-------------------------------------------------------------------
+ * Record events by hand into a 2-thread trace small enough that thread 0
+ * wraps its ring, dump it, and check the JSON keeps the newest events of
+ * each thread with their phase, track and iteration.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_trace_test(char *testmsg) {
+  char path[] = "/tmp/itmv_trace_XXXXXX";
+  char text[4096];
+  FILE *f;
+  size_t len;
+  int fd, k;
+  char *msg = NULL;
+
+  if (trace_init(2, 4) != 0) {
+    msg = "Failed space allocation";
+    print_error(testmsg, msg);
+    return msg;
+  }
+  for (k = 0; k < 6; k++) {
+    trace_record(0, k % 2 == 0 ? TRACE_COMPUTE : TRACE_WAIT, k, 1.0 * k,
+                 1.0 * k + 0.5);
+  }
+  trace_record(1, TRACE_COPY, 7, 0, 0.25);
+  trace_record(2, TRACE_COPY, 0, 0, 1); /* no such thread: ignored */
+
+  fd = mkstemp(path);
+  if (fd < 0) {
+    msg = "Cannot create the trace file";
+  } else {
+    close(fd);
+    if (trace_dump(path) != 0 || (f = fopen(path, "r")) == NULL) {
+      msg = "trace_dump failed";
+    } else {
+      len = fread(text, 1, sizeof(text) - 1, f);
+      text[len] = '\0';
+      fclose(f);
+    }
+    unlink(path);
+  }
+
+  if (msg == NULL && (trace_count(0) != 6 || trace_count(1) != 1 ||
+                      trace_count(2) != 0)) {
+    msg = "Wrong event counts";
+  }
+  if (msg == NULL && (strncmp(text, "{\"traceEvents\":[", 16) != 0 ||
+                      strstr(text, "\"displayTimeUnit\"") == NULL)) {
+    msg = "Not a Chrome trace";
+  }
+  if (msg == NULL && (count_matches(text, "\"ph\":\"M\"") != 2 ||
+                      count_matches(text, "\"ph\":\"X\"") != 5)) {
+    msg = "Ring did not keep the last 4 events of thread 0";
+  }
+  if (msg == NULL && (strstr(text, "\"iteration\":1}") != NULL ||
+                      strstr(text, "\"iteration\":2}") == NULL ||
+                      strstr(text, "\"iteration\":5}") == NULL)) {
+    msg = "Ring kept the wrong events";
+  }
+  if (msg == NULL &&
+      (count_matches(text, "\"name\":\"compute\"") != 2 ||
+       count_matches(text, "\"name\":\"wait\"") != 2 ||
+       strstr(text, "\"name\":\"copy\",\"cat\":\"itmv\",\"ph\":\"X\","
+                    "\"pid\":1,\"tid\":1") == NULL)) {
+    msg = "Wrong phase or thread in an event";
+  }
+  if (msg == NULL && strstr(text, "\"dur\":500000.000") == NULL) {
+    msg = "Durations are not in microseconds";
+  }
+  trace_free();
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+  return msg;
+}
+
+char *itmv_test4() {
+  return itmv_trace_test("Test 4: trace ring buffers and JSON");
+}
+
+/* The test matrix, full, as an OP_CALLBACK operator: data is the sum. */
+void test_op_prepare(itmv_op *op, const double x[]) {
+  double sum = 0;
+  int j;
+
+  for (j = 0; j < op->n; j++) {
+    sum += x[j];
+  }
+  *(double *)op->data = sum;
+}
+
+double test_op_row(const itmv_op *op, int i, const double x[]) {
+  return -(*(double *)op->data - x[i]) / op->n;
+}
+
+/*-------------------------------------------------------------------
+ * Return entry (i, j) of the matrix itmv_op_test builds for class kind,
+ * written out directly.
+ */
+double test_op_entry(int kind, int n, int i, int j, const double t_c[],
+                     const double diag[], const double U[], const double V[],
+                     int rank) {
+  double a;
+  int r;
+
+  if (kind == OP_TOEPLITZ) return j > i ? -1.0 / n : 0;
+  if (kind == OP_CIRCULANT) return t_c[((i - j) % n + n) % n];
+  if (kind == OP_LOWRANK_DIAG) {
+    a = i == j ? diag[i] : 0;
+    for (r = 0; r < rank; r++) {
+      a += U[i * rank + r] * V[j * rank + r];
+    }
+    return a;
+  }
+  return i == j ? 0 : -1.0 / n;
+}
+
+/*-------------------------------------------------------------------
+ * Build an operator of class kind on n rows -- for OP_CONST_DIAG,
+ * OP_TOEPLITZ and OP_CALLBACK the drivers' test matrix (full, upper
+ * triangular and full), for OP_CIRCULANT and OP_LOWRANK_DIAG other
+ * contractions -- and check its dense matrix entry by entry.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_op_matrix_test(char *testmsg, int kind, int n) {
+  double *A, *t_c = NULL, *U = NULL, *V = NULL, *diag = NULL, sum;
+  int i, r, err, rank = 2;
+  char *msg = NULL;
+  itmv_op op;
+
+  if (kind == OP_CONST_DIAG) {
+    err = itmv_op_const_diag(&op, n, -1.0 / n, NULL);
+  } else if (kind == OP_TOEPLITZ) {
+    t_c = malloc((2 * n - 1) * sizeof(double));
+    for (i = 0; i < 2 * n - 1; i++) {
+      t_c[i] = i < n - 1 ? -1.0 / n : 0;
+    }
+    err = itmv_op_toeplitz(&op, n, t_c);
+  } else if (kind == OP_CIRCULANT) {
+    t_c = malloc(n * sizeof(double));
+    for (i = 0; i < n; i++) {
+      t_c[i] = -(i % 3 + 1) / (4.0 * n);
+    }
+    err = itmv_op_circulant(&op, n, t_c);
+  } else if (kind == OP_LOWRANK_DIAG) {
+    diag = malloc(n * sizeof(double));
+    U = malloc(n * rank * sizeof(double));
+    V = malloc(n * rank * sizeof(double));
+    for (i = 0; i < n; i++) {
+      diag[i] = 0.1;
+      for (r = 0; r < rank; r++) {
+        U[i * rank + r] = 0.3 * cos(i + r) / sqrt(n);
+        V[i * rank + r] = 0.3 * sin(2 * i + r + 1) / sqrt(n);
+      }
+    }
+    err = itmv_op_lowrank_diag(&op, n, rank, diag, U, V);
+  } else {
+    err = itmv_op_callback(&op, n, test_op_prepare, test_op_row, &sum);
+  }
+  if (err != 0) {
+    msg = "Failed to build the operator";
+    print_error(testmsg, msg);
+    goto done;
+  }
+
+  A = malloc(n * n * sizeof(double));
+  if (A == NULL || itmv_op_to_dense(&op, A) != 0) {
+    msg = "Failed space allocation";
+  } else {
+    for (i = 0; i < n * n && msg == NULL; i++) {
+      if (fabs(A[i] - test_op_entry(kind, n, i / n, i % n, t_c, diag, U, V,
+                                    rank)) > 1e-12) {
+        msg = "The operator is not its matrix";
+      }
+    }
+  }
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+  free(A);
+  itmv_op_destroy(&op);
+
+done:
+  free(t_c);
+  free(diag);
+  free(U);
+  free(V);
+  return msg;
+}
+
+char *itmv_test5() {
+  return itmv_op_matrix_test("Test 5: n=17 constant-plus-diagonal operator",
+                             OP_CONST_DIAG, 17);
+}
+
+char *itmv_test6() {
+  return itmv_op_matrix_test("Test 6: n=17 upper Toeplitz operator",
+                             OP_TOEPLITZ, 17);
+}
+
+char *itmv_test7() {
+  return itmv_op_matrix_test("Test 7: n=20 circulant operator", OP_CIRCULANT,
+                             20);
+}
+
+char *itmv_test8() {
+  return itmv_op_matrix_test("Test 8: n=17 low-rank-plus-diagonal operator",
+                             OP_LOWRANK_DIAG, 17);
+}
+
+char *itmv_test9() {
+  return itmv_op_matrix_test("Test 9: n=17 callback operator", OP_CALLBACK,
+                             17);
+}
+
+#define BAND_FROM_DENSE 0
+#define BAND_FROM_MATRIX_MARKET 1
+
+/*-------------------------------------------------------------------
+ * Entry (i, j) of the banded test matrix: -(1 + (i + 2j) % 3) / 3(kl+ku+1)
+ * on the kl diagonals below the main one and the ku above, 0 elsewhere.
+ */
+double test_band_entry(int kl, int ku, int i, int j) {
+  if (j == i || j < i - kl || j > i + ku) return 0;
+  return -(1 + (i + 2 * j) % 3) / (3.0 * (kl + ku + 1));
+}
+
+/*-------------------------------------------------------------------
+ * Put the banded test matrix in band storage with the bandwidth found by
+ * itmv_band_detect -- from the dense matrix, or from its MatrixMarket text
+ * loaded as CSR -- and check the band expands back to the dense matrix and
+ * that itmv_band_rows gives y = d + Ax bit for bit as the dense rows do.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_band_storage_test(char *testmsg, int n, int kl, int ku,
+                             int source) {
+  char path[] = "/tmp/itmv_band_XXXXXX";
+  double *A, *B, *band = NULL, *x, *d, *y, a;
+  int i, j, fd, err, found_kl = kl, found_ku = ku;
+  itmv_loaded m;
+  FILE *f;
+  char *msg = NULL;
+
+  A = malloc(n * n * sizeof(double));
+  B = malloc(n * n * sizeof(double));
+  x = malloc(n * sizeof(double));
+  d = malloc(n * sizeof(double));
+  y = malloc(n * sizeof(double));
+  if (A == NULL || B == NULL || x == NULL || d == NULL || y == NULL) {
+    msg = "Failed space allocation";
+    goto done;
+  }
+  for (i = 0; i < n; i++) {
+    x[i] = 1 + i % 7;
+    d[i] = 1;
+    for (j = 0; j < n; j++) {
+      A[i * n + j] = test_band_entry(kl, ku, i, j);
+    }
+  }
+
+  if (source == BAND_FROM_DENSE) {
+    itmv_band_detect(A, n, &found_kl, &found_ku);
+  } else {
+    fd = mkstemp(path);
+    f = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (f == NULL) {
+      msg = "Cannot create the text matrix";
+      goto done;
+    }
+    fprintf(f, "%%%%MatrixMarket matrix coordinate real general\n%d %d %d\n",
+            n, n, n * (kl + ku) - kl * (kl + 1) / 2 - ku * (ku + 1) / 2);
+    for (i = 0; i < n; i++) {
+      for (j = 0; j < n; j++) {
+        if ((a = A[i * n + j]) != 0) {
+          fprintf(f, "%d %d %.17g\n", i + 1, j + 1, a);
+        }
+      }
+    }
+    fclose(f);
+    err = itmv_load_file(path, ITMV_CSR, 3, &m);
+    unlink(path);
+    if (err != 0) {
+      msg = (char *)itmv_map_strerror(err);
+      goto done;
+    }
+    itmv_band_detect_csr(n, m.row_ptr, m.col_idx, &found_kl, &found_ku);
+  }
+  if (found_kl != kl || found_ku != ku) {
+    msg = "Wrong bandwidth detected";
+  } else if (!itmv_band_worth(n, kl, ku)) {
+    msg = "Band storage not chosen for a narrow band";
+  } else if ((band = malloc(ITMV_BAND_SIZE(n, kl, ku) * sizeof(double))) ==
+             NULL) {
+    msg = "Failed space allocation";
+  } else if (source == BAND_FROM_DENSE) {
+    itmv_band_from_dense(A, n, kl, ku, band);
+  } else {
+    itmv_band_from_csr(n, m.row_ptr, m.col_idx, m.values, kl, ku, band);
+  }
+  if (source == BAND_FROM_MATRIX_MARKET) {
+    itmv_load_free(&m);
+  }
+  if (msg != NULL) {
+    goto done;
+  }
+
+  itmv_band_to_dense(band, n, kl, ku, B);
+  if (memcmp(A, B, n * n * sizeof(double)) != 0) {
+    msg = "The band is not its matrix";
+    goto done;
+  }
+  itmv_band_rows(band, n, kl, ku, x, d, y, 0, n);
+  for (i = 0; i < n && msg == NULL; i++) {
+    a = d[i];
+    for (j = 0; j < n; j++) {
+      a += A[i * n + j] * x[j];
+    }
+    if (y[i] != a) {
+      msg = "One mismatch against the dense rows";
+    }
+  }
+
+done:
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+  free(A);
+  free(B);
+  free(band);
+  free(x);
+  free(d);
+  free(y);
+  return msg;
+}
+
+char *itmv_test10() {
+  return itmv_band_storage_test("Test 10: n=100 banded (2,3) from dense", 100,
+                                2, 3, BAND_FROM_DENSE);
+}
+
+char *itmv_test11() {
+  return itmv_band_storage_test("Test 11: n=101 banded (4,1) from dense", 101,
+                                4, 1, BAND_FROM_DENSE);
+}
+
+char *itmv_test12() {
+  return itmv_band_storage_test("Test 12: n=97 banded (1,5) from MatrixMarket",
+                                97, 1, 5, BAND_FROM_MATRIX_MARKET);
+}
+
+/*-------------------------------------------------------------------
+ * Run all tests.  Ignore returned messages.
+ */
+void run_all_tests(void) {
+  mu_run_test(itmv_test1);
+  mu_run_test(itmv_test2);
+  mu_run_test(itmv_test3);
+  mu_run_test(itmv_test4);
+  mu_run_test(itmv_test5);
+  mu_run_test(itmv_test6);
+  mu_run_test(itmv_test7);
+  mu_run_test(itmv_test8);
+  mu_run_test(itmv_test9);
+  mu_run_test(itmv_test10);
+  mu_run_test(itmv_test11);
+  mu_run_test(itmv_test12);
+}
+
+/*-------------------------------------------------------------------
+ * The main entrance to run all tests.
+ */
+int main(void) {
+  run_all_tests();
+  mu_print_test_summary("Summary:");
+  return 0;
+}
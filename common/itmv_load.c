@@ -0,0 +1,676 @@
+/*
+ * File: itmv_load.c
+ *
+ * Purpose: Parallel text matrix loader. See itmv_load.h. The threads are
+ *          started by the driver's itmv_load_parallel.
+ *
+ *          The body of the file is split into one chunk per thread at
+ *          line boundaries and every pass below runs all chunks at once:
+ *
+ *            PASS_COUNT  count the data lines of each chunk; a prefix sum
+ *                        gives every chunk the index of its first line,
+ *                        which is the row (plain text), the entry
+ *                        (coordinate) or the value (array) it starts at.
+ *            PASS_ROWS   CSR only: count the nonzeros of every row.
+ *            PASS_FILL   parse again and store every value in place.
+ *            PASS_SORT   CSR from MatrixMarket only: sort each row by
+ *                        column, chunk c taking rows c*rows/T and up.
+ */
+
+#define _GNU_SOURCE
+#include "itmv_load.h"
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define KIND_TEXT 0
+#define KIND_COORDINATE 1
+#define KIND_ARRAY 2
+
+#define PASS_COUNT 0
+#define PASS_ROWS 1
+#define PASS_FILL 2
+#define PASS_SORT 3
+
+typedef struct {
+  const char *base;
+  long size;
+  int kind;
+  int symmetric;
+  int pattern;
+  long entries; /* declared entries of a coordinate file */
+  int structure;
+  int pass;
+  int chunks;
+  long start[ITMV_LOAD_THREADS_MAX + 1];
+  long first[ITMV_LOAD_THREADS_MAX + 1];
+  atomic_long *cursor; /* CSR: per-row count, then next free slot */
+  atomic_int error;
+  itmv_loaded *m;
+} load_state;
+
+typedef struct {
+  int32_t col;
+  double value;
+} load_pair;
+
+/* 10^0 .. 10^22 are exact doubles. */
+static const double load_pow10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+double load_time(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int is_separator(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == ',' || c == ';';
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_parse_double
+ * Purpose:   Parse one decimal floating-point number from [p, end), which
+ *            need not be NUL-terminated.
+ *            Up to 15 significant digits with a decimal exponent within
+ *            +-22 -- almost every number written by printf -- take the
+ *            exact fast path: the digits collected into an integer and
+ *            scaled by one exactly representable power of ten, a single
+ *            correctly rounded operation. Anything else is copied out and
+ *            handed to strtod, so the result is always correctly rounded.
+ * In arg:    p, end
+ * Out arg:   next: the first character after the number, p if there is
+ *            no number at p
+ * Return:    the value
+ */
+double itmv_parse_double(const char *p, const char *end, const char **next) {
+  const char *s = p;
+  uint64_t mantissa = 0;
+  int digits = 0, exp10 = 0, e = 0, negative = 0, exp_negative = 0, any = 0;
+  const char *q;
+  char buf[128];
+  double v;
+
+  if (p < end && (*p == '+' || *p == '-')) {
+    negative = *p++ == '-';
+  }
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    any = 1;
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa != 0;
+    } else {
+      exp10++;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+      any = 1;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa != 0;
+        exp10--;
+      }
+    }
+  }
+  if (!any) {
+    *next = s;
+    return 0;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    q = p + 1;
+    if (q < end && (*q == '+' || *q == '-')) {
+      exp_negative = *q++ == '-';
+    }
+    if (q < end && *q >= '0' && *q <= '9') {
+      for (; q < end && *q >= '0' && *q <= '9'; q++) {
+        if (e < 100000) {
+          e = e * 10 + (*q - '0');
+        }
+      }
+      exp10 += exp_negative ? -e : e;
+      p = q;
+    }
+  }
+  *next = p;
+
+  if (digits <= 15 && exp10 >= -22 && exp10 <= 22) {
+    v = (double)mantissa;
+    v = exp10 < 0 ? v / load_pow10[-exp10] : v * load_pow10[exp10];
+    return negative ? -v : v;
+  }
+  if (p - s >= (long)sizeof(buf)) {
+    *next = s;
+    return 0;
+  }
+  memcpy(buf, s, p - s);
+  buf[p - s] = '\0';
+  return strtod(buf, NULL);
+}
+
+/*-------------------------------------------------------------------
+ * Parse a non-negative integer from [p, end).
+ * Out arg:   next: the first character after it, p if there is none
+ */
+long parse_index(const char *p, const char *end, const char **next) {
+  long v = 0;
+
+  *next = p;
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    if (v < (1L << 40)) {
+      v = v * 10 + (*p - '0');
+    }
+  }
+  if (p < end && !is_separator(*p)) {
+    return 0;
+  }
+  *next = p;
+  return v;
+}
+
+/*-------------------------------------------------------------------
+ * Return 1 if [p, eol) holds no data: blank, or a % comment.
+ */
+int blank_line(const char *p, const char *eol) {
+  for (; p < eol; p++) {
+    if (*p == '%') {
+      return 1;
+    }
+    if (!is_separator(*p)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/*-------------------------------------------------------------------
+ * Skip separators in [p, end).
+ */
+const char *skip_separators(const char *p, const char *end) {
+  while (p < end && is_separator(*p)) {
+    p++;
+  }
+  return p;
+}
+
+/*-------------------------------------------------------------------
+ * Record entry (i, j) = v for the current pass.
+ * Return 0 or an ITMV_ERR code.
+ */
+int load_store(load_state *s, long i, long j, double v) {
+  itmv_loaded *m = s->m;
+  long pos;
+
+  if (s->pass == PASS_ROWS) {
+    if (v != 0) {
+      atomic_fetch_add_explicit(&s->cursor[i], 1, memory_order_relaxed);
+    }
+    return 0;
+  }
+  switch (s->structure) {
+  case ITMV_DENSE:
+    m->values[i * m->cols + j] = v;
+    break;
+  case ITMV_PACKED_UPPER:
+    if (j >= i) {
+      m->values[ITMV_PACKED_INDEX(i, j, m->cols)] = v;
+    } else if (v != 0 && !s->symmetric) {
+      return ITMV_ERR_FORMAT;
+    }
+    break;
+  case ITMV_CSR:
+    if (v != 0) {
+      pos = atomic_fetch_add_explicit(&s->cursor[i], 1, memory_order_relaxed);
+      m->values[pos] = v;
+      m->col_idx[pos] = (int32_t)j;
+    }
+    break;
+  }
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Parse the data line [p, eol), the line-th of the body, and store it.
+ * Return 0 or an ITMV_ERR code.
+ */
+int load_line(load_state *s, long line, const char *p, const char *eol) {
+  itmv_loaded *m = s->m;
+  const char *next;
+  long i, j;
+  double v;
+  int err;
+
+  p = skip_separators(p, eol);
+  if (s->kind == KIND_TEXT) {
+    for (j = 0; p < eol; j++) {
+      v = itmv_parse_double(p, eol, &next);
+      if (next == p || (next < eol && !is_separator(*next)) || j >= m->cols) {
+        return ITMV_ERR_PARSE;
+      }
+      if ((err = load_store(s, line, j, v)) != 0) {
+        return err;
+      }
+      p = skip_separators(next, eol);
+    }
+    return j == m->cols ? 0 : ITMV_ERR_PARSE;
+  }
+
+  if (s->kind == KIND_ARRAY) {
+    v = itmv_parse_double(p, eol, &next);
+    if (next == p || skip_separators(next, eol) != eol) {
+      return ITMV_ERR_PARSE;
+    }
+    return load_store(s, line % m->rows, line / m->rows, v);
+  }
+
+  i = parse_index(p, eol, &next);
+  if (next == p) {
+    return ITMV_ERR_PARSE;
+  }
+  p = skip_separators(next, eol);
+  j = parse_index(p, eol, &next);
+  if (next == p) {
+    return ITMV_ERR_PARSE;
+  }
+  p = skip_separators(next, eol);
+  v = 1.0;
+  if (!s->pattern) {
+    v = itmv_parse_double(p, eol, &next);
+    if (next == p) {
+      return ITMV_ERR_PARSE;
+    }
+    p = skip_separators(next, eol);
+  }
+  if (p != eol || i < 1 || i > m->rows || j < 1 || j > m->cols) {
+    return ITMV_ERR_PARSE;
+  }
+  if ((err = load_store(s, i - 1, j - 1, v)) != 0) {
+    return err;
+  }
+  if (s->symmetric && i != j) {
+    return load_store(s, j - 1, i - 1, v);
+  }
+  return 0;
+}
+
+int compare_pairs(const void *a, const void *b) {
+  int32_t x = ((const load_pair *)a)->col, y = ((const load_pair *)b)->col;
+  return (x > y) - (x < y);
+}
+
+/*-------------------------------------------------------------------
+ * Sort the CSR rows of chunk c by column.
+ */
+void sort_rows(load_state *s, int c) {
+  itmv_loaded *m = s->m;
+  long first = m->rows * c / s->chunks, last = m->rows * (c + 1) / s->chunks;
+  long i, k, len, cap = 0;
+  load_pair *pairs = NULL, *grown;
+
+  for (i = first; i < last; i++) {
+    len = m->row_ptr[i + 1] - m->row_ptr[i];
+    if (len > cap) {
+      grown = realloc(pairs, len * sizeof(load_pair));
+      if (grown == NULL) {
+        atomic_store(&s->error, ITMV_ERR_IO);
+        break;
+      }
+      pairs = grown;
+      cap = len;
+    }
+    for (k = 0; k < len; k++) {
+      pairs[k].col = m->col_idx[m->row_ptr[i] + k];
+      pairs[k].value = m->values[m->row_ptr[i] + k];
+    }
+    qsort(pairs, len, sizeof(load_pair), compare_pairs);
+    for (k = 0; k < len; k++) {
+      m->col_idx[m->row_ptr[i] + k] = pairs[k].col;
+      m->values[m->row_ptr[i] + k] = pairs[k].value;
+    }
+  }
+  free(pairs);
+}
+
+/*-------------------------------------------------------------------
+ * Run the current pass over chunk c.
+ */
+void load_chunk(load_state *s, int c) {
+  const char *p = s->base + s->start[c], *end = s->base + s->start[c + 1];
+  const char *eol;
+  long line = s->first[c];
+  int err = 0;
+
+  if (s->pass == PASS_SORT) {
+    sort_rows(s, c);
+    return;
+  }
+  while (p < end && err == 0) {
+    eol = memchr(p, '\n', end - p);
+    if (eol == NULL) {
+      eol = end;
+    }
+    if (!blank_line(p, eol)) {
+      if (s->pass != PASS_COUNT) {
+        err = load_line(s, line, p, eol);
+      }
+      line++;
+    }
+    p = eol + 1;
+  }
+  if (s->pass == PASS_COUNT) {
+    s->first[c] = line;
+  }
+  if (err != 0) {
+    atomic_store(&s->error, err);
+  }
+}
+
+/*-------------------------------------------------------------------
+ * load_chunk in the form itmv_load_parallel calls.
+ */
+void load_chunk_task(void *s, int c) {
+  load_chunk(s, c);
+}
+
+/*-------------------------------------------------------------------
+ * Run the current pass over all chunks, one thread each.
+ */
+void load_parallel(load_state *s) {
+  itmv_load_parallel(s->chunks, load_chunk_task, s);
+}
+
+/*-------------------------------------------------------------------
+ * Copy the next blank-separated word of [*p, eol) into word, lowercase.
+ */
+void next_word(const char **p, const char *eol, char *word, int size) {
+  int k = 0;
+
+  *p = skip_separators(*p, eol);
+  while (*p < eol && !is_separator(**p)) {
+    if (k < size - 1) {
+      word[k++] = (**p >= 'A' && **p <= 'Z') ? **p - 'A' + 'a' : **p;
+    }
+    (*p)++;
+  }
+  word[k] = '\0';
+}
+
+/*-------------------------------------------------------------------
+ * Work out the kind of file, its dimensions and where its data lines
+ * begin.
+ * Return:   the offset of the body, or an ITMV_ERR code.
+ */
+long parse_header(load_state *s) {
+  const char *p = s->base, *end = s->base + s->size, *eol = end, *next;
+  char object[16], format[16], field[16], symmetry[16];
+  itmv_loaded *m = s->m;
+  long cols;
+
+  if (s->size >= 14 && strncasecmp(p, "%%MatrixMarket", 14) == 0) {
+    eol = memchr(p, '\n', end - p);
+    eol = eol == NULL ? end : eol;
+    p += 14;
+    next_word(&p, eol, object, sizeof(object));
+    next_word(&p, eol, format, sizeof(format));
+    next_word(&p, eol, field, sizeof(field));
+    next_word(&p, eol, symmetry, sizeof(symmetry));
+    if (strcmp(object, "matrix") != 0 ||
+        (strcmp(field, "real") != 0 && strcmp(field, "integer") != 0 &&
+         strcmp(field, "pattern") != 0) ||
+        (strcmp(symmetry, "general") != 0 &&
+         strcmp(symmetry, "symmetric") != 0)) {
+      return ITMV_ERR_FORMAT;
+    }
+    if (strcmp(format, "coordinate") == 0) {
+      s->kind = KIND_COORDINATE;
+    } else if (strcmp(format, "array") == 0 &&
+               strcmp(field, "pattern") != 0 &&
+               strcmp(symmetry, "general") == 0) {
+      s->kind = KIND_ARRAY;
+    } else {
+      return ITMV_ERR_FORMAT;
+    }
+    s->pattern = strcmp(field, "pattern") == 0;
+    s->symmetric = strcmp(symmetry, "symmetric") == 0;
+
+    /* Comments, then the size line. */
+    for (p = eol + 1; p < end; p = eol + 1) {
+      eol = memchr(p, '\n', end - p);
+      eol = eol == NULL ? end : eol;
+      if (!blank_line(p, eol)) {
+        break;
+      }
+    }
+    if (p >= end) {
+      return ITMV_ERR_PARSE;
+    }
+    p = skip_separators(p, eol);
+    m->rows = parse_index(p, eol, &next);
+    p = skip_separators(next, eol);
+    m->cols = parse_index(p, eol, &next);
+    p = skip_separators(next, eol);
+    if (s->kind == KIND_COORDINATE) {
+      s->entries = parse_index(p, eol, &next);
+      if (next == p) {
+        return ITMV_ERR_PARSE;
+      }
+      p = skip_separators(next, eol);
+    }
+    if (p != eol || m->rows <= 0 || m->cols <= 0) {
+      return ITMV_ERR_PARSE;
+    }
+    return eol < end ? eol + 1 - s->base : s->size;
+  }
+
+  /* Plain text: the first data line fixes the number of columns. */
+  s->kind = KIND_TEXT;
+  for (p = s->base; p < end; p = eol + 1) {
+    eol = memchr(p, '\n', end - p);
+    eol = eol == NULL ? end : eol;
+    if (!blank_line(p, eol)) {
+      break;
+    }
+  }
+  for (cols = 0, p = skip_separators(p, eol); p < end && p < eol; cols++) {
+    itmv_parse_double(p, eol, &next);
+    if (next == p) {
+      return ITMV_ERR_PARSE;
+    }
+    p = skip_separators(next, eol);
+  }
+  if (cols == 0) {
+    return ITMV_ERR_FORMAT;
+  }
+  m->cols = cols;
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Allocate the output storage once the dimensions are known. For CSR
+ * only the per-row counters; the arrays follow PASS_ROWS.
+ * Return 0 or an ITMV_ERR code.
+ */
+int load_allocate(load_state *s) {
+  itmv_loaded *m = s->m;
+  long count;
+
+  switch (s->structure) {
+  case ITMV_DENSE:
+    count = m->rows * m->cols;
+    break;
+  case ITMV_PACKED_UPPER:
+    if (m->rows != m->cols) {
+      return ITMV_ERR_FORMAT;
+    }
+    count = m->rows * (m->rows + 1) / 2;
+    break;
+  case ITMV_CSR:
+    if (m->cols > INT32_MAX) {
+      return ITMV_ERR_FORMAT;
+    }
+    s->cursor = calloc(m->rows + 1, sizeof(atomic_long));
+    return s->cursor == NULL ? ITMV_ERR_IO : 0;
+  default:
+    return ITMV_ERR_FORMAT;
+  }
+  m->nnz = count;
+  m->values = calloc(count, sizeof(double));
+  return m->values == NULL ? ITMV_ERR_IO : 0;
+}
+
+/*-------------------------------------------------------------------
+ * Turn the per-row nonzero counts of PASS_ROWS into row_ptr, allocate the
+ * CSR arrays and leave each row's cursor at its first slot.
+ * Return 0 or an ITMV_ERR code.
+ */
+int load_csr_rows(load_state *s) {
+  itmv_loaded *m = s->m;
+  long i;
+
+  m->row_ptr = malloc((m->rows + 1) * sizeof(int64_t));
+  if (m->row_ptr == NULL) {
+    return ITMV_ERR_IO;
+  }
+  m->row_ptr[0] = 0;
+  for (i = 0; i < m->rows; i++) {
+    m->row_ptr[i + 1] = m->row_ptr[i] + atomic_load(&s->cursor[i]);
+    atomic_store(&s->cursor[i], m->row_ptr[i]);
+  }
+  m->nnz = m->row_ptr[m->rows];
+  m->values = malloc((m->nnz > 0 ? m->nnz : 1) * sizeof(double));
+  m->col_idx = malloc((m->nnz > 0 ? m->nnz : 1) * sizeof(int32_t));
+  return m->values == NULL || m->col_idx == NULL ? ITMV_ERR_IO : 0;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_load_file
+ * Purpose:   Load a MatrixMarket or plain text matrix with the given
+ *            number of threads into the requested storage.
+ * In arg:    path, structure (ITMV_DENSE, ITMV_PACKED_UPPER or ITMV_CSR),
+ *            threads
+ * Out arg:   m: the matrix, the file size and the time taken, so that
+ *            bytes / seconds is the ingestion throughput. Release it with
+ *            itmv_load_free.
+ * Return:    0 successful, otherwise an ITMV_ERR code and m holds nothing.
+ */
+int itmv_load_file(const char *path, int structure, int threads,
+                   itmv_loaded *m) {
+  load_state s;
+  struct stat st;
+  double start = load_time();
+  long body, pos, total, count;
+  void *base;
+  int fd, c, err;
+
+  memset(m, 0, sizeof(*m));
+  memset(&s, 0, sizeof(s));
+  s.m = m;
+  s.structure = structure;
+  m->structure = structure;
+  atomic_init(&s.error, 0);
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return ITMV_ERR_IO;
+  }
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    return st.st_size == 0 ? ITMV_ERR_FORMAT : ITMV_ERR_IO;
+  }
+  base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    return ITMV_ERR_IO;
+  }
+  madvise(base, st.st_size, MADV_WILLNEED);
+  s.base = base;
+  s.size = st.st_size;
+  m->bytes = st.st_size;
+
+  body = parse_header(&s);
+  if (body < 0) {
+    munmap(base, st.st_size);
+    return (int)body;
+  }
+
+  /* One chunk per thread, each starting at the body or just after a
+   * newline; with fewer bytes than threads the first chunks are empty. */
+  s.chunks = threads < 1 ? 1
+             : threads > ITMV_LOAD_THREADS_MAX ? ITMV_LOAD_THREADS_MAX
+                                                : threads;
+  s.start[0] = body;
+  for (c = 1; c < s.chunks; c++) {
+    pos = body + (s.size - body) * c / s.chunks;
+    if (pos < s.start[c - 1]) {
+      pos = s.start[c - 1];
+    }
+    while (pos > body && pos < s.size && s.base[pos - 1] != '\n') {
+      pos++;
+    }
+    s.start[c] = pos;
+  }
+  s.start[s.chunks] = s.size;
+
+  s.pass = PASS_COUNT;
+  load_parallel(&s);
+  for (c = 0, total = 0; c < s.chunks; c++) {
+    count = s.first[c];
+    s.first[c] = total;
+    total += count;
+  }
+
+  err = 0;
+  if (s.kind == KIND_TEXT) {
+    m->rows = total;
+  } else if (total != (s.kind == KIND_ARRAY ? m->rows * m->cols : s.entries)) {
+    err = ITMV_ERR_PARSE;
+  }
+  if (err == 0) {
+    err = load_allocate(&s);
+  }
+  if (err == 0 && structure == ITMV_CSR) {
+    s.pass = PASS_ROWS;
+    load_parallel(&s);
+    err = atomic_load(&s.error);
+    if (err == 0) {
+      err = load_csr_rows(&s);
+    }
+  }
+  if (err == 0) {
+    s.pass = PASS_FILL;
+    load_parallel(&s);
+    err = atomic_load(&s.error);
+  }
+  if (err == 0 && structure == ITMV_CSR && s.kind != KIND_TEXT) {
+    s.pass = PASS_SORT;
+    load_parallel(&s);
+    err = atomic_load(&s.error);
+  }
+
+  munmap(base, st.st_size);
+  free(s.cursor);
+  if (err != 0) {
+    itmv_load_free(m);
+    return err;
+  }
+  m->seconds = load_time() - start;
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Release a matrix loaded by itmv_load_file.
+ */
+void itmv_load_free(itmv_loaded *m) {
+  free(m->values);
+  free(m->row_ptr);
+  free(m->col_idx);
+  memset(m, 0, sizeof(*m));
+}
@@ -0,0 +1,73 @@
+/*
+ * File: itmv_load.h
+ *
+ * Purpose: Parallel loader for matrices kept as text. The file is mapped,
+ *          cut into one chunk per thread at line boundaries, and every
+ *          thread parses its own chunk straight into the output storage,
+ *          so ingestion scales with threads instead of being one fscanf
+ *          loop. Understood inputs:
+ *
+ *            MatrixMarket "matrix coordinate real|integer|pattern
+ *                          general|symmetric", one entry per line, 1-based.
+ *            MatrixMarket "matrix array real|integer general", one value
+ *                          per line, column-major.
+ *            plain text   one matrix row per line, values separated by
+ *                          commas, semicolons, blanks or tabs (CSV).
+ *
+ *          Output storage, chosen by the caller:
+ *
+ *            ITMV_DENSE         rows x cols doubles, row-major; a square
+ *                               one can be used as matrix_A directly.
+ *            ITMV_PACKED_UPPER  the upper triangle of a square matrix, row
+ *                               i holding columns i..n-1 from
+ *                               ITMV_PACKED_INDEX(i, i, n). Nonzeros below
+ *                               the diagonal are an ITMV_ERR_FORMAT unless
+ *                               the file is symmetric.
+ *            ITMV_CSR           values[nnz], row_ptr[rows+1], col_idx[nnz]
+ *                               as in itmv_mmap.h, columns sorted in each
+ *                               row, explicit zeros dropped.
+ *
+ *          Duplicate coordinate entries are not summed; the file is expected
+ *          to hold each (i, j) at most once.
+ */
+
+#ifndef _ITMV_LOAD_CS140
+#define _ITMV_LOAD_CS140
+
+#include <stdint.h>
+#include "itmv_mmap.h"
+
+/* Output only; the binary container stores upper triangles in full. */
+#define ITMV_PACKED_UPPER 3
+
+#define ITMV_PACKED_INDEX(i, j, n)                                           \
+  ((long)(i) * (n) - (long)(i) * ((i) - 1) / 2 + (j) - (i))
+
+#define ITMV_LOAD_THREADS_MAX 64
+
+typedef struct {
+  long rows;
+  long cols;
+  int structure;
+  double *values;
+  int64_t *row_ptr; /* NULL unless ITMV_CSR */
+  int32_t *col_idx; /* NULL unless ITMV_CSR */
+  long nnz;         /* stored values */
+  long bytes;       /* size of the text file */
+  double seconds;   /* wall time of itmv_load_file */
+} itmv_loaded;
+
+int itmv_load_file(const char *path, int structure, int threads,
+                   itmv_loaded *m);
+
+void itmv_load_free(itmv_loaded *m);
+
+double itmv_parse_double(const char *p, const char *end, const char **next);
+
+/* Run fn(arg, c) for every chunk 0 <= c < chunks, each on its own thread.
+ * The parser is shared; each driver links the one of its threading model,
+ * itmv_load_pth.c or itmv_load_omp.c. */
+void itmv_load_parallel(int chunks, void (*fn)(void *arg, int chunk),
+                        void *arg);
+
+#endif
@@ -0,0 +1,376 @@
+/*
+ * File: itmv_mmap.c
+ *
+ * Purpose: Read, validate and write the binary matrix container.
+ *          See itmv_mmap.h.
+ */
+
+#define _GNU_SOURCE
+#include "itmv_mmap.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(itmv_file_header) == ITMV_HEADER_SIZE,
+               "itmv_file_header must stay 128 bytes");
+
+#define FNV_OFFSET 14695981039346656037ull
+#define FNV_PRIME 1099511628211ull
+
+/*-------------------------------------------------------------------
+ * Continue a 64-bit FNV-1a hash over len bytes.
+ */
+uint64_t fnv1a(uint64_t h, const unsigned char *p, size_t len) {
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= FNV_PRIME;
+  }
+  return h;
+}
+
+/*-------------------------------------------------------------------
+ * Round offset up to a multiple of alignment.
+ */
+uint64_t align_up(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+/*-------------------------------------------------------------------
+ * Return 1 if the section [offset, offset+bytes) is aligned and lies
+ * after the header and inside a file of the given size, otherwise 0.
+ */
+int section_ok(const itmv_file_header *h, uint64_t offset, uint64_t bytes,
+               uint64_t size) {
+  return offset >= h->header_size && offset % h->alignment == 0 &&
+         offset <= size && bytes <= size - offset;
+}
+
+/*-------------------------------------------------------------------
+ * Check the header of a file of the given size without touching the
+ * payload.
+ *
+ * Return:   0 if the header is usable, otherwise an ITMV_ERR code.
+ */
+int check_header(const itmv_file_header *h, uint64_t size) {
+  uint64_t n_values;
+
+  if (size < ITMV_HEADER_SIZE) return ITMV_ERR_TRUNCATED;
+  if (memcmp(h->magic, ITMV_MAGIC, sizeof(ITMV_MAGIC)) != 0)
+    return ITMV_ERR_MAGIC;
+  if (h->byte_order != ITMV_BYTE_ORDER) return ITMV_ERR_BYTE_ORDER;
+  if (h->version != ITMV_VERSION) return ITMV_ERR_VERSION;
+  if (h->header_size != ITMV_HEADER_SIZE || h->layout != ITMV_ROW_MAJOR ||
+      h->dtype != ITMV_FLOAT64 || h->structure > ITMV_CSR ||
+      h->alignment < sizeof(double) ||
+      (h->alignment & (h->alignment - 1)) != 0 || h->rows != h->cols ||
+      h->rows == 0 || h->rows > (1ull << 26))
+    return ITMV_ERR_FORMAT;
+  if (h->file_size != size || h->nnz > size) return ITMV_ERR_TRUNCATED;
+
+  n_values = (h->structure == ITMV_CSR) ? h->nnz : h->rows * h->cols;
+  if (!section_ok(h, h->values_offset, n_values * sizeof(double), size))
+    return ITMV_ERR_TRUNCATED;
+  if (h->structure == ITMV_CSR &&
+      (!section_ok(h, h->row_ptr_offset, (h->rows + 1) * sizeof(int64_t),
+                   size) ||
+       !section_ok(h, h->col_idx_offset, h->nnz * sizeof(int32_t), size)))
+    return ITMV_ERR_TRUNCATED;
+  if (h->d_offset != 0 &&
+      !section_ok(h, h->d_offset, h->rows * sizeof(double), size))
+    return ITMV_ERR_TRUNCATED;
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Map a matrix file read-only and point m at its sections. The pages are
+ * shared with the page cache, so nothing is copied; with
+ * ITMV_MAP_POPULATE they are all faulted in before this returns,
+ * otherwise on first use by the solver.
+ *
+ * Argument:  path -- the file
+ *            flags -- ITMV_MAP_* hints, or 0
+ *            m -- out: the mapping
+ *
+ * Return:   0 successful, otherwise an ITMV_ERR code.
+ */
+int itmv_map_open(const char *path, int flags, itmv_mapped *m) {
+  struct stat st;
+  int fd, err, mflags = MAP_SHARED;
+  const itmv_file_header *h;
+
+  memset(m, 0, sizeof(*m));
+  fd = open(path, O_RDONLY);
+  if (fd < 0) return ITMV_ERR_IO;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return ITMV_ERR_IO;
+  }
+  if ((uint64_t)st.st_size < ITMV_HEADER_SIZE) {
+    close(fd);
+    return ITMV_ERR_TRUNCATED;
+  }
+  if (flags & ITMV_MAP_POPULATE) mflags |= MAP_POPULATE;
+  m->base = mmap(NULL, st.st_size, PROT_READ, mflags, fd, 0);
+  /* The mapping keeps its own reference to the file. */
+  close(fd);
+  if (m->base == MAP_FAILED) {
+    m->base = NULL;
+    return ITMV_ERR_IO;
+  }
+  m->length = st.st_size;
+  h = m->base;
+  err = check_header(h, st.st_size);
+  if (err != 0) {
+    itmv_map_close(m);
+    return err;
+  }
+
+  m->header = h;
+  m->values = (double *)((char *)m->base + h->values_offset);
+  if (h->structure == ITMV_CSR) {
+    m->row_ptr = (int64_t *)((char *)m->base + h->row_ptr_offset);
+    m->col_idx = (int32_t *)((char *)m->base + h->col_idx_offset);
+  }
+  if (h->d_offset != 0) m->d = (double *)((char *)m->base + h->d_offset);
+
+  if (flags & ITMV_MAP_SEQUENTIAL) madvise(m->base, m->length, MADV_SEQUENTIAL);
+  if (flags & ITMV_MAP_WILLNEED) madvise(m->base, m->length, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+  if (flags & ITMV_MAP_HUGEPAGE) madvise(m->base, m->length, MADV_HUGEPAGE);
+#endif
+  if (flags & ITMV_MAP_VERIFY) {
+    err = itmv_map_validate(m);
+    if (err != 0) {
+      itmv_map_close(m);
+      return err;
+    }
+  }
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Check the payload of a mapped file: the checksum and, for CSR, that
+ * row_ptr is monotone from 0 to nnz and every column index is in range.
+ * Reads the whole file.
+ *
+ * Return:   0 if the file is intact, otherwise an ITMV_ERR code.
+ */
+int itmv_map_validate(const itmv_mapped *m) {
+  const itmv_file_header *h = m->header;
+  uint64_t i;
+  int64_t k;
+
+  if (fnv1a(FNV_OFFSET, (const unsigned char *)m->base + h->header_size,
+            m->length - h->header_size) != h->checksum)
+    return ITMV_ERR_CHECKSUM;
+  if (h->structure != ITMV_CSR) return 0;
+  if (m->row_ptr[0] != 0 || (uint64_t)m->row_ptr[h->rows] != h->nnz)
+    return ITMV_ERR_INDEX;
+  for (i = 0; i < h->rows; i++) {
+    if (m->row_ptr[i] > m->row_ptr[i + 1]) return ITMV_ERR_INDEX;
+    for (k = m->row_ptr[i]; k < m->row_ptr[i + 1]; k++) {
+      if (m->col_idx[k] < 0 || (uint64_t)m->col_idx[k] >= h->cols)
+        return ITMV_ERR_INDEX;
+    }
+  }
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Read and check the header of an open matrix file without mapping it,
+ * for readers that stream the payload with pread.
+ *
+ * Argument:  fd -- the file, open for reading
+ *            h -- out: the header
+ *
+ * Return:   0 if the header is usable, otherwise an ITMV_ERR code.
+ */
+int itmv_read_header(int fd, itmv_file_header *h) {
+  struct stat st;
+
+  if (fstat(fd, &st) != 0) return ITMV_ERR_IO;
+  if ((uint64_t)st.st_size < ITMV_HEADER_SIZE) return ITMV_ERR_TRUNCATED;
+  if (pread(fd, h, sizeof(*h), 0) != sizeof(*h)) return ITMV_ERR_IO;
+  return check_header(h, st.st_size);
+}
+
+/*-------------------------------------------------------------------
+ * Unmap a file mapped by itmv_map_open.
+ */
+void itmv_map_close(itmv_mapped *m) {
+  if (m->base != NULL) munmap(m->base, m->length);
+  memset(m, 0, sizeof(*m));
+}
+
+/*-------------------------------------------------------------------
+ * Return a message for an ITMV_ERR code.
+ */
+const char *itmv_map_strerror(int err) {
+  switch (err) {
+  case 0:
+    return "ok";
+  case ITMV_ERR_IO:
+    return "cannot open, read or write the file";
+  case ITMV_ERR_MAGIC:
+    return "not an itmv matrix file";
+  case ITMV_ERR_VERSION:
+    return "unsupported format version";
+  case ITMV_ERR_BYTE_ORDER:
+    return "written on a machine of the other byte order";
+  case ITMV_ERR_FORMAT:
+    return "unsupported layout, dtype, structure or dimensions";
+  case ITMV_ERR_TRUNCATED:
+    return "file is shorter than its header says";
+  case ITMV_ERR_CHECKSUM:
+    return "payload checksum mismatch";
+  case ITMV_ERR_INDEX:
+    return "CSR row pointers or column indices out of range";
+  case ITMV_ERR_PARSE:
+    return "malformed number, entry or line in a text matrix";
+  }
+  return "unknown error";
+}
+
+/*-------------------------------------------------------------------
+ * Write one section at offset, zero-padding from the current end.
+ * Return 0 successful, otherwise -1.
+ */
+int write_section(FILE *f, uint64_t *pos, uint64_t offset, const void *data,
+                  uint64_t bytes, uint64_t *checksum) {
+  static const unsigned char zeros[4096];
+  uint64_t pad;
+
+  while (*pos < offset) {
+    pad = offset - *pos > sizeof(zeros) ? sizeof(zeros) : offset - *pos;
+    if (fwrite(zeros, 1, pad, f) != pad) return -1;
+    *checksum = fnv1a(*checksum, zeros, pad);
+    *pos += pad;
+  }
+  if (bytes > 0 && fwrite(data, 1, bytes, f) != bytes) return -1;
+  *checksum = fnv1a(*checksum, data, bytes);
+  *pos += bytes;
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Write an n x n row-major matrix, and d if not NULL, as a matrix file.
+ * For ITMV_UPPER only the entries on and above the diagonal are taken
+ * from A; those below are written as zeros. For ITMV_CSR the nonzeros of
+ * A are stored.
+ *
+ * Argument:  alignment -- section alignment in bytes, a power of two of
+ *                         at least 8; use the page size for the fewest
+ *                         faults per row or 64 for a compact file.
+ *
+ * Return:   0 successful, otherwise an ITMV_ERR code.
+ */
+int itmv_write_file(const char *path, const double A[], const double d[],
+                    int n, int structure, int alignment) {
+  itmv_file_header h;
+  FILE *f;
+  double *row = NULL, *vals = NULL;
+  int64_t *row_ptr = NULL;
+  int32_t *col_idx = NULL;
+  uint64_t pos = ITMV_HEADER_SIZE, checksum = FNV_OFFSET;
+  long i, j;
+  int err = 0;
+
+  if (n <= 0 || structure < ITMV_DENSE || structure > ITMV_CSR ||
+      alignment < (int)sizeof(double) || (alignment & (alignment - 1)) != 0)
+    return ITMV_ERR_FORMAT;
+
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, ITMV_MAGIC, sizeof(ITMV_MAGIC));
+  h.version = ITMV_VERSION;
+  h.byte_order = ITMV_BYTE_ORDER;
+  h.header_size = ITMV_HEADER_SIZE;
+  h.structure = structure;
+  h.layout = ITMV_ROW_MAJOR;
+  h.dtype = ITMV_FLOAT64;
+  h.rows = h.cols = n;
+  h.alignment = alignment;
+
+  if (structure == ITMV_CSR) {
+    row_ptr = malloc((n + 1) * sizeof(int64_t));
+    row_ptr[0] = 0;
+    for (i = 0; i < n; i++) {
+      row_ptr[i + 1] = row_ptr[i];
+      for (j = 0; j < n; j++)
+        if (A[i * n + j] != 0) row_ptr[i + 1]++;
+    }
+    h.nnz = row_ptr[n];
+    vals = malloc((h.nnz ? h.nnz : 1) * sizeof(double));
+    col_idx = malloc((h.nnz ? h.nnz : 1) * sizeof(int32_t));
+    for (i = 0; i < n; i++) {
+      int64_t k = row_ptr[i];
+      for (j = 0; j < n; j++) {
+        if (A[i * n + j] != 0) {
+          vals[k] = A[i * n + j];
+          col_idx[k++] = j;
+        }
+      }
+    }
+    h.values_offset = align_up(ITMV_HEADER_SIZE, alignment);
+    h.row_ptr_offset =
+        align_up(h.values_offset + h.nnz * sizeof(double), alignment);
+    h.col_idx_offset =
+        align_up(h.row_ptr_offset + (n + 1) * sizeof(int64_t), alignment);
+    h.file_size = h.col_idx_offset + h.nnz * sizeof(int32_t);
+  } else {
+    h.nnz = (uint64_t)n * n;
+    h.values_offset = align_up(ITMV_HEADER_SIZE, alignment);
+    h.file_size = h.values_offset + h.nnz * sizeof(double);
+  }
+  if (d != NULL) {
+    h.d_offset = align_up(h.file_size, alignment);
+    h.file_size = h.d_offset + n * sizeof(double);
+  }
+
+  f = fopen(path, "wb");
+  if (f == NULL) {
+    err = ITMV_ERR_IO;
+    goto done;
+  }
+  /* The checksum is only known at the end; write the header twice. */
+  if (fwrite(&h, sizeof(h), 1, f) != 1) err = ITMV_ERR_IO;
+  if (err == 0 && structure == ITMV_CSR) {
+    if (write_section(f, &pos, h.values_offset, vals, h.nnz * sizeof(double),
+                      &checksum) != 0 ||
+        write_section(f, &pos, h.row_ptr_offset, row_ptr,
+                      (n + 1) * sizeof(int64_t), &checksum) != 0 ||
+        write_section(f, &pos, h.col_idx_offset, col_idx,
+                      h.nnz * sizeof(int32_t), &checksum) != 0)
+      err = ITMV_ERR_IO;
+  } else if (err == 0) {
+    row = malloc(n * sizeof(double));
+    for (i = 0; i < n && err == 0; i++) {
+      for (j = 0; j < n; j++)
+        row[j] = (structure == ITMV_UPPER && j < i) ? 0.0 : A[i * n + j];
+      if (write_section(f, &pos, i == 0 ? h.values_offset : pos, row,
+                        n * sizeof(double), &checksum) != 0)
+        err = ITMV_ERR_IO;
+    }
+  }
+  if (err == 0 && d != NULL &&
+      write_section(f, &pos, h.d_offset, d, n * sizeof(double), &checksum) !=
+          0)
+    err = ITMV_ERR_IO;
+  h.checksum = checksum;
+  if (err == 0 && (fseek(f, 0, SEEK_SET) != 0 ||
+                   fwrite(&h, sizeof(h), 1, f) != 1))
+    err = ITMV_ERR_IO;
+  if (fclose(f) != 0 && err == 0) err = ITMV_ERR_IO;
+
+done:
+  free(row);
+  free(vals);
+  free(row_ptr);
+  free(col_idx);
+  return err;
+}
@@ -0,0 +1,109 @@
+/*
+ * File: itmv_mmap.h
+ *
+ * Purpose: A versioned binary container for the itmv matrices that the
+ *          drivers mmap and use in place, so loading a matrix costs page
+ *          faults instead of a parse and a copy.
+ *
+ *          The file is a 128-byte header followed by the payload sections,
+ *          each starting at a multiple of the header's alignment:
+ *
+ *            ITMV_DENSE, ITMV_UPPER -- n x n doubles, row-major. Upper
+ *                                      triangular matrices are stored in
+ *                                      full, zeros below the diagonal, so
+ *                                      matrix_A can point straight at them.
+ *            ITMV_CSR               -- values[nnz], then row_ptr[rows+1] as
+ *                                      int64, then col_idx[nnz] as int32.
+ *            optional d             -- rows doubles.
+ *
+ *          All integers are little-endian as written by this machine; a
+ *          byte-order mark rejects files from the other endianness. A
+ *          64-bit FNV-1a checksum over the payload lets itmv_map_validate
+ *          catch truncated or corrupted files.
+ */
+
+#ifndef _ITMV_MMAP_CS140
+#define _ITMV_MMAP_CS140
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define ITMV_MAGIC "ITMVMAT"
+#define ITMV_VERSION 1
+#define ITMV_BYTE_ORDER 0x01020304u
+#define ITMV_HEADER_SIZE 128
+
+/* structure values */
+#define ITMV_DENSE 0
+#define ITMV_UPPER 1
+#define ITMV_CSR 2
+
+/* layout and dtype values; only these are defined in version 1. */
+#define ITMV_ROW_MAJOR 0
+#define ITMV_FLOAT64 0
+
+/* flags for itmv_map_open */
+#define ITMV_MAP_POPULATE 1   /* MAP_POPULATE: fault every page in now */
+#define ITMV_MAP_SEQUENTIAL 2 /* madvise(MADV_SEQUENTIAL) */
+#define ITMV_MAP_WILLNEED 4   /* madvise(MADV_WILLNEED) */
+#define ITMV_MAP_HUGEPAGE 8   /* madvise(MADV_HUGEPAGE) */
+#define ITMV_MAP_VERIFY 16    /* check the payload checksum on open */
+
+/* Error codes, all negative. */
+#define ITMV_ERR_IO -1
+#define ITMV_ERR_MAGIC -2
+#define ITMV_ERR_VERSION -3
+#define ITMV_ERR_BYTE_ORDER -4
+#define ITMV_ERR_FORMAT -5
+#define ITMV_ERR_TRUNCATED -6
+#define ITMV_ERR_CHECKSUM -7
+#define ITMV_ERR_INDEX -8
+#define ITMV_ERR_PARSE -9 /* malformed text matrix, see itmv_load.h */
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t header_size;
+  uint32_t structure;
+  uint32_t layout;
+  uint32_t dtype;
+  uint64_t rows;
+  uint64_t cols;
+  uint64_t nnz;
+  uint64_t alignment;
+  uint64_t values_offset;
+  uint64_t row_ptr_offset; /* 0 unless ITMV_CSR */
+  uint64_t col_idx_offset; /* 0 unless ITMV_CSR */
+  uint64_t d_offset;       /* 0 if the file carries no d */
+  uint64_t file_size;
+  uint64_t checksum;       /* FNV-1a of bytes [header_size, file_size) */
+  char reserved[16];
+} itmv_file_header;
+
+/* A file mapped by itmv_map_open. The pointers point into the mapping and
+ * stay valid until itmv_map_close. */
+typedef struct {
+  void *base;
+  size_t length;
+  const itmv_file_header *header;
+  double *values;
+  int64_t *row_ptr;
+  int32_t *col_idx;
+  double *d;
+} itmv_mapped;
+
+int itmv_map_open(const char *path, int flags, itmv_mapped *m);
+
+int itmv_map_validate(const itmv_mapped *m);
+
+int itmv_read_header(int fd, itmv_file_header *h);
+
+void itmv_map_close(itmv_mapped *m);
+
+const char *itmv_map_strerror(int err);
+
+int itmv_write_file(const char *path, const double A[], const double d[],
+                    int n, int structure, int alignment);
+
+#endif
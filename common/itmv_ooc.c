@@ -0,0 +1,251 @@
+/*
+ * File: itmv_ooc.c
+ *
+ * Purpose: Reader pipeline of the out-of-core mode. The readers are plain
+ *          pthreads, outside any OpenMP team. See itmv_ooc.h.
+ */
+
+#define _GNU_SOURCE
+#include "itmv_ooc.h"
+#include "itmv_mmap.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define OOC_BUFFERS_MAX (OOC_READERS_MAX + 1)
+
+/* Per-iteration measurements of the last run, no_iterations entries. */
+ooc_iteration *ooc_stats;
+/* Panels per iteration. */
+int ooc_panels;
+/* 0, or the ITMV_ERR code of the first panel that could not be read. */
+int ooc_error;
+
+/* ooc_loaded[b]: the last panel read into buffer b, -1 before any.
+ * ooc_free[b]: the panel buffer b may be filled with next.
+ * ooc_pending[b]: consumers still to release the panel in buffer b.
+ * ooc_next[b]: the next row ooc_claim hands out from buffer b.
+ * ooc_failed: the first panel that could not be read, once ooc_error is
+ * set. Every panel before it is read, so all consumers stop there. */
+int ooc_fd, ooc_n, ooc_rows, ooc_reader_count, ooc_consumers, ooc_total;
+int ooc_nbuf, ooc_stop, ooc_failed;
+long ooc_offset;
+double *ooc_buf[OOC_BUFFERS_MAX];
+int ooc_loaded[OOC_BUFFERS_MAX];
+int ooc_free[OOC_BUFFERS_MAX];
+int ooc_pending[OOC_BUFFERS_MAX];
+atomic_int ooc_next[OOC_BUFFERS_MAX];
+pthread_mutex_t ooc_lock;
+pthread_cond_t ooc_cond;
+pthread_t ooc_reader_handles[OOC_READERS_MAX];
+
+double ooc_time(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*-------------------------------------------------------------------
+ * Reader thread: read panels rank, rank+readers, ... each into its
+ * buffer as soon as the buffer is free, until the run ends.
+ */
+void *ooc_reader(void *rank) {
+  int s, b, p, rows;
+  long bytes, done, got;
+  double start, end;
+  ooc_iteration *it;
+
+  for (s = (long)rank; s < ooc_total; s += ooc_reader_count) {
+    b = s % ooc_nbuf;
+    p = s % ooc_panels;
+    pthread_mutex_lock(&ooc_lock);
+    while (ooc_free[b] != s && !ooc_stop) {
+      pthread_cond_wait(&ooc_cond, &ooc_lock);
+    }
+    pthread_mutex_unlock(&ooc_lock);
+    if (ooc_stop) {
+      break;
+    }
+
+    rows = (p + 1) * ooc_rows > ooc_n ? ooc_n - p * ooc_rows : ooc_rows;
+    bytes = (long)rows * ooc_n * sizeof(double);
+    start = ooc_time();
+    for (done = 0; done < bytes; done += got) {
+      got = pread(ooc_fd, (char *)ooc_buf[b] + done, bytes - done,
+                  ooc_offset + (long)p * ooc_rows * ooc_n * sizeof(double) +
+                      done);
+      if (got <= 0) {
+        /* Wake the consumers waiting for this panel; it never comes. */
+        pthread_mutex_lock(&ooc_lock);
+        if (!ooc_error || s < ooc_failed) {
+          ooc_error = got == 0 ? ITMV_ERR_TRUNCATED : ITMV_ERR_IO;
+          ooc_failed = s;
+        }
+        pthread_cond_broadcast(&ooc_cond);
+        pthread_mutex_unlock(&ooc_lock);
+        return NULL;
+      }
+    }
+
+    end = ooc_time();
+
+    pthread_mutex_lock(&ooc_lock);
+    it = &ooc_stats[s / ooc_panels];
+    it->bytes += bytes;
+    if (start < it->read_start) {
+      it->read_start = start;
+    }
+    if (end > it->read_end) {
+      it->read_end = end;
+    }
+    atomic_store(&ooc_next[b], p * ooc_rows);
+    ooc_loaded[b] = s;
+    pthread_cond_broadcast(&ooc_cond);
+    pthread_mutex_unlock(&ooc_lock);
+  }
+  return NULL;
+}
+
+/*-------------------------------------------------------------------
+ * Open a dense or upper triangular matrix file of dimension n and start
+ * the readers for a run of up to iterations passes over A.
+ *
+ * Argument:  panel_rows -- rows per panel; each buffer holds one panel
+ *            readers -- reader threads, at most OOC_READERS_MAX
+ *            consumers -- threads that will release each panel
+ *
+ * Return:   0 successful, otherwise an ITMV_ERR code.
+ */
+int ooc_open(const char *path, int n, int panel_rows, int readers,
+             int consumers, int iterations) {
+  itmv_file_header h;
+  long r;
+  int b, err;
+
+  if (panel_rows <= 0 || readers <= 0 || readers > OOC_READERS_MAX ||
+      consumers <= 0 || iterations <= 0)
+    return ITMV_ERR_FORMAT;
+  ooc_fd = open(path, O_RDONLY);
+  if (ooc_fd < 0) return ITMV_ERR_IO;
+  err = itmv_read_header(ooc_fd, &h);
+  if (err == 0 && (h.structure == ITMV_CSR || h.rows != (uint64_t)n))
+    err = ITMV_ERR_FORMAT;
+  if (err != 0) {
+    close(ooc_fd);
+    return err;
+  }
+  /* Each panel is read once per iteration, front to back. */
+  posix_fadvise(ooc_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  ooc_n = n;
+  ooc_rows = panel_rows > n ? n : panel_rows;
+  ooc_panels = (n + ooc_rows - 1) / ooc_rows;
+  ooc_reader_count = readers;
+  ooc_consumers = consumers;
+  ooc_total = iterations * ooc_panels;
+  ooc_nbuf = readers + 1;
+  ooc_offset = h.values_offset;
+  ooc_stop = 0;
+  ooc_error = 0;
+  free(ooc_stats);
+  ooc_stats = calloc(iterations, sizeof(ooc_iteration));
+  err = ooc_stats == NULL;
+  for (b = 0; b < ooc_nbuf; b++) {
+    ooc_buf[b] = malloc((long)ooc_rows * n * sizeof(double));
+    err |= ooc_buf[b] == NULL;
+    ooc_loaded[b] = -1;
+    ooc_free[b] = b;
+    ooc_pending[b] = consumers;
+  }
+  if (err) {
+    for (b = 0; b < ooc_nbuf; b++) {
+      free(ooc_buf[b]);
+    }
+    close(ooc_fd);
+    return ITMV_ERR_IO;
+  }
+  for (r = 0; r < iterations; r++) {
+    ooc_stats[r].read_start = 1e300;
+  }
+  pthread_mutex_init(&ooc_lock, NULL);
+  pthread_cond_init(&ooc_cond, NULL);
+  for (r = 0; r < readers; r++) {
+    pthread_create(&ooc_reader_handles[r], NULL, ooc_reader, (void *)r);
+  }
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Block until panel s is in memory, or a reader has failed.
+ * Out args:  first, rows -- the rows of A the panel holds
+ * Return:    the panel, rows x n doubles, row-major, or NULL if it cannot
+ *            be read; ooc_error then says why
+ */
+const double *ooc_acquire(int s, int *first, int *rows) {
+  int b = s % ooc_nbuf, p = s % ooc_panels, loaded;
+
+  pthread_mutex_lock(&ooc_lock);
+  while (ooc_loaded[b] != s && !(ooc_error && s >= ooc_failed)) {
+    pthread_cond_wait(&ooc_cond, &ooc_lock);
+  }
+  loaded = ooc_loaded[b] == s;
+  pthread_mutex_unlock(&ooc_lock);
+  if (!loaded) {
+    return NULL;
+  }
+  *first = p * ooc_rows;
+  *rows = (p + 1) * ooc_rows > ooc_n ? ooc_n - p * ooc_rows : ooc_rows;
+  return ooc_buf[b];
+}
+
+/*-------------------------------------------------------------------
+ * Hand out the next chunk rows of acquired panel s, for dynamic
+ * schedules. Return the first row of the chunk; it is past the panel
+ * once the panel is used up.
+ */
+int ooc_claim(int s, int chunk) {
+  return atomic_fetch_add(&ooc_next[s % ooc_nbuf], chunk);
+}
+
+/*-------------------------------------------------------------------
+ * Release panel s. The last of the consumers frees its buffer for the
+ * panel ooc_nbuf further on.
+ */
+void ooc_release(int s) {
+  int b = s % ooc_nbuf;
+
+  pthread_mutex_lock(&ooc_lock);
+  if (--ooc_pending[b] == 0) {
+    ooc_pending[b] = ooc_consumers;
+    ooc_free[b] = s + ooc_nbuf;
+    pthread_cond_broadcast(&ooc_cond);
+  }
+  pthread_mutex_unlock(&ooc_lock);
+}
+
+/*-------------------------------------------------------------------
+ * Stop the readers, which may be ahead of a run that converged early,
+ * and release the buffers. ooc_stats stays valid until the next
+ * ooc_open.
+ */
+void ooc_close(void) {
+  int r, b;
+
+  pthread_mutex_lock(&ooc_lock);
+  ooc_stop = 1;
+  pthread_cond_broadcast(&ooc_cond);
+  pthread_mutex_unlock(&ooc_lock);
+  for (r = 0; r < ooc_reader_count; r++) {
+    pthread_join(ooc_reader_handles[r], NULL);
+  }
+  for (b = 0; b < ooc_nbuf; b++) {
+    free(ooc_buf[b]);
+  }
+  pthread_mutex_destroy(&ooc_lock);
+  pthread_cond_destroy(&ooc_cond);
+  close(ooc_fd);
+}
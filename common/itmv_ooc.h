@@ -0,0 +1,58 @@
+/*
+ * File: itmv_ooc.h
+ *
+ * Purpose: Stream the rows of A from a matrix file (see itmv_mmap.h) for
+ *          the out-of-core mode, when A does not fit in memory.
+ *
+ *          The rows are read in panels of panel_rows rows. Panel s of the
+ *          whole run -- iteration s / ooc_panels, panel s % ooc_panels --
+ *          is read by reader thread s % readers into buffer
+ *          s % (readers + 1) with pread. With one reader that is double
+ *          buffering: the next panel is read while this one is multiplied.
+ *          A buffer is reused once every consumer has released the panel
+ *          in it, so up to readers panels are in flight at any time.
+ *
+ *          ooc_open(path, n, panel_rows, readers, consumers, t);
+ *          for each iteration k and panel p:
+ *              a = ooc_acquire(k * ooc_panels + p, &first, &rows);
+ *              ... rows [first, first+rows) of A are a[0 .. rows*n) ...
+ *              ooc_release(k * ooc_panels + p);
+ *          ooc_close();
+ *
+ *          A reader that fails stores the error in ooc_error and wakes
+ *          the consumers. ooc_acquire returns NULL for that panel to
+ *          every one of them, so they all stop at the same panel and
+ *          ooc_close ends the run.
+ */
+
+#ifndef _ITMV_OOC_CS140
+#define _ITMV_OOC_CS140
+
+#define OOC_READERS_MAX 8
+
+/* What the out-of-core mode measured in one iteration. Reads of an
+ * iteration may overlap the compute of the one before. */
+typedef struct {
+  long bytes;         /* read from the file */
+  double read_start;  /* wall_time of the first read */
+  double read_end;    /* wall_time the last read finished */
+  double compute_sec; /* slowest thread's time in y=d+Ax */
+  double stall_sec;   /* slowest thread's time waiting for panels */
+} ooc_iteration;
+
+extern ooc_iteration *ooc_stats;
+extern int ooc_panels;
+extern int ooc_error;
+
+int ooc_open(const char *path, int n, int panel_rows, int readers,
+             int consumers, int iterations);
+
+const double *ooc_acquire(int s, int *first, int *rows);
+
+int ooc_claim(int s, int chunk);
+
+void ooc_release(int s);
+
+void ooc_close(void);
+
+#endif
@@ -0,0 +1,313 @@
+/*
+ * File: itmv_op.c
+ *
+ * Purpose: The structured operators of itmv_op.h.
+ */
+
+#include "itmv_op.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*-------------------------------------------------------------------
+ * Set the fields every constructor shares and clear the rest.
+ */
+void op_init(itmv_op *op, int kind, int n) {
+  memset(op, 0, sizeof(*op));
+  op->kind = kind;
+  op->n = n;
+}
+
+/*-------------------------------------------------------------------
+ * OP_CONST_DIAG: (Ax)_i = c (sum x - x_i) + diag_i x_i.
+ */
+void const_diag_prepare(itmv_op *op, const double x[]) {
+  double sum = 0;
+  int j;
+
+  for (j = 0; j < op->n; j++) {
+    sum += x[j];
+  }
+  op->sum = sum;
+}
+
+double const_diag_row(const itmv_op *op, int i, const double x[]) {
+  double d = op->diag != NULL ? op->diag[i] : 0;
+
+  return op->c * (op->sum - x[i]) + d * x[i];
+}
+
+/*-------------------------------------------------------------------
+ * OP_LOWRANK_DIAG: (Ax)_i = diag_i x_i + U_i (V^T x).
+ */
+void lowrank_prepare(itmv_op *op, const double x[]) {
+  int j, r;
+
+  for (r = 0; r < op->rank; r++) {
+    op->w[r] = 0;
+  }
+  for (j = 0; j < op->n; j++) {
+    for (r = 0; r < op->rank; r++) {
+      op->w[r] += op->V[(long)j * op->rank + r] * x[j];
+    }
+  }
+}
+
+double lowrank_row(const itmv_op *op, int i, const double x[]) {
+  const double *u = op->U + (long)i * op->rank;
+  double sum = op->diag != NULL ? op->diag[i] * x[i] : 0;
+  int r;
+
+  for (r = 0; r < op->rank; r++) {
+    sum += u[r] * op->w[r];
+  }
+  return sum;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  fft
+ * Purpose:   In-place iterative radix-2 FFT of m complex numbers stored as
+ *            re, im pairs. m is a power of 2 and twiddle[k] =
+ *            exp(-2 pi i k / m); inverse uses the conjugates and does not
+ *            divide by m.
+ */
+void fft(double a[], int m, const double twiddle[], int inverse) {
+  int i, j, k, len, half, step;
+  double re, im, wr, wi, t;
+
+  for (i = 1, j = 0; i < m; i++) {
+    for (k = m >> 1; j & k; k >>= 1) {
+      j ^= k;
+    }
+    j |= k;
+    if (i < j) {
+      t = a[2 * i], a[2 * i] = a[2 * j], a[2 * j] = t;
+      t = a[2 * i + 1], a[2 * i + 1] = a[2 * j + 1], a[2 * j + 1] = t;
+    }
+  }
+  for (len = 2; len <= m; len <<= 1) {
+    half = len >> 1;
+    step = m / len;
+    for (i = 0; i < m; i += len) {
+      for (j = 0; j < half; j++) {
+        double *u = a + 2 * (i + j), *v = a + 2 * (i + j + half);
+        wr = twiddle[2 * j * step];
+        wi = inverse ? -twiddle[2 * j * step + 1] : twiddle[2 * j * step + 1];
+        re = v[0] * wr - v[1] * wi;
+        im = v[0] * wi + v[1] * wr;
+        v[0] = u[0] - re;
+        v[1] = u[1] - im;
+        u[0] += re;
+        u[1] += im;
+      }
+    }
+  }
+}
+
+/*-------------------------------------------------------------------
+ * OP_TOEPLITZ, OP_CIRCULANT: (Ax)_{n-1+i} of the linear convolution of t
+ * and x, taken as a circular convolution of length m >= 2n-1 so nothing
+ * wraps around into the rows kept.
+ */
+void toeplitz_prepare(itmv_op *op, const double x[]) {
+  int j, m = op->m, n = op->n;
+  double re, im, *a = op->work, *s = op->spectrum;
+
+  for (j = 0; j < m; j++) {
+    a[2 * j] = j < n ? x[j] : 0;
+    a[2 * j + 1] = 0;
+  }
+  fft(a, m, op->twiddle, 0);
+  for (j = 0; j < m; j++) {
+    re = a[2 * j] * s[2 * j] - a[2 * j + 1] * s[2 * j + 1];
+    im = a[2 * j] * s[2 * j + 1] + a[2 * j + 1] * s[2 * j];
+    a[2 * j] = re;
+    a[2 * j + 1] = im;
+  }
+  fft(a, m, op->twiddle, 1);
+  for (j = 0; j < n; j++) {
+    op->ax[j] = a[2 * (n - 1 + j)] / m;
+  }
+}
+
+double toeplitz_row(const itmv_op *op, int i, const double x[]) {
+  (void)x;
+  return op->ax[i];
+}
+
+/*-------------------------------------------------------------------
+ * Function:  toeplitz_init
+ * Purpose:   Set op up as the Toeplitz operator of t (2n-1 entries, see
+ *            itmv_op.h) with the given kind: allocate the FFT buffers and
+ *            keep the spectrum of t, so t itself is not needed afterwards.
+ * Return:    0 successful, -1 out of memory
+ */
+int toeplitz_init(itmv_op *op, int kind, int n, const double t[]) {
+  int j, m = 1;
+
+  while (m < 2 * n - 1) {
+    m <<= 1;
+  }
+  op_init(op, kind, n);
+  op->m = m;
+  op->prepare = toeplitz_prepare;
+  op->row = toeplitz_row;
+  op->twiddle = malloc((m > 1 ? m : 2) * sizeof(double));
+  op->spectrum = malloc(2 * m * sizeof(double));
+  op->work = malloc(2 * m * sizeof(double));
+  op->ax = malloc(n * sizeof(double));
+  if (op->twiddle == NULL || op->spectrum == NULL || op->work == NULL ||
+      op->ax == NULL) {
+    itmv_op_destroy(op);
+    return -1;
+  }
+  for (j = 0; j < m / 2; j++) {
+    op->twiddle[2 * j] = cos(2 * M_PI * j / m);
+    op->twiddle[2 * j + 1] = -sin(2 * M_PI * j / m);
+  }
+  for (j = 0; j < m; j++) {
+    op->spectrum[2 * j] = j < 2 * n - 1 ? t[j] : 0;
+    op->spectrum[2 * j + 1] = 0;
+  }
+  fft(op->spectrum, m, op->twiddle, 0);
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_op_const_diag
+ * Purpose:   Make op the operator with c off the diagonal and diag[i] on
+ *            it; diag may be NULL for a zero diagonal.
+ * Return:    0 successful, -1 meaning an invalid argument
+ */
+int itmv_op_const_diag(itmv_op *op, int n, double c, const double diag[]) {
+  if (op == NULL || n <= 0) return -1;
+  op_init(op, OP_CONST_DIAG, n);
+  op->c = c;
+  op->diag = diag;
+  op->prepare = const_diag_prepare;
+  op->row = const_diag_row;
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_op_toeplitz
+ * Purpose:   Make op the Toeplitz operator A[i][j] = t[n-1+i-j].
+ * Return:    0 successful, -1 meaning an invalid argument or out of memory
+ */
+int itmv_op_toeplitz(itmv_op *op, int n, const double t[]) {
+  if (op == NULL || n <= 0 || t == NULL) return -1;
+  return toeplitz_init(op, OP_TOEPLITZ, n, t);
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_op_circulant
+ * Purpose:   Make op the circulant operator A[i][j] = c[(i-j) mod n], as
+ *            the Toeplitz operator with the diagonals c wraps around to.
+ * Return:    0 successful, -1 meaning an invalid argument or out of memory
+ */
+int itmv_op_circulant(itmv_op *op, int n, const double c[]) {
+  double *t;
+  int k, err;
+
+  if (op == NULL || n <= 0 || c == NULL) return -1;
+  if ((t = malloc((2 * n - 1) * sizeof(double))) == NULL) return -1;
+  for (k = 0; k < 2 * n - 1; k++) {
+    t[k] = c[(k + 1) % n];
+  }
+  err = toeplitz_init(op, OP_CIRCULANT, n, t);
+  free(t);
+  return err;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_op_lowrank_diag
+ * Purpose:   Make op the operator diag(diag) + U V^T; diag may be NULL.
+ * Return:    0 successful, -1 meaning an invalid argument or out of memory
+ */
+int itmv_op_lowrank_diag(itmv_op *op, int n, int rank, const double diag[],
+                         const double U[], const double V[]) {
+  if (op == NULL || n <= 0 || rank <= 0 || U == NULL || V == NULL) return -1;
+  op_init(op, OP_LOWRANK_DIAG, n);
+  op->rank = rank;
+  op->diag = diag;
+  op->U = U;
+  op->V = V;
+  op->prepare = lowrank_prepare;
+  op->row = lowrank_row;
+  if ((op->w = malloc(rank * sizeof(double))) == NULL) return -1;
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_op_callback
+ * Purpose:   Make op an operator the caller computes: prepare (or NULL)
+ *            once per x, then row for each row. data is for them to use.
+ * Return:    0 successful, -1 meaning an invalid argument
+ */
+int itmv_op_callback(itmv_op *op, int n, itmv_op_prepare_fn prepare,
+                     itmv_op_row_fn row, void *data) {
+  if (op == NULL || n <= 0 || row == NULL) return -1;
+  op_init(op, OP_CALLBACK, n);
+  op->prepare = prepare;
+  op->row = row;
+  op->data = data;
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_op_apply
+ * Purpose:   ax = Ax, sequentially.
+ */
+void itmv_op_apply(itmv_op *op, const double x[], double ax[]) {
+  int i;
+
+  if (op->prepare != NULL) {
+    op->prepare(op, x);
+  }
+  for (i = 0; i < op->n; i++) {
+    ax[i] = op->row(op, i, x);
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_op_to_dense
+ * Purpose:   Write the n x n matrix of op to A, row-major, column by column
+ *            as A e_j. For checking an operator against the dense drivers
+ *            at small n.
+ * Return:    0 successful, -1 out of memory
+ */
+int itmv_op_to_dense(itmv_op *op, double A[]) {
+  int i, j, n = op->n;
+  double *e = calloc(n, sizeof(double)), *col = malloc(n * sizeof(double));
+
+  if (e == NULL || col == NULL) {
+    free(e);
+    free(col);
+    return -1;
+  }
+  for (j = 0; j < n; j++) {
+    e[j] = 1;
+    itmv_op_apply(op, e, col);
+    for (i = 0; i < n; i++) {
+      A[(long)i * n + j] = col[i];
+    }
+    e[j] = 0;
+  }
+  free(e);
+  free(col);
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_op_destroy
+ * Purpose:   Free what the operator allocated. The caller's arrays are
+ *            left alone.
+ */
+void itmv_op_destroy(itmv_op *op) {
+  free(op->w);
+  free(op->twiddle);
+  free(op->spectrum);
+  free(op->work);
+  free(op->ax);
+  op->w = op->twiddle = op->spectrum = op->work = op->ax = NULL;
+}
@@ -0,0 +1,97 @@
+/*
+ * File: itmv_op.h
+ *
+ * Purpose: Structured operators A for y = d + Ax that are never stored as
+ *          n x n doubles, so an iteration costs O(n) or O(n log n) instead
+ *          of streaming n^2 doubles, and n is limited by the vectors alone.
+ *
+ *          An operator is applied in two steps. prepare(op, x) runs once
+ *          per x, by one thread, and keeps whatever the rows share; then
+ *          row(op, i, x) returns (Ax)_i, for the rows in any order and from
+ *          any thread. The built-in classes:
+ *
+ *            OP_CONST_DIAG    A[i][j] = c off the diagonal, diag[i] on it.
+ *                             prepare sums x, a row is O(1). The test
+ *                             matrix of the drivers is c = -1/n, diag 0.
+ *            OP_TOEPLITZ      A[i][j] = t[n-1+i-j], t of 2n-1 entries.
+ *            OP_CIRCULANT     A[i][j] = c[(i-j) mod n], c of n entries.
+ *                             Both: prepare takes the whole product as a
+ *                             convolution by FFT, O(n log n); a row is a
+ *                             lookup.
+ *            OP_LOWRANK_DIAG  A = diag(diag) + U V^T, U and V n x rank,
+ *                             row-major. prepare forms V^T x, O(n rank);
+ *                             a row is O(rank).
+ *            OP_CALLBACK      prepare and row given by the caller, with
+ *                             data for them; prepare may be NULL.
+ *
+ *          itmv_op op;
+ *          itmv_op_const_diag(&op, n, -1.0 / n, diag);
+ *          matrix_op = &op;               (the drivers use op, not A)
+ *          parallel_itmv_mult(...);
+ *          matrix_op = NULL;
+ *          itmv_op_destroy(&op);
+ *
+ *          The arrays given to the constructors belong to the caller and
+ *          must outlive the operator. An operator defines all of A, so
+ *          matrix_type is ignored while one is set.
+ */
+
+#ifndef _ITMV_OP_CS140
+#define _ITMV_OP_CS140
+
+/* kind values */
+#define OP_CONST_DIAG 0
+#define OP_TOEPLITZ 1
+#define OP_CIRCULANT 2
+#define OP_LOWRANK_DIAG 3
+#define OP_CALLBACK 4
+
+struct itmv_op;
+
+typedef void (*itmv_op_prepare_fn)(struct itmv_op *op, const double x[]);
+typedef double (*itmv_op_row_fn)(const struct itmv_op *op, int i,
+                                 const double x[]);
+
+typedef struct itmv_op {
+  int kind;
+  int n;
+  itmv_op_prepare_fn prepare;
+  itmv_op_row_fn row;
+  void *data; /* OP_CALLBACK */
+
+  /* The representation, owned by the caller. */
+  double c;            /* OP_CONST_DIAG */
+  const double *diag;  /* OP_CONST_DIAG, OP_LOWRANK_DIAG */
+  const double *U;     /* OP_LOWRANK_DIAG */
+  const double *V;
+  int rank;
+
+  /* What prepare keeps, owned by the operator. */
+  double sum;       /* OP_CONST_DIAG: the sum of x */
+  double *w;        /* OP_LOWRANK_DIAG: V^T x */
+  int m;            /* OP_TOEPLITZ, OP_CIRCULANT: FFT length, 2^k >= 2n-1 */
+  double *spectrum; /* the FFT of the zero-padded t, m complex numbers */
+  double *twiddle;  /* exp(-2 pi i k / m) for k < m/2 */
+  double *work;     /* m complex numbers */
+  double *ax;       /* Ax, n */
+} itmv_op;
+
+int itmv_op_const_diag(itmv_op *op, int n, double c, const double diag[]);
+
+int itmv_op_toeplitz(itmv_op *op, int n, const double t[]);
+
+int itmv_op_circulant(itmv_op *op, int n, const double c[]);
+
+int itmv_op_lowrank_diag(itmv_op *op, int n, int rank, const double diag[],
+                         const double U[], const double V[]);
+
+int itmv_op_callback(itmv_op *op, int n, itmv_op_prepare_fn prepare,
+                     itmv_op_row_fn row, void *data);
+
+void itmv_op_apply(itmv_op *op, const double x[], double ax[]);
+
+int itmv_op_to_dense(itmv_op *op, double A[]);
+
+void itmv_op_destroy(itmv_op *op);
+
+#endif
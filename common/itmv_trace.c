@@ -0,0 +1,158 @@
+/*
+ * File: itmv_trace.c
+ *
+ * Purpose: Per-thread ring buffers of phase timings and their Chrome trace
+ *          JSON export. See itmv_trace.h.
+ */
+
+#include "itmv_trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* One thread's buffer. count is the number of events recorded since
+ * trace_init; the buffer holds the last trace_capacity of them. Padded to
+ * a cache line so threads appending to neighbouring rings do not share
+ * one. */
+typedef struct {
+  trace_event *events;
+  long count;
+  char pad[64 - sizeof(trace_event *) - sizeof(long)];
+} trace_ring;
+
+trace_ring *trace_rings;
+int trace_threads;
+int trace_capacity;
+double trace_origin;
+
+static const char *trace_names[] = {"compute", "check", "wait", "copy"};
+
+double trace_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  trace_init
+ * Purpose:   Start a new trace for the given number of threads, each
+ *            keeping its last capacity events. The buffers of the previous
+ *            trace are reused when the sizes match, so calling this before
+ *            every run costs nothing but a reset.
+ * Return:    0 successful, -1 out of memory
+ */
+int trace_init(int threads, int capacity) {
+  int r;
+
+  if (trace_rings == NULL || threads != trace_threads ||
+      capacity != trace_capacity) {
+    trace_free();
+    trace_rings = calloc(threads, sizeof(trace_ring));
+    if (trace_rings == NULL) {
+      return -1;
+    }
+    trace_threads = threads;
+    trace_capacity = capacity;
+    for (r = 0; r < threads; r++) {
+      trace_rings[r].events = malloc(capacity * sizeof(trace_event));
+      if (trace_rings[r].events == NULL) {
+        trace_free();
+        return -1;
+      }
+      /* Fault the pages in now rather than inside a timed phase. */
+      memset(trace_rings[r].events, 0, capacity * sizeof(trace_event));
+    }
+  }
+  for (r = 0; r < threads; r++) {
+    trace_rings[r].count = 0;
+  }
+  trace_origin = trace_now();
+  return 0;
+}
+
+/*-------------------------------------------------------------------
+ * Append one phase of thread rank, overwriting its oldest event when the
+ * ring is full. Only thread rank may call this for rank.
+ */
+void trace_record(int rank, int phase, int iteration, double start,
+                  double end) {
+  trace_ring *ring;
+  trace_event *e;
+
+  if (rank < 0 || rank >= trace_threads) {
+    return;
+  }
+  ring = &trace_rings[rank];
+  e = &ring->events[ring->count % trace_capacity];
+  e->start = start;
+  e->end = end;
+  e->phase = phase;
+  e->iteration = iteration;
+  ring->count++;
+}
+
+/*-------------------------------------------------------------------
+ * Return the number of events thread rank recorded since trace_init,
+ * including those the ring has since overwritten.
+ */
+long trace_count(int rank) {
+  return rank >= 0 && rank < trace_threads ? trace_rings[rank].count : 0;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  trace_dump
+ * Purpose:   Write the events still in the rings as Chrome trace JSON:
+ *            one complete ("X") event per phase, timestamps in
+ *            microseconds since trace_init, one track per thread, the
+ *            iteration in args.
+ * Return:    0 successful, -1 if the file cannot be written
+ */
+int trace_dump(const char *path) {
+  FILE *f = fopen(path, "w");
+  const trace_event *e;
+  long i, first;
+  int r, comma = 0;
+
+  if (f == NULL) {
+    return -1;
+  }
+  fprintf(f, "{\"traceEvents\":[\n");
+  for (r = 0; r < trace_threads; r++) {
+    fprintf(f,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"thread %d\"}}",
+            comma++ ? ",\n" : "", r, r);
+  }
+  for (r = 0; r < trace_threads; r++) {
+    first = trace_rings[r].count > trace_capacity
+                ? trace_rings[r].count - trace_capacity
+                : 0;
+    for (i = first; i < trace_rings[r].count; i++) {
+      e = &trace_rings[r].events[i % trace_capacity];
+      fprintf(f,
+              ",\n{\"name\":\"%s\",\"cat\":\"itmv\",\"ph\":\"X\",\"pid\":1,"
+              "\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+              "\"args\":{\"iteration\":%d}}",
+              trace_names[e->phase], r, (e->start - trace_origin) * 1e6,
+              (e->end - e->start) * 1e6, e->iteration);
+    }
+  }
+  fprintf(f, "\n],\"displayTimeUnit\":\"ns\"}\n");
+  return fclose(f) == 0 ? 0 : -1;
+}
+
+/*-------------------------------------------------------------------
+ * Release the ring buffers.
+ */
+void trace_free(void) {
+  int r;
+
+  for (r = 0; trace_rings != NULL && r < trace_threads; r++) {
+    free(trace_rings[r].events);
+  }
+  free(trace_rings);
+  trace_rings = NULL;
+  trace_threads = 0;
+  trace_capacity = 0;
+}
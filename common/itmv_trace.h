@@ -0,0 +1,67 @@
+/*
+ * File: itmv_trace.h
+ *
+ * Purpose: Per-thread timeline of the phases of each iteration -- compute,
+ *          convergence check, barrier wait and copy -- for telling load
+ *          imbalance from synchronization cost. Every thread appends to
+ *          its own preallocated ring buffer, keeping the last
+ *          TRACE_CAPACITY events, and trace_dump writes them all as Chrome
+ *          trace JSON (chrome://tracing, ui.perfetto.dev).
+ *
+ *          The drivers are instrumented with the TRACE_ macros, which
+ *          compile to nothing unless built with -DITMV_TRACE
+ *          (make TRACE=-DITMV_TRACE):
+ *
+ *            TRACE_START(thread_count);               (before a run)
+ *            TRACE_VAR(t0);
+ *            TRACE_MARK(t0);
+ *            ... the phase ...
+ *            TRACE_SPAN(my_rank, TRACE_COMPUTE, k, t0);
+ */
+
+#ifndef _ITMV_TRACE_CS140
+#define _ITMV_TRACE_CS140
+
+/* Phases */
+#define TRACE_COMPUTE 0
+#define TRACE_CHECK 1
+#define TRACE_WAIT 2
+#define TRACE_COPY 3
+
+/* Events kept per thread. */
+#define TRACE_CAPACITY 65536
+
+typedef struct {
+  double start;
+  double end;
+  int phase;
+  int iteration;
+} trace_event;
+
+int trace_init(int threads, int capacity);
+
+double trace_now(void);
+
+void trace_record(int rank, int phase, int iteration, double start,
+                  double end);
+
+long trace_count(int rank);
+
+int trace_dump(const char *path);
+
+void trace_free(void);
+
+#ifdef ITMV_TRACE
+#define TRACE_START(threads) trace_init(threads, TRACE_CAPACITY)
+#define TRACE_VAR(v) double v
+#define TRACE_MARK(v) ((v) = trace_now())
+#define TRACE_SPAN(rank, phase, iteration, v)                                 \
+  trace_record(rank, phase, iteration, v, trace_now())
+#else
+#define TRACE_START(threads) ((void)0)
+#define TRACE_VAR(v)
+#define TRACE_MARK(v) ((void)0)
+#define TRACE_SPAN(rank, phase, iteration, v) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,273 @@
+/* File:     itmv_mult_mpi.c
+ *
+ * Purpose:  Implement the Jacobi iteration y = d + Ax across processes with
+ *           MPI. Each process computes the rows of y in its band against
+ *           its full copy of x; MPI_Allgatherv then hands every process
+ *           all of the new x. The convergence error is combined with a
+ *           max-reduction started before, and completed after, the
+ *           allgather so the two overlap.
+ *
+ *           Inside a process the band is split into equal blocks of rows
+ *           over threads: with OpenMP when built with -fopenmp, or with a
+ *           pthreads team synchronized by cs140barrier when built with
+ *           -DITMV_PTHREADS. Only the calling thread makes MPI calls, so
+ *           MPI_THREAD_FUNNELED is enough.
+ *
+ * Algorithm:
+ *        For k = 0 to t-1
+ *            y[band] = d[band] + A[band] x
+ *            x = allgather(y[band])
+ *            if max over all processes |x_i - y_i| < threshold: break
+ *        Endfor
+ */
+
+#include "itmv_mult_mpi.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef ITMV_PTHREADS
+#include <pthread.h>
+#include "cs140barrier.h"
+#elif defined(_OPENMP)
+#include <omp.h>
+#endif
+
+int iterations_done;
+double comm_time;
+
+/* The band this process works on during parallel_itmv_mult. */
+struct {
+  double *A;
+  double *d;
+  double *y;
+  double *x;
+  int matrix_type;
+  int n;
+  int first;
+  int count;
+} band;
+
+#ifdef ITMV_PTHREADS
+/* The pthreads team of a run. The caller is rank 0; the others wait on
+ * team_barrier for each sweep, and leave once team_stop is set. */
+cs140barrier team_barrier;
+int team_size;
+int team_stop;
+double team_error[THREAD_COUNT_MAX];
+#endif
+
+/*-------------------------------------------------------------------
+ * Function:  block_range
+ * Purpose:   Give the band of rows process my_rank of no_proc owns.
+ * Out args:  first: its first row
+ *            count: its number of rows
+ */
+void block_range(int n, int no_proc, int my_rank, int *first, int *count) {
+  *first = (long)n * my_rank / no_proc;
+  *count = (long)n * (my_rank + 1) / no_proc - *first;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  band_rows
+ * Purpose:   Compute y = d + Ax for rows [begin, end) of the band.
+ * Return:    max |y_i - x_i| over those rows
+ */
+double band_rows(int begin, int end) {
+  double error = 0, y, diff;
+  int i, j, row, n = band.n;
+  const double *a;
+
+  for (i = begin; i < end; i++) {
+    row = band.first + i;
+    a = band.A + (long)i * n;
+    y = band.d[i];
+    for (j = band.matrix_type == UPPER_TRIANGULAR ? row : 0; j < n; j++) {
+      y += a[j] * band.x[j];
+    }
+    band.y[i] = y;
+    diff = fabs(y - band.x[row]);
+    if (diff > error) {
+      error = diff;
+    }
+  }
+  return error;
+}
+
+#ifdef ITMV_PTHREADS
+/*-------------------------------------------------------------------
+ * Compute thread rank's block of the band. Return its error.
+ */
+double team_rows(long rank) {
+  return band_rows((long)band.count * rank / team_size,
+                   (long)band.count * (rank + 1) / team_size);
+}
+
+void *team_worker(void *rank) {
+  for (;;) {
+    cs140barrier_wait(&team_barrier);
+    if (team_stop) {
+      break;
+    }
+    team_error[(long)rank] = team_rows((long)rank);
+    cs140barrier_wait(&team_barrier);
+  }
+  return NULL;
+}
+#endif
+
+/*-------------------------------------------------------------------
+ * Function:  band_sweep
+ * Purpose:   Compute y = d + Ax for the whole band with the given number
+ *            of threads.
+ * Return:    max |y_i - x_i| over the band
+ */
+double band_sweep(int threads) {
+  double error = 0;
+
+#ifdef ITMV_PTHREADS
+  int r;
+
+  (void)threads; /* parallel_itmv_mult started team_size threads */
+  cs140barrier_wait(&team_barrier);
+  team_error[0] = team_rows(0);
+  cs140barrier_wait(&team_barrier);
+  for (r = 0; r < team_size; r++) {
+    if (team_error[r] > error) {
+      error = team_error[r];
+    }
+  }
+#elif defined(_OPENMP)
+#pragma omp parallel num_threads(threads) reduction(max : error)
+  {
+    int r = omp_get_thread_num(), size = omp_get_num_threads();
+
+    error = band_rows((long)band.count * r / size,
+                      (long)band.count * (r + 1) / size);
+  }
+#else
+  (void)threads;
+  error = band_rows(0, band.count);
+#endif
+  return error;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  parallel_itmv_mult
+ * Purpose:   Run at most t iterations of {y=d+Ax; x=y} on all processes of
+ *            comm, stopping once no entry of x moved by ERROR_THRESHOLD.
+ *            Every process calls it with its own band.
+ * In args:   local_A: the band of A, count rows of n doubles (block_range)
+ *            local_d: the band of d
+ *            matrix_type: UPPER_TRIANGULAR or not
+ *            n, t: dimension and maximum number of iterations
+ *            threads: threads per process for the band (hybrid mode)
+ *            my_rank, no_proc, comm: this process, and all of them
+ * In/out:    global_x: all of x, the same on every process; on return the
+ *            last y
+ * Out args:  local_y: the band of the last y
+ * Global out vars:
+ *            iterations_done, comm_time
+ * Return:    the number of iterations, or -1 if out of memory.
+ */
+int parallel_itmv_mult(double local_A[], double local_d[], double local_y[],
+                       double global_x[], int matrix_type, int n, int t,
+                       int threads, int my_rank, int no_proc, MPI_Comm comm) {
+  int *counts, *displs;
+  int k, r;
+  double error, global_error, start;
+  MPI_Request request;
+#ifdef ITMV_PTHREADS
+  pthread_t handles[THREAD_COUNT_MAX];
+#endif
+
+  counts = malloc(no_proc * sizeof(int));
+  displs = malloc(no_proc * sizeof(int));
+  if (counts == NULL || displs == NULL) {
+    free(counts);
+    free(displs);
+    return -1;
+  }
+  for (r = 0; r < no_proc; r++) {
+    block_range(n, no_proc, r, &displs[r], &counts[r]);
+  }
+  band.A = local_A;
+  band.d = local_d;
+  band.y = local_y;
+  band.x = global_x;
+  band.matrix_type = matrix_type;
+  band.n = n;
+  band.first = displs[my_rank];
+  band.count = counts[my_rank];
+  if (threads < 1) {
+    threads = 1;
+  } else if (threads > THREAD_COUNT_MAX) {
+    threads = THREAD_COUNT_MAX;
+  }
+
+#ifdef ITMV_PTHREADS
+  team_size = threads;
+  team_stop = 0;
+  cs140barrier_init(&team_barrier, threads);
+  for (r = 1; r < threads; r++) {
+    pthread_create(&handles[r], NULL, team_worker, (void *)(long)r);
+  }
+#endif
+
+  comm_time = 0;
+  for (k = 0; k < t;) {
+    error = band_sweep(threads);
+    start = MPI_Wtime();
+    MPI_Iallreduce(&error, &global_error, 1, MPI_DOUBLE, MPI_MAX, comm,
+                   &request);
+    MPI_Allgatherv(local_y, band.count, MPI_DOUBLE, global_x, counts, displs,
+                   MPI_DOUBLE, comm);
+    MPI_Wait(&request, MPI_STATUS_IGNORE);
+    comm_time += MPI_Wtime() - start;
+    k++;
+    if (global_error < ERROR_THRESHOLD) {
+      break;
+    }
+  }
+  iterations_done = k;
+
+#ifdef ITMV_PTHREADS
+  team_stop = 1;
+  cs140barrier_wait(&team_barrier);
+  for (r = 1; r < threads; r++) {
+    pthread_join(handles[r], NULL);
+  }
+  cs140barrier_destroy(&team_barrier);
+#endif
+  free(counts);
+  free(displs);
+  return iterations_done;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_mult_seq
+ * Purpose:   Sequential reference: at most t iterations of {y=d+Ax; x=y}
+ *            on the whole matrix, stopping as parallel_itmv_mult does.
+ * Return:    1 successful, 0 on bad arguments
+ */
+int itmv_mult_seq(double A[], double x[], double d[], double y[],
+                  int matrix_type, int n, int t) {
+  int i, j, k, stop;
+
+  if (n <= 0 || A == NULL || x == NULL || d == NULL || y == NULL) return 0;
+
+  for (k = 0; k < t; k++) {
+    for (i = 0; i < n; i++) {
+      y[i] = d[i];
+      for (j = matrix_type == UPPER_TRIANGULAR ? i : 0; j < n; j++) {
+        y[i] += A[i * n + j] * x[j];
+      }
+    }
+    stop = 1;
+    for (i = 0; i < n; i++) {
+      if (fabs(x[i] - y[i]) >= ERROR_THRESHOLD) stop = 0;
+      x[i] = y[i];
+    }
+    if (stop) break;
+  }
+  return 1;
+}
@@ -0,0 +1,35 @@
+/*
+ * File: itmv_mult_mpi.h
+ *
+ * Purpose: Distributed-memory Jacobi iteration y = d + Ax. Process r of p
+ *          owns rows block_range(n, p, r) of A and d -- n/p consecutive
+ *          rows, the first n%p processes one row fewer -- and a full copy
+ *          of x.
+ */
+
+#ifndef _ITMV_MULT_MPI_CS140
+#define _ITMV_MULT_MPI_CS140
+
+#include <mpi.h>
+
+#define UPPER_TRIANGULAR 1
+
+#define THREAD_COUNT_MAX 64
+
+#define ERROR_THRESHOLD 1e-3
+
+/* Iterations of y=d+Ax the last run performed. */
+extern int iterations_done;
+/* Seconds the last run spent in the allgather and the max-reduction. */
+extern double comm_time;
+
+void block_range(int n, int no_proc, int my_rank, int *first, int *count);
+
+int parallel_itmv_mult(double local_A[], double local_d[], double local_y[],
+                       double global_x[], int matrix_type, int n, int t,
+                       int threads, int my_rank, int no_proc, MPI_Comm comm);
+
+int itmv_mult_seq(double A[], double x[], double d[], double y[],
+                  int matrix_type, int n, int t);
+
+#endif
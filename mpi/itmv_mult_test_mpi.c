@@ -0,0 +1,273 @@
+/*
+ * File:     itmv_mult_test_mpi.c
+ *
+ * Purpose:  test the distributed iterative matrix vector multiplication
+ * y=d+Ax. Every process builds only its own band of the test matrix.
+ * Input test matrix:  A[i][j] = -1/n off the diagonal (above it for an
+ *                     upper triangular A), 0 elsewhere.
+ *                     x[i] is 0 in all positions.
+ * Process 0 gathers nothing extra: x is replicated, so it checks its copy
+ * against the sequential code and prints the summary report.
+ *
+ * Usage:    mpirun -np <processes> ./itmv_mult_test_mpi [threads per process]
+ */
+
+#include <math.h>
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "itmv_mult_mpi.h"
+#include "minunit.h"
+
+#define MAX_TEST_MATRIX_SIZE 256
+
+#define TEST_CORRECTNESS 1
+#define TEST_REACH_CONVERGENCE 1
+#define THRESHOLD 0.000001
+
+int my_rank, no_proc, thread_count = 1;
+
+void print_error(char *msgheader, char *msg) {
+  printf("%s error msg: %s\n", msgheader, msg);
+}
+
+/*-------------------------------------------------------------------
+ * Build rows [first, first+count) of the test matrix and d, and all of x.
+ * Row first is row 0 of A and d.
+ */
+void initialize(double A[], double x[], double d[], int n, int matrix_type,
+                int first, int count) {
+  int i, j, row;
+
+  for (i = 0; i < n; i++) {
+    x[i] = 0;
+  }
+  for (i = 0; i < count; i++) {
+    row = first + i;
+    if (matrix_type == UPPER_TRIANGULAR)
+      d[i] = (2.0 * n - 1.0 * row - 1.0) / n;
+    else
+      d[i] = (2.0 * n - 1.0) / n;
+    for (j = 0; j < n; j++) {
+      A[(long)i * n + j] =
+          (j == row || (matrix_type == UPPER_TRIANGULAR && j < row))
+              ? 0.0
+              : -1.0 / n;
+    }
+  }
+}
+
+/*-------------------------------------------------------------------
+ * Run the sequential code on the whole test matrix.
+ * Return its y, to be freed by the caller.
+ */
+double *compute_expected(int n, int t, int matrix_type) {
+  double *A, *x, *d, *y;
+
+  A = malloc((long)n * n * sizeof(double));
+  x = malloc(n * sizeof(double));
+  d = malloc(n * sizeof(double));
+  y = malloc(n * sizeof(double));
+  initialize(A, x, d, n, matrix_type, 0, n);
+  itmv_mult_seq(A, x, d, y, matrix_type, n, t);
+  free(A);
+  free(x);
+  free(d);
+  return y;
+}
+
+char *validate_vect(double y[], int n, int t, int matrix_type) {
+  int i;
+  double *expected;
+  if (n <= 0) return "Failed: 0 or negative size";
+  if (n > MAX_TEST_MATRIX_SIZE) return "Failed: Too big to validate";
+
+  expected = compute_expected(n, t, matrix_type);
+  for (i = 0; i < n; i++) {
+    if (fabs(y[i] - expected[i]) >= THRESHOLD) {
+      free(expected);
+      return "One mismatch in iterative mat-vect multiplication";
+    }
+  }
+  free(expected);
+  return NULL;
+}
+
+char *validate_convergence(double y[], int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    mu_assert("Failed to reach convergence",
+              fabs(y[i] - 1.0) < ERROR_THRESHOLD);
+  }
+  return NULL;
+}
+
+/*-------------------------------------------------------------------
+ * Test the distributed iteration on all processes of MPI_COMM_WORLD.
+ * Process 0 reports the slowest process's latency, the GFLOPS that gives
+ * and the time spent communicating, and checks the result.
+ * If failed, return a message string on process 0. If successful, return
+ * NULL
+ */
+char *itmv_test(char *testmsg, int test_correctness, int test_reach_convergence,
+                int n, int mtype, int t) {
+  double *local_A, *local_d, *local_y, *global_x;
+  double startwtime, latency, max_latency, max_comm, flops;
+  int first, count, done, ok, all_ok;
+  char *msg = NULL;
+
+  block_range(n, no_proc, my_rank, &first, &count);
+  local_A = malloc(((long)count * n > 0 ? (long)count * n : 1) *
+                   sizeof(double));
+  local_d = malloc((count > 0 ? count : 1) * sizeof(double));
+  local_y = malloc((count > 0 ? count : 1) * sizeof(double));
+  global_x = malloc(n * sizeof(double));
+  ok = local_A != NULL && local_d != NULL && local_y != NULL &&
+       global_x != NULL;
+  /* Every process must agree before any enters a collective. */
+  MPI_Allreduce(&ok, &all_ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+  if (!all_ok) {
+    free(local_A);
+    free(local_d);
+    free(local_y);
+    free(global_x);
+    msg = "Failed space allocation";
+    if (my_rank == 0) print_error(testmsg, msg);
+    return msg;
+  }
+  initialize(local_A, global_x, local_d, n, mtype, first, count);
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  startwtime = MPI_Wtime();
+  done = parallel_itmv_mult(local_A, local_d, local_y, global_x, mtype, n, t,
+                            thread_count, my_rank, no_proc, MPI_COMM_WORLD);
+  latency = MPI_Wtime() - startwtime;
+  MPI_Reduce(&latency, &max_latency, 1, MPI_DOUBLE, MPI_MAX, 0,
+             MPI_COMM_WORLD);
+  MPI_Reduce(&comm_time, &max_comm, 1, MPI_DOUBLE, MPI_MAX, 0,
+             MPI_COMM_WORLD);
+
+  if (my_rank == 0) {
+    flops = (mtype == UPPER_TRIANGULAR ? (double)n * (n + 1)
+                                       : 2.0 * n * n) * done;
+    printf("%s: Latency = %f sec and %.4f GFLOPS with %d processes x %d "
+           "threads. Matrix dimension %d. Iterations = %d. Communication = "
+           "%f sec\n",
+           testmsg, max_latency, flops / max_latency / 1e9, no_proc,
+           thread_count, n, done, max_comm);
+    if (done < 0) {
+      msg = "Failed space allocation";
+    }
+    if (msg == NULL && test_correctness == TEST_CORRECTNESS) {
+      msg = validate_vect(global_x, n, t, mtype);
+    }
+    if (msg == NULL && test_reach_convergence == TEST_REACH_CONVERGENCE) {
+      msg = validate_convergence(global_x, n);
+    }
+    if (msg != NULL) {
+      print_error(testmsg, msg);
+    }
+  }
+
+  free(local_A);
+  free(local_d);
+  free(local_y);
+  free(global_x);
+  return msg; /*Only process 0 conducts correctness test, and prints summary
+                 report*/
+}
+
+char *itmv_test1() {
+  return itmv_test("Test 1: n=4 t=1", TEST_CORRECTNESS,
+                   !TEST_REACH_CONVERGENCE, 4, !UPPER_TRIANGULAR, 1);
+}
+
+char *itmv_test2() {
+  return itmv_test("Test 2: n=4 t=2 upper", TEST_CORRECTNESS,
+                   !TEST_REACH_CONVERGENCE, 4, UPPER_TRIANGULAR, 2);
+}
+
+char *itmv_test3() {
+  return itmv_test("Test 3: n=17 t=3 uneven bands", TEST_CORRECTNESS,
+                   !TEST_REACH_CONVERGENCE, 17, !UPPER_TRIANGULAR, 3);
+}
+
+char *itmv_test4() {
+  return itmv_test("Test 4: n=17 t=3 upper uneven bands", TEST_CORRECTNESS,
+                   !TEST_REACH_CONVERGENCE, 17, UPPER_TRIANGULAR, 3);
+}
+
+char *itmv_test5() {
+  return itmv_test("Test 5: n=2 t=4 fewer rows than processes",
+                   TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 2,
+                   !UPPER_TRIANGULAR, 4);
+}
+
+char *itmv_test6() {
+  return itmv_test("Test 6: n=64 t=4K to convergence", TEST_CORRECTNESS,
+                   TEST_REACH_CONVERGENCE, 64, !UPPER_TRIANGULAR, 4096);
+}
+
+char *itmv_test7() {
+  return itmv_test("Test 7: n=64 t=4K upper to convergence", TEST_CORRECTNESS,
+                   TEST_REACH_CONVERGENCE, 64, UPPER_TRIANGULAR, 4096);
+}
+
+char *itmv_test8() {
+  return itmv_test("Test 8: n=4K t=1K", !TEST_CORRECTNESS,
+                   !TEST_REACH_CONVERGENCE, 4096, !UPPER_TRIANGULAR, 1024);
+}
+
+char *itmv_test9() {
+  return itmv_test("Test 9: n=4K t=1K upper", !TEST_CORRECTNESS,
+                   !TEST_REACH_CONVERGENCE, 4096, UPPER_TRIANGULAR, 1024);
+}
+
+/*-------------------------------------------------------------------
+ * Run all tests.  Ignore returned messages.
+ */
+void run_all_tests(void) {
+  mu_run_test(itmv_test1);
+  mu_run_test(itmv_test2);
+  mu_run_test(itmv_test3);
+  mu_run_test(itmv_test4);
+  mu_run_test(itmv_test5);
+  mu_run_test(itmv_test6);
+  mu_run_test(itmv_test7);
+  mu_run_test(itmv_test8);
+  mu_run_test(itmv_test9);
+}
+
+/*-------------------------------------------------------------------
+ * The main entrance to run all tests.
+ * Only Proc 0 prints the test summary
+ */
+int main(int argc, char *argv[]) {
+  int provided;
+
+  MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+  MPI_Comm_size(MPI_COMM_WORLD, &no_proc);
+  MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
+  if (argc == 2) {
+    thread_count = atoi(argv[1]);
+  }
+  if (argc > 2 || thread_count <= 0 || thread_count > THREAD_COUNT_MAX) {
+    if (my_rank == 0) {
+      printf("mpirun -np <processes> ./itmv_mult_test_mpi "
+             "[threads per process]\n");
+    }
+    MPI_Finalize();
+    return 1;
+  }
+  if (thread_count > 1 && provided < MPI_THREAD_FUNNELED && my_rank == 0) {
+    printf("Warning: MPI provides no thread support\n");
+  }
+
+  run_all_tests();
+
+  if (my_rank == 0) {
+    mu_print_test_summary("Summary:");
+  }
+  MPI_Finalize();
+  return 0;
+}
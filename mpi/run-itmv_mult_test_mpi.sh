@@ -0,0 +1,23 @@
+#!/bin/bash  
+# Next line shows the job name you can find when querying the job status
+#SBATCH --job-name="itmvmpi"
+# Next line is the output file name of the execution log
+#SBATCH --output="job_itmvmpi.%j.out"
+# Next line shows where to ask for machine nodes
+#SBATCH --partition=shared
+#Next line asks for 1 node and 4 cores per node for a total of 4 cores.
+#SBATCH --nodes=1
+#SBATCH --ntasks-per-node=4
+#SBATCH --export=ALL
+# Next line limits the job execution time at most 3 minute.
+#SBATCH -t 00:03:00
+#SBATCH --account=csb175
+
+# 1, 2 and 4 processes with one thread each
+mpirun -np 1 ./itmv_mult_test_mpi
+mpirun -np 2 ./itmv_mult_test_mpi
+mpirun -np 4 ./itmv_mult_test_mpi
+
+# Hybrid: 2 processes x 2 threads, OpenMP then pthreads
+mpirun -np 2 --bind-to none ./itmv_mult_test_mpi 2
+mpirun -np 2 --bind-to none ./itmv_mult_test_mpi_pth 2
@@ -0,0 +1,122 @@
+/*
+ * File: affinity_omp.c
+ *
+ * Purpose: Bind OpenMP threads to the CPUs of the pinning policy resolved
+ *          by affinity.c. See affinity.h.
+ */
+
+#define _GNU_SOURCE
+#include "affinity.h"
+#include <omp.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*-------------------------------------------------------------------
+ * Hand the CPU list to the OpenMP runtime. The runtime reads OMP_PLACES
+ * and OMP_PROC_BIND only when the program starts, so set them and restart
+ * the program in place. Leaves things alone when no policy is set, when
+ * this is the restarted program, or when the user set OMP_PLACES already.
+ *
+ * Argument:  argv -- the program's arguments, passed on unchanged.
+ *
+ * Return:   0 if the runtime will bind threads as requested (or nothing
+ *           was requested), -1 if the program runs unpinned. Does not
+ *           return if the restart succeeds.
+ */
+int affinity_export_omp(char *argv[]) {
+  char *places;
+  int i, pos = 0;
+
+  if (affinity_count == 0 || getenv("ITMV_AFFINITY_EXPORTED") != NULL)
+    return 0;
+  if (getenv("OMP_PLACES") != NULL) {
+    printf("Affinity: OMP_PLACES is already set, leaving binding to it\n");
+    return 0;
+  }
+
+  places = malloc(affinity_count * 16 + 1);
+  places[0] = '\0';
+  for (i = 0; i < affinity_count; i++) {
+    pos += sprintf(places + pos, "%s{%d}", i ? "," : "",
+                   affinity_cpus[i].id);
+  }
+  setenv("OMP_PLACES", places, 1);
+  setenv("OMP_PROC_BIND", "close", 1);
+  setenv("ITMV_AFFINITY_EXPORTED", affinity_spec, 1);
+  free(places);
+  fflush(stdout);
+  execv("/proc/self/exe", argv);
+
+  printf("Affinity: could not restart with OMP_PLACES, threads are not "
+         "pinned\n");
+  return -1;
+}
+
+/*-------------------------------------------------------------------
+ * Pin the calling thread to one CPU, for thread teams that bind
+ * themselves rather than through OMP_PLACES.
+ *
+ * Return:   0 successful, otherwise -1.
+ */
+int affinity_bind_cpu(int cpu) {
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return sched_setaffinity(0, sizeof(set), &set);
+}
+
+/*-------------------------------------------------------------------
+ * Print the CPUs each of nthreads OpenMP threads is bound to, as
+ * reported by the runtime.
+ */
+void affinity_print(int nthreads) {
+  int *place = malloc(nthreads * sizeof(int));
+  int *cpu = malloc(nthreads * sizeof(int));
+  int r, n, p, *ids;
+
+  printf("Affinity: %s, OMP_PLACES=%s OMP_PROC_BIND=%s\n",
+         getenv("ITMV_AFFINITY_EXPORTED") ? getenv("ITMV_AFFINITY_EXPORTED")
+                                          : affinity_spec,
+         getenv("OMP_PLACES") ? getenv("OMP_PLACES") : "unset",
+         getenv("OMP_PROC_BIND") ? getenv("OMP_PROC_BIND") : "unset");
+#pragma omp parallel num_threads(nthreads)
+  {
+    int me = omp_get_thread_num();
+    place[me] = omp_get_place_num();
+    cpu[me] = sched_getcpu();
+  }
+  for (r = 0; r < nthreads; r++) {
+    if (place[r] < 0) {
+      printf("  thread %d -> unbound, on cpu %d\n", r, cpu[r]);
+      continue;
+    }
+    n = omp_get_place_num_procs(place[r]);
+    ids = malloc(n * sizeof(int));
+    omp_get_place_proc_ids(place[r], ids);
+    printf("  thread %d -> place %d cpus", r, place[r]);
+    for (p = 0; p < n; p++) printf(" %d", ids[p]);
+    printf("\n");
+    free(ids);
+  }
+  free(place);
+  free(cpu);
+}
+
+/*-------------------------------------------------------------------
+ * Zero a freshly allocated array with a static OpenMP loop over nthreads
+ * bound threads, so that with first-touch page placement each chunk lands
+ * on the memory node of the thread that uses it under block mapping.
+ * Does nothing when no policy is set.
+ */
+void affinity_first_touch(double *a, long len, int nthreads) {
+  long i;
+
+  if (affinity_count == 0 && getenv("ITMV_AFFINITY_EXPORTED") == NULL) return;
+#pragma omp parallel for num_threads(nthreads) schedule(static)
+  for (i = 0; i < len; i++) {
+    a[i] = 0;
+  }
+}
@@ -0,0 +1,209 @@
+/* File:     itmv_ctx_omp.c
+ *
+ * Purpose:  Reentrant Jacobi iteration y = d + Ax over a context object.
+ *           See itmv_ctx_omp.h. The iteration is jacobi_solve of
+ *           itmv_mult_omp.c, run over an itmv_solve that points at the
+ *           fields of the context.
+ */
+#include "itmv_ctx_omp.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*---------------------------------------------------------------------
+ * Function:  ctx_to_solve
+ * Purpose:   Describe the context's solve for jacobi_solve and solve_row.
+ * In arg:    ctx -- the context
+ * Out arg:   s
+ */
+void ctx_to_solve(itmv_ctx *ctx, itmv_solve *s) {
+  s->A = ctx->A;
+  s->x = ctx->x;
+  s->d = ctx->d;
+  s->y = ctx->y;
+  s->n = ctx->n;
+  s->matrix_type = ctx->matrix_type;
+  s->band_lower = ctx->band_lower;
+  s->band_upper = ctx->band_upper;
+  s->thread_count = ctx->thread_count;
+  s->mapping = ctx->mapping;
+  s->chunksize = ctx->chunksize;
+  s->threshold = ctx->threshold;
+  s->cpus = ctx->cpus;
+  s->cpu_count = ctx->cpu_count;
+  s->thread_compute_time = ctx->thread_compute_time;
+  s->sync_wait_time = ctx->sync_wait_time;
+  s->thread_rows = ctx->thread_rows;
+  s->thread_flops = ctx->thread_flops;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_ctx_init
+ * Purpose:   Set up a context over caller-owned arrays with default
+ *            options.
+ * In args:   A, x, d, y -- the n x n matrix and vectors of the solve
+ *            n -- the matrix dimension
+ *            matrix_type -- 0 for a regular matrix, UPPER_TRIANGULAR
+ *                           or BANDED; set band_lower and band_upper
+ *                           afterwards for BANDED
+ *            thread_count -- the size of the thread team
+ * Out arg:   ctx
+ * Return:    0 successful, otherwise -1 meaning an invalid argument.
+ */
+int itmv_ctx_init(itmv_ctx *ctx, double A[], double x[], double d[],
+                  double y[], int n, int matrix_type, int thread_count) {
+  if (ctx == NULL || n <= 0 || thread_count <= 0 ||
+      thread_count > THREAD_COUNT_MAX) {
+    return -1;
+  }
+  ctx->A = A;
+  ctx->x = x;
+  ctx->d = d;
+  ctx->y = y;
+  ctx->n = n;
+  ctx->matrix_type = matrix_type;
+  ctx->band_lower = 0;
+  ctx->band_upper = 0;
+  ctx->no_iterations = 1;
+  ctx->mapping = BLOCK_MAPPING;
+  ctx->chunksize = 1;
+  ctx->threshold = ERROR_THRESHOLD;
+  ctx->thread_count = thread_count;
+  ctx->cpu_count = 0;
+  ctx->iterations_done = 0;
+  return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_ctx_set_cpus
+ * Purpose:   Pin the context's thread r to cpus[r % count] on later runs.
+ *            A count of 0 leaves binding to the runtime. Use
+ *            affinity_cpu_list to turn a policy string into cpus.
+ * Return:    0 successful, otherwise -1.
+ */
+int itmv_ctx_set_cpus(itmv_ctx *ctx, const int cpus[], int count) {
+  int i;
+
+  if (count < 0 || count > THREAD_COUNT_MAX) return -1;
+  for (i = 0; i < count; i++) {
+    ctx->cpus[i] = cpus[i];
+  }
+  ctx->cpu_count = count;
+  return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_ctx_run
+ * Purpose:   Run up to no_iterations of {y=d+Ax; x=y} with a team of
+ *            thread_count threads, stopping early once max |y-x| <
+ *            threshold.
+ * In/out:    ctx -- x and y are updated, iterations_done and the
+ *            per-thread counters are set.
+ * Return:    0 successful, otherwise -1 meaning an unsupported mapping.
+ */
+int itmv_ctx_run(itmv_ctx *ctx) {
+  int mapping = ctx->mapping, r;
+  itmv_solve s;
+
+  if (mapping != BLOCK_MAPPING && mapping != BLOCK_CYCLIC &&
+      mapping != BLOCK_DYNAMIC && mapping != BLOCK_GUIDED) {
+    return -1;
+  }
+  if (mapping != BLOCK_MAPPING && ctx->chunksize <= 0) {
+    return -1;
+  }
+  for (r = 0; r < THREAD_COUNT_MAX; r++) {
+    ctx->thread_compute_time[r] = ctx->sync_wait_time[r] = 0;
+    ctx->thread_flops[r] = 0;
+    ctx->thread_rows[r] = 0;
+  }
+  ctx_to_solve(ctx, &s);
+  ctx->iterations_done = jacobi_solve(&s, ctx->no_iterations);
+  return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_ctx_destroy
+ * Purpose:   Release what the context holds. The arrays are the caller's,
+ *            and the team only lives for one itmv_ctx_run, so there is
+ *            nothing to free yet; call it anyway to stay source compatible
+ *            with the pthreads version.
+ */
+void itmv_ctx_destroy(itmv_ctx *ctx) { ctx->cpu_count = 0; }
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_ctx_solve_seq
+ * Purpose:   Run the same iteration as itmv_ctx_run on the calling thread
+ *            alone. The context's thread settings are ignored.
+ * In/out:    ctx -- x and y are updated, iterations_done is set.
+ * Return:    0
+ */
+int itmv_ctx_solve_seq(itmv_ctx *ctx) {
+  int i, k, n = ctx->n;
+  double error;
+  itmv_solve s;
+
+  ctx_to_solve(ctx, &s);
+  for (k = 0; k < ctx->no_iterations; k++) {
+    for (i = 0; i < n; i++) {
+      ctx->y[i] = solve_row(&s, i);
+    }
+    error = 0;
+    for (i = 0; i < n; i++) {
+      error = fmax(error, fabs(ctx->y[i] - ctx->x[i]));
+      ctx->x[i] = ctx->y[i];
+    }
+    if (error < ctx->threshold) {
+      k++;
+      break;
+    }
+  }
+  ctx->iterations_done = k;
+  return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_batch_run
+ * Purpose:   Solve count independent problems with thread_count threads.
+ *            Members with n >= parallel_n are run first, one at a time,
+ *            by itmv_ctx_run with their team resized to thread_count.
+ *            The rest are handed out one member at a time with a dynamic
+ *            schedule and solved whole by itmv_ctx_solve_seq, so a thread
+ *            that finishes early simply takes the next one.
+ * In args:   problems -- initialized contexts, one per problem
+ *            count -- the number of problems
+ *            thread_count -- the size of the team
+ *            parallel_n -- smallest n solved with intra-solve parallelism,
+ *                          normally ITMV_BATCH_PARALLEL_N
+ * Return:    the number of members solved with intra-solve parallelism,
+ *            or -1 meaning an invalid argument or unsupported mapping.
+ */
+int itmv_batch_run(itmv_ctx *problems[], int count, int thread_count,
+                   int parallel_n) {
+  int *order;
+  int small = 0, large = 0, i;
+
+  if (count < 0 || thread_count <= 0 || thread_count > THREAD_COUNT_MAX) {
+    return -1;
+  }
+  order = malloc((count > 0 ? count : 1) * sizeof(int));
+  for (i = 0; i < count; i++) {
+    if (problems[i]->n < parallel_n) {
+      order[small++] = i;
+      continue;
+    }
+    problems[i]->thread_count = thread_count;
+    if (itmv_ctx_run(problems[i]) != 0) {
+      free(order);
+      return -1;
+    }
+    large++;
+  }
+
+#pragma omp parallel for num_threads(thread_count) schedule(dynamic, 1)
+  for (i = 0; i < small; i++) {
+    itmv_ctx_solve_seq(problems[order[i]]);
+  }
+  free(order);
+  return large;
+}
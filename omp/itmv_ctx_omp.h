@@ -0,0 +1,86 @@
+/*
+ * File: itmv_ctx_omp.h
+ *
+ * Purpose: Reentrant interface to the Jacobi iteration y = d + Ax for the
+ *          OpenMP driver. A context owns one solve's view of A, x, d and
+ *          y, its options and the CPUs of its thread team, and touches
+ *          none of the globals of itmv_mult_omp.c. Each itmv_ctx_run opens
+ *          its own parallel region, so contexts run from different caller
+ *          threads get independent teams and may run at the same time.
+ *
+ *          itmv_ctx ctx;
+ *          itmv_ctx_init(&ctx, A, x, d, y, n, matrix_type, threads);
+ *          ctx.no_iterations = t;
+ *          itmv_ctx_set_cpus(&ctx, cpus, ncpus);    (optional)
+ *          itmv_ctx_run(&ctx);                      (any number of times)
+ *          itmv_ctx_destroy(&ctx);
+ *
+ *          BLOCK_MAPPING, BLOCK_CYCLIC, BLOCK_DYNAMIC and BLOCK_GUIDED are
+ *          supported; the other mappings still run through
+ *          parallel_itmv_mult. A run is jacobi_solve of itmv_mult_omp.c,
+ *          the iteration parallel_itmv_mult runs for those mappings, so it
+ *          fills the same counters -- here the context's -- and, built
+ *          with -DITMV_TRACE, records into the one timeline of
+ *          itmv_trace.h by thread number: trace one context at a time.
+ *
+ *          itmv_batch_run solves many independent contexts with one team:
+ *          small members are solved whole by one thread each, handed out
+ *          one at a time, and members with n of at least parallel_n are
+ *          solved one at a time by the whole team.
+ */
+
+#ifndef _ITMV_CTX_OMP
+#define _ITMV_CTX_OMP
+
+#include "itmv_mult_omp.h"
+
+typedef struct itmv_ctx {
+  /* The problem. The arrays belong to the caller. */
+  double *A;
+  double *x;
+  double *d;
+  double *y;
+  int n;
+  int matrix_type;
+  int band_lower; /* the bandwidths of a BANDED A (itmv_band.h), set */
+  int band_upper; /* after itmv_ctx_init, which makes them 0 */
+
+  /* Options, given defaults by itmv_ctx_init. */
+  int no_iterations; /* 1 */
+  int mapping;       /* BLOCK_MAPPING */
+  int chunksize;     /* 1, for all but BLOCK_MAPPING */
+  double threshold;  /* ERROR_THRESHOLD */
+
+  /* The thread team. cpus[r % cpu_count] is thread r's CPU when
+   * cpu_count > 0; with cpu_count 0 binding is left to the runtime. */
+  int thread_count;
+  int cpus[THREAD_COUNT_MAX];
+  int cpu_count;
+
+  /* Results of the last itmv_ctx_run. */
+  int iterations_done;
+  double thread_compute_time[THREAD_COUNT_MAX];
+  double sync_wait_time[THREAD_COUNT_MAX];
+  long thread_rows[THREAD_COUNT_MAX];
+  double thread_flops[THREAD_COUNT_MAX];
+} itmv_ctx;
+
+int itmv_ctx_init(itmv_ctx *ctx, double A[], double x[], double d[],
+                  double y[], int n, int matrix_type, int thread_count);
+
+int itmv_ctx_set_cpus(itmv_ctx *ctx, const int cpus[], int count);
+
+int itmv_ctx_run(itmv_ctx *ctx);
+
+void itmv_ctx_destroy(itmv_ctx *ctx);
+
+int itmv_ctx_solve_seq(itmv_ctx *ctx);
+
+/* Default parallel_n for itmv_batch_run: below this a solve spends more
+ * time in the barriers of each iteration than in y=d+Ax. */
+#define ITMV_BATCH_PARALLEL_N 1024
+
+int itmv_batch_run(itmv_ctx *problems[], int count, int thread_count,
+                   int parallel_n);
+
+#endif
@@ -0,0 +1,23 @@
+/*
+ * File: itmv_load_omp.c
+ *
+ * Purpose: itmv_load_parallel for the OpenMP driver. See itmv_load.h.
+ */
+
+#include "itmv_load.h"
+#include <omp.h>
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_load_parallel
+ * Purpose:   Run fn(arg, c) for every chunk, one chunk per thread of a
+ *            team of chunks threads.
+ */
+void itmv_load_parallel(int chunks, void (*fn)(void *arg, int chunk),
+                        void *arg) {
+  int c;
+
+#pragma omp parallel for num_threads(chunks) schedule(static, 1)
+  for (c = 0; c < chunks; c++) {
+    fn(arg, c);
+  }
+}
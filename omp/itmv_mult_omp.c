@@ -9,12 +9,49 @@
  *     x=y
  *          Endfor
  */
+#include "affinity.h"
+#include "itmv_band.h"
+#include "itmv_mmap.h"
 #include "itmv_mult_omp.h"
+#include "itmv_ooc.h"
+#include "itmv_op.h"
+#include "itmv_trace.h"
 #include <math.h>
 #include <omp.h>
+#include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+/* Iterations of y=d+Ax the last run performed (sweeps for ASYNC_JACOBI). */
+int iterations_done;
+
+/* Why the last run stopped without a result, or NULL if it did not. */
+char *run_error;
+
+/* Method the last KRYLOV run used, after KRYLOV_AUTO made its choice. */
+int krylov_chosen;
+
+/* The spectral interval the last Chebyshev run used. */
+double accel_bounds[2];
+
+/* Iterations each MULTI_RHS column ran before it was retired. */
+int panel_iterations[RHS_MAX];
+
+/* The schedule the last BLOCK_AUTOTUNE run settled on, and whether it came
+ * from the profile instead of trial iterations. */
+int autotune_mapping;
+int autotune_chunksize;
+int autotune_cached;
+
+/* Seconds each thread spent computing y = d + Ax and waiting in barriers
+ * in the last run, and the rows and floating point operations it computed.
+ * Counted by the static, cyclic, dynamic, guided and autotuned schedules;
+ * zero for the others. */
+double thread_compute_time[THREAD_COUNT_MAX];
+double sync_wait_time[THREAD_COUNT_MAX];
+long thread_rows[THREAD_COUNT_MAX];
+double thread_flops[THREAD_COUNT_MAX];
+
 /*---------------------------------------------------------------------
  * Function:            mv_compute
  * Purpose:             Compute  y[i]=d[i]+A[i]x;
@@ -25,6 +62,8 @@
  *        matrix_type:  matrix_type=0 means A is a regular matrix.
  *            matrix_type=1 (UPPER_TRIANGULAR) means A is an upper
  * triangular matrix
+ *            matrix_type=2 (BANDED) means matrix_A holds the
+ * band_lower+band_upper+1 diagonals of A (itmv_band.h)
  *        matrix_dim:  the global  number of columns (same as the
  * number of rows)
  *
@@ -36,6 +75,11 @@
 void mv_compute(int i) {
   int j, col_start, k;
   vector_y[i] = vector_d[i];
+  if (matrix_type == BANDED) {
+    vector_y[i] += itmv_band_row(matrix_A, matrix_dim, band_lower,
+                                 band_upper, i, vector_x);
+    return;
+  }
   if (matrix_type == UPPER_TRIANGULAR) {
     col_start = i;
   } else {
@@ -45,18 +89,150 @@ void mv_compute(int i) {
     vector_y[i] += matrix_A[i * matrix_dim + j] * vector_x[j];
   }
 }
+/*---------------------------------------------------------------------
+ * Function:            solve_globals
+ * Purpose:             Describe the solve held in the globals --
+ *                      matrix_A, the vectors and the per-thread counters
+ *                      -- for jacobi_solve, run all the way with the
+ *                      given team and schedule.
+ * In args:             threadcnt, mappingtype, chunksize: as
+ *                      parallel_itmv_mult
+ * Out arg:             s
+ */
+void solve_globals(itmv_solve *s, int threadcnt, int mappingtype,
+                   int chunksize) {
+  s->A = matrix_A;
+  s->x = vector_x;
+  s->d = vector_d;
+  s->y = vector_y;
+  s->n = matrix_dim;
+  s->matrix_type = matrix_type;
+  s->band_lower = band_lower;
+  s->band_upper = band_upper;
+  s->thread_count = threadcnt;
+  s->mapping = mappingtype;
+  s->chunksize = chunksize;
+  s->threshold = 0;
+  s->cpus = NULL;
+  s->cpu_count = 0;
+  s->thread_compute_time = thread_compute_time;
+  s->sync_wait_time = sync_wait_time;
+  s->thread_rows = thread_rows;
+  s->thread_flops = thread_flops;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            solve_row
+ * Purpose:             Return d[i]+A[i]x for the i-th row of the solve s,
+ *                      as mv_compute does for the globals.
+ */
+double solve_row(const itmv_solve *s, int i) {
+  int j, n = s->n;
+  double tmp_y = s->d[i];
+
+  if (s->matrix_type == BANDED)
+    return tmp_y +
+           itmv_band_row(s->A, n, s->band_lower, s->band_upper, i, s->x);
+  for (j = s->matrix_type == UPPER_TRIANGULAR ? i : 0; j < n; j++) {
+    tmp_y += s->A[(long)i * n + j] * s->x[j];
+  }
+  return tmp_y;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            solve_flops
+ * Purpose:             Return the floating point operations of y=d+Ax for
+ *                      rows start <= i < end of the solve s: a multiply
+ *                      and an add per stored entry of A.
+ */
+double solve_flops(const itmv_solve *s, int start, int end) {
+  double rows = end - start;
+
+  if (rows <= 0)
+    return 0;
+  if (s->matrix_type == BANDED)
+    return 2.0 * itmv_band_entries(s->n, s->band_lower, s->band_upper, start,
+                                   end);
+  if (s->matrix_type == UPPER_TRIANGULAR) {
+    /* Row i stores n - i entries. */
+    return 2 * (rows * s->n - (start + end - 1) * rows / 2);
+  }
+  return 2 * rows * s->n;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            row_span
+ * Purpose:             The columns first <= j < last that row i of A may
+ *                      have nonzero, and where they are: A[i][j] is
+ *                      matrix_A[base + j * stride], for the row-by-row
+ *                      solvers to read dense, upper triangular and banded
+ *                      A alike.
+ * Out args:            first, last, base, stride
+ */
+void row_span(int i, int *first, int *last, long *base, long *stride) {
+  if (matrix_type == BANDED) {
+    itmv_band_span(matrix_dim, band_lower, band_upper, i, first, last, base);
+    *stride = matrix_dim;
+    return;
+  }
+  *first = matrix_type == UPPER_TRIANGULAR ? i : 0;
+  *last = matrix_dim;
+  *base = (long)i * matrix_dim;
+  *stride = 1;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            thread_stats_summary
+ * Purpose:             Summarize the counters of the last run of threads
+ *                      threads.
+ * In arg:              latency: its wall time in seconds
+ * Out args:            imbalance: max over mean of the per-thread compute
+ *                      time, 1 when perfectly balanced; 0 if nothing was
+ *                      counted
+ *                      wait_fraction: mean per-thread wait time over
+ *                      latency; 0 if nothing was counted
+ */
+void thread_stats_summary(int threads, double latency, double *imbalance,
+                          double *wait_fraction) {
+  double total = 0, max = 0, wait = 0;
+  int r;
+
+  for (r = 0; r < threads; r++) {
+    total += thread_compute_time[r];
+    max = fmax(max, thread_compute_time[r]);
+    wait += sync_wait_time[r];
+  }
+  *imbalance = total > 0 ? max / (total / threads) : 0;
+  *wait_fraction = latency > 0 ? wait / threads / latency : 0;
+}
+
+/* The mappings parallel_itmv_mult hands off to, defined below. */
+void parallel_itmv_async(int);
+void parallel_itmv_gs(int, int);
+void parallel_itmv_krylov(int);
+void parallel_itmv_accel(int, int, int);
+void parallel_itmv_panel(int, int, int);
+void parallel_itmv_ooc(int, int, int);
+void jacobi_steps(int, int, int, int);
+void parallel_itmv_autotune(int);
+void parallel_itmv_tasks(int, int, int);
+void parallel_itmv_op(int, int, int);
+
 /*---------------------------------------------------------------------
  * Function:            parallel_itmv_mult
  * Purpose:             Run t iterations of parallel computation in parallel:
  * {y=d+Ax; x=y}
  *
  * In arg:              threadcnt - number of threads to run in parallel
- *                      mappingtype:  BLOCK_MAPPING, BLOCK_CYLIC, BLOCK_DYNAMIC.
+ *                      mappingtype:  BLOCK_MAPPING, BLOCK_CYLIC, BLOCK_DYNAMIC,
+ *                      BLOCK_GUIDED, BLOCK_AUTOTUNE.
  *                      These constants are defined in itmv_mult_omp.h
  *                They correspond to OpenMP's omp_sched_static with block size
  * equal to number of iterations  divided by number of threads, omp_sched_static
- * with basic chunk size equal to  chunksize, omp_sched_dynamic with basic chunk
- * size equal to chunksize. Type  omp_sched_guided is not required.
+ * with basic chunk size equal to  chunksize, omp_sched_dynamic and
+ * omp_sched_guided with basic chunk size equal to chunksize. BLOCK_AUTOTUNE
+ * picks one of those itself (parallel_itmv_autotune). BLOCK_TASKLOOP and
+ * BLOCK_TASKDEP use tasks of chunksize rows (parallel_itmv_tasks).
  *
  * Global in vars: matrix_A:  2D matrix A represented by a 1D array.
  *                 vector_d:  vector d
@@ -74,34 +250,1485 @@ void mv_compute(int i) {
  */
 void parallel_itmv_mult(int threadcnt, int mappingtype, int chunksize) {
   /*Your solutuion with OpenMP*/
-  int i, k;
+  TRACE_START(threadcnt);
+  run_error = NULL;
+  for (int r = 0; r < THREAD_COUNT_MAX; r++) {
+    thread_compute_time[r] = sync_wait_time[r] = thread_flops[r] = 0;
+    thread_rows[r] = 0;
+  }
+  if (matrix_op != NULL) {
+    parallel_itmv_op(threadcnt, mappingtype, chunksize);
+    return;
+  }
+  if (ooc_path != NULL) {
+    parallel_itmv_ooc(threadcnt, mappingtype, chunksize);
+    return;
+  }
+  if (mappingtype == ASYNC_JACOBI) {
+    parallel_itmv_async(threadcnt);
+    return;
+  }
+  if (mappingtype == GAUSS_SEIDEL) {
+    parallel_itmv_gs(threadcnt, chunksize);
+    return;
+  }
+  if (mappingtype == KRYLOV) {
+    parallel_itmv_krylov(threadcnt);
+    return;
+  }
+  if (rhs_count > 0) {
+    parallel_itmv_panel(threadcnt, mappingtype, chunksize);
+    return;
+  }
+  if (acceleration != ACCEL_NONE) {
+    parallel_itmv_accel(threadcnt, mappingtype, chunksize);
+    return;
+  }
+  if (mappingtype == BLOCK_AUTOTUNE) {
+    parallel_itmv_autotune(threadcnt);
+    return;
+  }
+  if (mappingtype == BLOCK_TASKLOOP || mappingtype == BLOCK_TASKDEP) {
+    parallel_itmv_tasks(threadcnt, mappingtype, chunksize);
+    return;
+  }
+  iterations_done = no_iterations;
+  jacobi_steps(threadcnt, mappingtype, chunksize, no_iterations);
+}
+
+/*---------------------------------------------------------------------
+ * Function:            jacobi_steps
+ * Purpose:             Run the given number of iterations {y=d+Ax; x=y}
+ *                      on the globals with one team, rows scheduled by
+ *                      mappingtype, as jacobi_solve.
+ * In arg:              threadcnt, mappingtype, chunksize: as
+ *                      parallel_itmv_mult
+ *                      steps: the number of iterations
+ */
+void jacobi_steps(int threadcnt, int mappingtype, int chunksize, int steps) {
+  itmv_solve s;
+
+  solve_globals(&s, threadcnt, mappingtype, chunksize);
+  jacobi_solve(&s, steps);
+}
+
+/*---------------------------------------------------------------------
+ * Function:            jacobi_solve
+ * Purpose:             Run up to steps iterations {y=d+Ax; x=y} of the
+ *                      solve s with one team of s->thread_count threads,
+ *                      rows scheduled by s->mapping. With a threshold,
+ *                      each thread folds the error of its rows of the x=y
+ *                      loop into error[k & 1], which every thread reads
+ *                      after that loop's barrier; thread 0 clears the
+ *                      other parity after the next y loop's barrier, so
+ *                      all threads leave at the same iteration.
+ * In/out:              s -- x and y are updated, the counters added to
+ * Return:              the number of iterations done
+ */
+int jacobi_solve(itmv_solve *s, int steps) {
+  int i, k, b, n = s->n, band_rows = 0, band_blocks = 0;
+  int mappingtype = s->mapping, chunksize = s->chunksize;
+  int done = steps;
+  double error[2] = {0, 0};
+
+  if (s->matrix_type == BANDED) {
+    /* A banded A is handed out in blocks of rows for itmv_band_rows to
+     * stream, chunksize rows at a time as the mapping would, or one block
+     * per thread for the static mapping. */
+    if (mappingtype == BLOCK_CYCLIC || mappingtype == BLOCK_DYNAMIC ||
+        mappingtype == BLOCK_GUIDED)
+      band_rows = chunksize > 0 ? chunksize : 1;
+    else
+      band_rows = (n + s->thread_count - 1) / s->thread_count;
+    band_blocks = (n + band_rows - 1) / band_rows;
+    if (mappingtype == BLOCK_DYNAMIC)
+      omp_set_schedule(omp_sched_dynamic, 1);
+    else if (mappingtype == BLOCK_GUIDED)
+      omp_set_schedule(omp_sched_guided, 1);
+    else
+      omp_set_schedule(omp_sched_static, 1);
+  }
 
-#pragma omp parallel num_threads(threadcnt) private(k)
+#pragma omp parallel num_threads(s->thread_count) private(k)
   {
-    for (k = 0; k < no_iterations; k++) {
-      if (mappingtype == BLOCK_DYNAMIC) {
-#pragma omp for schedule(dynamic, chunksize)
-        for (i = 0; i < matrix_dim; i++) {
-          mv_compute(i);
+    int r = omp_get_thread_num();
+    long rows = 0;
+    double flops = 0, compute = 0, wait = 0, start, local_error;
+    TRACE_VAR(phase_start);
+
+    if (s->cpu_count > 0)
+      affinity_bind_cpu(s->cpus[r % s->cpu_count]);
+    for (k = 0; k < steps; k++) {
+      TRACE_MARK(phase_start);
+      start = omp_get_wtime();
+      if (s->matrix_type == BANDED) {
+#pragma omp for schedule(runtime) nowait
+        for (b = 0; b < band_blocks; b++) {
+          int lo = b * band_rows;
+          int hi = lo + band_rows < n ? lo + band_rows : n;
+          itmv_band_rows(s->A, n, s->band_lower, s->band_upper, s->x, s->d,
+                         s->y, lo, hi);
+          rows += hi - lo;
+          flops += solve_flops(s, lo, hi);
+        }
+      } else if (mappingtype == BLOCK_DYNAMIC) {
+#pragma omp for schedule(dynamic, chunksize) nowait
+        for (i = 0; i < n; i++) {
+          s->y[i] = solve_row(s, i);
+          rows++;
+          flops += solve_flops(s, i, i + 1);
         }
       } else if (mappingtype == BLOCK_CYCLIC) {
-#pragma omp for schedule(static, chunksize)
-        for (i = 0; i < matrix_dim; i++) {
-          mv_compute(i);
+#pragma omp for schedule(static, chunksize) nowait
+        for (i = 0; i < n; i++) {
+          s->y[i] = solve_row(s, i);
+          rows++;
+          flops += solve_flops(s, i, i + 1);
+        }
+      } else if (mappingtype == BLOCK_GUIDED) {
+#pragma omp for schedule(guided, chunksize) nowait
+        for (i = 0; i < n; i++) {
+          s->y[i] = solve_row(s, i);
+          rows++;
+          flops += solve_flops(s, i, i + 1);
+        }
+      } else {
+#pragma omp for schedule(static) nowait
+        for (i = 0; i < n; i++) {
+          s->y[i] = solve_row(s, i);
+          rows++;
+          flops += solve_flops(s, i, i + 1);
+        }
+      }
+      compute += omp_get_wtime() - start;
+      TRACE_SPAN(r, TRACE_COMPUTE, k, phase_start);
+      /* The barriers are explicit so they can be timed. */
+      TRACE_MARK(phase_start);
+      start = omp_get_wtime();
+#pragma omp barrier
+      wait += omp_get_wtime() - start;
+      TRACE_SPAN(r, TRACE_WAIT, k, phase_start);
+      if (r == 0)
+        error[(k + 1) & 1] = 0;
+      TRACE_MARK(phase_start);
+      if (s->threshold > 0) {
+        local_error = 0;
+#pragma omp for nowait
+        for (i = 0; i < n; i++) {
+          local_error = fmax(local_error, fabs(s->y[i] - s->x[i]));
+          s->x[i] = s->y[i];
         }
-      } else if (mappingtype == BLOCK_MAPPING) {
+#pragma omp critical
+        error[k & 1] = fmax(error[k & 1], local_error);
+      } else {
+#pragma omp for nowait
+        for (i = 0; i < n; i++) {
+          s->x[i] = s->y[i];
+        }
+      }
+      TRACE_SPAN(r, TRACE_COPY, k, phase_start);
+      TRACE_MARK(phase_start);
+      start = omp_get_wtime();
+#pragma omp barrier
+      wait += omp_get_wtime() - start;
+      TRACE_SPAN(r, TRACE_WAIT, k, phase_start);
+      if (error[k & 1] < s->threshold) {
+        if (r == 0)
+          done = k + 1;
+        break;
+      }
+    }
+    if (r < THREAD_COUNT_MAX) {
+      s->thread_compute_time[r] += compute;
+      s->sync_wait_time[r] += wait;
+      s->thread_rows[r] += rows;
+      s->thread_flops[r] += flops;
+    }
+  }
+  return done;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            profile_lookup
+ * Purpose:             Find the schedule recorded for this problem in
+ *                      the autotune profile. The file holds one line per
+ *                      tuned problem:
+ *                        n matrix_type threads mapping chunksize seconds
+ *                      with seconds the time of one iteration; the last
+ *                      line for a problem wins.
+ * Out args:            mapping, chunksize
+ * Return:              1 if found, otherwise 0
+ */
+int profile_lookup(int threadcnt, int *mapping, int *chunksize) {
+  FILE *f;
+  int n, type, threads, m, c, found = 0;
+  double seconds;
+
+  if (autotune_profile == NULL || (f = fopen(autotune_profile, "r")) == NULL)
+    return 0;
+  while (fscanf(f, "%d %d %d %d %d %lf", &n, &type, &threads, &m, &c,
+                &seconds) == 6) {
+    if (n == matrix_dim && type == matrix_type && threads == threadcnt) {
+      *mapping = m;
+      *chunksize = c;
+      found = 1;
+    }
+  }
+  fclose(f);
+  return found;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            parallel_itmv_autotune
+ * Purpose:             Pick the schedule while iterating. Unless the
+ *                      autotune profile already names one for (n,
+ *                      matrix_type, threads), run AUTOTUNE_TRIALS
+ *                      iterations under each candidate below, keep the
+ *                      one with the fastest iteration for the rest of the
+ *                      no_iterations, and append it to the profile. The
+ *                      trial iterations are real ones: rows are computed
+ *                      the same way under every schedule, so y matches
+ *                      any fixed mapping exactly.
+ * In arg:              threadcnt - number of threads to run in parallel
+ * Global out vars:     autotune_mapping, autotune_chunksize: the choice
+ *                      autotune_cached: 1 if it came from the profile
+ *                      vector_x, vector_y, iterations_done
+ */
+void parallel_itmv_autotune(int threadcnt) {
+  static const int candidates[][2] = {
+      {BLOCK_MAPPING, 0},  {BLOCK_CYCLIC, 1},   {BLOCK_CYCLIC, 16},
+      {BLOCK_CYCLIC, 64},  {BLOCK_DYNAMIC, 16}, {BLOCK_DYNAMIC, 64},
+      {BLOCK_GUIDED, 16}};
+  int count = sizeof(candidates) / sizeof(candidates[0]);
+  int c, trial, done = 0;
+  double best = 1e300, start, seconds;
+  FILE *f;
+
+  autotune_mapping = BLOCK_MAPPING;
+  autotune_chunksize = 0;
+  autotune_cached = profile_lookup(threadcnt, &autotune_mapping,
+                                   &autotune_chunksize);
+  for (c = 0; c < count && !autotune_cached; c++) {
+    for (trial = 0; trial < AUTOTUNE_TRIALS && done < no_iterations;
+         trial++) {
+      start = omp_get_wtime();
+      jacobi_steps(threadcnt, candidates[c][0], candidates[c][1], 1);
+      seconds = omp_get_wtime() - start;
+      done++;
+      if (seconds < best) {
+        best = seconds;
+        autotune_mapping = candidates[c][0];
+        autotune_chunksize = candidates[c][1];
+      }
+    }
+  }
+  /* Only a complete comparison is worth remembering. */
+  if (!autotune_cached && done == count * AUTOTUNE_TRIALS &&
+      autotune_profile != NULL && (f = fopen(autotune_profile, "a")) != NULL) {
+    fprintf(f, "%d %d %d %d %d %.9f\n", matrix_dim, matrix_type, threadcnt,
+            autotune_mapping, autotune_chunksize, best);
+    fclose(f);
+  }
+  jacobi_steps(threadcnt, autotune_mapping, autotune_chunksize,
+               no_iterations - done);
+  iterations_done = no_iterations;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            task_row
+ * Purpose:             Return d[i]+A[i]x against a given x, summed in the
+ *                      same order as mv_compute.
+ */
+double task_row(int i, const double x[]) {
+  int j, first, last;
+  long base, stride;
+  double y = vector_d[i];
+
+  row_span(i, &first, &last, &base, &stride);
+  for (j = first; j < last; j++) {
+    y += matrix_A[base + j * stride] * x[j];
+  }
+  return y;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            parallel_itmv_tasks
+ * Purpose:             Run t iterations of {y=d+Ax; x=y} as tasks over
+ *                      blocks of chunksize rows (4 blocks per thread when
+ *                      chunksize is 0), x and y taking turns as the input
+ *                      of an iteration so nothing is copied between them.
+ *
+ *                      BLOCK_TASKLOOP: one taskloop per iteration. The
+ *                      taskloop's taskgroup still ends every iteration for
+ *                      all threads at once, like the worksharing loops.
+ *
+ *                      BLOCK_TASKDEP: one task per block per iteration,
+ *                      created up front and ordered only by depend clauses
+ *                      on dep[], one byte standing for each block of each
+ *                      buffer. Block b of iteration k+1 needs the blocks
+ *                      of iteration k it reads -- all of them, or only
+ *                      b and later for an upper triangular A -- and must
+ *                      not overwrite a block iteration k-1 wrote until
+ *                      every reader of it in iteration k is done. Nothing
+ *                      else waits, so a thread whose inputs are ready runs
+ *                      ahead into the next iteration instead of idling at
+ *                      a barrier; with an upper triangular A the last
+ *                      blocks can be iterations ahead of the first.
+ * In arg:              threadcnt, mappingtype, chunksize
+ * Global in/out vars:  vector_x, vector_y: both hold the last y on return
+ * Global out vars:     run_error: set if dep[] cannot be allocated; x and
+ *                        y are then unchanged
+ */
+void parallel_itmv_tasks(int threadcnt, int mappingtype, int chunksize) {
+  int n = matrix_dim, t = no_iterations;
+  int upper = matrix_type == UPPER_TRIANGULAR;
+  int size = chunksize > 0 ? chunksize
+                           : (n + 4 * threadcnt - 1) / (4 * threadcnt);
+  int blocks = size > 0 ? (n + size - 1) / size : 0;
+  double *buf[2] = {vector_x, vector_y};
+  char *dep = malloc(2 * (blocks > 0 ? blocks : 1));
+  int i;
+
+  if (dep == NULL) {
+    run_error = "Failed task dependence allocation";
+    iterations_done = 0;
+    return;
+  }
+
+#pragma omp parallel num_threads(threadcnt)
+#pragma omp single
+  {
+    int k, b;
+
+    for (k = 0; k < t; k++) {
+      const double *x = buf[k & 1];
+      double *y = buf[(k + 1) & 1];
+
+      if (mappingtype == BLOCK_TASKLOOP) {
+#pragma omp taskloop grainsize(size)
+        for (i = 0; i < n; i++) {
+          y[i] = task_row(i, x);
+        }
+        continue;
+      }
+      /* Iteration k reads the blocks of dep[(k & 1) * blocks ...] and
+       * writes those of dep[((k + 1) & 1) * blocks ...]. */
+      for (b = 0; b < blocks; b++) {
+#pragma omp task firstprivate(b) depend(iterator(j = (upper ? b : 0) : blocks), in : dep[(k & 1) * blocks + j]) depend(out : dep[((k + 1) & 1) * blocks + b])
+        {
+          int r, end = (b + 1) * size < n ? (b + 1) * size : n;
+
+          for (r = b * size; r < end; r++) {
+            y[r] = task_row(r, x);
+          }
+        }
+      }
+    }
+  }
+
+  /* The last y is in buf[t & 1]; make x and y agree as after x=y. */
+  if (t & 1) {
+    for (i = 0; i < n; i++) vector_x[i] = vector_y[i];
+  } else {
+    for (i = 0; i < n; i++) vector_y[i] = vector_x[i];
+  }
+  iterations_done = t;
+  free(dep);
+}
+
+/*---------------------------------------------------------------------
+ * Function:            parallel_itmv_async
+ * Purpose:             Asynchronous (chaotic) Jacobi: each thread sweeps its
+ * block of rows over and over, updating x in place from whatever values of
+ * x the other threads have stored, with no barrier between sweeps. x is
+ * read and written with relaxed atomics.
+ *
+ * A thread whose sweep moved none of its rows by more than ERROR_THRESHOLD
+ * counts itself converged, and uncounts itself when a later sweep does.
+ * Once all threads count as converged, one synchronous step y=d+Ax between
+ * barriers produces vector_y and confirms max|y-x| is within the threshold;
+ * if not, the sweeps resume from x=y. A thread does at most no_iterations
+ * sweeps including the synchronous steps, and the run ends once any thread
+ * has used them up.
+ *
+ * In arg:              threadcnt - number of threads to run in parallel
+ * Global in vars:      as parallel_itmv_mult
+ * Global in/out vars:  vector_x:  vector x
+ * Global out vars:     vector_y:  vector y
+ *                      iterations_done: the most sweeps any thread did
+ */
+void parallel_itmv_async(int threadcnt) {
+  int converged[THREAD_COUNT_MAX];
+  int sweeps[2][THREAD_COUNT_MAX];
+  double errors[2][THREAD_COUNT_MAX];
+  int converged_threads = 0, done = 0;
+
+  iterations_done = 0;
+#pragma omp parallel num_threads(threadcnt)
+  {
+    int me = omp_get_thread_num(), nth = omp_get_num_threads();
+    int block_size = (matrix_dim + nth - 1) / nth;
+    int start = me * block_size < matrix_dim ? me * block_size : matrix_dim;
+    int end = start + block_size < matrix_dim ? start + block_size : matrix_dim;
+    int i, j, r, k = 0, round = 0, stop, count, now_done;
+    double change, value, xj, error;
+    int first, last;
+    long base, stride;
+
+    converged[me] = 0;
+    while (1) {
+      while (k < no_iterations - 1) {
+#pragma omp atomic read relaxed
+        now_done = done;
+        if (now_done) break;
+
+        change = 0;
+        for (i = start; i < end; i++) {
+          value = vector_d[i];
+          row_span(i, &first, &last, &base, &stride);
+          for (j = first; j < last; j++) {
+#pragma omp atomic read relaxed
+            xj = vector_x[j];
+            value += matrix_A[base + j * stride] * xj;
+          }
+          change = fmax(change, fabs(value - vector_x[i]));
+#pragma omp atomic write relaxed
+          vector_x[i] = value;
+        }
+        k++;
+        if ((change < ERROR_THRESHOLD || k >= no_iterations - 1) !=
+            converged[me]) {
+          converged[me] = !converged[me];
+#pragma omp atomic capture
+          count = converged_threads += converged[me] ? 1 : -1;
+          if (count == nth) {
+#pragma omp atomic write
+            done = 1;
+          }
+        }
+        if (converged[me]) {
+          /* Nothing new to read yet; let a descheduled thread run on an
+           * oversubscribed core. */
+          sched_yield();
+        }
+      }
+      sweeps[round & 1][me] = k;
+#pragma omp barrier
+
+      error = 0;
+      for (i = start; i < end; i++) {
+        mv_compute(i);
+        error = fmax(error, fabs(vector_y[i] - vector_x[i]));
+      }
+      k++;
+      errors[round & 1][me] = error;
+      converged[me] = 0;
+#pragma omp single
+      {
+        converged_threads = 0;
+        done = 0;
+      }
+      /* implicit barrier after single */
+
+      error = 0;
+      stop = 0;
+      for (r = 0; r < nth; r++) {
+        error = fmax(error, errors[round & 1][r]);
+        if (sweeps[round & 1][r] >= no_iterations - 1) stop = 1;
+      }
+      if (error < ERROR_THRESHOLD || stop) break;
+      for (i = start; i < end; i++) {
+#pragma omp atomic write relaxed
+        vector_x[i] = vector_y[i];
+      }
+      round++;
+    }
+#pragma omp critical
+    if (k > iterations_done) iterations_done = k;
+  }
+}
+
+/*---------------------------------------------------------------------
+ * Function:            gs_colored
+ * Purpose:             Gauss-Seidel/SOR sweeps for a general A with
+ * multi-color ordering (red-black for 2 colors), called by every thread of
+ * a parallel region. Row i has color i % colors; the colors are updated one
+ * after the other, each from the newest values of the others, with the
+ * implicit barrier of an omp for between colors.
+ *
+ * vector_y always holds the newest value of every row; new values of color
+ * c go to vector_y only, while rows of color c read their own color from
+ * vector_x, the previous sweep. Nobody reads vector_x for color c again
+ * until the next sweep, so it is brought up to date with a nowait loop
+ * while color c+1 is computed.
+ *
+ * In args:             colors -- number of colors, at least 2
+ *                      errors -- shared [2][THREAD_COUNT_MAX] scratch for
+ *                                the per-thread convergence error
+ * Global out vars:     iterations_done (set by thread 0)
+ */
+void gs_colored(int colors, double errors[][THREAD_COUNT_MAX]) {
+  int me = omp_get_thread_num(), nth = omp_get_num_threads();
+  int i, j, c, cj, k, r, first, last;
+  long base, stride;
+  double local, value, error, *z;
+
 #pragma omp for schedule(static)
-        for (i = 0; i < matrix_dim; i++) {
-          mv_compute(i);
+  for (i = 0; i < matrix_dim; i++) {
+    vector_y[i] = vector_x[i];
+  }
+  for (k = 0; k < no_iterations; k++) {
+    local = 0;
+    for (c = 0; c < colors; c++) {
+#pragma omp for schedule(static) nowait
+      for (i = (c + colors - 1) % colors; i < matrix_dim; i += colors) {
+        vector_x[i] = vector_y[i];
+      }
+#pragma omp for schedule(static) nowait
+      for (i = c; i < matrix_dim; i += colors) {
+        value = vector_d[i];
+        row_span(i, &first, &last, &base, &stride);
+        for (j = first, cj = first % colors; j < last; j++) {
+          z = (cj == c) ? vector_x : vector_y;
+          value += matrix_A[base + j * stride] * z[j];
+          if (++cj == colors)
+            cj = 0;
         }
+        value = (1 - relax_omega) * vector_x[i] + relax_omega * value;
+        local = fmax(local, fabs(value - vector_x[i]));
+        vector_y[i] = value;
       }
-#pragma omp for
+      if (c == colors - 1)
+        errors[k & 1][me] = local;
+#pragma omp barrier
+    }
+    error = 0;
+    for (r = 0; r < nth; r++)
+      error = fmax(error, errors[k & 1][r]);
+    if (error < ERROR_THRESHOLD)
+      break;
+  }
+#pragma omp for schedule(static)
+  for (i = colors - 1; i < matrix_dim; i += colors) {
+    vector_x[i] = vector_y[i];
+  }
+  if (me == 0)
+    iterations_done = (k < no_iterations) ? k + 1 : k;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            gs_wavefront
+ * Purpose:             Gauss-Seidel/SOR sweeps for an UPPER_TRIANGULAR A,
+ * called by every thread of a parallel region. A sweep runs rows n-1 down
+ * to 0, i.e. a back substitution. Rows are split into blocks of block_size
+ * owned cyclically; a thread visits its blocks from high to low, adds in
+ * each higher block as soon as its owner has published it in version[],
+ * then solves its own block and publishes it. Lower blocks accumulate the
+ * higher ones while a block is being solved, so the sweep moves down the
+ * matrix as a wavefront. Sweeps are separated by a barrier.
+ *
+ * In args:             block_size -- rows per block
+ *                      version -- shared, one entry per block, all 0
+ *                      errors -- as gs_colored
+ * Global out vars:     iterations_done (set by thread 0)
+ */
+void gs_wavefront(int block_size, int version[],
+                  double errors[][THREAD_COUNT_MAX]) {
+  int me = omp_get_thread_num(), nth = omp_get_num_threads();
+  int no_blocks = (matrix_dim + block_size - 1) / block_size;
+  int b, jb, i, j, k, r, start, end, jend, ready;
+  double local, value, error;
+
+  for (k = 0; k < no_iterations; k++) {
+    local = 0;
+    for (b = no_blocks - 1; b >= 0; b--) {
+      if (b % nth != me)
+        continue;
+      start = b * block_size;
+      end = start + block_size < matrix_dim ? start + block_size : matrix_dim;
+      for (i = start; i < end; i++)
+        vector_y[i] = vector_d[i];
+      for (jb = no_blocks - 1; jb > b; jb--) {
+        while (1) {
+#pragma omp atomic read seq_cst
+          ready = version[jb];
+          if (ready > k)
+            break;
+          sched_yield();
+        }
+        jend = (jb + 1) * block_size < matrix_dim ? (jb + 1) * block_size
+                                                  : matrix_dim;
+        for (i = start; i < end; i++) {
+          value = 0;
+          for (j = jb * block_size; j < jend; j++)
+            value += matrix_A[i * matrix_dim + j] * vector_x[j];
+          vector_y[i] += value;
+        }
+      }
+      for (i = end - 1; i >= start; i--) {
+        value = vector_y[i];
+        for (j = i; j < end; j++)
+          value += matrix_A[i * matrix_dim + j] * vector_x[j];
+        value = (1 - relax_omega) * vector_x[i] + relax_omega * value;
+        local = fmax(local, fabs(value - vector_x[i]));
+        vector_x[i] = value;
+        vector_y[i] = value;
+      }
+#pragma omp atomic write seq_cst
+      version[b] = k + 1;
+    }
+    errors[k & 1][me] = local;
+#pragma omp barrier
+    error = 0;
+    for (r = 0; r < nth; r++)
+      error = fmax(error, errors[k & 1][r]);
+    if (error < ERROR_THRESHOLD)
+      break;
+  }
+  if (me == 0)
+    iterations_done = (k < no_iterations) ? k + 1 : k;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            parallel_itmv_gs
+ * Purpose:             Run up to t Gauss-Seidel (relax_omega = 1) or SOR
+ * sweeps x_i = (1-w)x_i + w(d_i + A_i x) in place, stopping at the same
+ * threshold as itmv_mult_seq would. vector_y holds the final x. Uses the
+ * wavefront schedule for an upper triangular A and multi-color ordering
+ * with color_count colors otherwise.
+ *
+ * In arg:              threadcnt - number of threads to run in parallel
+ *                      chunksize - rows per wavefront block, 0 for
+ *                                  ceil(n/threadcnt)
+ * Global in vars:      as parallel_itmv_mult, and relax_omega, color_count
+ * Global in/out vars:  vector_x:  vector x
+ * Global out vars:     vector_y:  vector y
+ *                      iterations_done: the number of sweeps
+ */
+void parallel_itmv_gs(int threadcnt, int chunksize) {
+  double errors[2][THREAD_COUNT_MAX];
+  int block_size = chunksize > 0 ? chunksize
+                                 : (matrix_dim + threadcnt - 1) / threadcnt;
+  int *version = NULL;
+
+  if (matrix_type == UPPER_TRIANGULAR)
+    version = calloc((matrix_dim + block_size - 1) / block_size, sizeof(int));
+#pragma omp parallel num_threads(threadcnt)
+  {
+    if (matrix_type == UPPER_TRIANGULAR)
+      gs_wavefront(block_size, version, errors);
+    else
+      gs_colored(color_count > 2 ? color_count : 2, errors);
+  }
+  free(version);
+}
+
+/*---------------------------------------------------------------------
+ * Function:            krylov_apply
+ * Purpose:             out = (I-A)in, rows in parallel.
+ * In args:             in -- the vector to multiply
+ *                      threadcnt -- number of threads
+ * Out arg:             out
+ */
+void krylov_apply(double out[], double in[], int threadcnt) {
+  int i, j, first, last;
+  long base, stride;
+  double tmp;
+#pragma omp parallel for num_threads(threadcnt) schedule(static) private(j, tmp, first, last, base, stride)
+  for (i = 0; i < matrix_dim; i++) {
+    tmp = in[i];
+    row_span(i, &first, &last, &base, &stride);
+    for (j = first; j < last; j++)
+      tmp -= matrix_A[base + j * stride] * in[j];
+    out[i] = tmp;
+  }
+}
+
+/*---------------------------------------------------------------------
+ * Function:            krylov_dot
+ * Purpose:             Return a.b computed in parallel.
+ */
+double krylov_dot(double a[], double b[], int threadcnt) {
+  int i;
+  double sum = 0;
+#pragma omp parallel for num_threads(threadcnt) schedule(static) reduction(+ : sum)
+  for (i = 0; i < matrix_dim; i++)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            krylov_max
+ * Purpose:             Return max |a[i]| computed in parallel.
+ */
+double krylov_max(double a[], int threadcnt) {
+  int i;
+  double m = 0;
+#pragma omp parallel for num_threads(threadcnt) schedule(static) reduction(max : m)
+  for (i = 0; i < matrix_dim; i++)
+    m = fmax(m, fabs(a[i]));
+  return m;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            krylov_choose
+ * Purpose:             Pick a method for KRYLOV_AUTO: CG if A is
+ * symmetric and a few power iterations put its spectral radius below 1, so
+ * I-A is positive definite; otherwise BiCGStab if that estimate is below
+ * KRYLOV_BICGSTAB_RHO; otherwise restarted GMRES.
+ * In args:             work -- two scratch vectors of matrix_dim
+ *                      threadcnt -- number of threads
+ */
+int krylov_choose(double work[], int threadcnt) {
+  double *u = work, *w = work + matrix_dim, *tmp, asym = 0, rho = 0, ww, uu;
+  int i, j, step;
+
+  if (matrix_type == UPPER_TRIANGULAR) {
+    asym = 1;
+  } else if (matrix_type == BANDED) {
+#pragma omp parallel for num_threads(threadcnt) schedule(static) private(j) reduction(max : asym)
+    for (i = 0; i < matrix_dim; i++)
+      for (j = i + 1; j < matrix_dim && j <= i + band_lower + band_upper; j++)
+        asym = fmax(asym, fabs(itmv_band_entry(matrix_A, matrix_dim,
+                                               band_lower, band_upper, i, j) -
+                               itmv_band_entry(matrix_A, matrix_dim,
+                                               band_lower, band_upper, j, i)));
+  } else {
+#pragma omp parallel for num_threads(threadcnt) schedule(static) private(j) reduction(max : asym)
+    for (i = 0; i < matrix_dim; i++)
+      for (j = i + 1; j < matrix_dim; j++)
+        asym = fmax(asym, fabs(matrix_A[i * matrix_dim + j] -
+                               matrix_A[j * matrix_dim + i]));
+  }
+  for (i = 0; i < matrix_dim; i++)
+    u[i] = 1 + i % 7;
+  for (step = 0; step < KRYLOV_POWER_STEPS; step++) {
+    krylov_apply(w, u, threadcnt);
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+    for (i = 0; i < matrix_dim; i++)
+      w[i] = u[i] - w[i];
+    ww = krylov_dot(w, w, threadcnt);
+    uu = krylov_dot(u, u, threadcnt);
+    rho = uu > 0 ? sqrt(ww / uu) : 0;
+    for (i = 0; i < matrix_dim; i++)
+      w[i] = ww > 0 ? w[i] / sqrt(ww) : 0;
+    tmp = u;
+    u = w;
+    w = tmp;
+  }
+  if (asym == 0 && rho < 1)
+    return KRYLOV_CG;
+  return rho < KRYLOV_BICGSTAB_RHO ? KRYLOV_BICGSTAB : KRYLOV_GMRES;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            krylov_cg
+ * Purpose:             Conjugate gradients on (I-A)x = d, x = vector_x.
+ * In args:             work -- three scratch vectors of matrix_dim
+ *                      threadcnt -- number of threads
+ * Return:              the number of products with I-A done
+ */
+int krylov_cg(double work[], int threadcnt) {
+  double *x = vector_x, *r = work, *p = r + matrix_dim, *q = p + matrix_dim;
+  double rr, rr_new, alpha, beta;
+  int i, k = 1;
+
+  krylov_apply(q, x, threadcnt);
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+  for (i = 0; i < matrix_dim; i++) {
+    r[i] = vector_d[i] - q[i];
+    p[i] = r[i];
+  }
+  rr = krylov_dot(r, r, threadcnt);
+  while (krylov_max(r, threadcnt) >= ERROR_THRESHOLD && k < no_iterations) {
+    krylov_apply(q, p, threadcnt);
+    k++;
+    alpha = rr / krylov_dot(p, q, threadcnt);
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+    for (i = 0; i < matrix_dim; i++) {
+      x[i] += alpha * p[i];
+      r[i] -= alpha * q[i];
+    }
+    rr_new = krylov_dot(r, r, threadcnt);
+    beta = rr_new / rr;
+    rr = rr_new;
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+    for (i = 0; i < matrix_dim; i++)
+      p[i] = r[i] + beta * p[i];
+  }
+  return k;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            krylov_bicgstab
+ * Purpose:             BiCGStab on (I-A)x = d, x = vector_x, for a general
+ * A. Two products with I-A per iteration.
+ * In args:             work -- six scratch vectors of matrix_dim
+ *                      threadcnt -- number of threads
+ * Return:              the number of products with I-A done
+ */
+int krylov_bicgstab(double work[], int threadcnt) {
+  double *x = vector_x, *r = work, *rhat = r + matrix_dim, *p = rhat + matrix_dim,
+         *v = p + matrix_dim, *s = v + matrix_dim, *t = s + matrix_dim;
+  double rho = 1, rho_new, alpha = 1, omega = 1, beta;
+  int i, k = 1;
+
+  krylov_apply(v, x, threadcnt);
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+  for (i = 0; i < matrix_dim; i++) {
+    r[i] = vector_d[i] - v[i];
+    rhat[i] = r[i];
+    p[i] = 0;
+    v[i] = 0;
+  }
+  while (krylov_max(r, threadcnt) >= ERROR_THRESHOLD && k < no_iterations) {
+    rho_new = krylov_dot(rhat, r, threadcnt);
+    beta = (rho_new / rho) * (alpha / omega);
+    rho = rho_new;
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+    for (i = 0; i < matrix_dim; i++)
+      p[i] = r[i] + beta * (p[i] - omega * v[i]);
+    krylov_apply(v, p, threadcnt);
+    k++;
+    alpha = rho / krylov_dot(rhat, v, threadcnt);
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+    for (i = 0; i < matrix_dim; i++)
+      s[i] = r[i] - alpha * v[i];
+    if (krylov_max(s, threadcnt) < ERROR_THRESHOLD || k >= no_iterations) {
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+      for (i = 0; i < matrix_dim; i++)
+        x[i] += alpha * p[i];
+      break;
+    }
+    krylov_apply(t, s, threadcnt);
+    k++;
+    omega = krylov_dot(t, s, threadcnt) / krylov_dot(t, t, threadcnt);
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+    for (i = 0; i < matrix_dim; i++) {
+      x[i] += alpha * p[i] + omega * s[i];
+      r[i] = s[i] - omega * t[i];
+    }
+  }
+  return k;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            krylov_gmres
+ * Purpose:             GMRES(KRYLOV_RESTART) on (I-A)x = d, x = vector_x,
+ * for a general A, with classical Gram-Schmidt and Givens rotations. Stops
+ * once the 2-norm of the residual, which bounds its max norm, is below the
+ * threshold.
+ * In args:             work -- KRYLOV_RESTART+1 scratch vectors
+ *                      threadcnt -- number of threads
+ * Return:              the number of products with I-A done
+ */
+int krylov_gmres(double work[], int threadcnt) {
+  int m = KRYLOV_RESTART, n = matrix_dim;
+  double *x = vector_x, *w;
+  double h[KRYLOV_RESTART + 1][KRYLOV_RESTART], g[KRYLOV_RESTART + 1];
+  double cs[KRYLOV_RESTART], sn[KRYLOV_RESTART], yk[KRYLOV_RESTART];
+  double beta, tmp, hl;
+  int i, j, l, k = 0, steps;
+
+  while (k < no_iterations) {
+    krylov_apply(work, x, threadcnt);
+    k++;
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+    for (i = 0; i < n; i++)
+      work[i] = vector_d[i] - work[i];
+    if (krylov_max(work, threadcnt) < ERROR_THRESHOLD)
+      break;
+    beta = sqrt(krylov_dot(work, work, threadcnt));
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+    for (i = 0; i < n; i++)
+      work[i] /= beta;
+    g[0] = beta;
+    steps = 0;
+    for (j = 0; j < m && k < no_iterations; j++) {
+      w = work + (long)(j + 1) * n;
+      krylov_apply(w, work + (long)j * n, threadcnt);
+      k++;
+      for (l = 0; l <= j; l++)
+        h[l][j] = krylov_dot(work + (long)l * n, w, threadcnt);
+#pragma omp parallel for num_threads(threadcnt) schedule(static) private(l)
+      for (i = 0; i < n; i++)
+        for (l = 0; l <= j; l++)
+          w[i] -= h[l][j] * work[(long)l * n + i];
+      hl = sqrt(krylov_dot(w, w, threadcnt));
+      h[j + 1][j] = hl;
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+      for (i = 0; i < n; i++)
+        w[i] = hl > 0 ? w[i] / hl : 0;
+      for (l = 0; l < j; l++) {
+        tmp = cs[l] * h[l][j] + sn[l] * h[l + 1][j];
+        h[l + 1][j] = -sn[l] * h[l][j] + cs[l] * h[l + 1][j];
+        h[l][j] = tmp;
+      }
+      tmp = sqrt(h[j][j] * h[j][j] + hl * hl);
+      cs[j] = h[j][j] / tmp;
+      sn[j] = hl / tmp;
+      h[j][j] = tmp;
+      g[j + 1] = -sn[j] * g[j];
+      g[j] = cs[j] * g[j];
+      steps = j + 1;
+      if (fabs(g[j + 1]) < ERROR_THRESHOLD || hl == 0)
+        break;
+    }
+    for (l = steps - 1; l >= 0; l--) {
+      yk[l] = g[l];
+      for (j = l + 1; j < steps; j++)
+        yk[l] -= h[l][j] * yk[j];
+      yk[l] /= h[l][l];
+    }
+#pragma omp parallel for num_threads(threadcnt) schedule(static) private(l)
+    for (i = 0; i < n; i++)
+      for (l = 0; l < steps; l++)
+        x[i] += yk[l] * work[(long)l * n + i];
+    if (fabs(g[steps]) < ERROR_THRESHOLD)
+      break;
+  }
+  return k;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            krylov_alloc
+ * Purpose:             Replace work with the scratch vectors method needs:
+ * KRYLOV_RESTART+1 for GMRES, six for BiCGStab, three for CG and two for
+ * krylov_choose (KRYLOV_AUTO).
+ * In args:             work -- the old vectors, or NULL
+ *                      method
+ * Return:              the new vectors, or NULL with run_error set
+ */
+double *krylov_alloc(double work[], int method) {
+  int count = method == KRYLOV_GMRES      ? KRYLOV_RESTART + 1
+              : method == KRYLOV_BICGSTAB ? 6
+              : method == KRYLOV_CG       ? 3
+                                          : 2;
+
+  free(work);
+  work = malloc(count * (long)matrix_dim * sizeof(double));
+  if (work == NULL) run_error = "Failed Krylov work space allocation";
+  return work;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            parallel_itmv_krylov
+ * Purpose:             Solve (I-A)x = d, the fixed point of y=d+Ax, with
+ * CG, BiCGStab or GMRES(KRYLOV_RESTART) as set by krylov_method, or chosen
+ * by krylov_choose for KRYLOV_AUTO. Products with I-A, dot products and
+ * vector updates are parallel loops over the rows.
+ *
+ * Stops once max |d + Ax - x| is below the threshold, the quantity the
+ * Jacobi iteration tests, or after no_iterations products with I-A.
+ *
+ * In arg:              threadcnt - number of threads to run in parallel
+ * Global in vars:      as parallel_itmv_mult, and krylov_method
+ * Global in/out vars:  vector_x:  vector x, the initial guess on entry
+ * Global out vars:     vector_y:  vector y, the solution
+ *                      iterations_done: products with I-A done
+ *                      krylov_chosen: the method used
+ *                      run_error: set if the scratch vectors cannot be
+ *                        allocated; x and y are then unchanged
+ */
+void parallel_itmv_krylov(int threadcnt) {
+  double *work = NULL;
+  int i, method = krylov_method;
+
+  iterations_done = 0;
+  if (method == KRYLOV_AUTO) {
+    work = krylov_alloc(work, KRYLOV_AUTO);
+    if (work == NULL) return;
+    method = krylov_choose(work, threadcnt);
+  }
+  work = krylov_alloc(work, method);
+  if (work == NULL) return;
+  if (method == KRYLOV_CG)
+    iterations_done = krylov_cg(work, threadcnt);
+  else if (method == KRYLOV_BICGSTAB)
+    iterations_done = krylov_bicgstab(work, threadcnt);
+  else
+    iterations_done = krylov_gmres(work, threadcnt);
+  krylov_chosen = method;
+  for (i = 0; i < matrix_dim; i++)
+    vector_y[i] = vector_x[i];
+  free(work);
+}
+
+/*---------------------------------------------------------------------
+ * Function:            spectral_bounds
+ * Purpose:             Estimate the interval [lo, hi] holding the
+ * eigenvalues of A, assumed real: KRYLOV_POWER_STEPS power iterations give
+ * the eigenvalue of largest magnitude through its Rayleigh quotient, and as
+ * many on A - lo*I give the one at the other end. The interval is widened
+ * by ACCEL_BOUNDS_MARGIN of its width on each side.
+ * In args:             u, w -- two scratch vectors of matrix_dim
+ *                      threadcnt -- number of threads
+ * Out args:            lo, hi
+ */
+void spectral_bounds(double u[], double w[], int threadcnt, double *lo,
+                     double *hi) {
+  double lambda[2] = {0, 0}, shift = 0, ww, uu, uw, *tmp, width;
+  int i, pass, step;
+
+  for (pass = 0; pass < 2; pass++) {
+    for (i = 0; i < matrix_dim; i++)
+      u[i] = 1 + i % 7;
+    for (step = 0; step < KRYLOV_POWER_STEPS; step++) {
+      krylov_apply(w, u, threadcnt);
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+      for (i = 0; i < matrix_dim; i++)
+        w[i] = u[i] - w[i] - shift * u[i];
+      ww = krylov_dot(w, w, threadcnt);
+      uu = krylov_dot(u, u, threadcnt);
+      uw = krylov_dot(u, w, threadcnt);
+      lambda[pass] = uu > 0 ? uw / uu + shift : shift;
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+      for (i = 0; i < matrix_dim; i++)
+        w[i] = ww > 0 ? w[i] / sqrt(ww) : 0;
+      tmp = u;
+      u = w;
+      w = tmp;
+    }
+    shift = lambda[0];
+  }
+  *lo = fmin(lambda[0], lambda[1]);
+  *hi = fmax(lambda[0], lambda[1]);
+  width = *hi - *lo;
+  *lo -= ACCEL_BOUNDS_MARGIN * width;
+  *hi += ACCEL_BOUNDS_MARGIN * width;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            solve_small
+ * Purpose:             Solve the m x m system M theta = b in place by
+ * Gaussian elimination with partial pivoting.
+ * In/out:              M -- destroyed
+ *                      b -- the right-hand side in, theta out
+ */
+void solve_small(double M[][ANDERSON_DEPTH_MAX], double b[], int m) {
+  int i, j, l, piv;
+  double f, tmp;
+
+  for (i = 0; i < m; i++) {
+    piv = i;
+    for (l = i + 1; l < m; l++)
+      if (fabs(M[l][i]) > fabs(M[piv][i]))
+        piv = l;
+    for (j = 0; j < m; j++) {
+      tmp = M[i][j];
+      M[i][j] = M[piv][j];
+      M[piv][j] = tmp;
+    }
+    tmp = b[i];
+    b[i] = b[piv];
+    b[piv] = tmp;
+    for (l = i + 1; l < m; l++) {
+      f = M[i][i] != 0 ? M[l][i] / M[i][i] : 0;
+      for (j = i; j < m; j++)
+        M[l][j] -= f * M[i][j];
+      b[l] -= f * b[i];
+    }
+  }
+  for (i = m - 1; i >= 0; i--) {
+    for (j = i + 1; j < m; j++)
+      b[i] -= M[i][j] * b[j];
+    b[i] = M[i][i] != 0 ? b[i] / M[i][i] : 0;
+  }
+}
+
+/*---------------------------------------------------------------------
+ * Function:            parallel_itmv_accel
+ * Purpose:             The loop of parallel_itmv_mult with the x=y step
+ * replaced by an accelerated update, stopping once max|y-x| is below the
+ * threshold. y=d+Ax keeps the schedule of mappingtype.
+ *
+ * ACCEL_CHEBYSHEV: with the eigenvalues of A in [lo, hi] (spectral_bounds),
+ * hi < 1, g = 2/(2-lo-hi), r = (hi-lo)/(2-lo-hi) and
+ * z = g*y + (1-g)*x:  x_k+1 = w_k+1 * (z_k - x_k-1) + x_k-1 with w_1 = 1,
+ * w_2 = 2/(2-r^2), w_k+1 = 1/(1 - r^2 w_k/4). Falls back to x=y if hi >= 1.
+ *
+ * ACCEL_ANDERSON: keeps the last m = anderson_depth differences dF of
+ * f = y-x and dG of y, takes theta minimizing |f - dF theta| from the
+ * normal equations, and sets x = y - dG theta. Only the newest column of
+ * dF^T dF is recomputed, so an iteration adds 2m dot products and O(mn)
+ * vector work.
+ *
+ * In args:             threadcnt, mappingtype, chunksize: as
+ *                      parallel_itmv_mult
+ * Global in vars:      as parallel_itmv_mult, and acceleration,
+ *                      anderson_depth
+ * Global in/out vars:  vector_x:  vector x
+ * Global out vars:     vector_y:  vector y
+ *                      iterations_done, accel_bounds
+ */
+void parallel_itmv_accel(int threadcnt, int mappingtype, int chunksize) {
+  int n = matrix_dim;
+  int m = anderson_depth < 1                    ? 1
+          : anderson_depth > ANDERSON_DEPTH_MAX ? ANDERSON_DEPTH_MAX
+                                                : anderson_depth;
+  double *work = malloc((2 * m + 2) * (long)n * sizeof(double));
+  double *x_prev = work, *f_prev = work, *g_prev = work + n, *dF = g_prev + n,
+         *dG = dF + (long)m * n;
+  double gram[ANDERSON_DEPTH_MAX][ANDERSON_DEPTH_MAX];
+  double M[ANDERSON_DEPTH_MAX][ANDERSON_DEPTH_MAX], theta[ANDERSON_DEPTH_MAX];
+  double lo = 0, hi = 0, gamma = 1, rho2 = 0, omega = 1, error, z, dot, reg;
+  int i, j, l, k, cols = 0, slot = 0, usable = 0;
+
+  if (mappingtype == BLOCK_CYCLIC)
+    omp_set_schedule(omp_sched_static, chunksize);
+  else if (mappingtype == BLOCK_DYNAMIC)
+    omp_set_schedule(omp_sched_dynamic, chunksize);
+  else if (mappingtype == BLOCK_GUIDED)
+    omp_set_schedule(omp_sched_guided, chunksize);
+  else
+    omp_set_schedule(omp_sched_static, 0);
+
+  if (acceleration == ACCEL_CHEBYSHEV) {
+    spectral_bounds(work + n, work + 2 * (long)n, threadcnt, &lo, &hi);
+    usable = hi < 1;
+    if (usable) {
+      gamma = 2 / (2 - lo - hi);
+      rho2 = (hi - lo) / (2 - lo - hi);
+      rho2 *= rho2;
+    }
+    accel_bounds[0] = lo;
+    accel_bounds[1] = hi;
+  }
+
+  for (k = 0; k < no_iterations; k++) {
+#pragma omp parallel for num_threads(threadcnt) schedule(runtime)
+    for (i = 0; i < n; i++)
+      mv_compute(i);
+    error = 0;
+#pragma omp parallel for num_threads(threadcnt) schedule(static) reduction(max : error)
+    for (i = 0; i < n; i++)
+      error = fmax(error, fabs(vector_y[i] - vector_x[i]));
+    if (error < ERROR_THRESHOLD)
+      break;
+
+    if (acceleration == ACCEL_CHEBYSHEV) {
+      if (usable)
+        omega = k == 0 ? 1 : k == 1 ? 2 / (2 - rho2) : 1 / (1 - rho2 * omega / 4);
+#pragma omp parallel for num_threads(threadcnt) schedule(static) private(z)
+      for (i = 0; i < n; i++) {
+        z = gamma * vector_y[i] + (1 - gamma) * vector_x[i];
+        z = k == 0 ? z : omega * (z - x_prev[i]) + x_prev[i];
+        x_prev[i] = vector_x[i];
+        vector_x[i] = z;
+      }
+      continue;
+    }
+
+    if (k > 0) {
+#pragma omp parallel for num_threads(threadcnt) schedule(static)
+      for (i = 0; i < n; i++) {
+        dF[(long)slot * n + i] = vector_y[i] - vector_x[i] - f_prev[i];
+        dG[(long)slot * n + i] = vector_y[i] - g_prev[i];
+      }
+      cols = cols < m ? cols + 1 : m;
+    }
+    reg = 0;
+    for (j = 0; j < cols; j++) {
+      gram[slot][j] = gram[j][slot] =
+          krylov_dot(dF + (long)j * n, dF + (long)slot * n, threadcnt);
+      dot = 0;
+#pragma omp parallel for num_threads(threadcnt) schedule(static) reduction(+ : dot)
+      for (i = 0; i < n; i++)
+        dot += dF[(long)j * n + i] * (vector_y[i] - vector_x[i]);
+      theta[j] = dot;
+    }
+    for (j = 0; j < cols; j++)
+      reg += gram[j][j];
+    reg = ANDERSON_REGULARIZATION * reg / (cols > 0 ? cols : 1);
+    for (j = 0; j < cols; j++)
+      for (l = 0; l < cols; l++)
+        M[j][l] = gram[j][l] + (j == l ? reg : 0);
+    solve_small(M, theta, cols);
+#pragma omp parallel for num_threads(threadcnt) schedule(static) private(j)
+    for (i = 0; i < n; i++) {
+      f_prev[i] = vector_y[i] - vector_x[i];
+      g_prev[i] = vector_y[i];
+      vector_x[i] = vector_y[i];
+      for (j = 0; j < cols; j++)
+        vector_x[i] -= theta[j] * dG[(long)j * n + i];
+    }
+    if (k > 0)
+      slot = (slot + 1) % m;
+  }
+  iterations_done = k < no_iterations ? k + 1 : k;
+  free(work);
+}
+
+/*---------------------------------------------------------------------
+ * Function:            panel_row
+ * Purpose:             Y[i][c] = D[i][c] + A[i]X[][c] for the active
+ * columns c of the n x rhs_count panels (row-major). Columns are taken
+ * RHS_TILE at a time with one accumulator each, so every A[i][j] loaded is
+ * used RHS_TILE times from a register and row i of A is streamed from
+ * memory once for all the columns.
+ * In args:             i -- row index
+ *                      active, nactive -- the columns still iterating
+ */
+void panel_row(int i, int active[], int nactive) {
+  int j, t, c, m = rhs_count, first, last;
+  long base, stride;
+  double *xj, aij;
+  double y0, y1, y2, y3;
+
+  row_span(i, &first, &last, &base, &stride);
+
+  for (t = 0; t + RHS_TILE <= nactive; t += RHS_TILE) {
+    int c0 = active[t], c1 = active[t + 1], c2 = active[t + 2],
+        c3 = active[t + 3];
+    y0 = panel_d[(long)i * m + c0];
+    y1 = panel_d[(long)i * m + c1];
+    y2 = panel_d[(long)i * m + c2];
+    y3 = panel_d[(long)i * m + c3];
+    for (j = first; j < last; j++) {
+      aij = matrix_A[base + j * stride];
+      xj = panel_x + (long)j * m;
+      y0 += aij * xj[c0];
+      y1 += aij * xj[c1];
+      y2 += aij * xj[c2];
+      y3 += aij * xj[c3];
+    }
+    panel_y[(long)i * m + c0] = y0;
+    panel_y[(long)i * m + c1] = y1;
+    panel_y[(long)i * m + c2] = y2;
+    panel_y[(long)i * m + c3] = y3;
+  }
+  for (; t < nactive; t++) {
+    c = active[t];
+    y0 = panel_d[(long)i * m + c];
+    for (j = first; j < last; j++)
+      y0 += matrix_A[base + j * stride] * panel_x[(long)j * m + c];
+    panel_y[(long)i * m + c] = y0;
+  }
+}
+
+/*---------------------------------------------------------------------
+ * Function:            parallel_itmv_panel
+ * Purpose:             Jacobi iteration Y = D + AX on rhs_count
+ * right-hand sides at once, rows scheduled as mappingtype. A column whose
+ * max |Y-X| falls below the threshold is retired with that Y as its result,
+ * and later iterations only compute the columns still active.
+ *
+ * In args:             threadcnt, mappingtype, chunksize: as
+ *                      parallel_itmv_mult
+ * Global in vars:      rhs_count (at most RHS_MAX), panel_d, and as
+ *                      parallel_itmv_mult
+ * Global in/out vars:  panel_x
+ * Global out vars:     panel_y, panel_iterations, iterations_done
+ */
+void parallel_itmv_panel(int threadcnt, int mappingtype, int chunksize) {
+  int active[RHS_MAX], nactive = rhs_count, kept, i, c, t, k;
+  int m = rhs_count;
+  double error[RHS_MAX];
+
+  if (mappingtype == BLOCK_CYCLIC)
+    omp_set_schedule(omp_sched_static, chunksize);
+  else if (mappingtype == BLOCK_DYNAMIC)
+    omp_set_schedule(omp_sched_dynamic, chunksize);
+  else if (mappingtype == BLOCK_GUIDED)
+    omp_set_schedule(omp_sched_guided, chunksize);
+  else
+    omp_set_schedule(omp_sched_static, 0);
+
+  for (c = 0; c < m; c++)
+    active[c] = c;
+  for (k = 0; k < no_iterations && nactive > 0;) {
+    for (t = 0; t < nactive; t++)
+      error[t] = 0;
+#pragma omp parallel for num_threads(threadcnt) schedule(runtime)
+    for (i = 0; i < matrix_dim; i++)
+      panel_row(i, active, nactive);
+#pragma omp parallel for num_threads(threadcnt) schedule(static) private(t) reduction(max : error[:nactive])
+    for (i = 0; i < matrix_dim; i++) {
+      for (t = 0; t < nactive; t++) {
+        error[t] = fmax(error[t], fabs(panel_y[(long)i * m + active[t]] -
+                                       panel_x[(long)i * m + active[t]]));
+        panel_x[(long)i * m + active[t]] = panel_y[(long)i * m + active[t]];
+      }
+    }
+    k++;
+    kept = 0;
+    for (t = 0; t < nactive; t++) {
+      if (error[t] < ERROR_THRESHOLD)
+        panel_iterations[active[t]] = k;
+      else
+        active[kept++] = active[t];
+    }
+    nactive = kept;
+  }
+  for (t = 0; t < nactive; t++)
+    panel_iterations[active[t]] = k;
+  iterations_done = k;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            ooc_row
+ * Purpose:             Return d[i]+A[i]x for row i held at a in a
+ * streamed panel.
+ * In args:             a -- row i of A, matrix_dim doubles
+ *                      i -- row index
+ */
+double ooc_row(const double a[], int i) {
+  int j, col_start = (matrix_type == UPPER_TRIANGULAR) ? i : 0;
+  double tmp_y = vector_d[i];
+
+  for (j = col_start; j < matrix_dim; j++)
+    tmp_y += a[j] * vector_x[j];
+  return tmp_y;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            parallel_itmv_ooc
+ * Purpose:             Jacobi iteration with A streamed from ooc_path one
+ * panel of ooc_panel_rows rows at a time by ooc_readers reader threads
+ * (see itmv_ooc.h), so the next panels are read while this one is
+ * multiplied. Each thread waits for a panel itself and the panel's rows
+ * are scheduled as mappingtype with nowait, so no barrier separates the
+ * panels; a panel's buffer is recycled once every thread has released it.
+ * Stops early once max |y-x| < ERROR_THRESHOLD. The file holds dense rows,
+ * so matrix_type is 0 or UPPER_TRIANGULAR here, never BANDED.
+ *
+ * In args:             threadcnt, mappingtype, chunksize: as
+ *                      parallel_itmv_mult
+ * Global in vars:      ooc_path, ooc_panel_rows, ooc_readers, and as
+ *                      parallel_itmv_mult except matrix_A
+ * Global in/out vars:  vector_x
+ * Global out vars:     vector_y, ooc_stats, iterations_done, and run_error
+ *                      if the file cannot be opened or read
+ */
+void parallel_itmv_ooc(int threadcnt, int mappingtype, int chunksize) {
+  int i, k, err, failed;
+  double error;
+
+  if (mappingtype == BLOCK_CYCLIC)
+    omp_set_schedule(omp_sched_static, chunksize);
+  else if (mappingtype == BLOCK_DYNAMIC)
+    omp_set_schedule(omp_sched_dynamic, chunksize);
+  else if (mappingtype == BLOCK_GUIDED)
+    omp_set_schedule(omp_sched_guided, chunksize);
+  else
+    omp_set_schedule(omp_sched_static, 0);
+
+  iterations_done = 0;
+  err = ooc_open(ooc_path, matrix_dim, ooc_panel_rows, ooc_readers,
+                 threadcnt, no_iterations);
+  if (err != 0) {
+    run_error = (char *)itmv_map_strerror(err);
+    return;
+  }
+
+  for (k = 0; k < no_iterations;) {
+    failed = 0;
+#pragma omp parallel num_threads(threadcnt) private(i) reduction(|| : failed)
+    {
+      int p, s, first, rows;
+      const double *a;
+      double t0, compute = 0, stall = 0;
+
+      for (p = 0; p < ooc_panels; p++) {
+        s = k * ooc_panels + p;
+        t0 = omp_get_wtime();
+        a = ooc_acquire(s, &first, &rows);
+        stall += omp_get_wtime() - t0;
+        /* A read failed; every thread stops at the same panel. */
+        if (a == NULL) {
+          failed = 1;
+          break;
+        }
+        t0 = omp_get_wtime();
+#pragma omp for schedule(runtime) nowait
+        for (i = first; i < first + rows; i++)
+          vector_y[i] = ooc_row(a + (long)(i - first) * matrix_dim, i);
+        compute += omp_get_wtime() - t0;
+        ooc_release(s);
+      }
+#pragma omp critical
+      {
+        ooc_stats[k].compute_sec = fmax(ooc_stats[k].compute_sec, compute);
+        ooc_stats[k].stall_sec = fmax(ooc_stats[k].stall_sec, stall);
+      }
+    }
+    if (failed) {
+      run_error = (char *)itmv_map_strerror(ooc_error);
+      break;
+    }
+    error = 0;
+#pragma omp parallel for num_threads(threadcnt) schedule(static) reduction(max : error)
+    for (i = 0; i < matrix_dim; i++) {
+      error = fmax(error, fabs(vector_y[i] - vector_x[i]));
+      vector_x[i] = vector_y[i];
+    }
+    k++;
+    if (error < ERROR_THRESHOLD)
+      break;
+  }
+  iterations_done = k;
+  ooc_close();
+}
+
+/*---------------------------------------------------------------------
+ * Function:            parallel_itmv_op
+ * Purpose:             Jacobi iteration with A given by the structured
+ * operator matrix_op (see itmv_op.h) instead of matrix_A. Each iteration
+ * one thread prepares the operator for x, then the rows are scheduled as
+ * mappingtype, so an iteration costs the operator's prepare and rows
+ * instead of n^2 loads. Stops early once max |y-x| < ERROR_THRESHOLD.
+ *
+ * In args:             threadcnt, mappingtype, chunksize: as
+ *                      parallel_itmv_mult
+ * Global in vars:      matrix_op, vector_d, matrix_dim, no_iterations
+ * Global in/out vars:  vector_x
+ * Global out vars:     vector_y, iterations_done
+ */
+void parallel_itmv_op(int threadcnt, int mappingtype, int chunksize) {
+  itmv_op *op = matrix_op;
+  int i, k;
+  double error;
+
+  if (mappingtype == BLOCK_CYCLIC)
+    omp_set_schedule(omp_sched_static, chunksize);
+  else if (mappingtype == BLOCK_DYNAMIC)
+    omp_set_schedule(omp_sched_dynamic, chunksize);
+  else if (mappingtype == BLOCK_GUIDED)
+    omp_set_schedule(omp_sched_guided, chunksize);
+  else
+    omp_set_schedule(omp_sched_static, 0);
+
+  for (k = 0; k < no_iterations;) {
+#pragma omp parallel num_threads(threadcnt) private(i)
+    {
+      int me = omp_get_thread_num();
+      long rows = 0;
+      double t0 = omp_get_wtime();
+
+#pragma omp single
+      if (op->prepare != NULL)
+        op->prepare(op, vector_x);
+      sync_wait_time[me] += omp_get_wtime() - t0;
+      t0 = omp_get_wtime();
+#pragma omp for schedule(runtime) nowait
       for (i = 0; i < matrix_dim; i++) {
-        vector_x[i] = vector_y[i];
+        vector_y[i] = vector_d[i] + op->row(op, i, vector_x);
+        rows++;
       }
-      // end
+      thread_compute_time[me] += omp_get_wtime() - t0;
+      thread_rows[me] += rows;
+    }
+    error = 0;
+#pragma omp parallel for num_threads(threadcnt) schedule(static) reduction(max : error)
+    for (i = 0; i < matrix_dim; i++) {
+      error = fmax(error, fabs(vector_y[i] - vector_x[i]));
+      vector_x[i] = vector_y[i];
     }
+    k++;
+    if (error < ERROR_THRESHOLD)
+      break;
   }
+  iterations_done = k;
 }
 
 /*-------------------------------------------------------------------
@@ -150,3 +1777,61 @@ int itmv_mult_seq(double A[], double x[], double d[], double y[],
   }
   return 1;
 }
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_gs_seq
+ * Purpose:   Run up to t Gauss-Seidel/SOR sweeps sequentially, in the order
+ *            parallel_itmv_gs uses: rows n-1 down to 0 for an upper
+ *            triangular A, otherwise color by color (row i has color
+ *            i % colors, at least 2) with the rows of a color updated
+ *            together from the previous values of that color. Stops once no
+ *            row moves by more than ERROR_THRESHOLD.
+ * In args:   A, d, matrix_type, n, t:  as itmv_mult_seq
+ *            omega:  relaxation factor, 1 for Gauss-Seidel
+ *            colors:  number of colors for a regular matrix
+ * In/out:    x:  column vector x
+ *            y:  column vector y, the final x
+ *
+ * Return:  1  means succesful 0  means unsuccessful
+ */
+int itmv_gs_seq(double A[], double x[], double d[], double y[],
+                int matrix_type, int n, int t, double omega, int colors) {
+  int i, j, c, k, stop;
+  double value;
+
+  if (n <= 0 || A == NULL || x == NULL || d == NULL || y == NULL)
+    return 0;
+  if (colors < 2)
+    colors = 2;
+
+  for (k = 0; k < t; k++) {
+    stop = 1;
+    if (matrix_type == UPPER_TRIANGULAR) {
+      for (i = n - 1; i >= 0; i--) {
+        value = d[i];
+        for (j = i; j < n; j++)
+          value += A[i * n + j] * x[j];
+        y[i] = (1 - omega) * x[i] + omega * value;
+        if (fabs(y[i] - x[i]) > ERROR_THRESHOLD)
+          stop = 0;
+        x[i] = y[i];
+      }
+    } else {
+      for (c = 0; c < colors; c++) {
+        for (i = c; i < n; i += colors) {
+          value = d[i];
+          for (j = 0; j < n; j++)
+            value += A[i * n + j] * x[j];
+          y[i] = (1 - omega) * x[i] + omega * value;
+          if (fabs(y[i] - x[i]) > ERROR_THRESHOLD)
+            stop = 0;
+        }
+        for (i = c; i < n; i += colors)
+          x[i] = y[i];
+      }
+    }
+    if (stop)
+      break;
+  }
+  return 1;
+}
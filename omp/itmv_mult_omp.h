@@ -1,3 +1,6 @@
+#ifndef _ITMV_MULT_OMP
+#define _ITMV_MULT_OMP
+
 /*Global variables*/
 
 extern int thread_count;
@@ -5,18 +8,118 @@ extern double *matrix_A;
 extern double *vector_x;
 extern double *vector_d;
 extern double *vector_y;
+extern double *panel_x;
+extern double *panel_d;
+extern double *panel_y;
+extern int rhs_count;
 extern int matrix_type;
+extern int band_lower;
+extern int band_upper;
 extern int matrix_dim;
 extern int no_iterations;
 
 extern int thread_mapping;
 extern int cyclic_blocksize;
+extern int iterations_done;
+extern char *run_error;
+extern int color_count;
+extern double relax_omega;
+extern int krylov_method;
+extern int krylov_chosen;
+extern int acceleration;
+extern int anderson_depth;
+extern double accel_bounds[];
+extern int panel_iterations[];
+extern char *ooc_path;
+extern int ooc_panel_rows;
+extern int ooc_readers;
+extern struct itmv_op *matrix_op;
+extern char *autotune_profile;
+extern int autotune_mapping;
+extern int autotune_chunksize;
+extern int autotune_cached;
+extern double thread_compute_time[];
+extern double sync_wait_time[];
+extern long thread_rows[];
+extern double thread_flops[];
 #define UPPER_TRIANGULAR 1
+#define BANDED 2
+#define BLOCK_TASKDEP 12
+#define BLOCK_TASKLOOP 11
+#define BLOCK_AUTOTUNE 10
+#define KRYLOV 8
+#define GAUSS_SEIDEL 7
+#define ASYNC_JACOBI 6
 #define BLOCK_GUIDED 3
 #define BLOCK_DYNAMIC 2
 #define BLOCK_CYCLIC 1
 #define BLOCK_MAPPING 0
 
 void parallel_itmv_mult(int, int, int);
+void thread_stats_summary(int threads, double latency, double *imbalance,
+                          double *wait_fraction);
 
 #define THREAD_COUNT_MAX 64
+
+#define ERROR_THRESHOLD 1e-3
+
+/* krylov_method values for the KRYLOV mapping. KRYLOV always splits rows
+ * into contiguous blocks as BLOCK_MAPPING does; chunksize is ignored. */
+#define KRYLOV_AUTO 0
+#define KRYLOV_CG 1
+#define KRYLOV_BICGSTAB 2
+#define KRYLOV_GMRES 3
+
+#define KRYLOV_RESTART 30
+#define KRYLOV_POWER_STEPS 8
+#define KRYLOV_BICGSTAB_RHO 0.5
+
+/* acceleration values, applied to the Jacobi mappings. */
+#define ACCEL_NONE 0
+#define ACCEL_CHEBYSHEV 1
+#define ACCEL_ANDERSON 2
+
+#define ACCEL_BOUNDS_MARGIN 0.05
+#define ANDERSON_DEPTH_MAX 8
+#define ANDERSON_REGULARIZATION 1e-10
+
+/* Iterations BLOCK_AUTOTUNE times under each candidate schedule. */
+#define AUTOTUNE_TRIALS 2
+
+/* Multiple right-hand sides: rhs_count > 0 runs the panel iteration with
+ * at most RHS_MAX columns, RHS_TILE per register tile. */
+#define RHS_MAX 64
+#define RHS_TILE 4
+
+/* One Jacobi solve as jacobi_solve sees it: filled from the globals above
+ * by solve_globals for parallel_itmv_mult, or from an itmv_ctx
+ * (itmv_ctx_omp.h). The arrays belong to the caller; the counters are
+ * added to. */
+typedef struct itmv_solve {
+  double *A;
+  double *x;
+  double *d;
+  double *y;
+  int n;
+  int matrix_type;
+  int band_lower;
+  int band_upper;
+  int thread_count;
+  int mapping;      /* BLOCK_MAPPING, BLOCK_CYCLIC, BLOCK_DYNAMIC or
+                       BLOCK_GUIDED */
+  int chunksize;
+  double threshold; /* stop once max |y-x| < threshold; 0 never stops */
+  const int *cpus;  /* thread r runs on cpus[r % cpu_count] if cpu_count */
+  int cpu_count;
+  double *thread_compute_time;
+  double *sync_wait_time;
+  long *thread_rows;
+  double *thread_flops;
+} itmv_solve;
+
+void solve_globals(itmv_solve *s, int threadcnt, int mappingtype,
+                   int chunksize);
+double solve_row(const itmv_solve *s, int i);
+int jacobi_solve(itmv_solve *s, int steps);
+
+#endif
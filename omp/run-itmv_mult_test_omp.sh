@@ -16,3 +16,6 @@
 #Use 4 threads
 
 ./itmv_mult_test_omp 4
+
+#Same, one thread per physical core
+./itmv_mult_test_omp 4 physical
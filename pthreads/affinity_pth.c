@@ -0,0 +1,106 @@
+/*
+ * File: affinity_pth.c
+ *
+ * Purpose: Bind pthreads to the CPUs of the pinning policy resolved by
+ *          affinity.c. See affinity.h.
+ */
+
+#define _GNU_SOURCE
+#include "affinity.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*-------------------------------------------------------------------
+ * Pin the calling thread to the CPU for rank. Does nothing when no
+ * policy is set.
+ *
+ * Return:   0 successful, otherwise an error number from
+ *           pthread_setaffinity_np.
+ */
+int affinity_bind_self(int rank) {
+  if (affinity_count == 0) return 0;
+  return affinity_bind_cpu(affinity_cpu(rank));
+}
+
+/*-------------------------------------------------------------------
+ * Pin the calling thread to one CPU, independent of the policy.
+ *
+ * Return:   0 successful, otherwise an error number from
+ *           pthread_setaffinity_np.
+ */
+int affinity_bind_cpu(int cpu) {
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+/*-------------------------------------------------------------------
+ * Print which CPU each of nthreads threads is pinned to.
+ */
+void affinity_print(int nthreads) {
+  int r;
+  cpu_info *c;
+
+  if (affinity_count == 0) {
+    printf("Affinity: none, threads are not pinned\n");
+    return;
+  }
+  printf("Affinity: %s over %d cpus\n", affinity_spec, affinity_count);
+  for (r = 0; r < nthreads; r++) {
+    c = &affinity_cpus[r % affinity_count];
+    printf("  thread %d -> cpu %d (socket %d core %d smt %d)\n", r, c->id,
+           c->package, c->core, c->smt);
+  }
+}
+
+/* Information passed into each first-touch thread. */
+typedef struct {
+  int rank;
+  int nthreads;
+  double *a;
+  long len;
+} TouchArgs;
+
+void *touch_work(void *args) {
+  TouchArgs *t = args;
+  long chunk = (t->len + t->nthreads - 1) / t->nthreads;
+  long start = t->rank * chunk;
+  long end = (start + chunk > t->len) ? t->len : start + chunk;
+
+  affinity_bind_self(t->rank);
+  if (start < end) memset(t->a + start, 0, (end - start) * sizeof(double));
+  return NULL;
+}
+
+/*-------------------------------------------------------------------
+ * Zero a freshly allocated array from nthreads pinned threads, thread i
+ * taking the i-th contiguous chunk, so that with first-touch page
+ * placement each chunk lands on the memory node of the thread that will
+ * use it under block mapping. Does nothing when no policy is set.
+ */
+void affinity_first_touch(double *a, long len, int nthreads) {
+  pthread_t *handles;
+  TouchArgs *args;
+  int r;
+
+  if (affinity_count == 0) return;
+  handles = malloc(nthreads * sizeof(pthread_t));
+  args = malloc(nthreads * sizeof(TouchArgs));
+  for (r = 0; r < nthreads; r++) {
+    args[r].rank = r;
+    args[r].nthreads = nthreads;
+    args[r].a = a;
+    args[r].len = len;
+    pthread_create(&handles[r], NULL, touch_work, &args[r]);
+  }
+  for (r = 0; r < nthreads; r++) {
+    pthread_join(handles[r], NULL);
+  }
+  free(handles);
+  free(args);
+}
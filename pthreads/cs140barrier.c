@@ -71,6 +71,64 @@ int cs140barrier_wait(cs140barrier *bstate) {
     return 0;
 }
 
+/******************************************************
+ * First half of a split-phase barrier: register the calling thread as
+ * arrived in the current round without blocking. The thread may then do
+ * work that does not depend on the other threads before calling
+ * cs140barrier_wait_token() with the returned token.
+ *
+ * Argument:  bstate -- keep the state of a cs140barrier.
+ *
+ * Return:   A token naming the round the thread arrived in.
+ *
+ * Algorithm: Same sense reversal as cs140barrier_wait(). The token is the
+ *            value of odd_round on arrival; the round is complete once
+ *            odd_round differs from it. A round cannot flip twice before
+ *            the token is redeemed since the next round needs this thread
+ *            to arrive again.
+ */
+
+cs140barrier_token cs140barrier_arrive(cs140barrier *bstate) {
+  cs140barrier_token token;
+
+  pthread_mutex_lock(&(bstate->barrier_mutex));
+  token = bstate->odd_round;
+  bstate->arrive_nthread++;
+  if (bstate->arrive_nthread == bstate->total_nthread) {
+    bstate->arrive_nthread = 0;
+    bstate->odd_round = !(bstate->odd_round);
+    pthread_cond_broadcast(&(bstate->barrier_cond));
+  }
+  pthread_mutex_unlock(&(bstate->barrier_mutex));
+
+  return token;
+}
+
+/******************************************************
+ * Second half of a split-phase barrier: block until every thread has
+ * arrived in the round named by token.
+ *
+ * Argument:  bstate -- keep the state of a cs140barrier.
+ *            token -- the value returned by cs140barrier_arrive().
+ *
+ * Return:   1 if the round had already completed when this was called,
+ *           meaning the wait was entirely hidden behind the work done
+ *           since arriving, otherwise 0.
+ */
+
+int cs140barrier_wait_token(cs140barrier *bstate, cs140barrier_token token) {
+  int hidden;
+
+  pthread_mutex_lock(&(bstate->barrier_mutex));
+  hidden = bstate->odd_round != token;
+  while (bstate->odd_round == token) {
+    pthread_cond_wait(&(bstate->barrier_cond), &(bstate->barrier_mutex));
+  }
+  pthread_mutex_unlock(&(bstate->barrier_mutex));
+
+  return hidden;
+}
+
 /******************************************************
  * Destroy mutex and cond variables in a cs140barrier.
  * Note that the memory of bstate is not freed here.
@@ -23,10 +23,17 @@ typedef struct {
   boolean odd_round;
 } cs140barrier;
 
+/* The round a thread arrived in, handed back by cs140barrier_arrive(). */
+typedef boolean cs140barrier_token;
+
 int cs140barrier_init(cs140barrier *bstate, int total_nthread);
 
 int cs140barrier_wait(cs140barrier *bstate);
 
+cs140barrier_token cs140barrier_arrive(cs140barrier *bstate);
+
+int cs140barrier_wait_token(cs140barrier *bstate, cs140barrier_token token);
+
 int cs140barrier_destroy(cs140barrier *bstate);
 
 #endif
@@ -13,6 +13,11 @@
 /* The total round cs140barrier is used. */
 #define TOTAL_ROUND 100
 
+/* Rounds and per-round work (in microseconds) for the split-phase benchmark. */
+#define BENCH_ROUND 200
+#define BENCH_WORK_US 200
+#define BENCH_LOCAL_US 50
+
 /* Information passed into each thread. */
 typedef struct {
   /* wait_count: count the output for each thread from cs140barrier_wait. */
@@ -21,6 +26,20 @@ typedef struct {
   cs140barrier *bstate;
 } ThreadArgs;
 
+/* Information passed into each thread of the split-phase tests. */
+typedef struct {
+  int rank;
+  /* rounds: the number of rounds each thread has completed. */
+  volatile int *rounds;
+  /* idle: time this thread spent blocked in the barrier, in seconds. */
+  double *idle;
+  /* hidden: the number of rounds whose wait was fully overlapped. */
+  int *hidden;
+  /* split: use arrive/wait_token instead of cs140barrier_wait. */
+  int split;
+  cs140barrier *bstate;
+} SplitArgs;
+
 /*-------------------------------------------------------------------
  * This function is executed by each thread.
  * If any error in cs140barrier, return that error message.
@@ -64,6 +83,196 @@ void *threadFunc(void *args) {
   return NULL;
 }
 
+/*-------------------------------------------------------------------
+ * This function is executed by each thread in the split-phase test.
+ * After waiting on round i, every thread must have arrived in round i,
+ * and none can have gone past round i+1.
+ * If any error in cs140barrier, return that error message.
+ * If successful, return NULL.
+ */
+void *splitThreadFunc(void *args) {
+  SplitArgs *split_args = args;
+  cs140barrier *bstate = split_args->bstate;
+  int i, j, done;
+  cs140barrier_token token;
+  char *err;
+
+  for (i = 0; i < TOTAL_ROUND; i++) {
+    token = cs140barrier_arrive(bstate);
+    usleep(random() % 100);
+    cs140barrier_wait_token(bstate, token);
+
+    for (j = 0; j < bstate->total_nthread; j++) {
+      done = split_args->rounds[j];
+      err = mu_check_assert(
+          "Something wrong. A thread left the split-phase barrier early.\n",
+          done >= i && done <= i + 1);
+
+      if (err) {
+        return (void *)err;
+      }
+    }
+    split_args->rounds[split_args->rank] = i + 1;
+  }
+
+  return NULL;
+}
+
+/*-------------------------------------------------------------------
+ * Spin for the given number of microseconds to stand in for computation.
+ */
+void busy_work(double usec) {
+  double end = get_time() + usec / 1000000.0;
+  while (get_time() < end)
+    ;
+}
+
+/*-------------------------------------------------------------------
+ * This function is executed by each thread in the split-phase benchmark.
+ * Each round a thread does an imbalanced share of work followed by a fixed
+ * amount of thread-local work, the way an itmv thread computes its rows and
+ * then its local convergence error. With split set, the local work runs
+ * between arrive and wait_token, so it can hide the wait for slower threads.
+ */
+void *benchThreadFunc(void *args) {
+  SplitArgs *split_args = args;
+  cs140barrier *bstate = split_args->bstate;
+  int nthread = bstate->total_nthread;
+  int i;
+  double start;
+  cs140barrier_token token;
+
+  for (i = 0; i < BENCH_ROUND; i++) {
+    busy_work(BENCH_WORK_US * ((split_args->rank + i) % nthread + 1) / nthread);
+    if (split_args->split) {
+      token = cs140barrier_arrive(bstate);
+      busy_work(BENCH_LOCAL_US);
+      start = get_time();
+      *split_args->hidden += cs140barrier_wait_token(bstate, token);
+      *split_args->idle += get_time() - start;
+    } else {
+      busy_work(BENCH_LOCAL_US);
+      start = get_time();
+      cs140barrier_wait(bstate);
+      *split_args->idle += get_time() - start;
+    }
+  }
+
+  return NULL;
+}
+
+/*-------------------------------------------------------------------
+ * Run <nthread> threads of <func> on a fresh barrier.
+ * Thread i gets rounds, idle[i], hidden[i] and the split flag.
+ * If failed, return a message string showing the failed point.
+ * If successful, return NULL.
+ */
+char *run_split_threads(int nthread, void *(*func)(void *), int split,
+                        double *idle, int *hidden) {
+  int i;
+  char *err = NULL;
+  void *thread_err;
+  volatile int *rounds = calloc(nthread, sizeof(int));
+  SplitArgs *split_args = malloc(nthread * sizeof(SplitArgs));
+  pthread_t *tha = malloc(nthread * sizeof(pthread_t));
+  cs140barrier *bstate = malloc(sizeof(cs140barrier));
+
+  cs140barrier_init(bstate, nthread);
+  for (i = 0; i < nthread; i++) {
+    idle[i] = 0;
+    hidden[i] = 0;
+    split_args[i].rank = i;
+    split_args[i].rounds = rounds;
+    split_args[i].idle = idle + i;
+    split_args[i].hidden = hidden + i;
+    split_args[i].split = split;
+    split_args[i].bstate = bstate;
+    if (pthread_create(&tha[i], NULL, func, (void *)(split_args + i)) != 0) {
+      /* The threads already started would block forever on the barrier. */
+      printf("Failed to initialize a new thread.\n");
+      exit(1);
+    }
+  }
+
+  for (i = 0; i < nthread; i++) {
+    if (pthread_join(tha[i], &thread_err) != 0) {
+      err = "Failed to join a thread.\n";
+    } else if (thread_err && !err) {
+      err = (char *)thread_err;
+    }
+  }
+
+  cs140barrier_destroy(bstate);
+  free(bstate);
+  free(tha);
+  free(split_args);
+  free((void *)rounds);
+
+  return err;
+}
+
+/*-------------------------------------------------------------------
+ * Test the split-phase barrier used for <nthread> threads.
+ * If failed, return a message string showing the failed point.
+ * If successful, return NULL.
+ */
+char *barrier_split_thread_test(int nthread) {
+  double *idle = malloc(nthread * sizeof(double));
+  int *hidden = malloc(nthread * sizeof(int));
+  char *err;
+
+  printf("Test function cs140barrier_arrive/wait_token with %d threads\n",
+         nthread);
+  err = run_split_threads(nthread, splitThreadFunc, True, idle, hidden);
+
+  free(idle);
+  free(hidden);
+
+  return err;
+}
+
+char *barrier_split_one_thread_test() { return barrier_split_thread_test(1); }
+char *barrier_split_multi_thread_test() { return barrier_split_thread_test(4); }
+char *barrier_split_multi_thread_test1() {
+  return barrier_split_thread_test(11);
+}
+
+/*-------------------------------------------------------------------
+ * Compare the time threads sit blocked in cs140barrier_wait against the
+ * time left over after overlapping the local work with arrive/wait_token.
+ * Always succeeds; the numbers are for reading.
+ */
+char *barrier_split_bench(int nthread) {
+  double *idle = malloc(nthread * sizeof(double));
+  int *hidden = malloc(nthread * sizeof(int));
+  double blocking_idle = 0, split_idle = 0;
+  int i, hidden_rounds = 0;
+  char *err;
+
+  err = run_split_threads(nthread, benchThreadFunc, False, idle, hidden);
+  for (i = 0; i < nthread; i++) blocking_idle += idle[i];
+
+  if (!err) {
+    err = run_split_threads(nthread, benchThreadFunc, True, idle, hidden);
+  }
+  for (i = 0; i < nthread; i++) {
+    split_idle += idle[i];
+    hidden_rounds += hidden[i];
+  }
+
+  printf("Benchmark %d threads %d rounds: wait idle %f sec, split-phase idle "
+         "%f sec, %f sec hidden, %d of %d waits fully hidden\n",
+         nthread, BENCH_ROUND, blocking_idle, split_idle,
+         blocking_idle - split_idle, hidden_rounds, nthread * BENCH_ROUND);
+
+  free(idle);
+  free(hidden);
+
+  return err;
+}
+
+char *barrier_split_bench_test() { return barrier_split_bench(4); }
+
 /*-------------------------------------------------------------------
  * Test barrier initialization.
  * If failed, return a message string showing the failed point.
@@ -165,6 +374,10 @@ void run_all_tests(void) {
   mu_run_test(barrier_multi_thread_test);
   mu_run_test(barrier_multi_thread_test1);
   mu_run_test(barrier_multi_thread_test2);
+  mu_run_test(barrier_split_one_thread_test);
+  mu_run_test(barrier_split_multi_thread_test);
+  mu_run_test(barrier_split_multi_thread_test1);
+  mu_run_test(barrier_split_bench_test);
 }
 
 /*-------------------------------------------------------------------
@@ -0,0 +1,190 @@
+/*
+ * File: itmv_convert.c
+ *
+ * Purpose: Create, convert and check itmv matrix files (see itmv_mmap.h).
+ *
+ *   itmv_convert gen <out> <n> [dense|upper|csr] [alignment]
+ *       Write the test matrix and d that the itmv tests build.
+ *   itmv_convert raw <in> <out> <n> [dense|upper|csr] [alignment]
+ *       Convert n*n row-major doubles, optionally followed by n doubles of
+ *       d, as written by fwrite.
+ *   itmv_convert text <in> <out> [dense|upper|csr] [alignment] [threads]
+ *       Convert a square MatrixMarket or CSV matrix (see itmv_load.h),
+ *       loaded in parallel, and report the ingestion throughput.
+ *   itmv_convert validate <file>
+ *       Check the header, checksum and CSR indices.
+ *   itmv_convert info <file>
+ *       Print the header.
+ *
+ *   The alignment defaults to the page size.
+ */
+
+#include "itmv_load.h"
+#include "itmv_mmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void usage(void) {
+  printf("./itmv_convert gen <out> <n> [dense|upper|csr] [alignment]\n"
+         "./itmv_convert raw <in> <out> <n> [dense|upper|csr] [alignment]\n"
+         "./itmv_convert text <in> <out> [dense|upper|csr] [alignment] "
+         "[threads]\n"
+         "./itmv_convert validate <file>\n"
+         "./itmv_convert info <file>\n");
+}
+
+/*-------------------------------------------------------------------
+ * Parse a structure name. Return the ITMV_ value or -1.
+ */
+int parse_structure(const char *s) {
+  if (strcmp(s, "dense") == 0) return ITMV_DENSE;
+  if (strcmp(s, "upper") == 0) return ITMV_UPPER;
+  if (strcmp(s, "csr") == 0) return ITMV_CSR;
+  return -1;
+}
+
+/*-------------------------------------------------------------------
+ * Build the matrix and d of initialize() in the test drivers.
+ */
+void generate(double A[], double d[], int n, int upper) {
+  long i, j;
+
+  for (i = 0; i < n; i++) {
+    d[i] = upper ? (2.0 * n - 1.0 * i - 1.0) / n : (2.0 * n - 1.0) / n;
+    for (j = 0; j < n; j++)
+      A[i * n + j] = (i == j || (upper && j < i)) ? 0.0 : -1.0 / n;
+  }
+}
+
+/*-------------------------------------------------------------------
+ * itmv_convert text: load a text matrix and write it as a matrix file.
+ * Return the exit status.
+ */
+int convert_text(int argc, char *argv[]) {
+  itmv_loaded m;
+  int structure, alignment, threads, err;
+
+  structure = argc > 4 ? parse_structure(argv[4]) : ITMV_DENSE;
+  alignment = argc > 5 ? atoi(argv[5]) : getpagesize();
+  threads = argc > 6 ? atoi(argv[6]) : sysconf(_SC_NPROCESSORS_ONLN);
+  if (structure < 0) {
+    usage();
+    return 1;
+  }
+  err = itmv_load_file(argv[2], ITMV_DENSE, threads, &m);
+  if (err == 0 && m.rows != m.cols) {
+    itmv_load_free(&m);
+    err = ITMV_ERR_FORMAT;
+  }
+  if (err != 0) {
+    printf("%s: %s\n", argv[2], itmv_map_strerror(err));
+    return 1;
+  }
+  printf("%s: %ld x %ld, %.1f MB in %f sec, %.1f MB/s with %d threads\n",
+         argv[2], m.rows, m.cols, m.bytes / 1e6, m.seconds,
+         m.bytes / 1e6 / m.seconds, threads);
+  err = itmv_write_file(argv[3], m.values, NULL, m.rows, structure, alignment);
+  itmv_load_free(&m);
+  if (err != 0) {
+    printf("%s: %s\n", argv[3], itmv_map_strerror(err));
+    return 1;
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  itmv_mapped m;
+  double *A, *d;
+  const char *out;
+  int n, structure, alignment, err, first;
+  long got;
+  FILE *f;
+
+  if (argc < 3) {
+    usage();
+    return 1;
+  }
+
+  if (strcmp(argv[1], "validate") == 0 || strcmp(argv[1], "info") == 0) {
+    err = itmv_map_open(argv[2], 0, &m);
+    if (err == 0 && strcmp(argv[1], "validate") == 0)
+      err = itmv_map_validate(&m);
+    if (err != 0) {
+      printf("%s: %s\n", argv[2], itmv_map_strerror(err));
+      return 1;
+    }
+    printf("%s: version %u, %llu x %llu, %s, nnz %llu, alignment %llu, "
+           "%s d, %llu bytes%s\n",
+           argv[2], m.header->version, (unsigned long long)m.header->rows,
+           (unsigned long long)m.header->cols,
+           m.header->structure == ITMV_CSR     ? "csr"
+           : m.header->structure == ITMV_UPPER ? "upper"
+                                               : "dense",
+           (unsigned long long)m.header->nnz,
+           (unsigned long long)m.header->alignment, m.d ? "with" : "no",
+           (unsigned long long)m.header->file_size,
+           strcmp(argv[1], "validate") == 0 ? ", valid" : "");
+    itmv_map_close(&m);
+    return 0;
+  }
+
+  if (strcmp(argv[1], "text") == 0 && argc >= 4) {
+    return convert_text(argc, argv);
+  }
+
+  if (strcmp(argv[1], "gen") == 0 && argc >= 4) {
+    first = 3;
+    out = argv[2];
+  } else if (strcmp(argv[1], "raw") == 0 && argc >= 5) {
+    first = 4;
+    out = argv[3];
+  } else {
+    usage();
+    return 1;
+  }
+  n = atoi(argv[first]);
+  structure = argc > first + 1 ? parse_structure(argv[first + 1]) : ITMV_DENSE;
+  alignment = argc > first + 2 ? atoi(argv[first + 2]) : getpagesize();
+  if (n <= 0 || structure < 0) {
+    usage();
+    return 1;
+  }
+
+  A = malloc((long)n * n * sizeof(double));
+  d = malloc(n * sizeof(double));
+  if (A == NULL || d == NULL) {
+    printf("Failed space allocation\n");
+    return 1;
+  }
+  if (first == 3) {
+    generate(A, d, n, structure == ITMV_UPPER);
+  } else {
+    f = fopen(argv[2], "rb");
+    if (f == NULL) {
+      printf("%s: cannot open\n", argv[2]);
+      return 1;
+    }
+    got = fread(A, sizeof(double), (long)n * n, f);
+    if (got != (long)n * n) {
+      printf("%s: expected %ld doubles, found %ld\n", argv[2], (long)n * n,
+             got);
+      return 1;
+    }
+    if (fread(d, sizeof(double), n, f) != (size_t)n) {
+      free(d);
+      d = NULL;
+    }
+    fclose(f);
+  }
+
+  err = itmv_write_file(out, A, d, n, structure, alignment);
+  if (err != 0) {
+    printf("%s: %s\n", out, itmv_map_strerror(err));
+    return 1;
+  }
+  free(A);
+  free(d);
+  return 0;
+}
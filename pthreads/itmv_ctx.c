@@ -0,0 +1,380 @@
+/*
+ * File:     itmv_ctx.c
+ *
+ * Purpose:  Reentrant Jacobi iteration y = d + Ax over a context object.
+ *           See itmv_ctx.h. The iteration is solve_block or
+ *           solve_blockcyclic of itmv_mult_pth.c, run over an itmv_solve
+ *           that points at the fields of the context.
+ */
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "affinity.h"
+#include "itmv_ctx.h"
+
+/* State of one itmv_batch_run, on the caller's stack.
+ * order: the indices of the small members.
+ * deque[r]: entries [head, tail) of order still queued for thread r; the
+ * owner takes one from head, thieves take half the remainder from tail,
+ * as the rows of BLOCK_STEALING are in itmv_mult_pth.c. */
+typedef struct {
+  pthread_mutex_t lock;
+  int head;
+  int tail;
+} batch_range;
+
+typedef struct itmv_batch {
+  itmv_ctx **problems;
+  int *order;
+  int thread_count;
+  batch_range deque[THREAD_COUNT_MAX];
+} itmv_batch;
+
+typedef struct {
+  itmv_batch *batch;
+  long rank;
+  pthread_t handle;
+} batch_worker;
+
+/*---------------------------------------------------------------------
+ * Function:  ctx_to_solve
+ * Purpose:   Describe the context's solve for solve_rows, solve_block and
+ *            solve_blockcyclic.
+ * In arg:    ctx -- the context
+ * Out arg:   s
+ */
+void ctx_to_solve(itmv_ctx *ctx, itmv_solve *s) {
+  s->A = ctx->A;
+  s->x = ctx->x;
+  s->d = ctx->d;
+  s->y = ctx->y;
+  s->n = ctx->n;
+  s->matrix_type = ctx->matrix_type;
+  s->band_lower = ctx->band_lower;
+  s->band_upper = ctx->band_upper;
+  s->no_iterations = ctx->no_iterations;
+  s->thread_count = ctx->thread_count;
+  s->cyclic_blocksize = ctx->cyclic_blocksize;
+  s->threshold = ctx->threshold;
+  s->barrier = &ctx->barrier;
+  s->thread_error = ctx->thread_error;
+  s->sync_wait_time = ctx->sync_wait_time;
+  s->thread_compute_time = ctx->thread_compute_time;
+  s->thread_rows = ctx->thread_rows;
+  s->thread_flops = ctx->thread_flops;
+  s->iterations_done = &ctx->iterations_done;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  ctx_work
+ * Purpose:   Thread body of a context's team: bind to the thread's CPU if
+ *            the context has any, then run the context's mapping.
+ * In arg:    args -- the itmv_ctx_worker of this thread
+ */
+void *ctx_work(void *args) {
+  itmv_ctx_worker *me = args;
+  itmv_ctx *ctx = me->ctx;
+  itmv_solve s;
+
+  if (ctx->cpu_count > 0) {
+    affinity_bind_cpu(ctx->cpus[me->rank % ctx->cpu_count]);
+  }
+  ctx_to_solve(ctx, &s);
+  if (ctx->mapping == BLOCK_CYCLIC) {
+    solve_blockcyclic(&s, me->rank);
+  } else {
+    solve_block(&s, me->rank);
+  }
+  return NULL;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_ctx_init
+ * Purpose:   Set up a context over caller-owned arrays with default
+ *            options, and create its barrier.
+ * In args:   A, x, d, y -- the n x n matrix and vectors of the solve
+ *            n -- the matrix dimension
+ *            matrix_type -- 0 for a regular matrix, UPPER_TRIANGULAR
+ *                           or BANDED; set band_lower and band_upper
+ *                           afterwards for BANDED
+ *            thread_count -- the size of the thread team
+ * Out arg:   ctx
+ * Return:    0 successful, otherwise -1 meaning an invalid argument.
+ */
+int itmv_ctx_init(itmv_ctx *ctx, double A[], double x[], double d[],
+                  double y[], int n, int matrix_type, int thread_count) {
+  if (ctx == NULL || n <= 0 || thread_count <= 0 ||
+      thread_count > THREAD_COUNT_MAX) {
+    return -1;
+  }
+  ctx->A = A;
+  ctx->x = x;
+  ctx->d = d;
+  ctx->y = y;
+  ctx->n = n;
+  ctx->matrix_type = matrix_type;
+  ctx->band_lower = 0;
+  ctx->band_upper = 0;
+  ctx->no_iterations = 1;
+  ctx->mapping = BLOCK_MAPPING;
+  ctx->cyclic_blocksize = 1;
+  ctx->threshold = ERROR_THRESHOLD;
+  ctx->thread_count = thread_count;
+  ctx->cpu_count = 0;
+  ctx->iterations_done = 0;
+  cs140barrier_init(&ctx->barrier, thread_count);
+  return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_ctx_set_cpus
+ * Purpose:   Pin the context's thread r to cpus[r % count] on later runs.
+ *            A count of 0 leaves the threads unpinned. Use
+ *            affinity_cpu_list to turn a policy string into cpus.
+ * Return:    0 successful, otherwise -1.
+ */
+int itmv_ctx_set_cpus(itmv_ctx *ctx, const int cpus[], int count) {
+  int i;
+
+  if (count < 0 || count > THREAD_COUNT_MAX) return -1;
+  for (i = 0; i < count; i++) {
+    ctx->cpus[i] = cpus[i];
+  }
+  ctx->cpu_count = count;
+  return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_ctx_run
+ * Purpose:   Run up to no_iterations of {y=d+Ax; x=y} with the context's
+ *            thread team, stopping early once max |y-x| < threshold.
+ *            Blocks until the team is done. Safe to call at the same time
+ *            as itmv_ctx_run on other contexts.
+ * In/out:    ctx -- x and y are updated, iterations_done and the
+ *            per-thread counters are set.
+ * Return:    0 successful, otherwise -1 meaning an unsupported mapping.
+ *            Exits if the team cannot be started.
+ */
+int itmv_ctx_run(itmv_ctx *ctx) {
+  long r, started;
+
+  if (ctx->mapping != BLOCK_MAPPING && ctx->mapping != BLOCK_CYCLIC) {
+    return -1;
+  }
+  if (ctx->mapping == BLOCK_CYCLIC && ctx->cyclic_blocksize <= 0) {
+    return -1;
+  }
+  for (started = 0; started < ctx->thread_count; started++) {
+    ctx->workers[started].ctx = ctx;
+    ctx->workers[started].rank = started;
+    if (pthread_create(&ctx->workers[started].handle, NULL, ctx_work,
+                       &ctx->workers[started]) != 0) {
+      break;
+    }
+  }
+  if (started < ctx->thread_count) {
+    /* The threads already started would wait forever at the barrier. */
+    printf("itmv_ctx_run: could only start %ld of %d threads\n", started,
+           ctx->thread_count);
+    exit(1);
+  }
+  for (r = 0; r < ctx->thread_count; r++) {
+    pthread_join(ctx->workers[r].handle, NULL);
+  }
+  return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_ctx_destroy
+ * Purpose:   Release the context's barrier. The arrays are the caller's.
+ */
+void itmv_ctx_destroy(itmv_ctx *ctx) { cs140barrier_destroy(&ctx->barrier); }
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_ctx_solve_seq
+ * Purpose:   Run the same iteration as itmv_ctx_run on the calling thread
+ *            alone, with no barriers. The context's thread settings are
+ *            ignored.
+ * In/out:    ctx -- x and y are updated, iterations_done is set.
+ * Return:    0
+ */
+int itmv_ctx_solve_seq(itmv_ctx *ctx) {
+  int i, k, n = ctx->n;
+  double error;
+  itmv_solve s;
+
+  ctx_to_solve(ctx, &s);
+  for (k = 0; k < ctx->no_iterations; k++) {
+    solve_rows(&s, 0, n);
+    error = 0;
+    for (i = 0; i < n; i++) {
+      if (fabs(ctx->y[i] - ctx->x[i]) > error) {
+        error = fabs(ctx->y[i] - ctx->x[i]);
+      }
+      ctx->x[i] = ctx->y[i];
+    }
+    if (error < ctx->threshold) {
+      k++;
+      break;
+    }
+  }
+  ctx->iterations_done = k;
+  return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  batch_pop
+ * Purpose:   Take the next entry from the head of thread r's deque.
+ * Out arg:   next -- the entry of order taken
+ * Return:    1 if an entry was taken, 0 if the deque was empty
+ */
+int batch_pop(itmv_batch *b, int r, int *next) {
+  int found = 0;
+
+  pthread_mutex_lock(&b->deque[r].lock);
+  if (b->deque[r].head < b->deque[r].tail) {
+    *next = b->deque[r].head++;
+    found = 1;
+  }
+  pthread_mutex_unlock(&b->deque[r].lock);
+  return found;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  batch_steal
+ * Purpose:   Move half of the entries left in another thread's deque
+ *            (at least one) into this thread's own, now empty, deque.
+ *            Victims are tried in rank order starting after my_rank.
+ * Return:    1 if entries were stolen, 0 if every deque was empty
+ */
+int batch_steal(itmv_batch *b, long my_rank) {
+  int v, r, start, end, take;
+
+  for (v = 1; v < b->thread_count; v++) {
+    r = (my_rank + v) % b->thread_count;
+    pthread_mutex_lock(&b->deque[r].lock);
+    take = (b->deque[r].tail - b->deque[r].head + 1) / 2;
+    end = b->deque[r].tail;
+    start = end - take;
+    b->deque[r].tail = start;
+    pthread_mutex_unlock(&b->deque[r].lock);
+    if (take > 0) {
+      pthread_mutex_lock(&b->deque[my_rank].lock);
+      b->deque[my_rank].head = start;
+      b->deque[my_rank].tail = end;
+      pthread_mutex_unlock(&b->deque[my_rank].lock);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  batch_work
+ * Purpose:   Thread body of itmv_batch_run: solve whole members from this
+ *            thread's deque, then from other threads' deques, until none
+ *            are left.
+ * In arg:    args -- the batch_worker of this thread
+ */
+void *batch_work(void *args) {
+  batch_worker *me = args;
+  itmv_batch *b = me->batch;
+  int next;
+
+  for (;;) {
+    while (batch_pop(b, me->rank, &next)) {
+      itmv_ctx_solve_seq(b->problems[b->order[next]]);
+    }
+    if (!batch_steal(b, me->rank)) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  itmv_batch_run
+ * Purpose:   Solve count independent problems with thread_count threads.
+ *            Members with n >= parallel_n are run first, one at a time,
+ *            by itmv_ctx_run with their team resized to thread_count.
+ *            The rest are dealt out in contiguous runs, one run per
+ *            thread, and each is solved whole by itmv_ctx_solve_seq on
+ *            whichever thread takes it; a thread that runs dry steals
+ *            half of another's remaining members.
+ * In args:   problems -- initialized contexts, one per problem
+ *            count -- the number of problems
+ *            thread_count -- the size of the team
+ *            parallel_n -- smallest n solved with intra-solve parallelism,
+ *                          normally ITMV_BATCH_PARALLEL_N
+ * Return:    the number of members solved with intra-solve parallelism,
+ *            or -1 meaning an invalid argument or unsupported mapping.
+ */
+int itmv_batch_run(itmv_ctx *problems[], int count, int thread_count,
+                   int parallel_n) {
+  itmv_batch b;
+  batch_worker workers[THREAD_COUNT_MAX];
+  batch_worker me;
+  int small = 0, large = 0, started = 0, block, i;
+  long r;
+
+  if (count < 0 || thread_count <= 0 || thread_count > THREAD_COUNT_MAX) {
+    return -1;
+  }
+  b.problems = problems;
+  b.order = malloc((count > 0 ? count : 1) * sizeof(int));
+  b.thread_count = thread_count;
+  for (i = 0; i < count; i++) {
+    if (problems[i]->n < parallel_n) {
+      b.order[small++] = i;
+      continue;
+    }
+    if (problems[i]->thread_count != thread_count) {
+      cs140barrier_destroy(&problems[i]->barrier);
+      cs140barrier_init(&problems[i]->barrier, thread_count);
+      problems[i]->thread_count = thread_count;
+    }
+    if (itmv_ctx_run(problems[i]) != 0) {
+      free(b.order);
+      return -1;
+    }
+    large++;
+  }
+
+  block = (small + thread_count - 1) / thread_count;
+  for (r = 0; r < thread_count; r++) {
+    pthread_mutex_init(&b.deque[r].lock, NULL);
+    b.deque[r].head = (r * block < small) ? r * block : small;
+    b.deque[r].tail = (b.deque[r].head + block < small)
+                          ? b.deque[r].head + block
+                          : small;
+  }
+  for (r = 0; r < thread_count; r++) {
+    workers[r].batch = &b;
+    workers[r].rank = r;
+    if (pthread_create(&workers[r].handle, NULL, batch_work, &workers[r]) !=
+        0) {
+      /* The others steal this thread's share, so just run with fewer. */
+      workers[r].rank = -1;
+    } else {
+      started++;
+    }
+  }
+  for (r = 0; r < thread_count; r++) {
+    if (workers[r].rank >= 0) {
+      pthread_join(workers[r].handle, NULL);
+    }
+  }
+  if (started == 0) {
+    /* Rank 0 drains its own deque and steals all the others. */
+    me.batch = &b;
+    me.rank = 0;
+    batch_work(&me);
+  }
+  for (r = 0; r < thread_count; r++) {
+    pthread_mutex_destroy(&b.deque[r].lock);
+  }
+  free(b.order);
+  return large;
+}
@@ -0,0 +1,51 @@
+/*
+ * File: itmv_load_pth.c
+ *
+ * Purpose: itmv_load_parallel for the pthreads driver. See itmv_load.h.
+ */
+
+#include "itmv_load.h"
+#include <pthread.h>
+
+typedef struct {
+  void (*fn)(void *arg, int chunk);
+  void *arg;
+  int chunk;
+} load_task;
+
+void *load_thread(void *arg) {
+  load_task *task = arg;
+
+  task->fn(task->arg, task->chunk);
+  return NULL;
+}
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_load_parallel
+ * Purpose:   Run fn(arg, c) for every chunk, chunk 0 on the caller and the
+ *            others on threads of their own. A chunk whose thread cannot
+ *            be created runs on the caller.
+ */
+void itmv_load_parallel(int chunks, void (*fn)(void *arg, int chunk),
+                        void *arg) {
+  pthread_t handles[ITMV_LOAD_THREADS_MAX];
+  load_task tasks[ITMV_LOAD_THREADS_MAX];
+  int started[ITMV_LOAD_THREADS_MAX];
+  int c;
+
+  for (c = 1; c < chunks; c++) {
+    tasks[c].fn = fn;
+    tasks[c].arg = arg;
+    tasks[c].chunk = c;
+    started[c] = pthread_create(&handles[c], NULL, load_thread, &tasks[c]) == 0;
+    if (!started[c]) {
+      fn(arg, c);
+    }
+  }
+  fn(arg, 0);
+  for (c = 1; c < chunks; c++) {
+    if (started[c]) {
+      pthread_join(handles[c], NULL);
+    }
+  }
+}
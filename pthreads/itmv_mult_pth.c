@@ -15,167 +15,2496 @@
  */
 #include <math.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 
+#include "cs140barrier.h"
+#include "itmv_band.h"
+#include "itmv_mmap.h"
 #include "itmv_mult_pth.h"
+#include "itmv_ooc.h"
+#include "itmv_op.h"
+#include "itmv_trace.h"
 
-pthread_barrier_t mybarrier; /*It will be initailized at itmv_mult_test_pth.c*/
+cs140barrier mybarrier; /*It will be initailized at itmv_mult_test_pth.c*/
+
+/* Per-thread convergence error, double-buffered by iteration parity so a
+ * thread that runs ahead cannot overwrite a value still being read. */
+double thread_error[2][THREAD_COUNT_MAX];
+
+/* Seconds each thread spent blocked on synchronization in the last run. */
+double sync_wait_time[THREAD_COUNT_MAX];
+
+/* Seconds, rows and floating point operations each thread spent computing
+ * y = d + Ax in the last run. Counted by the block, block cyclic and
+ * scheduled mappings; zero for the others. */
+double thread_compute_time[THREAD_COUNT_MAX];
+long thread_rows[THREAD_COUNT_MAX];
+double thread_flops[THREAD_COUNT_MAX];
+
+/* Iterations of y=d+Ax the last run performed (sweeps for ASYNC_JACOBI). */
+int iterations_done;
+
+/* Why the last run stopped without a result, or NULL if it did not. */
+char *run_error;
+
+/* State of the dataflow mapping, set up by rank 0 in work_dataflow.
+ * block_version[b]: the last iteration whose rows of block b are published.
+ * converged_count[c]: how many blocks were within threshold at iteration c.
+ * stop_iteration: the first iteration every block converged, or t. */
+atomic_int *block_version;
+atomic_int *converged_count;
+atomic_int stop_iteration;
+double *dataflow_buf[3];
+
+/* State of ASYNC_JACOBI. async_converged[r] is 1 once thread r's last sweep
+ * moved none of its rows by more than the threshold, or it ran out of
+ * sweeps; converged_threads counts those flags and async_done is raised
+ * when it reaches thread_count. */
+int async_converged[THREAD_COUNT_MAX];
+int async_sweeps[2][THREAD_COUNT_MAX];
+atomic_int converged_threads;
+atomic_int async_done;
+
+/* State of the KRYLOV mapping, set up by rank 0 in krylov_alloc.
+ * krylov_vec: work vectors of matrix_dim each (GMRES basis first).
+ * krylov_partial[parity][r]: thread r's share of a reduction, double-
+ * buffered like thread_error. */
+double *krylov_vec;
+double krylov_partial[2][THREAD_COUNT_MAX][KRYLOV_RESTART + 2];
+
+/* Method the last KRYLOV run used, after KRYLOV_AUTO made its choice. */
+int krylov_chosen;
+
+/* Work vectors of the Chebyshev and Anderson accelerations, set up by
+ * rank 0. accel_bounds holds the spectral interval Chebyshev used. */
+double *accel_vec;
+double accel_bounds[2];
+
+/* Per-column state of the MULTI_RHS mapping.
+ * panel_error[parity][r][c]: thread r's max |Y-X| in column c.
+ * panel_iterations[c]: iterations column c ran before it was retired. */
+double panel_error[2][THREAD_COUNT_MAX][RHS_MAX];
+int panel_iterations[RHS_MAX];
+
+/* Per-thread time in y=d+Ax and waiting for panels in the out-of-core
+ * mode, double-buffered like thread_error. */
+double ooc_compute[2][THREAD_COUNT_MAX];
+double ooc_stall[2][THREAD_COUNT_MAX];
+
+/* State of the dynamic, guided and work-stealing mappings.
+ * next_row: the first row not yet handed out this iteration.
+ * row_deque[r]: rows [head, tail) still queued for thread r; the owner
+ * takes chunks from head, thieves take half the remainder from tail. */
+atomic_int next_row;
+typedef struct {
+	pthread_mutex_t lock;
+	int head;
+	int tail;
+} row_range;
+row_range row_deque[THREAD_COUNT_MAX];
+
+/*---------------------------------------------------------------------
+ * Function:            mv_row
+ * Purpose:             Return d[i]+A[i]x for the i-th row against a given x
+ * In args:             i -- row index
+ *                      x -- the vector x to multiply with
+ * Global in vars:
+ *        double matrix_A[]: 2D matrix A represented by a 1D array.
+ *        double vector_d[]: vector d
+ *        matrix_type: matrix_type=0 means A is a regular matrix.
+ *                     matrix_type=1 (UPPER_TRIANGULAR) means A is an upper
+ *                     triangular matrix
+ *                     matrix_type=2 (BANDED) means matrix_A holds the
+ *                     band_lower+band_upper+1 diagonals of A (itmv_band.h)
+ *        matrix_dim: the global  number of columns (same as the number of rows)
+ */
+double mv_row(int i, double x[])
+{
+	int j, col_start;
+	double tmp_y = vector_d[i];
+	if (matrix_type == BANDED)
+	{
+		return tmp_y + itmv_band_row(matrix_A, matrix_dim, band_lower,
+		                             band_upper, i, x);
+	}
+	if (matrix_type == UPPER_TRIANGULAR)
+	{
+		col_start = i;
+	}
+	else
+	{
+		col_start = 0;
+	}
+	for (j = col_start; j < matrix_dim; j++)
+	{
+		tmp_y += matrix_A[i * matrix_dim + j] * x[j];
+	}
+	return tmp_y;
+}
+
+/*---------------------------------------------------------------------
+ * Function:            mv_compute
+ * Purpose:             Compute  y[i]=d[i]+A[i]x for i-th element of vector y
+ * In arg:              i -- row index
+ * Global in vars:
+ *        double vector_x[]: vector x
+ *        and those of mv_row
+ * Global in/out vars:
+ *        double vector_y[]: vector y
+ */
+void mv_compute(int i)
+{
+	vector_y[i] = mv_row(i, vector_x);
+}
+
+/*---------------------------------------------------------------------
+ * Function:  solve_globals
+ * Purpose:   Describe the solve held in the globals -- matrix_A, the
+ *            vectors, the options, mybarrier and the per-thread counters
+ *            -- for the functions that take an itmv_solve.
+ * Out arg:   s
+ */
+void solve_globals(itmv_solve *s)
+{
+	s->A = matrix_A;
+	s->x = vector_x;
+	s->d = vector_d;
+	s->y = vector_y;
+	s->n = matrix_dim;
+	s->matrix_type = matrix_type;
+	s->band_lower = band_lower;
+	s->band_upper = band_upper;
+	s->no_iterations = no_iterations;
+	s->thread_count = thread_count;
+	s->cyclic_blocksize = cyclic_blocksize;
+	s->threshold = ERROR_THRESHOLD;
+	s->barrier = &mybarrier;
+	s->thread_error = thread_error;
+	s->sync_wait_time = sync_wait_time;
+	s->thread_compute_time = thread_compute_time;
+	s->thread_rows = thread_rows;
+	s->thread_flops = thread_flops;
+	s->iterations_done = &iterations_done;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  solve_rows
+ * Purpose:   Compute y[i]=d[i]+A[i]x for rows start <= i < end of the
+ *            solve s. A banded A is streamed diagonal by diagonal by
+ *            itmv_band_rows, so every mapping that hands a thread ranges
+ *            of rows gets the vectorized kernel; otherwise row by row.
+ * In args:   s -- the solve
+ *            start, end -- row range
+ */
+void solve_rows(const itmv_solve *s, int start, int end)
+{
+	int i, j, n = s->n;
+	double *A = s->A, *x = s->x;
+	double tmp_y;
+
+	if (s->matrix_type == BANDED) {
+		itmv_band_rows(A, n, s->band_lower, s->band_upper, x, s->d,
+		               s->y, start, end);
+		return;
+	}
+	for (i = start; i < end; i++) {
+		tmp_y = s->d[i];
+		for (j = (s->matrix_type == UPPER_TRIANGULAR) ? i : 0; j < n; j++) {
+			tmp_y += A[(long)i * n + j] * x[j];
+		}
+		s->y[i] = tmp_y;
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  mv_rows
+ * Purpose:   Compute y[i]=d[i]+A[i]x for rows start <= i < end of the
+ *            global matrix against a given x, as solve_rows.
+ * In args:   start, end -- row range
+ *            x -- the vector x to multiply with
+ * Out arg:   y
+ */
+void mv_rows(int start, int end, double x[], double y[])
+{
+	itmv_solve s;
+
+	solve_globals(&s);
+	s.x = x;
+	s.y = y;
+	solve_rows(&s, start, end);
+}
+
+/*---------------------------------------------------------------------
+ * Function:  row_span
+ * Purpose:   The columns first <= j < last that row i of A may have
+ *            nonzero, and where they are: A[i][j] is
+ *            matrix_A[base + j * stride], for the row-by-row solvers to
+ *            read dense, upper triangular and banded A alike.
+ * Out args:  first, last, base, stride
+ */
+void row_span(int i, int *first, int *last, long *base, long *stride)
+{
+	if (matrix_type == BANDED) {
+		itmv_band_span(matrix_dim, band_lower, band_upper, i, first, last,
+		               base);
+		*stride = matrix_dim;
+		return;
+	}
+	*first = (matrix_type == UPPER_TRIANGULAR) ? i : 0;
+	*last = matrix_dim;
+	*base = (long)i * matrix_dim;
+	*stride = 1;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  wall_time
+ * Purpose:   Return a monotonic time stamp in seconds for the wait counters.
+ */
+double wall_time(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  solve_flops
+ * Purpose:   Return the floating point operations of y = d + Ax for rows
+ *            start <= i < end of the solve s: a multiply and an add per
+ *            stored entry of A.
+ */
+double solve_flops(const itmv_solve *s, int start, int end)
+{
+	double rows = end - start;
+
+	if (rows <= 0) {
+		return 0;
+	}
+	if (s->matrix_type == BANDED) {
+		return 2.0 * itmv_band_entries(s->n, s->band_lower, s->band_upper,
+		                               start, end);
+	}
+	if (s->matrix_type == UPPER_TRIANGULAR) {
+		/* Row i stores n - i entries. */
+		return 2 * (rows * s->n - (start + end - 1) * rows / 2);
+	}
+	return 2 * rows * s->n;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  row_flops
+ * Purpose:   solve_flops for the global matrix.
+ */
+double row_flops(int start, int end)
+{
+	itmv_solve s;
+
+	solve_globals(&s);
+	return solve_flops(&s, start, end);
+}
+
+/*---------------------------------------------------------------------
+ * Function:  solve_stats_reset
+ * Purpose:   Zero the wait and compute counters of thread my_rank of the
+ *            solve s at the start of a run.
+ */
+void solve_stats_reset(const itmv_solve *s, long my_rank)
+{
+	s->sync_wait_time[my_rank] = 0;
+	s->thread_compute_time[my_rank] = 0;
+	s->thread_rows[my_rank] = 0;
+	s->thread_flops[my_rank] = 0;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  thread_stats_reset
+ * Purpose:   solve_stats_reset for the global counters.
+ */
+void thread_stats_reset(long my_rank)
+{
+	itmv_solve s;
+
+	solve_globals(&s);
+	solve_stats_reset(&s, my_rank);
+}
+
+/*---------------------------------------------------------------------
+ * Function:  thread_stats_summary
+ * Purpose:   Summarize the counters of the last run of threads threads.
+ * In args:   latency: its wall time in seconds
+ * Out args:  imbalance: max over mean of the per-thread compute time, 1
+ *                       when perfectly balanced; 0 if nothing was counted
+ *            wait_fraction: mean per-thread wait time over latency; 0
+ *                       if nothing was counted
+ */
+void thread_stats_summary(int threads, double latency, double *imbalance,
+		double *wait_fraction)
+{
+	double total = 0, max = 0, wait = 0;
+
+	for (int r = 0; r < threads; r++) {
+		total += thread_compute_time[r];
+		max = fmax(max, thread_compute_time[r]);
+		wait += sync_wait_time[r];
+	}
+	*imbalance = total > 0 ? max / (total / threads) : 0;
+	*wait_fraction = latency > 0 ? wait / threads / latency : 0;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  solve_row_error
+ * Purpose:   Return max |y[i] - x[i]| for start <= i < end of the solve
+ *            s, the part of the convergence check a thread can do on its
+ *            own rows without waiting for the others.
+ * In args:   s -- the solve
+ *            start, end -- row range
+ */
+double solve_row_error(const itmv_solve *s, int start, int end)
+{
+	double error = 0;
+	for (int p = start; p < end; p++) {
+		double temp_error = fabs(s->y[p] - s->x[p]);
+		if (temp_error > error) {
+			error = temp_error;
+		}
+	}
+	return error;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  row_error
+ * Purpose:   solve_row_error for the global vectors.
+ */
+double row_error(int start, int end)
+{
+	itmv_solve s;
+
+	solve_globals(&s);
+	return solve_row_error(&s, start, end);
+}
+
+/*---------------------------------------------------------------------
+ * Function:  solve_error
+ * Purpose:   Combine the per-thread errors of one iteration of the solve
+ *            s. Call only after a barrier that follows every thread's
+ *            write to thread_error[parity].
+ * In arg:    parity -- iteration number & 1
+ */
+double solve_error(const itmv_solve *s, int parity)
+{
+	double error = 0;
+	for (int r = 0; r < s->thread_count; r++) {
+		if (s->thread_error[parity][r] > error) {
+			error = s->thread_error[parity][r];
+		}
+	}
+	return error;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  global_error
+ * Purpose:   solve_error for the global thread_error.
+ */
+double global_error(int parity)
+{
+	itmv_solve s;
+
+	solve_globals(&s);
+	return solve_error(&s, parity);
+}
+
+/*---------------------------------------------------------------------
+ * Function:  solve_block
+ * Purpose:   Run t iterations of parallel computation:  {y=d+Ax; x=y}
+ *            based on block mapping. blocksize=ceil(n/thread_count);
+ *            For example, given 2 threads,
+ *            Thread 0 should handle computation for Rows 0 and 1, and
+ *            Thread 1 should handle computation for Rows 2 and 3.
+ *
+ *            x may only be overwritten once every thread is done reading it,
+ *            but the local error only needs this thread's rows, so it is
+ *            computed between arriving at that barrier and waiting on it.
+ *            The errors are combined after the second barrier so all
+ *            threads stop at the same iteration, the first whose error is
+ *            below the solve's threshold.
+ * In args:
+ *            s: the solve, shared by the team through its arrays
+ *            my_rank: rank of this thread (counted from 0)
+ * Out:       s->x and s->y updated; thread my_rank's counters set;
+ *            rank 0 sets *s->iterations_done.
+ */
+void solve_block(itmv_solve *s, long my_rank)
+{
+	int n = s->n;
+	int block_size = ceil((double)n/s->thread_count);
+	int k = 0;
+	int start = my_rank * block_size;
+	int end = ((start + block_size) > n) ? n : (start + block_size);
+	double wait_start, compute_start;
+	double block_flops = solve_flops(s, start, end);
+	TRACE_VAR(phase_start);
+	cs140barrier_token token;
+
+	solve_stats_reset(s, my_rank);
+	while (k < s->no_iterations) {
+		compute_start = wall_time();
+		solve_rows(s, start, end);
+		s->thread_compute_time[my_rank] += wall_time() - compute_start;
+		TRACE_SPAN(my_rank, TRACE_COMPUTE, k, compute_start);
+		token = cs140barrier_arrive(s->barrier);
+		TRACE_MARK(phase_start);
+		s->thread_error[k & 1][my_rank] = solve_row_error(s, start, end);
+		TRACE_SPAN(my_rank, TRACE_CHECK, k, phase_start);
+		wait_start = wall_time();
+		cs140barrier_wait_token(s->barrier, token);
+		s->sync_wait_time[my_rank] += wall_time() - wait_start;
+		TRACE_SPAN(my_rank, TRACE_WAIT, k, wait_start);
+		TRACE_MARK(phase_start);
+		for (int p = start; p < end; p++) {	
+			s->x[p] = s->y[p];
+		}
+		TRACE_SPAN(my_rank, TRACE_COPY, k, phase_start);
+		wait_start = wall_time();
+		cs140barrier_wait(s->barrier);
+		s->sync_wait_time[my_rank] += wall_time() - wait_start;
+		TRACE_SPAN(my_rank, TRACE_WAIT, k, wait_start);
+		if (end > start) {
+			s->thread_rows[my_rank] += end - start;
+			s->thread_flops[my_rank] += block_flops;
+		}
+		if (solve_error(s, k & 1) < s->threshold) {
+			break;
+		}
+		k++;
+	}
+	if (my_rank == 0) {
+		*s->iterations_done = (k < s->no_iterations) ? k + 1 : k;
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_block
+ * Purpose:   Run t iterations of parallel computation:  {y=d+Ax; x=y}
+ *            on the globals based on block mapping, as solve_block.
+ *            With acceleration set, the x=y step is replaced by
+ *            work_chebyshev or work_anderson.
+ * In arg:
+ *            my_rank: rank of this thread (counted from 0)
+ * Global in vars:
+ *            those of solve_globals
+ * Global in/out vars:
+ *            double vector_x[]:  vector x
+ * Global out vars:
+ *            double vector_y[]:  vector y
+ */
+void work_block(long my_rank)
+{
+	itmv_solve s;
+	void work_chebyshev(long);
+	void work_anderson(long);
+
+	if (acceleration == ACCEL_CHEBYSHEV) {
+		work_chebyshev(my_rank);
+		return;
+	}
+	if (acceleration == ACCEL_ANDERSON) {
+		work_anderson(my_rank);
+		return;
+	}
+	solve_globals(&s);
+	solve_block(&s, my_rank);
+}
+
+/*---------------------------------------------------------------------
+ * Function:  solve_blockcyclic
+ * Purpose:   Run t iterations of parallel computation:  {y=d+Ax; x=y}
+ *            based on block cylic mapping with blocks of
+ *            s->cyclic_blocksize rows. Synchronizes the same way as
+ *            solve_block.
+ * In args:
+ *            s: the solve, shared by the team through its arrays
+ *            my_rank: rank of this thread (counted from 0)
+ * Out:       as solve_block
+ */
+void solve_blockcyclic(itmv_solve *s, long my_rank) { 	
+	int n = s->n, chunk = s->cyclic_blocksize;
+	int stride = s->thread_count * chunk;
+	int k = 0, i = 0, start = 0, end = 0;
+	double local_error, wait_start, compute_start;
+	TRACE_VAR(phase_start);
+	cs140barrier_token token;
+	solve_stats_reset(s, my_rank);
+
+	while (k < s->no_iterations) {
+		compute_start = wall_time();
+		start = my_rank * chunk;
+		while (start < n) {
+			i = (start + chunk > n) ? n : (start + chunk);
+			solve_rows(s, start, i);
+			s->thread_rows[my_rank] += i - start;
+			s->thread_flops[my_rank] += solve_flops(s, start, i);
+			start += stride;
+		}
+		s->thread_compute_time[my_rank] += wall_time() - compute_start;
+		TRACE_SPAN(my_rank, TRACE_COMPUTE, k, compute_start);
+		token = cs140barrier_arrive(s->barrier);
+		TRACE_MARK(phase_start);
+		local_error = 0;
+		start = my_rank * chunk;
+		while (start < n) {
+			end = (start + chunk > n) ? n : (start + chunk);
+			local_error = fmax(local_error, solve_row_error(s, start, end));
+			start += stride;
+		}
+		s->thread_error[k & 1][my_rank] = local_error;
+		TRACE_SPAN(my_rank, TRACE_CHECK, k, phase_start);
+		wait_start = wall_time();
+		cs140barrier_wait_token(s->barrier, token);
+		s->sync_wait_time[my_rank] += wall_time() - wait_start;
+		TRACE_SPAN(my_rank, TRACE_WAIT, k, wait_start);
+		TRACE_MARK(phase_start);
+		start = my_rank * chunk;
+		while (start < n) {
+			i = start;
+			while (i < start + chunk && i < n) {
+				s->x[i] = s->y[i];
+				i++;
+			}
+			start += stride;
+		}
+		TRACE_SPAN(my_rank, TRACE_COPY, k, phase_start);
+		wait_start = wall_time();
+		cs140barrier_wait(s->barrier);
+		s->sync_wait_time[my_rank] += wall_time() - wait_start;
+		TRACE_SPAN(my_rank, TRACE_WAIT, k, wait_start);
+		if (solve_error(s, k & 1) < s->threshold) {
+			break;
+		}
+		k++;
+	}
+	if (my_rank == 0) {
+		*s->iterations_done = (k < s->no_iterations) ? k + 1 : k;
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_blockcyclic
+ * Purpose:   Run t iterations of parallel computation:  {y=d+Ax; x=y}
+ *            on the globals based on block cylic mapping, as
+ *            solve_blockcyclic.
+ * In arg:
+ *            my_rank:         rank of this thread (counted from 0)
+ * Global in vars:
+ *            those of solve_globals
+ * Global in/out vars:
+ *            double vector_x[]:  vector x
+ * Global out vars:
+ *            double vector_y[]:  vector y
+ */
+void work_blockcyclic(long my_rank)
+{
+	itmv_solve s;
+
+	solve_globals(&s);
+	solve_blockcyclic(&s, my_rank);
+}
+
+/*---------------------------------------------------------------------
+ * Function:  pop_rows
+ * Purpose:   Take up to chunk rows from the head of thread r's deque.
+ * In args:   r -- owner of the deque
+ *            chunk -- number of rows wanted
+ * Out args:  start, end -- the rows taken
+ * Return:    1 if any rows were taken, 0 if the deque was empty
+ */
+int pop_rows(int r, int chunk, int *start, int *end)
+{
+	int found = 0;
+	pthread_mutex_lock(&row_deque[r].lock);
+	if (row_deque[r].head < row_deque[r].tail) {
+		*start = row_deque[r].head;
+		*end = (*start + chunk > row_deque[r].tail) ? row_deque[r].tail : (*start + chunk);
+		row_deque[r].head = *end;
+		found = 1;
+	}
+	pthread_mutex_unlock(&row_deque[r].lock);
+	return found;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  steal_rows
+ * Purpose:   Move half of the rows left in another thread's deque (at least
+ *            chunk) into this thread's own, now empty, deque. Victims are
+ *            tried in rank order starting after my_rank.
+ * In args:   my_rank -- the thief
+ *            chunk -- the smallest number of rows worth stealing
+ * Return:    1 if rows were stolen, 0 if every deque was empty
+ */
+int steal_rows(long my_rank, int chunk)
+{
+	int v, r, start, end, take;
+	for (v = 1; v < thread_count; v++) {
+		r = (my_rank + v) % thread_count;
+		pthread_mutex_lock(&row_deque[r].lock);
+		take = (row_deque[r].tail - row_deque[r].head + 1) / 2;
+		if (take < chunk) {
+			take = chunk;
+		}
+		if (take > row_deque[r].tail - row_deque[r].head) {
+			take = row_deque[r].tail - row_deque[r].head;
+		}
+		end = row_deque[r].tail;
+		start = end - take;
+		row_deque[r].tail = start;
+		pthread_mutex_unlock(&row_deque[r].lock);
+		if (take > 0) {
+			pthread_mutex_lock(&row_deque[my_rank].lock);
+			row_deque[my_rank].head = start;
+			row_deque[my_rank].tail = end;
+			pthread_mutex_unlock(&row_deque[my_rank].lock);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  next_rows
+ * Purpose:   Hand out the next rows for this thread to compute under
+ *            BLOCK_DYNAMIC, BLOCK_GUIDED or BLOCK_STEALING.
+ *            Dynamic: fixed chunks of cyclic_blocksize from a shared counter.
+ *            Guided:  chunks of remaining/thread_count rows, never below
+ *                     cyclic_blocksize, from the same counter.
+ *            Stealing: chunks of cyclic_blocksize from this thread's own
+ *                     deque, seeded with its block-mapping rows, then from
+ *                     other threads' deques once it runs dry.
+ * In arg:    my_rank -- rank of this thread
+ * Out args:  start, end -- the rows to compute
+ * Return:    1 if rows were handed out, 0 if this iteration is done
+ */
+int next_rows(long my_rank, int *start, int *end)
+{
+	int chunk = cyclic_blocksize > 0 ? cyclic_blocksize : 1;
+	int first, size;
+
+	if (thread_mapping == BLOCK_STEALING) {
+		while (!pop_rows(my_rank, chunk, start, end)) {
+			if (!steal_rows(my_rank, chunk)) {
+				return 0;
+			}
+		}
+		return 1;
+	}
+
+	if (thread_mapping == BLOCK_GUIDED) {
+		first = atomic_load(&next_row);
+		do {
+			if (first >= matrix_dim) {
+				return 0;
+			}
+			size = (matrix_dim - first + thread_count - 1) / thread_count;
+			if (size < chunk) {
+				size = chunk;
+			}
+		} while (!atomic_compare_exchange_weak(&next_row, &first, first + size));
+	} else {
+		size = chunk;
+		first = atomic_fetch_add(&next_row, size);
+		if (first >= matrix_dim) {
+			return 0;
+		}
+	}
+	*start = first;
+	*end = (first + size > matrix_dim) ? matrix_dim : (first + size);
+	return 1;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  reset_rows
+ * Purpose:   Refill the row counter (rank 0) and this thread's deque with
+ *            the block-mapping rows for the next iteration. Must run while
+ *            no thread is taking rows.
+ * In arg:    my_rank -- rank of this thread
+ */
+void reset_rows(long my_rank)
+{
+	int block_size = ceil((double)matrix_dim/thread_count);
+	int start = my_rank * block_size;
+	if (my_rank == 0) {
+		atomic_store(&next_row, 0);
+	}
+	if (start > matrix_dim) {
+		start = matrix_dim;
+	}
+	pthread_mutex_lock(&row_deque[my_rank].lock);
+	row_deque[my_rank].head = start;
+	row_deque[my_rank].tail = (start + block_size > matrix_dim) ? matrix_dim : (start + block_size);
+	pthread_mutex_unlock(&row_deque[my_rank].lock);
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_scheduled
+ * Purpose:   Run t iterations of parallel computation:  {y=d+Ax; x=y}
+ *            with rows handed out at run time by next_rows, for
+ *            BLOCK_DYNAMIC, BLOCK_GUIDED and BLOCK_STEALING.
+ *            Since a thread does not know in advance which rows it gets, it
+ *            tracks the error of each row as it computes it. Rows are handed
+ *            out again between the two barriers, when nobody is taking any,
+ *            and x is copied back under block mapping.
+ * In arg:
+ *            my_rank: rank of this thread (counted from 0)
+ * Global in vars:
+ *            int thread_mapping:  which of the three schedules to use
+ *            int cyclic_blocksize:  chunk size (minimum chunk for guided)
+ *            and those of work_block
+ * Global in/out vars:
+ *            double vector_x[]:  vector x
+ * Global out vars:
+ *            double vector_y[]:  vector y
+ */
+void work_scheduled(long my_rank)
+{
+	int block_size = ceil((double)matrix_dim/thread_count);
+	int copy_start = my_rank * block_size;
+	int copy_end = ((copy_start + block_size) > matrix_dim) ? matrix_dim : (copy_start + block_size);
+	int k = 0, i, start, end;
+	double local_error, wait_start, compute_start;
+	TRACE_VAR(phase_start);
+
+	thread_stats_reset(my_rank);
+	pthread_mutex_init(&row_deque[my_rank].lock, NULL);
+	reset_rows(my_rank);
+	cs140barrier_wait(&mybarrier);
+
+	while (k < no_iterations) {
+		/* The error is tracked row by row, so it is part of compute. */
+		compute_start = wall_time();
+		local_error = 0;
+		while (next_rows(my_rank, &start, &end)) {
+			mv_rows(start, end, vector_x, vector_y);
+			local_error = fmax(local_error, row_error(start, end));
+			thread_rows[my_rank] += end - start;
+			thread_flops[my_rank] += row_flops(start, end);
+		}
+		thread_error[k & 1][my_rank] = local_error;
+		thread_compute_time[my_rank] += wall_time() - compute_start;
+		TRACE_SPAN(my_rank, TRACE_COMPUTE, k, compute_start);
+		wait_start = wall_time();
+		cs140barrier_wait(&mybarrier);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+		TRACE_SPAN(my_rank, TRACE_WAIT, k, wait_start);
+		TRACE_MARK(phase_start);
+		reset_rows(my_rank);
+		for (i = copy_start; i < copy_end; i++) {
+			vector_x[i] = vector_y[i];
+		}
+		TRACE_SPAN(my_rank, TRACE_COPY, k, phase_start);
+		wait_start = wall_time();
+		cs140barrier_wait(&mybarrier);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+		TRACE_SPAN(my_rank, TRACE_WAIT, k, wait_start);
+		if (global_error(k & 1) < ERROR_THRESHOLD) {
+			break;
+		}
+		k++;
+	}
+	if (my_rank == 0) {
+		iterations_done = (k < no_iterations) ? k + 1 : k;
+	}
+
+	cs140barrier_wait(&mybarrier);
+	pthread_mutex_destroy(&row_deque[my_rank].lock);
+}
+
+/*---------------------------------------------------------------------
+ * Function:  dataflow_ready
+ * Purpose:   Spin until blocks [lo, *cursor) have all published at least
+ *            iteration need, moving *cursor down as they do. The cursor
+ *            lets a thread that visits its blocks from high to low scan
+ *            each block at most once per iteration.
+ * In args:   lo -- lowest block index required
+ *            need -- iteration the blocks must have reached
+ * In/out:    cursor -- blocks at or above *cursor are known to be ready
+ *            wait -- seconds spent spinning are added here
+ * Return:    1 if ready, 0 if the run stopped while waiting
+ */
+int dataflow_ready(int lo, int need, int *cursor, double *wait)
+{
+	double wait_start;
+	while (*cursor > lo) {
+		if (atomic_load(&block_version[*cursor - 1]) < need) {
+			wait_start = wall_time();
+			while (atomic_load(&block_version[*cursor - 1]) < need) {
+				if (atomic_load(&stop_iteration) < need + 1) {
+					*wait += wall_time() - wait_start;
+					return 0;
+				}
+				sched_yield();
+			}
+			*wait += wall_time() - wait_start;
+		}
+		(*cursor)--;
+	}
+	return 1;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  dataflow_prefix_ready
+ * Purpose:   Same as dataflow_ready for blocks [*cursor, hi), moving
+ *            *cursor up.
+ */
+int dataflow_prefix_ready(int hi, int need, int *cursor, double *wait)
+{
+	double wait_start;
+	while (*cursor < hi) {
+		if (atomic_load(&block_version[*cursor]) < need) {
+			wait_start = wall_time();
+			while (atomic_load(&block_version[*cursor]) < need) {
+				if (atomic_load(&stop_iteration) < need + 1) {
+					*wait += wall_time() - wait_start;
+					return 0;
+				}
+				sched_yield();
+			}
+			*wait += wall_time() - wait_start;
+		}
+		(*cursor)++;
+	}
+	return 1;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_dataflow
+ * Purpose:   Run t iterations of parallel computation:  {y=d+Ax; x=y}
+ *            without global barriers. Rows are split into blocks of
+ *            cyclic_blocksize owned block-cyclically. Iterate c of block b
+ *            is computed as soon as the blocks it depends on are published:
+ *
+ *              - blocks it reads must hold iterate c-1 (all blocks for a
+ *                regular matrix, blocks >= b for UPPER_TRIANGULAR);
+ *              - blocks that read b must be done with the iterate being
+ *                overwritten.
+ *
+ *            Iterates rotate through three buffers (vector_x, vector_y and
+ *            one scratch vector), so writing iterate c overwrites c-3 and
+ *            only has to wait for readers of b to reach c-2. For an upper
+ *            triangular A this lets low blocks trail high blocks by an
+ *            iteration instead of lining up at a barrier.
+ *
+ *            Each block counts itself in converged_count[c] when within
+ *            threshold; the block completing the count sets stop_iteration
+ *            before publishing, so no thread can start an iterate that
+ *            would overwrite the converged one. The result is copied into
+ *            vector_y (and vector_x) at the end.
+ * In arg:
+ *            my_rank: rank of this thread (counted from 0)
+ * Global in vars:
+ *            int cyclic_blocksize:  rows per dataflow block
+ *            and those of work_blockcyclic
+ * Global in/out vars:
+ *            double vector_x[]:  vector x
+ * Global out vars:
+ *            double vector_y[]:  vector y
+ */
+void work_dataflow(long my_rank)
+{
+	int block_size = cyclic_blocksize > 0 ? cyclic_blocksize : 1;
+	int no_blocks = (matrix_dim + block_size - 1) / block_size;
+	int last_owned = (my_rank < no_blocks) ?
+		no_blocks - 1 - (no_blocks - 1 - my_rank) % thread_count : -1;
+	int b, c, i, start, end, suffix, prefix, stop;
+	double *x, *y, local_error;
+
+	thread_stats_reset(my_rank);
+	if (my_rank == 0) {
+		block_version = malloc(no_blocks * sizeof(atomic_int));
+		converged_count = malloc((no_iterations + 1) * sizeof(atomic_int));
+		for (b = 0; b < no_blocks; b++) {
+			atomic_init(&block_version[b], 0);
+		}
+		for (c = 0; c <= no_iterations; c++) {
+			atomic_init(&converged_count[c], 0);
+		}
+		atomic_init(&stop_iteration, no_iterations);
+		dataflow_buf[0] = vector_x;
+		dataflow_buf[1] = vector_y;
+		dataflow_buf[2] = malloc(matrix_dim * sizeof(double));
+	}
+	cs140barrier_wait(&mybarrier);
+
+	for (c = 1; c <= atomic_load(&stop_iteration); c++) {
+		x = dataflow_buf[(c - 1) % 3];
+		y = dataflow_buf[c % 3];
+		suffix = no_blocks;
+		prefix = 0;
+		/* High blocks first: their rows are shortest when A is upper
+		 * triangular, and the lower blocks of every thread wait on them. */
+		for (b = last_owned; b >= 0; b -= thread_count) {
+			if (matrix_type == UPPER_TRIANGULAR) {
+				if (!dataflow_ready(b, c - 1, &suffix, &sync_wait_time[my_rank]) ||
+					!dataflow_prefix_ready(b, c - 2, &prefix, &sync_wait_time[my_rank]))
+					break;
+			} else if (!dataflow_ready(0, c - 1, &suffix, &sync_wait_time[my_rank])) {
+				break;
+			}
+			if (c > atomic_load(&stop_iteration)) {
+				break;
+			}
+			start = b * block_size;
+			end = (start + block_size > matrix_dim) ? matrix_dim : (start + block_size);
+			mv_rows(start, end, x, y);
+			local_error = 0;
+			for (i = start; i < end; i++) {
+				local_error = fmax(local_error, fabs(y[i] - x[i]));
+			}
+			if (local_error < ERROR_THRESHOLD &&
+				atomic_fetch_add(&converged_count[c], 1) + 1 == no_blocks) {
+				stop = atomic_load(&stop_iteration);
+				while (c < stop &&
+					   !atomic_compare_exchange_weak(&stop_iteration, &stop, c))
+					;
+			}
+			atomic_store(&block_version[b], c);
+		}
+		if (b >= 0) {
+			break;
+		}
+	}
+
+	cs140barrier_wait(&mybarrier);
+	stop = atomic_load(&stop_iteration);
+	if (my_rank == 0) {
+		iterations_done = stop;
+	}
+	x = dataflow_buf[stop % 3];
+	for (b = last_owned; b >= 0; b -= thread_count) {
+		start = b * block_size;
+		end = (start + block_size > matrix_dim) ? matrix_dim : (start + block_size);
+		for (i = start; i < end; i++) {
+			vector_x[i] = x[i];
+			vector_y[i] = x[i];
+		}
+	}
+	cs140barrier_wait(&mybarrier);
+	if (my_rank == 0) {
+		free(dataflow_buf[2]);
+		free((void *)block_version);
+		free((void *)converged_count);
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  async_row
+ * Purpose:   Return d[i]+A[i]x reading x with relaxed atomic loads, since
+ *            other threads may be storing to it at the same time.
+ * In arg:    i -- row index
+ */
+double async_row(int i)
+{
+	int j, first, last;
+	long base, stride;
+	double tmp_y = vector_d[i], xj;
+	row_span(i, &first, &last, &base, &stride);
+	for (j = first; j < last; j++) {
+		__atomic_load(&vector_x[j], &xj, __ATOMIC_RELAXED);
+		tmp_y += matrix_A[base + j * stride] * xj;
+	}
+	return tmp_y;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  async_set_converged
+ * Purpose:   Update this thread's convergence flag and the shared count,
+ *            raising async_done when every thread is converged.
+ * In args:   my_rank -- rank of this thread
+ *            converged -- the new flag value
+ */
+void async_set_converged(long my_rank, int converged)
+{
+	if (converged == async_converged[my_rank]) {
+		return;
+	}
+	async_converged[my_rank] = converged;
+	if (!converged) {
+		atomic_fetch_sub(&converged_threads, 1);
+	} else if (atomic_fetch_add(&converged_threads, 1) + 1 == thread_count) {
+		atomic_store(&async_done, 1);
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_async
+ * Purpose:   Asynchronous (chaotic) Jacobi: each thread keeps sweeping its
+ *            block-mapping rows, updating x in place from whatever values
+ *            of x the other threads have stored so far, with no barrier
+ *            between sweeps. This converges for contractive A such as the
+ *            test matrices, where the spectral radius of |A| is below 1.
+ *
+ *            Termination: a thread whose sweep changed none of its rows by
+ *            more than the threshold counts itself converged, and uncounts
+ *            itself if a later sweep does. When all threads count as
+ *            converged, everyone stops and one synchronous step y=d+Ax is
+ *            taken between barriers. That step both produces vector_y and
+ *            checks the detection: if max|y-x| is still above the
+ *            threshold (a thread was disturbed after counting itself),
+ *            the asynchronous sweeps resume from x=y.
+ *
+ *            Each thread does at most no_iterations sweeps, counting the
+ *            synchronous steps; the run ends once any thread has used
+ *            them up.
+ * In arg:
+ *            my_rank: rank of this thread (counted from 0)
+ * Global in vars:
+ *            and those of work_block
+ * Global in/out vars:
+ *            double vector_x[]:  vector x
+ * Global out vars:
+ *            double vector_y[]:  vector y
+ */
+void work_async(long my_rank)
+{
+	int block_size = ceil((double)matrix_dim/thread_count);
+	int start = my_rank * block_size;
+	int end = ((start + block_size) > matrix_dim) ? matrix_dim : (start + block_size);
+	int i, k = 0, r, round = 0, exhausted;
+	double change, value, wait_start;
+
+	thread_stats_reset(my_rank);
+	async_converged[my_rank] = 0;
+	if (my_rank == 0) {
+		atomic_store(&converged_threads, 0);
+		atomic_store(&async_done, 0);
+	}
+	cs140barrier_wait(&mybarrier);
+
+	while (1) {
+		while (k < no_iterations - 1 && !atomic_load(&async_done)) {
+			change = 0;
+			for (i = start; i < end; i++) {
+				value = async_row(i);
+				change = fmax(change, fabs(value - vector_x[i]));
+				__atomic_store(&vector_x[i], &value, __ATOMIC_RELAXED);
+			}
+			k++;
+			async_set_converged(my_rank, change < ERROR_THRESHOLD);
+			if (change < ERROR_THRESHOLD) {
+				/* Nothing new to read yet; let a descheduled thread
+				 * run on an oversubscribed core. */
+				sched_yield();
+			}
+		}
+		if (k >= no_iterations - 1) {
+			/* Out of sweeps: stop holding the others up. */
+			async_set_converged(my_rank, 1);
+		}
+		async_sweeps[round & 1][my_rank] = k;
+
+		wait_start = wall_time();
+		cs140barrier_wait(&mybarrier);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+
+		mv_rows(start, end, vector_x, vector_y);
+		k++;
+		thread_error[round & 1][my_rank] = row_error(start, end);
+		async_converged[my_rank] = 0;
+		if (my_rank == 0) {
+			atomic_store(&converged_threads, 0);
+			atomic_store(&async_done, 0);
+		}
+
+		wait_start = wall_time();
+		cs140barrier_wait(&mybarrier);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+
+		exhausted = 0;
+		for (r = 0; r < thread_count; r++) {
+			if (async_sweeps[round & 1][r] >= no_iterations - 1) {
+				exhausted = 1;
+			}
+		}
+		if (global_error(round & 1) < ERROR_THRESHOLD || exhausted) {
+			break;
+		}
+		for (i = start; i < end; i++) {
+			__atomic_store(&vector_x[i], &vector_y[i], __ATOMIC_RELAXED);
+		}
+		round++;
+	}
+
+	async_sweeps[(round + 1) & 1][my_rank] = k;
+	cs140barrier_wait(&mybarrier);
+	if (my_rank == 0) {
+		iterations_done = 0;
+		for (r = 0; r < thread_count; r++) {
+			if (async_sweeps[(round + 1) & 1][r] > iterations_done) {
+				iterations_done = async_sweeps[(round + 1) & 1][r];
+			}
+		}
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  gs_row
+ * Purpose:   Return d[i]+A[i]z for a row of color c in a multi-color
+ *            Gauss-Seidel sweep, where z[j] is vector_x[j] (the value from
+ *            the previous sweep) for rows j of the same color and
+ *            vector_y[j] (the newest value) for every other row.
+ *            Rows of one color never read each other's new values, so a
+ *            color can be updated in parallel.
+ * In args:   i -- row index
+ *            c -- color of row i
+ *            colors -- number of colors; row j has color j % colors
+ */
+double gs_row(int i, int c, int colors)
+{
+	int j, cj, first, last;
+	long base, stride;
+	double tmp_y = vector_d[i];
+	double *z;
+	row_span(i, &first, &last, &base, &stride);
+	for (j = first, cj = first % colors; j < last; j++) {
+		z = (cj == c) ? vector_x : vector_y;
+		tmp_y += matrix_A[base + j * stride] * z[j];
+		if (++cj == colors) {
+			cj = 0;
+		}
+	}
+	return tmp_y;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_gs_colored
+ * Purpose:   Gauss-Seidel/SOR for a general A with multi-color ordering
+ *            (red-black when color_count is 2). Row i has color
+ *            i % color_count; a sweep updates the colors one after the
+ *            other, each color from the newest values of the others, with
+ *            a barrier between colors. Rows are block mapped.
+ *
+ *            vector_y always holds the newest value of every row. New
+ *            values of color c are written to vector_y only, while
+ *            vector_x keeps the previous sweep's values that rows of the
+ *            same color read. After the barrier ending color c nobody
+ *            reads vector_x for color c until the next sweep, so each
+ *            thread brings its rows of color c up to date in vector_x
+ *            then, overlapped with color c+1.
+ *
+ *            Each row moves to (1-w)*old + w*(d[i]+A[i]z), w=relax_omega.
+ * In arg:
+ *            my_rank: rank of this thread (counted from 0)
+ * Global in vars:
+ *            int color_count:  colors of the ordering, at least 2
+ *            double relax_omega:  relaxation factor
+ *            and those of work_block
+ * Global in/out vars:
+ *            double vector_x[]:  vector x
+ * Global out vars:
+ *            double vector_y[]:  vector y
+ */
+void work_gs_colored(long my_rank)
+{
+	int block_size = ceil((double)matrix_dim/thread_count);
+	int start = my_rank * block_size;
+	int end = ((start + block_size) > matrix_dim) ? matrix_dim : (start + block_size);
+	int colors = (color_count > 2) ? color_count : 2;
+	int c, i, k = 0;
+	double local_error, value, wait_start;
+
+	thread_stats_reset(my_rank);
+	for (i = start; i < end; i++) {
+		vector_y[i] = vector_x[i];
+	}
+	cs140barrier_wait(&mybarrier);
+	while (k < no_iterations) {
+		local_error = 0;
+		for (c = 0; c < colors; c++) {
+			for (i = start + (c - start % colors + colors) % colors; i < end;
+				 i += colors) {
+				value = (1 - relax_omega) * vector_x[i] +
+					relax_omega * gs_row(i, c, colors);
+				local_error = fmax(local_error, fabs(value - vector_x[i]));
+				vector_y[i] = value;
+			}
+			if (c == colors - 1) {
+				thread_error[k & 1][my_rank] = local_error;
+			}
+			wait_start = wall_time();
+			cs140barrier_wait(&mybarrier);
+			sync_wait_time[my_rank] += wall_time() - wait_start;
+			for (i = start + (c - start % colors + colors) % colors; i < end;
+				 i += colors) {
+				vector_x[i] = vector_y[i];
+			}
+		}
+		if (global_error(k & 1) < ERROR_THRESHOLD) {
+			break;
+		}
+		k++;
+	}
+	if (my_rank == 0) {
+		iterations_done = (k < no_iterations) ? k + 1 : k;
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_gs_wavefront
+ * Purpose:   Gauss-Seidel/SOR for an UPPER_TRIANGULAR A. Rows are swept
+ *            from n-1 down to 0, so a sweep is a back substitution: row i
+ *            needs the new values of all rows j > i.
+ *
+ *            Rows are split into blocks of cyclic_blocksize owned block
+ *            cyclically. A thread visits its blocks from high to low and
+ *            accumulates the contribution of each higher block into
+ *            vector_y as soon as that block's owner publishes it in
+ *            block_version, then solves its own block and publishes it.
+ *            So while block b is being solved, the owners of all lower
+ *            blocks are already adding in blocks above b: the sweep moves
+ *            down the matrix as a wavefront instead of one row at a time.
+ *
+ *            x is updated in place. Sweeps are separated by a barrier,
+ *            which also combines the convergence check as in work_block.
+ * In arg:
+ *            my_rank: rank of this thread (counted from 0)
+ * Global in vars:
+ *            int cyclic_blocksize:  rows per wavefront block
+ *            double relax_omega:  relaxation factor
+ *            and those of work_block
+ * Global in/out vars:
+ *            double vector_x[]:  vector x
+ * Global out vars:
+ *            double vector_y[]:  vector y
+ */
+void work_gs_wavefront(long my_rank)
+{
+	int block_size = cyclic_blocksize > 0 ? cyclic_blocksize :
+		(int)ceil((double)matrix_dim/thread_count);
+	int no_blocks = (matrix_dim + block_size - 1) / block_size;
+	int last_owned = (my_rank < no_blocks) ?
+		no_blocks - 1 - (no_blocks - 1 - my_rank) % thread_count : -1;
+	int b, i, j, jb, k = 0, start, end, jend, cursor;
+	double local_error, value, wait_start;
+
+	thread_stats_reset(my_rank);
+	if (my_rank == 0) {
+		block_version = malloc(no_blocks * sizeof(atomic_int));
+		for (b = 0; b < no_blocks; b++) {
+			atomic_init(&block_version[b], 0);
+		}
+		/* dataflow_ready gives up waiting only past stop_iteration. */
+		atomic_init(&stop_iteration, no_iterations + 1);
+	}
+	cs140barrier_wait(&mybarrier);
+
+	while (k < no_iterations) {
+		local_error = 0;
+		cursor = no_blocks;
+		for (b = last_owned; b >= 0; b -= thread_count) {
+			start = b * block_size;
+			end = (start + block_size > matrix_dim) ? matrix_dim : (start + block_size);
+			for (i = start; i < end; i++) {
+				vector_y[i] = vector_d[i];
+			}
+			for (jb = no_blocks - 1; jb > b; jb--) {
+				dataflow_ready(jb, k + 1, &cursor, &sync_wait_time[my_rank]);
+				jend = (jb + 1) * block_size > matrix_dim ?
+					matrix_dim : (jb + 1) * block_size;
+				for (i = start; i < end; i++) {
+					value = 0;
+					for (j = jb * block_size; j < jend; j++) {
+						value += matrix_A[i * matrix_dim + j] * vector_x[j];
+					}
+					vector_y[i] += value;
+				}
+			}
+			for (i = end - 1; i >= start; i--) {
+				value = vector_y[i];
+				for (j = i; j < end; j++) {
+					value += matrix_A[i * matrix_dim + j] * vector_x[j];
+				}
+				value = (1 - relax_omega) * vector_x[i] + relax_omega * value;
+				local_error = fmax(local_error, fabs(value - vector_x[i]));
+				vector_x[i] = value;
+				vector_y[i] = value;
+			}
+			atomic_store(&block_version[b], k + 1);
+		}
+		thread_error[k & 1][my_rank] = local_error;
+		wait_start = wall_time();
+		cs140barrier_wait(&mybarrier);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+		if (global_error(k & 1) < ERROR_THRESHOLD) {
+			break;
+		}
+		k++;
+	}
+
+	if (my_rank == 0) {
+		iterations_done = (k < no_iterations) ? k + 1 : k;
+	}
+	cs140barrier_wait(&mybarrier);
+	if (my_rank == 0) {
+		free((void *)block_version);
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_gauss_seidel
+ * Purpose:   Run up to t Gauss-Seidel (relax_omega = 1) or SOR sweeps
+ *            x_i = (1-w)x_i + w(d_i + A_i x) in place, stopping at the
+ *            same threshold as the Jacobi drivers. vector_y holds the
+ *            final x. Uses the wavefront schedule for an upper triangular
+ *            A and multi-color ordering otherwise.
+ * In arg:
+ *            my_rank: rank of this thread (counted from 0)
+ */
+void work_gauss_seidel(long my_rank)
+{
+	if (matrix_type == UPPER_TRIANGULAR) {
+		work_gs_wavefront(my_rank);
+	} else {
+		work_gs_colored(my_rank);
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  a_row
+ * Purpose:   Return A[i]v, skipping the zero part of an upper triangular A.
+ * In args:   i -- row index
+ *            v -- the vector to multiply with
+ */
+double a_row(int i, double v[])
+{
+	int j, first, last;
+	long base, stride;
+	double tmp = 0;
+	row_span(i, &first, &last, &base, &stride);
+	for (j = first; j < last; j++) {
+		tmp += matrix_A[base + j * stride] * v[j];
+	}
+	return tmp;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  krylov_apply
+ * Purpose:   out = (I-A)in for rows start <= i < end. Every row of in must
+ *            be final, i.e. a barrier separates this from writes to in.
+ */
+void krylov_apply(double out[], double in[], int start, int end)
+{
+	for (int i = start; i < end; i++) {
+		out[i] = in[i] - a_row(i, in);
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  local_dot
+ * Purpose:   Return this thread's share a[start:end].b[start:end] of a dot
+ *            product.
+ */
+double local_dot(double a[], double b[], int start, int end)
+{
+	double sum = 0;
+	for (int i = start; i < end; i++) {
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  local_max
+ * Purpose:   Return max |a[i]| for start <= i < end.
+ */
+double local_max(double a[], int start, int end)
+{
+	double m = 0;
+	for (int i = start; i < end; i++) {
+		m = fmax(m, fabs(a[i]));
+	}
+	return m;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  krylov_allreduce
+ * Purpose:   Combine count values across all threads: val[v] is summed for
+ *            v < max_from and maxed for v >= max_from. Every thread adds
+ *            the shares up in rank order, so all threads get bit-identical
+ *            results and take the same branches afterwards. Also acts as a
+ *            barrier.
+ * In args:   my_rank -- rank of this thread
+ *            count, max_from -- as above, count <= KRYLOV_RESTART + 2
+ * In/out:    parity -- this thread's reduction counter & 1
+ *            val -- this thread's shares in, the combined values out
+ */
+void krylov_allreduce(long my_rank, int *parity, double val[], int count,
+					  int max_from)
+{
+	int r, v;
+	double wait_start;
+
+	for (v = 0; v < count; v++) {
+		krylov_partial[*parity][my_rank][v] = val[v];
+	}
+	wait_start = wall_time();
+	cs140barrier_wait(&mybarrier);
+	sync_wait_time[my_rank] += wall_time() - wait_start;
+	for (v = 0; v < count; v++) {
+		val[v] = (v < max_from) ? 0 : krylov_partial[*parity][0][v];
+		for (r = 0; r < thread_count; r++) {
+			if (v < max_from) {
+				val[v] += krylov_partial[*parity][r][v];
+			} else {
+				val[v] = fmax(val[v], krylov_partial[*parity][r][v]);
+			}
+		}
+	}
+	*parity ^= 1;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  krylov_barrier
+ * Purpose:   cs140barrier_wait, counting the time as synchronization wait.
+ */
+void krylov_barrier(long my_rank)
+{
+	double wait_start = wall_time();
+	cs140barrier_wait(&mybarrier);
+	sync_wait_time[my_rank] += wall_time() - wait_start;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  krylov_choose
+ * Purpose:   Pick a method for KRYLOV_AUTO from a quick look at A:
+ *            CG if A is symmetric and a few power iterations put the
+ *            spectral radius of A below 1, so I-A is positive definite;
+ *            otherwise BiCGStab if that estimate is below
+ *            KRYLOV_BICGSTAB_RHO, where the spectrum of I-A stays well
+ *            away from 0 and the short recurrence is cheapest; otherwise
+ *            restarted GMRES, the most robust of the three.
+ * In arg:    my_rank, start, end -- this thread and its rows
+ * In/out:    parity -- as krylov_allreduce
+ * Return:    KRYLOV_CG, KRYLOV_BICGSTAB or KRYLOV_GMRES, the same on all
+ *            threads
+ */
+int krylov_choose(long my_rank, int start, int end, int *parity)
+{
+	double *u = krylov_vec, *w = krylov_vec + matrix_dim, *tmp;
+	double val[2], rho = 0, asym = 0;
+	int i, j, step;
+
+	if (matrix_type == BANDED) {
+		for (i = start; i < end; i++) {
+			for (j = i + 1; j < matrix_dim && j <= i + band_lower + band_upper; j++) {
+				asym = fmax(asym, fabs(itmv_band_entry(matrix_A, matrix_dim, band_lower, band_upper, i, j) -
+									   itmv_band_entry(matrix_A, matrix_dim, band_lower, band_upper, j, i)));
+			}
+		}
+	} else if (matrix_type != UPPER_TRIANGULAR) {
+		for (i = start; i < end; i++) {
+			for (j = i + 1; j < matrix_dim; j++) {
+				asym = fmax(asym, fabs(matrix_A[i * matrix_dim + j] -
+									   matrix_A[j * matrix_dim + i]));
+			}
+		}
+	} else {
+		asym = 1;
+	}
+	for (i = start; i < end; i++) {
+		u[i] = 1 + i % 7;
+	}
+	for (step = 0; step < KRYLOV_POWER_STEPS; step++) {
+		krylov_barrier(my_rank);
+		for (i = start; i < end; i++) {
+			w[i] = a_row(i, u);
+		}
+		val[0] = local_dot(w, w, start, end);
+		val[1] = local_dot(u, u, start, end);
+		krylov_allreduce(my_rank, parity, val, 2, 2);
+		rho = (val[1] > 0) ? sqrt(val[0] / val[1]) : 0;
+		for (i = start; i < end; i++) {
+			w[i] = (val[0] > 0) ? w[i] / sqrt(val[0]) : 0;
+		}
+		tmp = u;
+		u = w;
+		w = tmp;
+	}
+	val[0] = asym;
+	krylov_allreduce(my_rank, parity, val, 1, 0);
+	if (val[0] == 0 && rho < 1) {
+		return KRYLOV_CG;
+	}
+	return (rho < KRYLOV_BICGSTAB_RHO) ? KRYLOV_BICGSTAB : KRYLOV_GMRES;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  krylov_cg
+ * Purpose:   Conjugate gradients on (I-A)x = d. Needs I-A symmetric
+ *            positive definite.
+ * In args:   my_rank, start, end -- this thread and its rows
+ * In/out:    parity -- as krylov_allreduce
+ * Return:    the number of products with I-A done
+ */
+int krylov_cg(long my_rank, int start, int end, int *parity)
+{
+	double *x = vector_x, *r = krylov_vec, *p = r + matrix_dim,
+		*q = p + matrix_dim;
+	double val[2], rr, alpha, beta;
+	int i, k = 0;
+
+	krylov_apply(q, x, start, end);
+	for (i = start; i < end; i++) {
+		r[i] = vector_d[i] - q[i];
+		p[i] = r[i];
+	}
+	val[0] = local_dot(r, r, start, end);
+	val[1] = local_max(r, start, end);
+	krylov_allreduce(my_rank, parity, val, 2, 1);
+	k++;
+	rr = val[0];
+	while (val[1] >= ERROR_THRESHOLD && k < no_iterations) {
+		krylov_apply(q, p, start, end);
+		k++;
+		val[0] = local_dot(p, q, start, end);
+		krylov_allreduce(my_rank, parity, val, 1, 1);
+		alpha = rr / val[0];
+		for (i = start; i < end; i++) {
+			x[i] += alpha * p[i];
+			r[i] -= alpha * q[i];
+		}
+		val[0] = local_dot(r, r, start, end);
+		val[1] = local_max(r, start, end);
+		krylov_allreduce(my_rank, parity, val, 2, 1);
+		beta = val[0] / rr;
+		rr = val[0];
+		for (i = start; i < end; i++) {
+			p[i] = r[i] + beta * p[i];
+		}
+		krylov_barrier(my_rank);
+	}
+	return k;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  krylov_bicgstab
+ * Purpose:   BiCGStab on (I-A)x = d, for a general A. Two products with
+ *            I-A per iteration.
+ * In args:   my_rank, start, end -- this thread and its rows
+ * In/out:    parity -- as krylov_allreduce
+ * Return:    the number of products with I-A done
+ */
+int krylov_bicgstab(long my_rank, int start, int end, int *parity)
+{
+	double *x = vector_x, *r = krylov_vec, *rhat = r + matrix_dim,
+		*p = rhat + matrix_dim, *v = p + matrix_dim, *s = v + matrix_dim,
+		*t = s + matrix_dim;
+	double val[2], rho = 1, rho_new, alpha = 1, omega = 1, beta;
+	int i, k = 0;
+
+	krylov_apply(v, x, start, end);
+	for (i = start; i < end; i++) {
+		r[i] = vector_d[i] - v[i];
+		rhat[i] = r[i];
+		p[i] = 0;
+		v[i] = 0;
+	}
+	val[0] = local_dot(rhat, r, start, end);
+	val[1] = local_max(r, start, end);
+	krylov_allreduce(my_rank, parity, val, 2, 1);
+	k++;
+	while (val[1] >= ERROR_THRESHOLD && k < no_iterations) {
+		rho_new = val[0];
+		beta = (rho_new / rho) * (alpha / omega);
+		rho = rho_new;
+		for (i = start; i < end; i++) {
+			p[i] = r[i] + beta * (p[i] - omega * v[i]);
+		}
+		krylov_barrier(my_rank);
+		krylov_apply(v, p, start, end);
+		k++;
+		val[0] = local_dot(rhat, v, start, end);
+		krylov_allreduce(my_rank, parity, val, 1, 1);
+		alpha = rho / val[0];
+		for (i = start; i < end; i++) {
+			s[i] = r[i] - alpha * v[i];
+		}
+		val[0] = local_max(s, start, end);
+		krylov_allreduce(my_rank, parity, val, 1, 0);
+		if (val[0] < ERROR_THRESHOLD || k >= no_iterations) {
+			for (i = start; i < end; i++) {
+				x[i] += alpha * p[i];
+			}
+			break;
+		}
+		krylov_apply(t, s, start, end);
+		k++;
+		val[0] = local_dot(t, s, start, end);
+		val[1] = local_dot(t, t, start, end);
+		krylov_allreduce(my_rank, parity, val, 2, 2);
+		omega = val[0] / val[1];
+		for (i = start; i < end; i++) {
+			x[i] += alpha * p[i] + omega * s[i];
+			r[i] = s[i] - omega * t[i];
+		}
+		val[0] = local_dot(rhat, r, start, end);
+		val[1] = local_max(r, start, end);
+		krylov_allreduce(my_rank, parity, val, 2, 1);
+	}
+	return k;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  krylov_gmres
+ * Purpose:   GMRES(KRYLOV_RESTART) on (I-A)x = d, for a general A. The
+ *            basis is orthogonalized with classical Gram-Schmidt so each
+ *            step needs one reduction for all of its dot products. The
+ *            small least-squares problem is solved redundantly by every
+ *            thread with Givens rotations. Stops once the 2-norm of the
+ *            residual, which bounds its max norm, is below the threshold.
+ * In args:   my_rank, start, end -- this thread and its rows
+ * In/out:    parity -- as krylov_allreduce
+ * Return:    the number of products with I-A done
+ */
+int krylov_gmres(long my_rank, int start, int end, int *parity)
+{
+	int m = KRYLOV_RESTART;
+	double *x = vector_x, *basis = krylov_vec, *vj, *w;
+	double h[KRYLOV_RESTART + 1][KRYLOV_RESTART], g[KRYLOV_RESTART + 1];
+	double cs[KRYLOV_RESTART], sn[KRYLOV_RESTART], yk[KRYLOV_RESTART];
+	double val[KRYLOV_RESTART + 2], beta, tmp;
+	int i, j, l, k = 0, steps;
+
+	while (k < no_iterations) {
+		w = basis;
+		krylov_apply(w, x, start, end);
+		k++;
+		for (i = start; i < end; i++) {
+			w[i] = vector_d[i] - w[i];
+		}
+		val[0] = local_dot(w, w, start, end);
+		val[1] = local_max(w, start, end);
+		krylov_allreduce(my_rank, parity, val, 2, 1);
+		beta = sqrt(val[0]);
+		if (val[1] < ERROR_THRESHOLD) {
+			break;
+		}
+		for (i = start; i < end; i++) {
+			w[i] /= beta;
+		}
+		g[0] = beta;
+		steps = 0;
+		for (j = 0; j < m && k < no_iterations; j++) {
+			vj = basis + (long)j * matrix_dim;
+			w = vj + matrix_dim;
+			krylov_barrier(my_rank);
+			krylov_apply(w, vj, start, end);
+			k++;
+			for (l = 0; l <= j; l++) {
+				val[l] = local_dot(basis + (long)l * matrix_dim, w, start, end);
+			}
+			krylov_allreduce(my_rank, parity, val, j + 1, j + 1);
+			for (i = start; i < end; i++) {
+				for (l = 0; l <= j; l++) {
+					w[i] -= val[l] * basis[(long)l * matrix_dim + i];
+				}
+			}
+			for (l = 0; l <= j; l++) {
+				h[l][j] = val[l];
+			}
+			val[0] = local_dot(w, w, start, end);
+			krylov_allreduce(my_rank, parity, val, 1, 1);
+			h[j + 1][j] = sqrt(val[0]);
+			for (i = start; i < end; i++) {
+				w[i] = (h[j + 1][j] > 0) ? w[i] / h[j + 1][j] : 0;
+			}
+			for (l = 0; l < j; l++) {
+				tmp = cs[l] * h[l][j] + sn[l] * h[l + 1][j];
+				h[l + 1][j] = -sn[l] * h[l][j] + cs[l] * h[l + 1][j];
+				h[l][j] = tmp;
+			}
+			tmp = sqrt(h[j][j] * h[j][j] + h[j + 1][j] * h[j + 1][j]);
+			cs[j] = h[j][j] / tmp;
+			sn[j] = h[j + 1][j] / tmp;
+			h[j][j] = tmp;
+			g[j + 1] = -sn[j] * g[j];
+			g[j] = cs[j] * g[j];
+			steps = j + 1;
+			if (fabs(g[j + 1]) < ERROR_THRESHOLD || h[j + 1][j] == 0) {
+				break;
+			}
+		}
+		for (l = steps - 1; l >= 0; l--) {
+			yk[l] = g[l];
+			for (j = l + 1; j < steps; j++) {
+				yk[l] -= h[l][j] * yk[j];
+			}
+			yk[l] /= h[l][l];
+		}
+		for (i = start; i < end; i++) {
+			for (l = 0; l < steps; l++) {
+				x[i] += yk[l] * basis[(long)l * matrix_dim + i];
+			}
+		}
+		if (fabs(g[steps]) < ERROR_THRESHOLD) {
+			break;
+		}
+		krylov_barrier(my_rank);
+	}
+	return k;
+}
 
 /*---------------------------------------------------------------------
- * Function:            mv_compute
- * Purpose:             Compute  y[i]=d[i]+A[i]x for i-th element of vector y
- * In arg:              i -- row index
+ * Function:  krylov_alloc
+ * Purpose:   Replace krylov_vec with the work vectors method needs:
+ *            KRYLOV_RESTART+1 for GMRES, six for BiCGStab, three for CG
+ *            and two for krylov_choose (KRYLOV_AUTO). Rank 0 allocates
+ *            between two barriers, so no thread still reads the old
+ *            vectors and all see the new ones.
+ * In args:   my_rank, method
+ * Return:    1 if the vectors were allocated, 0 if not. Then run_error
+ *            is set and every thread gets 0.
+ */
+int krylov_alloc(long my_rank, int method)
+{
+	int count = (method == KRYLOV_GMRES) ? KRYLOV_RESTART + 1
+		: (method == KRYLOV_BICGSTAB) ? 6
+		: (method == KRYLOV_CG) ? 3 : 2;
+
+	cs140barrier_wait(&mybarrier);
+	if (my_rank == 0) {
+		free(krylov_vec);
+		krylov_vec = malloc(count * (long)matrix_dim * sizeof(double));
+		if (krylov_vec == NULL) {
+			run_error = "Failed Krylov work space allocation";
+			iterations_done = 0;
+		}
+	}
+	cs140barrier_wait(&mybarrier);
+	return krylov_vec != NULL;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_krylov
+ * Purpose:   Solve (I-A)x = d, the fixed point of y=d+Ax, with a Krylov
+ *            method instead of Jacobi iteration: CG, BiCGStab or
+ *            GMRES(KRYLOV_RESTART) as set by krylov_method, or chosen by
+ *            krylov_choose for KRYLOV_AUTO. Rows are block mapped as in
+ *            work_block for products with I-A, dot products and vector
+ *            updates; dot products are combined with krylov_allreduce.
+ *
+ *            Stops once max |d + Ax - x| is below the threshold, the
+ *            quantity the Jacobi drivers test, or after no_iterations
+ *            products with I-A, which iterations_done reports. The
+ *            solution is left in vector_x and vector_y.
+ * In arg:
+ *            my_rank: rank of this thread (counted from 0)
  * Global in vars:
- *        double matrix_A[]: 2D matrix A represented by a 1D array.
- *        double vector_d[]: vector d
- *        double vector_x[]: vector x
- *        matrix_type: matrix_type=0 means A is a regular matrix.
- *                     matrix_type=1 (UPPER_TRIANGULAR) means A is an upper
- *                     triangular matrix
- *        matrix_dim: the global  number of columns (same as the number of rows)
+ *            int krylov_method:  KRYLOV_AUTO, KRYLOV_CG, KRYLOV_BICGSTAB
+ *                                or KRYLOV_GMRES
+ *            and those of work_block
  * Global in/out vars:
- *        double vector_y[]: vector y
+ *            double vector_x[]:  vector x, the initial guess on entry
+ * Global out vars:
+ *            double vector_y[]:  vector y
+ *            int krylov_chosen:  the method used
+ *            char *run_error:    set if the work vectors cannot be
+ *                                allocated; x and y are then unchanged
  */
-void mv_compute(int i)
+void work_krylov(long my_rank)
 {
-	int j, col_start, k;
-	double tmp_y = vector_d[i];
-	if (matrix_type == UPPER_TRIANGULAR)
-	{
-		col_start = i;
+	int block_size = ceil((double)matrix_dim/thread_count);
+	int start = my_rank * block_size;
+	int end = ((start + block_size) > matrix_dim) ? matrix_dim : (start + block_size);
+	int i, k, method, parity = 0;
+
+	if (start > matrix_dim) {
+		start = matrix_dim;
 	}
-	else
-	{
-		col_start = 0;
+	thread_stats_reset(my_rank);
+
+	method = krylov_method;
+	if (method == KRYLOV_AUTO) {
+		if (!krylov_alloc(my_rank, KRYLOV_AUTO)) {
+			return;
+		}
+		method = krylov_choose(my_rank, start, end, &parity);
 	}
-	for (j = col_start; j < matrix_dim; j++)
-	{
-		tmp_y += matrix_A[i * matrix_dim + j] * vector_x[j];
+	if (!krylov_alloc(my_rank, method)) {
+		return;
+	}
+	if (method == KRYLOV_CG) {
+		k = krylov_cg(my_rank, start, end, &parity);
+	} else if (method == KRYLOV_BICGSTAB) {
+		k = krylov_bicgstab(my_rank, start, end, &parity);
+	} else {
+		k = krylov_gmres(my_rank, start, end, &parity);
+	}
+	for (i = start; i < end; i++) {
+		vector_y[i] = vector_x[i];
+	}
+
+	cs140barrier_wait(&mybarrier);
+	if (my_rank == 0) {
+		iterations_done = k;
+		krylov_chosen = method;
+		free(krylov_vec);
+		krylov_vec = NULL;
 	}
-	vector_y[i] = tmp_y;
 }
 
 /*---------------------------------------------------------------------
- * Function:  work_block
- * Purpose:   Run t iterations of parallel computation:  {y=d+Ax; x=y}
- *            based on block mapping. blocksize=ceil(matrix_dim/thread_count);
- *            For example, given 2 threads,
- *            Thread 0 should handle computation for Rows 0 and 1, and
- *            Thread 1 should handle computation for Rows 2 and 3.
+ * Function:  spectral_bounds
+ * Purpose:   Estimate the interval [lo, hi] holding the eigenvalues of A,
+ *            assumed real: KRYLOV_POWER_STEPS power iterations give the
+ *            eigenvalue of largest magnitude through its Rayleigh quotient,
+ *            and as many on A - lo*I give the one at the other end. The
+ *            interval is widened by ACCEL_BOUNDS_MARGIN of its width on
+ *            each side since power iteration approaches from inside.
+ * In args:   my_rank, start, end -- this thread and its rows
+ *            u, w -- two scratch vectors of matrix_dim
+ * In/out:    parity -- as krylov_allreduce
+ * Out args:  lo, hi -- the interval, the same on all threads
+ */
+void spectral_bounds(long my_rank, int start, int end, int *parity,
+					 double u[], double w[], double *lo, double *hi)
+{
+	double val[3], lambda[2] = {0, 0}, shift = 0, *tmp, width;
+	int i, pass, step;
+
+	for (pass = 0; pass < 2; pass++) {
+		for (i = start; i < end; i++) {
+			u[i] = 1 + i % 7;
+		}
+		for (step = 0; step < KRYLOV_POWER_STEPS; step++) {
+			krylov_barrier(my_rank);
+			for (i = start; i < end; i++) {
+				w[i] = a_row(i, u) - shift * u[i];
+			}
+			val[0] = local_dot(w, w, start, end);
+			val[1] = local_dot(u, u, start, end);
+			val[2] = local_dot(u, w, start, end);
+			krylov_allreduce(my_rank, parity, val, 3, 3);
+			lambda[pass] = (val[1] > 0) ? val[2] / val[1] + shift : shift;
+			for (i = start; i < end; i++) {
+				w[i] = (val[0] > 0) ? w[i] / sqrt(val[0]) : 0;
+			}
+			tmp = u;
+			u = w;
+			w = tmp;
+		}
+		shift = lambda[0];
+	}
+	*lo = fmin(lambda[0], lambda[1]);
+	*hi = fmax(lambda[0], lambda[1]);
+	width = *hi - *lo;
+	*lo -= ACCEL_BOUNDS_MARGIN * width;
+	*hi += ACCEL_BOUNDS_MARGIN * width;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_chebyshev
+ * Purpose:   Jacobi with Chebyshev semi-iteration, block mapped. If the
+ *            eigenvalues of A lie in [lo, hi] with hi < 1, the
+ *            extrapolated step z = g*(d+Ax) + (1-g)*x with
+ *            g = 2/(2-lo-hi) contracts by r = (hi-lo)/(2-lo-hi) and
+ *
+ *              x_k+1 = w_k+1 * (z_k - x_k-1) + x_k-1,
+ *              w_1 = 1, w_2 = 2/(2-r^2), w_k+1 = 1/(1 - r^2 w_k/4)
+ *
+ *            reduces the error as fast as the Chebyshev polynomial of
+ *            degree k allows. The bounds come from spectral_bounds; if
+ *            they reach 1 the plain x=y step is used.
+ *
+ *            Per iteration this only replaces the x=y copy of
+ *            work_block with the update above and one saved vector, so
+ *            the barriers and the convergence test on max|y-x| are
+ *            unchanged.
  * In arg:
  *            my_rank: rank of this thread (counted from 0)
  * Global in vars:
- *            thread_count
- *            double matrix_A[]:  2D matrix A represented by a 1D array.
- *            double vector_d[]: vector d
- *            int matrix_type:  matrix_type=0 means A is a regular matrix.
- *                              matrix_type=1 (UPPER_TRIANGULAR) means
- *                              A is an upper triangular matrix.
- *            int matrix_dim:  the global  number of columns
- *                             (same as the number of rows)
- *            int no_iteration:   the maximum number of iterations
+ *            and those of work_block
  * Global in/out vars:
  *            double vector_x[]:  vector x
  * Global out vars:
  *            double vector_y[]:  vector y
+ *            double accel_bounds[]:  the interval used
  */
-void work_block(long my_rank)
+void work_chebyshev(long my_rank)
 {
-	double local_error = __DBL_MAX__;
 	int block_size = ceil((double)matrix_dim/thread_count);
-	int k = 0;
 	int start = my_rank * block_size;
 	int end = ((start + block_size) > matrix_dim) ? matrix_dim : (start + block_size);
+	int i, k = 0, parity = 0, usable;
+	double lo, hi, gamma = 1, rho2 = 0, omega = 1, z, *x_prev, wait_start;
+	cs140barrier_token token;
+
+	if (start > matrix_dim) {
+		start = matrix_dim;
+	}
+	thread_stats_reset(my_rank);
+	if (my_rank == 0) {
+		accel_vec = malloc(3 * (long)matrix_dim * sizeof(double));
+	}
+	cs140barrier_wait(&mybarrier);
+	x_prev = accel_vec;
+	spectral_bounds(my_rank, start, end, &parity, accel_vec + matrix_dim,
+					accel_vec + 2 * (long)matrix_dim, &lo, &hi);
+	usable = hi < 1;
+	if (usable) {
+		gamma = 2 / (2 - lo - hi);
+		rho2 = (hi - lo) / (2 - lo - hi);
+		rho2 *= rho2;
+	}
+
 	while (k < no_iterations) {
-		int i = start;
-		while (i < end) {
-			mv_compute(i);
-			i++;
-		}
-		double temp_error = 0;
-		double glob_error = 0;
-		for (int p = 0; p < matrix_dim; p++) {
-			temp_error = fabs(vector_y[p] - vector_x[p]);	
-			if (temp_error > glob_error) {
-				glob_error = temp_error;
-			}
-		} 
-		local_error = glob_error;
-		k++;
-		if (local_error < ERROR_THRESHOLD) {
+		mv_rows(start, end, vector_x, vector_y);
+		token = cs140barrier_arrive(&mybarrier);
+		thread_error[k & 1][my_rank] = row_error(start, end);
+		wait_start = wall_time();
+		cs140barrier_wait_token(&mybarrier, token);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+		if (usable) {
+			omega = (k == 0) ? 1 : (k == 1) ? 2 / (2 - rho2) :
+				1 / (1 - rho2 * omega / 4);
+		}
+		for (i = start; i < end; i++) {
+			z = gamma * vector_y[i] + (1 - gamma) * vector_x[i];
+			z = (k == 0) ? z : omega * (z - x_prev[i]) + x_prev[i];
+			x_prev[i] = vector_x[i];
+			vector_x[i] = z;
+		}
+		wait_start = wall_time();
+		cs140barrier_wait(&mybarrier);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+		if (global_error(k & 1) < ERROR_THRESHOLD) {
 			break;
 		}
-		pthread_barrier_wait(&mybarrier);
-		for (int p = start; p < end; p++) {	
-			vector_x[p] = vector_y[p];
+		k++;
+	}
+
+	if (my_rank == 0) {
+		iterations_done = (k < no_iterations) ? k + 1 : k;
+		accel_bounds[0] = lo;
+		accel_bounds[1] = hi;
+	}
+	cs140barrier_wait(&mybarrier);
+	if (my_rank == 0) {
+		free(accel_vec);
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  solve_small
+ * Purpose:   Solve the m x m system M theta = b in place by Gaussian
+ *            elimination with partial pivoting. Rows of M are
+ *            ANDERSON_DEPTH_MAX apart.
+ * In/out:    M -- destroyed
+ *            b -- the right-hand side in, theta out
+ */
+void solve_small(double M[][ANDERSON_DEPTH_MAX], double b[], int m)
+{
+	int i, j, l, piv;
+	double f, tmp;
+
+	for (i = 0; i < m; i++) {
+		piv = i;
+		for (l = i + 1; l < m; l++) {
+			if (fabs(M[l][i]) > fabs(M[piv][i])) {
+				piv = l;
+			}
+		}
+		for (j = 0; j < m; j++) {
+			tmp = M[i][j];
+			M[i][j] = M[piv][j];
+			M[piv][j] = tmp;
+		}
+		tmp = b[i];
+		b[i] = b[piv];
+		b[piv] = tmp;
+		for (l = i + 1; l < m; l++) {
+			f = (M[i][i] != 0) ? M[l][i] / M[i][i] : 0;
+			for (j = i; j < m; j++) {
+				M[l][j] -= f * M[i][j];
+			}
+			b[l] -= f * b[i];
 		}
-		pthread_barrier_wait(&mybarrier);
+	}
+	for (i = m - 1; i >= 0; i--) {
+		for (j = i + 1; j < m; j++) {
+			b[i] -= M[i][j] * b[j];
+		}
+		b[i] = (M[i][i] != 0) ? b[i] / M[i][i] : 0;
 	}
 }
 
 /*---------------------------------------------------------------------
- * Function:  work_blockcyclic
- * Purpose:   Run t iterations of parallel computation:  {y=d+Ax; x=y}
- *            based on block cylic mapping
+ * Function:  work_anderson
+ * Purpose:   Jacobi with Anderson mixing of depth m = anderson_depth,
+ *            block mapped. With g(x) = d+Ax and f_k = g(x_k) - x_k, the
+ *            last m differences dF_i = f_i+1 - f_i and dG_i = g_i+1 - g_i
+ *            are kept, theta minimizes |f_k - dF theta| and
  *
+ *              x_k+1 = g(x_k) - dG theta.
+ *
+ *            Only the newest column of the Gram matrix dF^T dF changes
+ *            each iteration, so an iteration needs 2m dot products and
+ *            O(mn) vector work, all combined in the one krylov_allreduce
+ *            that, together with the thread errors, replaces the first
+ *            barrier of work_block. The small normal equations are solved
+ *            redundantly on every thread. The run stops on the same
+ *            max|y-x| test, with vector_y = g(x) as the result.
  * In arg:
- *            my_rank:         rank of this thread (counted from 0)
+ *            my_rank: rank of this thread (counted from 0)
  * Global in vars:
- *            int cyclic_blocksize:  basic block size used for
- *                                   block cylic mapping
- *            int thread_count: no of threads allocated
- *            double matrix_A[]:  2D matrix A represented by a 1D array.
- *            double vector_d[]:  vector d
- *            int matrix_type:  matrix_type=0 means A is a regular matrix.
- *                              matrix_type=1 (UPPER_TRIANGULAR) means
- *                              A is an upper triangular matrix
- *            int matrix_dim:  the global number of columns
- *                             (same as the number of rows)
- *            int no_iteration:   the maximum  number of iterations
+ *            int anderson_depth:  history depth, 1 to ANDERSON_DEPTH_MAX
+ *            and those of work_block
  * Global in/out vars:
  *            double vector_x[]:  vector x
  * Global out vars:
  *            double vector_y[]:  vector y
  */
-void work_blockcyclic(long my_rank) { 	
-	double local_error = __DBL_MAX__;
-	int k = 0, i = 0, start = 0;
+void work_anderson(long my_rank)
+{
+	int block_size = ceil((double)matrix_dim/thread_count);
+	int start = my_rank * block_size;
+	int end = ((start + block_size) > matrix_dim) ? matrix_dim : (start + block_size);
+	int m = (anderson_depth < 1) ? 1 :
+		(anderson_depth > ANDERSON_DEPTH_MAX) ? ANDERSON_DEPTH_MAX : anderson_depth;
+	int i, j, l, k = 0, parity = 0, cols = 0, slot = 0;
+	double gram[ANDERSON_DEPTH_MAX][ANDERSON_DEPTH_MAX];
+	double M[ANDERSON_DEPTH_MAX][ANDERSON_DEPTH_MAX];
+	double val[2 * ANDERSON_DEPTH_MAX + 1], theta[ANDERSON_DEPTH_MAX], f, reg;
+	double *f_prev, *g_prev, *dF, *dG;
+
+	if (start > matrix_dim) {
+		start = matrix_dim;
+	}
+	thread_stats_reset(my_rank);
+	if (my_rank == 0) {
+		accel_vec = malloc((2 * m + 2) * (long)matrix_dim * sizeof(double));
+	}
+	cs140barrier_wait(&mybarrier);
+	f_prev = accel_vec;
+	g_prev = f_prev + matrix_dim;
+	dF = g_prev + matrix_dim;
+	dG = dF + (long)m * matrix_dim;
 
 	while (k < no_iterations) {
-		start = my_rank * cyclic_blocksize;
-		while (start < matrix_dim) {
-			i = start;
-			while (i < start + cyclic_blocksize && i < matrix_dim) {
-				mv_compute(i);
-				i++;
+		mv_rows(start, end, vector_x, vector_y);
+		/* The new column goes in slot; its dot products with every kept
+		 * column of dF and with f_k are reduced together with the error. */
+		if (k > 0) {
+			for (i = start; i < end; i++) {
+				f = vector_y[i] - vector_x[i];
+				dF[(long)slot * matrix_dim + i] = f - f_prev[i];
+				dG[(long)slot * matrix_dim + i] = vector_y[i] - g_prev[i];
+			}
+			cols = (cols < m) ? cols + 1 : m;
+		}
+		for (j = 0; j < cols; j++) {
+			val[j] = local_dot(dF + (long)j * matrix_dim,
+							   dF + (long)slot * matrix_dim, start, end);
+			val[cols + j] = 0;
+			for (i = start; i < end; i++) {
+				val[cols + j] += dF[(long)j * matrix_dim + i] *
+					(vector_y[i] - vector_x[i]);
+			}
+		}
+		val[2 * cols] = row_error(start, end);
+		krylov_allreduce(my_rank, &parity, val, 2 * cols + 1, 2 * cols);
+		if (val[2 * cols] < ERROR_THRESHOLD) {
+			break;
+		}
+
+		for (j = 0; j < cols; j++) {
+			gram[slot][j] = val[j];
+			gram[j][slot] = val[j];
+			theta[j] = val[cols + j];
+		}
+		reg = 0;
+		for (j = 0; j < cols; j++) {
+			reg += gram[j][j];
+		}
+		reg = ANDERSON_REGULARIZATION * reg / (cols > 0 ? cols : 1);
+		for (j = 0; j < cols; j++) {
+			for (l = 0; l < cols; l++) {
+				M[j][l] = gram[j][l] + ((j == l) ? reg : 0);
+			}
+		}
+		solve_small(M, theta, cols);
+
+		for (i = start; i < end; i++) {
+			f_prev[i] = vector_y[i] - vector_x[i];
+			g_prev[i] = vector_y[i];
+			vector_x[i] = vector_y[i];
+			for (j = 0; j < cols; j++) {
+				vector_x[i] -= theta[j] * dG[(long)j * matrix_dim + i];
+			}
+		}
+		if (k > 0) {
+			slot = (slot + 1) % m;
+		}
+		krylov_barrier(my_rank);
+		k++;
+	}
+
+	if (my_rank == 0) {
+		iterations_done = (k < no_iterations) ? k + 1 : k;
+	}
+	cs140barrier_wait(&mybarrier);
+	if (my_rank == 0) {
+		free(accel_vec);
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  panel_row
+ * Purpose:   Y[i][c] = D[i][c] + A[i]X[][c] for the active columns c of
+ *            the n x rhs_count panels (row-major, so row j of X is
+ *            contiguous). Columns are taken RHS_TILE at a time with one
+ *            accumulator each, so every A[i][j] loaded is used RHS_TILE
+ *            times from a register and row i of A is streamed from memory
+ *            once for all the columns instead of once per right-hand side.
+ * In args:   i -- row index
+ *            active, nactive -- the columns still iterating
+ * Global in vars:
+ *            double panel_x[], panel_d[], matrix_A[]; int rhs_count
+ * Global out vars:
+ *            double panel_y[]
+ */
+void panel_row(int i, int active[], int nactive)
+{
+	int j, t, c, m = rhs_count, first, last;
+	long base, stride;
+	double *xj, aij;
+	double y0, y1, y2, y3;
+
+	row_span(i, &first, &last, &base, &stride);
+
+	for (t = 0; t + RHS_TILE <= nactive; t += RHS_TILE) {
+		int c0 = active[t], c1 = active[t + 1], c2 = active[t + 2],
+			c3 = active[t + 3];
+		y0 = panel_d[(long)i * m + c0];
+		y1 = panel_d[(long)i * m + c1];
+		y2 = panel_d[(long)i * m + c2];
+		y3 = panel_d[(long)i * m + c3];
+		for (j = first; j < last; j++) {
+			aij = matrix_A[base + j * stride];
+			xj = panel_x + (long)j * m;
+			y0 += aij * xj[c0];
+			y1 += aij * xj[c1];
+			y2 += aij * xj[c2];
+			y3 += aij * xj[c3];
+		}
+		panel_y[(long)i * m + c0] = y0;
+		panel_y[(long)i * m + c1] = y1;
+		panel_y[(long)i * m + c2] = y2;
+		panel_y[(long)i * m + c3] = y3;
+	}
+	for (; t < nactive; t++) {
+		c = active[t];
+		y0 = panel_d[(long)i * m + c];
+		for (j = first; j < last; j++) {
+			y0 += matrix_A[base + j * stride] * panel_x[(long)j * m + c];
+		}
+		panel_y[(long)i * m + c] = y0;
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_panel
+ * Purpose:   Jacobi iteration Y = D + AX on rhs_count right-hand sides at
+ *            once, block mapped and synchronized like work_block. Each
+ *            column is tested on its own: once max |Y-X| of a column is
+ *            below the threshold the column is retired, keeping that Y as
+ *            its result, and later iterations only compute the columns
+ *            still active. All threads combine the per-column errors after
+ *            the same barrier, so they retire the same columns together.
+ * In arg:
+ *            my_rank: rank of this thread (counted from 0)
+ * Global in vars:
+ *            int rhs_count:  number of columns, at most RHS_MAX
+ *            double panel_d[]:  n x rhs_count panel D
+ *            and those of work_block
+ * Global in/out vars:
+ *            double panel_x[]:  n x rhs_count panel X
+ * Global out vars:
+ *            double panel_y[]:  n x rhs_count panel Y
+ *            int panel_iterations[]:  iterations of each column
+ */
+void work_panel(long my_rank)
+{
+	int block_size = ceil((double)matrix_dim/thread_count);
+	int start = my_rank * block_size;
+	int end = ((start + block_size) > matrix_dim) ? matrix_dim : (start + block_size);
+	int active[RHS_MAX], nactive = rhs_count, kept;
+	int i, c, t, r, k = 0, m = rhs_count;
+	double error, wait_start;
+	cs140barrier_token token;
+
+	if (start > matrix_dim) {
+		start = matrix_dim;
+	}
+	thread_stats_reset(my_rank);
+	for (c = 0; c < m; c++) {
+		active[c] = c;
+	}
+	while (k < no_iterations && nactive > 0) {
+		for (i = start; i < end; i++) {
+			panel_row(i, active, nactive);
+		}
+		token = cs140barrier_arrive(&mybarrier);
+		for (t = 0; t < nactive; t++) {
+			c = active[t];
+			error = 0;
+			for (i = start; i < end; i++) {
+				error = fmax(error, fabs(panel_y[(long)i * m + c] -
+										 panel_x[(long)i * m + c]));
 			}
-			start += (thread_count * cyclic_blocksize);
+			panel_error[k & 1][my_rank][c] = error;
 		}
-		double temp_error = 0;
-		double glob_error = 0;
-		for (int p = 0; p < matrix_dim; p++) {
-			temp_error = fabs(vector_y[p] - vector_x[p]);	
-			if (temp_error > glob_error) {
-				glob_error = temp_error;
+		wait_start = wall_time();
+		cs140barrier_wait_token(&mybarrier, token);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+		for (i = start; i < end; i++) {
+			for (t = 0; t < nactive; t++) {
+				panel_x[(long)i * m + active[t]] = panel_y[(long)i * m + active[t]];
 			}
-		} 
-		local_error = glob_error;
+		}
+		wait_start = wall_time();
+		cs140barrier_wait(&mybarrier);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
 		k++;
-		if (local_error < ERROR_THRESHOLD) {
+		kept = 0;
+		for (t = 0; t < nactive; t++) {
+			c = active[t];
+			error = 0;
+			for (r = 0; r < thread_count; r++) {
+				error = fmax(error, panel_error[(k - 1) & 1][r][c]);
+			}
+			if (error < ERROR_THRESHOLD) {
+				if (my_rank == 0) {
+					panel_iterations[c] = k;
+				}
+			} else {
+				active[kept++] = c;
+			}
+		}
+		nactive = kept;
+	}
+	if (my_rank == 0) {
+		for (t = 0; t < nactive; t++) {
+			panel_iterations[active[t]] = k;
+		}
+		iterations_done = k;
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  ooc_row
+ * Purpose:   Return d[i]+A[i]x for row i held at a in a streamed panel.
+ * In args:   a -- row i of A, matrix_dim doubles
+ *            i -- row index
+ */
+double ooc_row(const double a[], int i)
+{
+	int j, col_start = (matrix_type == UPPER_TRIANGULAR) ? i : 0;
+	double tmp_y = vector_d[i];
+
+	for (j = col_start; j < matrix_dim; j++) {
+		tmp_y += a[j] * vector_x[j];
+	}
+	return tmp_y;
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_ooc
+ * Purpose:   Run t iterations of {y=d+Ax; x=y} with A streamed from
+ *            ooc_path one panel of ooc_panel_rows rows at a time by
+ *            ooc_readers reader threads (see itmv_ooc.h), so the next
+ *            panels are read while this one is multiplied.
+ *            The rows of each panel are shared out by thread_mapping:
+ *            BLOCK_CYCLIC gives a thread the same rows as in core,
+ *            the dynamic mappings hand out cyclic_blocksize rows at a
+ *            time, and any other mapping splits each panel into
+ *            thread_count blocks. Once every panel is done, x=y and the
+ *            error are taken over block-mapped rows between two
+ *            barriers as in work_block. The file holds dense rows, so
+ *            matrix_type is 0 or UPPER_TRIANGULAR here, never BANDED.
+ * In arg:    my_rank -- rank of this thread (counted from 0)
+ * Global in vars:
+ *            ooc_path, ooc_panel_rows, ooc_readers, vector_d,
+ *            matrix_type, matrix_dim, no_iterations, thread_count
+ * Global in/out vars:
+ *            vector_x
+ * Global out vars:
+ *            vector_y, ooc_stats, iterations_done, and run_error if the
+ *            file cannot be opened or read
+ */
+void work_ooc(long my_rank)
+{
+	int block_size = ceil((double)matrix_dim/thread_count);
+	int start = my_rank * block_size;
+	int end = ((start + block_size) > matrix_dim) ? matrix_dim : (start + block_size);
+	int chunk = cyclic_blocksize > 0 ? cyclic_blocksize : 1;
+	int k = 0, p, s, i, r, first, rows, last, err;
+	const double *a;
+	double compute, stall, t0, wait_start, error;
+
+	if (start > matrix_dim) {
+		start = matrix_dim;
+	}
+	if (my_rank == 0) {
+		err = ooc_open(ooc_path, matrix_dim, ooc_panel_rows, ooc_readers,
+		               thread_count, no_iterations);
+		if (err != 0) {
+			run_error = (char *)itmv_map_strerror(err);
+			iterations_done = 0;
+		}
+	}
+	thread_stats_reset(my_rank);
+	cs140barrier_wait(&mybarrier);
+	/* Set by rank 0 before the barrier, so every thread returns here. */
+	if (run_error != NULL) {
+		return;
+	}
+
+	while (k < no_iterations) {
+		compute = stall = 0;
+		for (p = 0; p < ooc_panels; p++) {
+			s = k * ooc_panels + p;
+			t0 = wall_time();
+			a = ooc_acquire(s, &first, &rows);
+			stall += wall_time() - t0;
+			if (a == NULL) {
+				break;
+			}
+			last = first + rows;
+			t0 = wall_time();
+			if (thread_mapping == BLOCK_CYCLIC) {
+				for (i = first; i < last; i++) {
+					if ((i / chunk) % thread_count == my_rank) {
+						vector_y[i] = ooc_row(a + (long)(i - first) * matrix_dim, i);
+					}
+				}
+			} else if (thread_mapping == BLOCK_DYNAMIC ||
+			           thread_mapping == BLOCK_GUIDED ||
+			           thread_mapping == BLOCK_STEALING) {
+				while ((i = ooc_claim(s, chunk)) < last) {
+					int stop = (i + chunk > last) ? last : i + chunk;
+					for (; i < stop; i++) {
+						vector_y[i] = ooc_row(a + (long)(i - first) * matrix_dim, i);
+					}
+				}
+			} else {
+				int size = (rows + thread_count - 1) / thread_count;
+				int stop = first + (my_rank + 1) * size;
+				for (i = first + my_rank * size; i < stop && i < last; i++) {
+					vector_y[i] = ooc_row(a + (long)(i - first) * matrix_dim, i);
+				}
+			}
+			compute += wall_time() - t0;
+			ooc_release(s);
+		}
+		if (a == NULL) {
+			/* A read failed; every thread stops at the same panel. */
 			break;
 		}
-		start = my_rank * cyclic_blocksize;
-		pthread_barrier_wait(&mybarrier);
-		while (start < matrix_dim) {
-			i = start;
-			while (i < start + cyclic_blocksize && i < matrix_dim) {
-				vector_x[i] = vector_y[i];
-				i++;
+		ooc_compute[k & 1][my_rank] = compute;
+		ooc_stall[k & 1][my_rank] = stall;
+		wait_start = wall_time();
+		cs140barrier_wait(&mybarrier);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+		thread_error[k & 1][my_rank] = row_error(start, end);
+		for (i = start; i < end; i++) {
+			vector_x[i] = vector_y[i];
+		}
+		wait_start = wall_time();
+		cs140barrier_wait(&mybarrier);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+		if (my_rank == 0) {
+			for (r = 0; r < thread_count; r++) {
+				ooc_stats[k].compute_sec = fmax(ooc_stats[k].compute_sec, ooc_compute[k & 1][r]);
+				ooc_stats[k].stall_sec = fmax(ooc_stats[k].stall_sec, ooc_stall[k & 1][r]);
 			}
-			start += (thread_count * cyclic_blocksize);
 		}
-		pthread_barrier_wait(&mybarrier);
+		error = global_error(k & 1);
+		k++;
+		if (error < ERROR_THRESHOLD) {
+			break;
+		}
+	}
+	if (my_rank == 0) {
+		if (a == NULL) {
+			run_error = (char *)itmv_map_strerror(ooc_error);
+		}
+		iterations_done = k;
+		ooc_close();
+	}
+}
+
+/*---------------------------------------------------------------------
+ * Function:  work_op
+ * Purpose:   Run t iterations of {y=d+Ax; x=y} with A given by the
+ *            structured operator matrix_op (see itmv_op.h) instead of
+ *            matrix_A. Each iteration rank 0 prepares the operator for x
+ *            behind a barrier, then every thread computes its block of
+ *            rows and the error and x=y follow as in work_block, so an
+ *            iteration costs the operator's prepare and rows instead of
+ *            n^2 loads. The rows are block-mapped whatever thread_mapping
+ *            is.
+ * In arg:    my_rank -- rank of this thread (counted from 0)
+ * Global in vars:
+ *            matrix_op, vector_d, matrix_dim, no_iterations, thread_count
+ * Global in/out vars:
+ *            vector_x
+ * Global out vars:
+ *            vector_y, iterations_done
+ */
+void work_op(long my_rank)
+{
+	int block_size = ceil((double)matrix_dim/thread_count);
+	int start = my_rank * block_size;
+	int end = ((start + block_size) > matrix_dim) ? matrix_dim : (start + block_size);
+	int k = 0, i;
+	double wait_start, compute_start;
+	itmv_op *op = matrix_op;
+
+	if (start > matrix_dim) {
+		start = matrix_dim;
+	}
+	thread_stats_reset(my_rank);
+	while (k < no_iterations) {
+		if (my_rank == 0 && op->prepare != NULL) {
+			op->prepare(op, vector_x);
+		}
+		wait_start = wall_time();
+		cs140barrier_wait(&mybarrier);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+		compute_start = wall_time();
+		for (i = start; i < end; i++) {
+			vector_y[i] = vector_d[i] + op->row(op, i, vector_x);
+		}
+		thread_compute_time[my_rank] += wall_time() - compute_start;
+		thread_rows[my_rank] += end - start;
+		wait_start = wall_time();
+		cs140barrier_wait(&mybarrier);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+		thread_error[k & 1][my_rank] = row_error(start, end);
+		for (i = start; i < end; i++) {
+			vector_x[i] = vector_y[i];
+		}
+		wait_start = wall_time();
+		cs140barrier_wait(&mybarrier);
+		sync_wait_time[my_rank] += wall_time() - wait_start;
+		if (global_error(k & 1) < ERROR_THRESHOLD) {
+			break;
+		}
+		k++;
+	}
+	if (my_rank == 0) {
+		iterations_done = (k < no_iterations) ? k + 1 : k;
 	}
 }
 
@@ -248,3 +2577,68 @@ int itmv_mult_seq(double A[], double x[], double d[], double y[],
 	}
 	return 1;
 }
+
+
+/*-------------------------------------------------------------------
+ * Function:  itmv_gs_seq
+ * Purpose:   Run up to t Gauss-Seidel/SOR sweeps sequentially, in the
+ *            order work_gauss_seidel uses: rows n-1 down to 0 for an upper
+ *            triangular A, otherwise color by color (row i has color
+ *            i % colors, at least 2) with the rows of a color updated
+ *            together from the previous values of that color.
+ * In args:   A, d, matrix_type, n, t:  as itmv_mult_seq
+ *            omega:  relaxation factor, 1 for Gauss-Seidel
+ *            colors:  number of colors for a regular matrix
+ * In/out:    x: column vector x
+ *            y: column vector y, the final x
+ * Return:  1  means succesful 0 means unsuccessful
+ */
+int itmv_gs_seq(double A[], double x[], double d[], double y[],
+				int matrix_type, int n, int t, double omega, int colors)
+{
+	int i, j, c, k, stop;
+	double value;
+
+	if (n <= 0 || A == NULL || x == NULL || d == NULL || y == NULL)
+		return 0;
+	if (colors < 2)
+		colors = 2;
+
+	for (k = 0; k < t; k++)
+	{
+		stop = 1;
+		if (matrix_type == UPPER_TRIANGULAR)
+		{
+			for (i = n - 1; i >= 0; i--)
+			{
+				value = d[i];
+				for (j = i; j < n; j++)
+					value += A[i * n + j] * x[j];
+				y[i] = (1 - omega) * x[i] + omega * value;
+				if (fabs(y[i] - x[i]) > ERROR_THRESHOLD)
+					stop = 0;
+				x[i] = y[i];
+			}
+		}
+		else
+		{
+			for (c = 0; c < colors; c++)
+			{
+				for (i = c; i < n; i += colors)
+				{
+					value = d[i];
+					for (j = 0; j < n; j++)
+						value += A[i * n + j] * x[j];
+					y[i] = (1 - omega) * x[i] + omega * value;
+					if (fabs(y[i] - x[i]) > ERROR_THRESHOLD)
+						stop = 0;
+				}
+				for (i = c; i < n; i += colors)
+					x[i] = y[i];
+			}
+		}
+		if (stop)
+			break;
+	}
+	return 1;
+}
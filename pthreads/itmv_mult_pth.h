@@ -1,3 +1,8 @@
+#ifndef _ITMV_MULT_PTH_CS140
+#define _ITMV_MULT_PTH_CS140
+
+#include "cs140barrier.h"
+
 /*Global variables*/
 
 extern int thread_count;
@@ -5,19 +10,112 @@ extern double *matrix_A;
 extern double *vector_x;
 extern double *vector_d;
 extern double *vector_y;
+extern double *panel_x;
+extern double *panel_d;
+extern double *panel_y;
+extern int rhs_count;
 extern int matrix_type;
+extern int band_lower;
+extern int band_upper;
 extern int matrix_dim;
 extern int no_iterations;
 
 extern int thread_mapping;
 extern int cyclic_blocksize;
+extern int color_count;
+extern double relax_omega;
+extern int krylov_method;
+extern int krylov_chosen;
+extern int acceleration;
+extern int anderson_depth;
+extern double accel_bounds[];
+extern int panel_iterations[];
+extern char *ooc_path;
+extern int ooc_panel_rows;
+extern int ooc_readers;
+extern struct itmv_op *matrix_op;
+
+extern double sync_wait_time[];
+extern double thread_compute_time[];
+extern long thread_rows[];
+extern double thread_flops[];
+extern int iterations_done;
+extern char *run_error;
 
 #define UPPER_TRIANGULAR 1
+#define BANDED 2
+#define MULTI_RHS 9
+#define KRYLOV 8
+#define GAUSS_SEIDEL 7
+#define ASYNC_JACOBI 6
+#define BLOCK_STEALING 5
+#define BLOCK_DATAFLOW 4
+#define BLOCK_GUIDED 3
+#define BLOCK_DYNAMIC 2
 #define BLOCK_CYCLIC 1
 #define BLOCK_MAPPING 0
 
 void parallel_itmv_mult(int);
+void thread_stats_summary(int threads, double latency, double *imbalance,
+                          double *wait_fraction);
 
 #define THREAD_COUNT_MAX 64
 
 #define ERROR_THRESHOLD 1e-3
+
+/* krylov_method values for the KRYLOV mapping. KRYLOV always maps rows in
+ * contiguous blocks as BLOCK_MAPPING does; cyclic_blocksize is ignored. */
+#define KRYLOV_AUTO 0
+#define KRYLOV_CG 1
+#define KRYLOV_BICGSTAB 2
+#define KRYLOV_GMRES 3
+
+#define KRYLOV_RESTART 30
+#define KRYLOV_POWER_STEPS 8
+#define KRYLOV_BICGSTAB_RHO 0.5
+
+/* acceleration values, applied to BLOCK_MAPPING. */
+#define ACCEL_NONE 0
+#define ACCEL_CHEBYSHEV 1
+#define ACCEL_ANDERSON 2
+
+#define ACCEL_BOUNDS_MARGIN 0.05
+#define ANDERSON_DEPTH_MAX 8
+#define ANDERSON_REGULARIZATION 1e-10
+
+/* MULTI_RHS panels: at most RHS_MAX columns, RHS_TILE per register tile. */
+#define RHS_MAX 64
+#define RHS_TILE 4
+
+/* One Jacobi solve as the block and block cyclic iterations see it:
+ * filled from the globals above by solve_globals for parallel_itmv_mult,
+ * or from an itmv_ctx (itmv_ctx.h). Each thread may hold its own copy;
+ * the arrays, the barrier and the counters are shared by the team. */
+typedef struct itmv_solve {
+  double *A;
+  double *x;
+  double *d;
+  double *y;
+  int n;
+  int matrix_type;
+  int band_lower;
+  int band_upper;
+  int no_iterations;
+  int thread_count;
+  int cyclic_blocksize;
+  double threshold;
+  cs140barrier *barrier;
+  double (*thread_error)[THREAD_COUNT_MAX];
+  double *sync_wait_time;
+  double *thread_compute_time;
+  long *thread_rows;
+  double *thread_flops;
+  int *iterations_done;
+} itmv_solve;
+
+void solve_globals(itmv_solve *s);
+void solve_rows(const itmv_solve *s, int start, int end);
+void solve_block(itmv_solve *s, long my_rank);
+void solve_blockcyclic(itmv_solve *s, long my_rank);
+
+#endif
@@ -10,11 +10,23 @@
  *                     we assume n is divisible by no_proc.
  */
 
+#include <ctype.h>
 #include <math.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "affinity.h"
+#include "cs140barrier.h"
+#include "itmv_band.h"
+#include "itmv_ctx.h"
+#include "itmv_load.h"
+#include "itmv_mmap.h"
 #include "itmv_mult_pth.h"
+#include "itmv_ooc.h"
+#include "itmv_op.h"
+#include "itmv_trace.h"
 #include "minunit.h"
 
 #define MAX_TEST_MATRIX_SIZE 256
@@ -28,14 +40,29 @@ double *matrix_A;
 double *vector_x;
 double *vector_d;
 double *vector_y;
+double *panel_x;
+double *panel_d;
+double *panel_y;
+int rhs_count;
 int matrix_type;
+int band_lower;
+int band_upper;
 int matrix_dim;
 int no_iterations;
 int thread_count;
 int thread_mapping = BLOCK_MAPPING;
 int cyclic_blocksize;
+int color_count = 2;
+double relax_omega = 1.0;
+int krylov_method = KRYLOV_AUTO;
+int acceleration = ACCEL_NONE;
+int anderson_depth = 3;
+char *ooc_path = NULL;
+int ooc_panel_rows = 64;
+int ooc_readers = 1;
+itmv_op *matrix_op = NULL;
 
-extern pthread_barrier_t mybarrier; /*defined in itmv_mult_pth.c*/
+extern cs140barrier mybarrier; /*defined in itmv_mult_pth.c*/
 
 /*---------------------------------------------------------------------
  * Function:  thread_work
@@ -46,9 +73,36 @@ extern pthread_barrier_t mybarrier; /*defined in itmv_mult_pth.c*/
 void *thread_work(void *rank) {
   extern void work_blockcyclic(long);
   extern void work_block(long);
+  extern void work_dataflow(long);
+  extern void work_scheduled(long);
+  extern void work_async(long);
+  extern void work_gauss_seidel(long);
+  extern void work_krylov(long);
+  extern void work_panel(long);
+  extern void work_ooc(long);
+  extern void work_op(long);
   long my_rank = (long)rank;
-  if (thread_mapping == BLOCK_CYCLIC) {
+  affinity_bind_self(my_rank);
+  if (matrix_op != NULL) {
+    work_op(my_rank);
+  } else if (ooc_path != NULL) {
+    work_ooc(my_rank);
+  } else if (thread_mapping == BLOCK_CYCLIC) {
     work_blockcyclic(my_rank);
+  } else if (thread_mapping == BLOCK_DATAFLOW) {
+    work_dataflow(my_rank);
+  } else if (thread_mapping == ASYNC_JACOBI) {
+    work_async(my_rank);
+  } else if (thread_mapping == GAUSS_SEIDEL) {
+    work_gauss_seidel(my_rank);
+  } else if (thread_mapping == KRYLOV) {
+    work_krylov(my_rank);
+  } else if (thread_mapping == MULTI_RHS) {
+    work_panel(my_rank);
+  } else if (thread_mapping == BLOCK_DYNAMIC ||
+             thread_mapping == BLOCK_GUIDED ||
+             thread_mapping == BLOCK_STEALING) {
+    work_scheduled(my_rank);
   } else {
     work_block(my_rank);
   }
@@ -65,8 +119,10 @@ void parallel_itmv_mult(int no_threads) {
   long i;
 
   thread_count = no_threads;
+  run_error = NULL;
   thread_handles = malloc(thread_count * sizeof(pthread_t));
-  pthread_barrier_init(&mybarrier, NULL, thread_count);
+  cs140barrier_init(&mybarrier, thread_count);
+  TRACE_START(thread_count);
 
   for (i = 0; i < thread_count; i++) {
     pthread_create(&thread_handles[i], NULL, thread_work, (void *)i);
@@ -75,12 +131,14 @@ void parallel_itmv_mult(int no_threads) {
   for (i = 0; i < thread_count; i++) {
     pthread_join(thread_handles[i], NULL);
   }
-  pthread_barrier_destroy(&mybarrier);
+  cs140barrier_destroy(&mybarrier);
   free(thread_handles);
 }
 
 int itmv_mult_seq(double A[], double x[], double d[], double y[],
                   int matrix_type, int n, int t);
+int itmv_gs_seq(double A[], double x[], double d[], double y[],
+                int matrix_type, int n, int t, double omega, int colors);
 
 void print_error(char *msgheader, char *msg) {
   printf("%s error msg: %s\n", msgheader, msg);
@@ -156,7 +214,10 @@ double *compute_expected(char *testmsg, int n, int t, int matrix_type) {
 #ifdef DEBUG1
   print_itmv_sample(testmsg, A, x, d, y, matrix_type, n, t);
 #endif
-  itmv_mult_seq(A, x, d, y, matrix_type, n, t);
+  if (thread_mapping == GAUSS_SEIDEL)
+    itmv_gs_seq(A, x, d, y, matrix_type, n, t, relax_omega, color_count);
+  else
+    itmv_mult_seq(A, x, d, y, matrix_type, n, t);
 
   free(A);
   free(x);
@@ -226,6 +287,26 @@ int allocate_space(double **A, double **x, double **d, double **y, int n) {
   return succ;
 }
 
+#ifdef ITMV_TRACE
+/*-------------------------------------------------------------------
+ * Dump the trace of the last run to trace_<test>.json, <test> being the
+ * first two words of testmsg ("Test 8" gives trace_Test_8.json).
+ */
+void trace_test(char *testmsg) {
+  char path[64] = "trace_";
+  int i, k = strlen(path), words = 0;
+
+  for (i = 0; testmsg[i] != '\0' && testmsg[i] != ':' && k < 58; i++) {
+    if (testmsg[i] == ' ' && ++words == 2) break;
+    path[k++] = isalnum((unsigned char)testmsg[i]) ? testmsg[i] : '_';
+  }
+  strcpy(path + k, ".json");
+  if (trace_dump(path) == 0) {
+    printf("%s: Trace written to %s\n", testmsg, path);
+  }
+}
+#endif
+
 /*-------------------------------------------------------------------
  * Test matrix vector multiplication
  * Process 0 collects the  error detection. If failed, return a message string
@@ -249,6 +330,7 @@ char *itmv_test(char *testmsg, int test_correctness, int test_reach_convergence,
     print_error(testmsg, msg);
     return msg;
   }
+  affinity_first_touch(matrix_A, (long)n * n, thread_count);
   /*Initialize test matrix and vectors*/
   initialize(matrix_A, vector_x, vector_d, vector_y, n, matrix_type);
 #ifdef DEBUG1
@@ -260,10 +342,57 @@ char *itmv_test(char *testmsg, int test_correctness, int test_reach_convergence,
   parallel_itmv_mult(thread_count);
 
   endwtime = get_time();
+  if (run_error != NULL) {
+    print_error(testmsg, run_error);
+    free(matrix_A);
+    free(vector_x);
+    free(vector_y);
+    free(vector_d);
+    return run_error;
+  }
   double latency=endwtime - startwtime;
-  printf("%s: Latency = %f sec with %d threads. Matrix dimension %d \n", testmsg,
-           latency,   thread_count, n);
-
+  double wait = 0, imbalance, wait_fraction;
+  char wait_text[64] = "n/a", imbalance_text[16] = "n/a";
+  for (int r = 0; r < thread_count; r++) wait += sync_wait_time[r];
+  thread_stats_summary(thread_count, latency, &imbalance, &wait_fraction);
+  /* Mappings that count nothing leave both at 0. */
+  if (wait_fraction > 0) {
+    snprintf(wait_text, sizeof(wait_text),
+             "%f sec per thread (%.1f%% of wall time)", wait / thread_count,
+             100 * wait_fraction);
+  }
+  if (imbalance > 0) {
+    snprintf(imbalance_text, sizeof(imbalance_text), "%.3f", imbalance);
+  }
+  printf("%s: Latency = %f sec with %d threads. Matrix dimension %d. "
+         "Iterations = %d. Sync wait = %s. Imbalance = %s \n",
+         testmsg, latency, thread_count, n, iterations_done, wait_text,
+         imbalance_text);
+  if (imbalance > 0) {
+    for (int r = 0; r < thread_count; r++) {
+      printf("%s: Thread %d: compute %f sec, wait %f sec, %ld rows, "
+             "%.4f GFLOP\n",
+             testmsg, r, thread_compute_time[r], sync_wait_time[r],
+             thread_rows[r], thread_flops[r] / 1e9);
+    }
+  }
+  if (thread_mapping == KRYLOV) {
+    printf("%s: Krylov method = %s\n", testmsg,
+           krylov_chosen == KRYLOV_CG         ? "CG"
+           : krylov_chosen == KRYLOV_BICGSTAB ? "BiCGStab"
+                                              : "GMRES");
+  }
+  if (acceleration == ACCEL_CHEBYSHEV && thread_mapping == BLOCK_MAPPING) {
+    printf("%s: Chebyshev spectral bounds [%f, %f]\n", testmsg,
+           accel_bounds[0], accel_bounds[1]);
+  }
+  if (iterations_done < no_iterations) {
+    printf("%s: Time to threshold = %f sec (%d iterations at %f sec each)\n",
+           testmsg, latency, iterations_done, latency / iterations_done);
+  }
+#ifdef ITMV_TRACE
+  trace_test(testmsg);
+#endif
 
   msg = NULL;
   if (test_correctness == TEST_CORRECTNESS) {
@@ -338,6 +467,1278 @@ char *itmv_test8() {
                    17, UPPER_TRIANGULAR, 2, BLOCK_CYCLIC, 1);
 }
 
+char *itmv_test8d() {
+  return itmv_test("Test 8d", TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE,
+                   16, !UPPER_TRIANGULAR, 2, BLOCK_DATAFLOW, 2);
+}
+
+char *itmv_test8e() {
+  return itmv_test("Test 8e", TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE,
+                   17, UPPER_TRIANGULAR, 3, BLOCK_DATAFLOW, 1);
+}
+
+char *itmv_test8f() {
+  return itmv_test("Test 8f: n=64 upper dataflow to convergence",
+                   !TEST_CORRECTNESS, TEST_REACH_CONVERGENCE, 64,
+                   UPPER_TRIANGULAR, 4096, BLOCK_DATAFLOW, 4);
+}
+
+char *itmv_test8g() {
+  return itmv_test("Test 8g", TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE,
+                   17, !UPPER_TRIANGULAR, 2, BLOCK_DYNAMIC, 2);
+}
+
+char *itmv_test8h() {
+  return itmv_test("Test 8h", TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE,
+                   17, UPPER_TRIANGULAR, 2, BLOCK_GUIDED, 1);
+}
+
+char *itmv_test8i() {
+  return itmv_test("Test 8i", TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE,
+                   17, UPPER_TRIANGULAR, 2, BLOCK_STEALING, 1);
+}
+
+char *itmv_test8j() {
+  return itmv_test("Test 8j: n=64 stealing to convergence", !TEST_CORRECTNESS,
+                   TEST_REACH_CONVERGENCE, 64, !UPPER_TRIANGULAR, 4096,
+                   BLOCK_STEALING, 4);
+}
+
+char *itmv_test8k() {
+  return itmv_test("Test 8k", TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE,
+                   17, UPPER_TRIANGULAR, 1, ASYNC_JACOBI, 0);
+}
+
+char *itmv_test8l() {
+  return itmv_test("Test 8l: n=64 async to convergence", !TEST_CORRECTNESS,
+                   TEST_REACH_CONVERGENCE, 64, !UPPER_TRIANGULAR, 4096,
+                   ASYNC_JACOBI, 0);
+}
+
+char *itmv_test8m() {
+  return itmv_test("Test 8m: n=64 upper async to convergence",
+                   !TEST_CORRECTNESS, TEST_REACH_CONVERGENCE, 64,
+                   UPPER_TRIANGULAR, 4096, ASYNC_JACOBI, 0);
+}
+
+char *itmv_test8n() {
+  return itmv_test("Test 8n", TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE,
+                   17, !UPPER_TRIANGULAR, 3, GAUSS_SEIDEL, 0);
+}
+
+char *itmv_test8o() {
+  return itmv_test("Test 8o", TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE,
+                   17, UPPER_TRIANGULAR, 2, GAUSS_SEIDEL, 2);
+}
+
+char *itmv_test8p() {
+  char *msg;
+  relax_omega = 1.2;
+  color_count = 3;
+  msg = itmv_test("Test 8p: SOR w=1.2 3 colors", TEST_CORRECTNESS,
+                  !TEST_REACH_CONVERGENCE, 17, !UPPER_TRIANGULAR, 3,
+                  GAUSS_SEIDEL, 0);
+  relax_omega = 1.0;
+  color_count = 2;
+  return msg;
+}
+
+char *itmv_test8q() {
+  return itmv_test("Test 8q: n=64 red-black to convergence", !TEST_CORRECTNESS,
+                   TEST_REACH_CONVERGENCE, 64, !UPPER_TRIANGULAR, 4096,
+                   GAUSS_SEIDEL, 0);
+}
+
+char *itmv_test8r() {
+  char *msg;
+  relax_omega = 0.8;
+  msg = itmv_test("Test 8r: n=64 upper SOR w=0.8 wavefront to convergence",
+                  !TEST_CORRECTNESS, TEST_REACH_CONVERGENCE, 64,
+                  UPPER_TRIANGULAR, 4096, GAUSS_SEIDEL, 4);
+  relax_omega = 1.0;
+  return msg;
+}
+
+char *itmv_krylov_test(char *testmsg, int n, int mtype, int t, int method) {
+  char *msg;
+  krylov_method = method;
+  msg = itmv_test(testmsg, !TEST_CORRECTNESS, TEST_REACH_CONVERGENCE, n, mtype,
+                  t, KRYLOV, 0);
+  krylov_method = KRYLOV_AUTO;
+  return msg;
+}
+
+char *itmv_test8s() {
+  return itmv_krylov_test("Test 8s: n=64 CG to convergence", 64,
+                          !UPPER_TRIANGULAR, 4096, KRYLOV_CG);
+}
+
+char *itmv_test8t() {
+  return itmv_krylov_test("Test 8t: n=64 BiCGStab to convergence", 64,
+                          !UPPER_TRIANGULAR, 4096, KRYLOV_BICGSTAB);
+}
+
+char *itmv_test8u() {
+  return itmv_krylov_test("Test 8u: n=64 upper BiCGStab to convergence", 64,
+                          UPPER_TRIANGULAR, 4096, KRYLOV_BICGSTAB);
+}
+
+char *itmv_test8v() {
+  return itmv_krylov_test("Test 8v: n=64 GMRES to convergence", 64,
+                          !UPPER_TRIANGULAR, 4096, KRYLOV_GMRES);
+}
+
+char *itmv_test8w() {
+  return itmv_krylov_test("Test 8w: n=64 upper GMRES to convergence", 64,
+                          UPPER_TRIANGULAR, 4096, KRYLOV_GMRES);
+}
+
+char *itmv_test8x() {
+  return itmv_krylov_test("Test 8x: n=64 upper auto Krylov to convergence",
+                          64, UPPER_TRIANGULAR, 4096, KRYLOV_AUTO);
+}
+
+char *itmv_accel_test(char *testmsg, int test_correctness,
+                      int test_reach_convergence, int n, int mtype, int t,
+                      int accel) {
+  char *msg;
+  acceleration = accel;
+  msg = itmv_test(testmsg, test_correctness, test_reach_convergence, n, mtype,
+                  t, BLOCK_MAPPING, 0);
+  acceleration = ACCEL_NONE;
+  return msg;
+}
+
+char *itmv_test8y() {
+  return itmv_accel_test("Test 8y: n=64 Chebyshev to convergence",
+                         !TEST_CORRECTNESS, TEST_REACH_CONVERGENCE, 64,
+                         !UPPER_TRIANGULAR, 4096, ACCEL_CHEBYSHEV);
+}
+
+char *itmv_test8z() {
+  return itmv_accel_test("Test 8z: n=64 upper Chebyshev to convergence",
+                         !TEST_CORRECTNESS, TEST_REACH_CONVERGENCE, 64,
+                         UPPER_TRIANGULAR, 4096, ACCEL_CHEBYSHEV);
+}
+
+char *itmv_test8aa() {
+  return itmv_accel_test("Test 8aa: n=64 Anderson to convergence",
+                         !TEST_CORRECTNESS, TEST_REACH_CONVERGENCE, 64,
+                         !UPPER_TRIANGULAR, 4096, ACCEL_ANDERSON);
+}
+
+char *itmv_test8ab() {
+  char *msg;
+  anderson_depth = 1;
+  msg = itmv_accel_test("Test 8ab: n=64 upper Anderson m=1 to convergence",
+                        !TEST_CORRECTNESS, TEST_REACH_CONVERGENCE, 64,
+                        UPPER_TRIANGULAR, 4096, ACCEL_ANDERSON);
+  anderson_depth = 3;
+  return msg;
+}
+
+char *itmv_test8ac() {
+  return itmv_accel_test("Test 8ac: Anderson first step is Jacobi",
+                         TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 17,
+                         !UPPER_TRIANGULAR, 1, ACCEL_ANDERSON);
+}
+
+/*-------------------------------------------------------------------
+ * Test the MULTI_RHS mode on m right-hand sides, column c of D being the
+ * test vector d scaled by c+1, so the columns need different numbers of
+ * iterations and retire at different times. Each column is checked
+ * against itmv_mult_seq on its own d (test_correctness) or against its
+ * fixed point c+1 (test_reach_convergence).
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_panel_test(char *testmsg, int test_correctness,
+                      int test_reach_convergence, int n, int mtype, int t,
+                      int m) {
+  double startwtime, latency;
+  int i, c, first, last;
+  char *msg = NULL;
+
+  matrix_dim = n;
+  no_iterations = t;
+  matrix_type = mtype;
+  thread_mapping = MULTI_RHS;
+  rhs_count = m;
+
+  if (!allocate_space(&matrix_A, &vector_x, &vector_d, &vector_y, n)) {
+    msg = "Failed space allocation";
+    print_error(testmsg, msg);
+    return msg;
+  }
+  panel_x = malloc((long)n * m * sizeof(double));
+  panel_d = malloc((long)n * m * sizeof(double));
+  panel_y = malloc((long)n * m * sizeof(double));
+  affinity_first_touch(matrix_A, (long)n * n, thread_count);
+  initialize(matrix_A, vector_x, vector_d, vector_y, n, matrix_type);
+  for (i = 0; i < n; i++) {
+    for (c = 0; c < m; c++) {
+      panel_x[(long)i * m + c] = 0;
+      panel_d[(long)i * m + c] = vector_d[i] * (c + 1);
+    }
+  }
+
+  startwtime = get_time();
+  parallel_itmv_mult(thread_count);
+  latency = get_time() - startwtime;
+
+  first = last = panel_iterations[0];
+  for (c = 1; c < m; c++) {
+    first = (panel_iterations[c] < first) ? panel_iterations[c] : first;
+    last = (panel_iterations[c] > last) ? panel_iterations[c] : last;
+  }
+  printf("%s: Latency = %f sec with %d threads. Matrix dimension %d. "
+         "%d right-hand sides retired after %d to %d iterations\n",
+         testmsg, latency, thread_count, n, m, first, last);
+
+  for (c = 0; c < m && msg == NULL; c++) {
+    if (test_correctness == TEST_CORRECTNESS) {
+      if (n > MAX_TEST_MATRIX_SIZE) {
+        msg = "Failed: Too big to validate";
+        break;
+      }
+      initialize(matrix_A, vector_x, vector_d, vector_y, n, matrix_type);
+      for (i = 0; i < n; i++) vector_d[i] *= c + 1;
+      itmv_mult_seq(matrix_A, vector_x, vector_d, vector_y, matrix_type, n, t);
+      for (i = 0; i < n; i++) {
+        if (fabs(panel_y[(long)i * m + c] - vector_y[i]) >= THRESHOLD) {
+          msg = "One mismatch in multiple right-hand-side column";
+        }
+      }
+    }
+    if (test_reach_convergence == TEST_REACH_CONVERGENCE) {
+      for (i = 0; i < n; i++) {
+        if (fabs(panel_y[(long)i * m + c] - (c + 1)) >= ERROR_THRESHOLD) {
+          msg = "Failed to reach convergence in a right-hand-side column";
+        }
+      }
+    }
+  }
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+
+  free(panel_x);
+  free(panel_d);
+  free(panel_y);
+  free(matrix_A);
+  free(vector_x);
+  free(vector_y);
+  free(vector_d);
+  return msg;
+}
+
+char *itmv_test8ad() {
+  return itmv_panel_test("Test 8ad: n=17 6 right-hand sides", TEST_CORRECTNESS,
+                         !TEST_REACH_CONVERGENCE, 17, !UPPER_TRIANGULAR, 3, 6);
+}
+
+char *itmv_test8ae() {
+  return itmv_panel_test("Test 8ae: n=64 upper 5 right-hand sides retired",
+                         TEST_CORRECTNESS, TEST_REACH_CONVERGENCE, 64,
+                         UPPER_TRIANGULAR, 4096, 5);
+}
+
+char *itmv_test8af() {
+  return itmv_panel_test("Test 8af: n=64 8 right-hand sides retired",
+                         TEST_CORRECTNESS, TEST_REACH_CONVERGENCE, 64,
+                         !UPPER_TRIANGULAR, 4096, 8);
+}
+
+/*-------------------------------------------------------------------
+ * Run two independent solves at once through the context API, each from
+ * its own caller thread with its own team of thread_count threads: a
+ * regular matrix under block mapping and an upper triangular one under
+ * block cyclic mapping. When the process may use more than one CPU, the
+ * two teams are pinned to disjoint halves of them.
+ * If failed, return a message string. If successful, return NULL
+ */
+void *ctx_solve(void *ctx) {
+  itmv_ctx_run(ctx);
+  return NULL;
+}
+
+char *itmv_ctx_test(char *testmsg, int test_correctness,
+                    int test_reach_convergence, int n, int t,
+                    int cyclic_block) {
+  itmv_ctx ctx[2];
+  double *A[2], *x[2], *d[2], *y[2];
+  pthread_t solver[2];
+  int cpus[THREAD_COUNT_MAX];
+  int ncpus, half, c, mtype;
+  double startwtime, latency;
+  char *msg = NULL;
+
+  /* validate_vect picks the sequential reference by thread_mapping. */
+  thread_mapping = BLOCK_MAPPING;
+  ncpus = affinity_cpu_list("compact", cpus, THREAD_COUNT_MAX);
+  half = ncpus / 2;
+  for (c = 0; c < 2; c++) {
+    mtype = (c == 0) ? !UPPER_TRIANGULAR : UPPER_TRIANGULAR;
+    if (!allocate_space(&A[c], &x[c], &d[c], &y[c], n)) {
+      msg = "Failed space allocation";
+      print_error(testmsg, msg);
+      return msg;
+    }
+    initialize(A[c], x[c], d[c], y[c], n, mtype);
+    itmv_ctx_init(&ctx[c], A[c], x[c], d[c], y[c], n, mtype, thread_count);
+    ctx[c].no_iterations = t;
+    if (c == 1) {
+      ctx[c].mapping = BLOCK_CYCLIC;
+      ctx[c].cyclic_blocksize = cyclic_block;
+    }
+    if (half > 0) {
+      itmv_ctx_set_cpus(&ctx[c], cpus + c * half, half);
+    }
+  }
+
+  startwtime = get_time();
+  for (c = 0; c < 2; c++) {
+    pthread_create(&solver[c], NULL, ctx_solve, &ctx[c]);
+  }
+  for (c = 0; c < 2; c++) {
+    pthread_join(solver[c], NULL);
+  }
+  latency = get_time() - startwtime;
+  printf("%s: Latency = %f sec for two concurrent solves with %d threads "
+         "each. Matrix dimension %d. Iterations = %d and %d\n",
+         testmsg, latency, thread_count, n, ctx[0].iterations_done,
+         ctx[1].iterations_done);
+
+  for (c = 0; c < 2 && msg == NULL; c++) {
+    if (test_correctness == TEST_CORRECTNESS) {
+      msg = validate_vect(testmsg, y[c], n, ctx[c].iterations_done,
+                          ctx[c].matrix_type);
+    }
+    if (msg == NULL && test_reach_convergence == TEST_REACH_CONVERGENCE) {
+      msg = validate_convergence(y[c], n);
+    }
+  }
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+
+  for (c = 0; c < 2; c++) {
+    itmv_ctx_destroy(&ctx[c]);
+    free(A[c]);
+    free(x[c]);
+    free(d[c]);
+    free(y[c]);
+  }
+  return msg;
+}
+
+char *itmv_test8ag() {
+  return itmv_ctx_test("Test 8ag: n=17 t=3 two concurrent contexts",
+                       TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 17, 3, 2);
+}
+
+char *itmv_test8ah() {
+  return itmv_ctx_test("Test 8ah: n=64 two concurrent contexts converge",
+                       TEST_CORRECTNESS, TEST_REACH_CONVERGENCE, 64, 4096, 4);
+}
+
+/*-------------------------------------------------------------------
+ * Solve count independent problems with itmv_batch_run and report solves
+ * per second, then the same problems one at a time with itmv_ctx_run
+ * using all threads inside each solve. Member i has dimension
+ * batch_sizes[i % BATCH_SIZE_KINDS] and alternates between a regular and
+ * an upper triangular matrix every BATCH_SIZE_KINDS members; members of
+ * the same dimension and type share their matrix.
+ * If failed, return a message string. If successful, return NULL
+ */
+int batch_sizes[] = {16, 32, 64, 128, 256};
+#define BATCH_SIZE_KINDS 5
+
+char *itmv_batch_test(char *testmsg, int test_correctness, int count, int t,
+                      int parallel_n) {
+  double *shared_A[BATCH_SIZE_KINDS][2];
+  itmv_ctx *ctx = malloc(count * sizeof(itmv_ctx));
+  itmv_ctx **problems = malloc(count * sizeof(itmv_ctx *));
+  double startwtime, batch_latency, single_latency;
+  int i, j, n, mtype, kind, large;
+  char *msg = NULL;
+
+  /* validate_vect picks the sequential reference by thread_mapping. */
+  thread_mapping = BLOCK_MAPPING;
+  for (kind = 0; kind < BATCH_SIZE_KINDS; kind++) {
+    for (j = 0; j < 2; j++) {
+      n = batch_sizes[kind];
+      shared_A[kind][j] = malloc(n * n * sizeof(double));
+    }
+  }
+  for (i = 0; i < count; i++) {
+    kind = i % BATCH_SIZE_KINDS;
+    n = batch_sizes[kind];
+    mtype = (i / BATCH_SIZE_KINDS) % 2 ? UPPER_TRIANGULAR : !UPPER_TRIANGULAR;
+    itmv_ctx_init(&ctx[i], shared_A[kind][mtype], malloc(n * sizeof(double)),
+                  malloc(n * sizeof(double)), malloc(n * sizeof(double)), n,
+                  mtype, thread_count);
+    initialize(ctx[i].A, ctx[i].x, ctx[i].d, ctx[i].y, n, mtype);
+    ctx[i].no_iterations = t;
+    problems[i] = &ctx[i];
+  }
+
+  startwtime = get_time();
+  large = itmv_batch_run(problems, count, thread_count, parallel_n);
+  batch_latency = get_time() - startwtime;
+
+  for (i = 0; i < count && msg == NULL; i++) {
+    if (test_correctness == TEST_CORRECTNESS) {
+      msg = validate_vect(testmsg, ctx[i].y, ctx[i].n, ctx[i].iterations_done,
+                          ctx[i].matrix_type);
+    }
+  }
+
+  for (i = 0; i < count; i++) {
+    for (j = 0; j < ctx[i].n; j++) {
+      ctx[i].x[j] = 0;
+    }
+  }
+  startwtime = get_time();
+  for (i = 0; i < count; i++) {
+    itmv_ctx_run(&ctx[i]);
+  }
+  single_latency = get_time() - startwtime;
+
+  printf("%s: %d solves in %f sec = %.1f solves/sec with %d threads, %d of "
+         "them with intra-solve parallelism. One at a time with all threads: "
+         "%.1f solves/sec\n",
+         testmsg, count, batch_latency, count / batch_latency, thread_count,
+         large, count / single_latency);
+  if (large < 0) {
+    msg = "Batch rejected its problems";
+  }
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+
+  for (i = 0; i < count; i++) {
+    itmv_ctx_destroy(&ctx[i]);
+    free(ctx[i].x);
+    free(ctx[i].d);
+    free(ctx[i].y);
+  }
+  for (kind = 0; kind < BATCH_SIZE_KINDS; kind++) {
+    free(shared_A[kind][0]);
+    free(shared_A[kind][1]);
+  }
+  free(problems);
+  free(ctx);
+  return msg;
+}
+
+char *itmv_test8ai() {
+  return itmv_batch_test("Test 8ai: 40 small solves t=64 batched",
+                         TEST_CORRECTNESS, 40, 64, 128);
+}
+
+/*-------------------------------------------------------------------
+ * Write the test matrix and d to a matrix file, map it with the given
+ * hints and run parallel_itmv_mult with matrix_A and vector_d pointing
+ * into the mapping.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_mmap_test(char *testmsg, int test_correctness, int n, int mtype,
+                     int t, int mappingtype, int cyclic_block, int flags) {
+  char path[] = "/tmp/itmv_mmap_XXXXXX";
+  double *A, *x, *d, *y;
+  double startwtime, map_latency, latency;
+  itmv_mapped m;
+  int fd, err;
+  char *msg = NULL;
+
+  matrix_dim = n;
+  no_iterations = t;
+  matrix_type = mtype;
+  thread_mapping = mappingtype;
+  cyclic_blocksize = cyclic_block;
+
+  if (!allocate_space(&A, &x, &d, &y, n)) {
+    msg = "Failed space allocation";
+    print_error(testmsg, msg);
+    return msg;
+  }
+  initialize(A, x, d, y, n, mtype);
+  fd = mkstemp(path);
+  if (fd >= 0) {
+    close(fd);
+  }
+  err = itmv_write_file(path, A, d, n,
+                        mtype == UPPER_TRIANGULAR ? ITMV_UPPER : ITMV_DENSE,
+                        getpagesize());
+  free(A);
+  free(d);
+  if (err == 0) {
+    startwtime = get_time();
+    err = itmv_map_open(path, flags, &m);
+    map_latency = get_time() - startwtime;
+  }
+  if (err != 0) {
+    unlink(path);
+    free(x);
+    free(y);
+    msg = (char *)itmv_map_strerror(err);
+    print_error(testmsg, msg);
+    return msg;
+  }
+
+  matrix_A = m.values;
+  vector_d = m.d;
+  vector_x = x;
+  vector_y = y;
+  startwtime = get_time();
+  parallel_itmv_mult(thread_count);
+  latency = get_time() - startwtime;
+  printf("%s: Map = %f sec, latency = %f sec with %d threads. Matrix "
+         "dimension %d. Iterations = %d\n",
+         testmsg, map_latency, latency, thread_count, n, iterations_done);
+
+  if (test_correctness == TEST_CORRECTNESS) {
+    msg = validate_vect(testmsg, vector_y, n, iterations_done, matrix_type);
+    if (msg != NULL) {
+      print_error(testmsg, msg);
+    }
+  }
+
+  itmv_map_close(&m);
+  unlink(path);
+  free(x);
+  free(y);
+  return msg;
+}
+
+char *itmv_test8aj() {
+  return itmv_mmap_test("Test 8aj: n=17 t=3 mapped file", TEST_CORRECTNESS, 17,
+                        !UPPER_TRIANGULAR, 3, BLOCK_MAPPING, 0,
+                        ITMV_MAP_POPULATE);
+}
+
+char *itmv_test8ak() {
+  return itmv_mmap_test("Test 8ak: n=17 t=3 upper mapped file verified",
+                        TEST_CORRECTNESS, 17, UPPER_TRIANGULAR, 3,
+                        BLOCK_CYCLIC, 2,
+                        ITMV_MAP_SEQUENTIAL | ITMV_MAP_VERIFY);
+}
+
+/*-------------------------------------------------------------------
+ * Write the test matrix to a matrix file and run parallel_itmv_mult out
+ * of core, streaming A from the file in panels of panel_rows rows with
+ * the given number of reader threads. Report the disk throughput (bytes
+ * over the span of an iteration's reads) and the compute throughput
+ * (flops over the slowest thread's multiply time), averaged over the
+ * iterations with the slowest iteration in brackets.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_ooc_test(char *testmsg, int test_correctness, int n, int mtype,
+                    int t, int mappingtype, int cyclic_block, int panel_rows,
+                    int readers) {
+  char path[] = "/tmp/itmv_ooc_XXXXXX";
+  double startwtime, latency, flops, disk, gflops, stall;
+  double min_disk = 1e300, min_gflops = 1e300;
+  int fd, err, k;
+  char *msg = NULL;
+
+  matrix_dim = n;
+  no_iterations = t;
+  matrix_type = mtype;
+  thread_mapping = mappingtype;
+  cyclic_blocksize = cyclic_block;
+
+  if (!allocate_space(&matrix_A, &vector_x, &vector_d, &vector_y, n)) {
+    msg = "Failed space allocation";
+    print_error(testmsg, msg);
+    return msg;
+  }
+  initialize(matrix_A, vector_x, vector_d, vector_y, n, matrix_type);
+  fd = mkstemp(path);
+  if (fd >= 0) {
+    close(fd);
+  }
+  err = itmv_write_file(path, matrix_A, NULL, n,
+                        mtype == UPPER_TRIANGULAR ? ITMV_UPPER : ITMV_DENSE,
+                        getpagesize());
+  /* Nothing may read A from memory in this mode. */
+  free(matrix_A);
+  matrix_A = NULL;
+  if (err != 0) {
+    msg = (char *)itmv_map_strerror(err);
+    print_error(testmsg, msg);
+  } else {
+    ooc_path = path;
+    ooc_panel_rows = panel_rows;
+    ooc_readers = readers;
+    startwtime = get_time();
+    parallel_itmv_mult(thread_count);
+    latency = get_time() - startwtime;
+    ooc_path = NULL;
+    msg = run_error;
+    if (msg != NULL) {
+      print_error(testmsg, msg);
+    }
+  }
+  if (err == 0 && msg == NULL) {
+    flops = (matrix_type == UPPER_TRIANGULAR) ? (double)n * (n + 1)
+                                              : 2.0 * n * n;
+    disk = gflops = stall = 0;
+    for (k = 0; k < iterations_done; k++) {
+      double d = ooc_stats[k].bytes / 1e9 /
+                 fmax(ooc_stats[k].read_end - ooc_stats[k].read_start, 1e-9);
+      double g = flops / 1e9 / fmax(ooc_stats[k].compute_sec, 1e-9);
+      disk += d;
+      gflops += g;
+      stall += ooc_stats[k].stall_sec;
+      min_disk = fmin(min_disk, d);
+      min_gflops = fmin(min_gflops, g);
+    }
+    printf("%s: Latency = %f sec with %d threads and %d readers, %d-row "
+           "panels. Matrix dimension %d. Iterations = %d. Per iteration: "
+           "disk %.3f GB/s (%.3f), compute %.3f GFLOPS (%.3f), panel wait "
+           "%f sec\n",
+           testmsg, latency, thread_count, readers, panel_rows, n,
+           iterations_done, disk / iterations_done, min_disk,
+           gflops / iterations_done, min_gflops, stall / iterations_done);
+
+    if (test_correctness == TEST_CORRECTNESS) {
+      msg = validate_vect(testmsg, vector_y, n, iterations_done, matrix_type);
+      if (msg != NULL) {
+        print_error(testmsg, msg);
+      }
+    }
+  }
+
+  unlink(path);
+  free(vector_x);
+  free(vector_y);
+  free(vector_d);
+  return msg;
+}
+
+char *itmv_test8am() {
+  return itmv_ooc_test("Test 8am: n=17 t=3 out of core", TEST_CORRECTNESS, 17,
+                       !UPPER_TRIANGULAR, 3, BLOCK_MAPPING, 0, 4, 1);
+}
+
+char *itmv_test8an() {
+  return itmv_ooc_test("Test 8an: n=17 t=3 upper out of core cyclic (r=2)",
+                       TEST_CORRECTNESS, 17, UPPER_TRIANGULAR, 3,
+                       BLOCK_CYCLIC, 2, 5, 2);
+}
+
+char *itmv_test8ao() {
+  return itmv_ooc_test("Test 8ao: n=64 out of core dynamic to convergence",
+                       TEST_CORRECTNESS, 64, !UPPER_TRIANGULAR, 4096,
+                       BLOCK_DYNAMIC, 3, 7, 3);
+}
+
+#define LOAD_CSV 0
+#define LOAD_MATRIX_MARKET 1
+
+/*-------------------------------------------------------------------
+ * Write the test matrix as text -- comma-separated rows, or MatrixMarket
+ * coordinate entries for its nonzeros -- load it back with itmv_load_file
+ * using thread_count threads, check every value came back exactly, then
+ * run parallel_itmv_mult on the loaded matrix. Report the ingestion
+ * throughput in MB/s.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_load_test(char *testmsg, int test_correctness, int n, int mtype,
+                     int t, int mappingtype, int cyclic_block, int format) {
+  char path[] = "/tmp/itmv_load_XXXXXX";
+  double *A, *x, *d, *y, a;
+  double startwtime, latency;
+  itmv_loaded m;
+  int fd, err, i, j, start;
+  FILE *f;
+  char *msg = NULL;
+
+  matrix_dim = n;
+  no_iterations = t;
+  matrix_type = mtype;
+  thread_mapping = mappingtype;
+  cyclic_blocksize = cyclic_block;
+
+  if (!allocate_space(&A, &x, &d, &y, n)) {
+    msg = "Failed space allocation";
+    print_error(testmsg, msg);
+    return msg;
+  }
+  initialize(A, x, d, y, n, mtype);
+  fd = mkstemp(path);
+  f = fd >= 0 ? fdopen(fd, "w") : NULL;
+  if (f == NULL) {
+    msg = "Cannot create the text matrix";
+  } else {
+    if (format == LOAD_MATRIX_MARKET) {
+      fprintf(f, "%%%%MatrixMarket matrix coordinate real general\n"
+                 "%% itmv test matrix\n%d %d %d\n",
+              n, n, mtype == UPPER_TRIANGULAR ? n * (n - 1) / 2 : n * (n - 1));
+    }
+    for (i = 0; i < n; i++) {
+      start = mtype == UPPER_TRIANGULAR ? i + 1 : 0;
+      for (j = 0; j < n; j++) {
+        a = j >= start ? A[i * n + j] : 0.0;
+        if (format == LOAD_CSV) {
+          fprintf(f, j == 0 ? "%.17g" : ",%.17g", a);
+        } else if (a != 0.0) {
+          fprintf(f, "%d %d %.17g\n", i + 1, j + 1, a);
+        }
+      }
+      if (format == LOAD_CSV) {
+        fputc('\n', f);
+      }
+    }
+    fclose(f);
+  }
+  free(A);
+
+  err = msg == NULL ? itmv_load_file(path, ITMV_DENSE, thread_count, &m) : 0;
+  unlink(path);
+  if (msg == NULL && err != 0) {
+    msg = (char *)itmv_map_strerror(err);
+  }
+  if (msg != NULL) {
+    free(x);
+    free(d);
+    free(y);
+    print_error(testmsg, msg);
+    return msg;
+  }
+  printf("%s: Loaded %.1f MB in %f sec, %.1f MB/s with %d threads\n",
+         testmsg, m.bytes / 1e6, m.seconds, m.bytes / 1e6 / m.seconds,
+         thread_count);
+
+  /* Rebuild A to compare against; only the upper part of an upper
+   * triangular matrix is defined. */
+  A = malloc(n * n * sizeof(double));
+  initialize(A, x, d, y, n, mtype);
+  if (m.rows != n || m.cols != n) {
+    msg = "Loaded matrix has the wrong dimensions";
+  }
+  for (i = 0; i < n && msg == NULL; i++) {
+    start = mtype == UPPER_TRIANGULAR ? i + 1 : 0;
+    for (j = 0; j < n; j++) {
+      a = j >= start ? A[i * n + j] : 0.0;
+      if (m.values[i * n + j] != a) {
+        msg = "Loaded value differs from the text";
+        break;
+      }
+    }
+  }
+  free(A);
+
+  if (msg == NULL) {
+    matrix_A = m.values;
+    vector_x = x;
+    vector_d = d;
+    vector_y = y;
+    startwtime = get_time();
+    parallel_itmv_mult(thread_count);
+    latency = get_time() - startwtime;
+    printf("%s: Latency = %f sec with %d threads. Matrix dimension %d. "
+           "Iterations = %d\n",
+           testmsg, latency, thread_count, n, iterations_done);
+    if (test_correctness == TEST_CORRECTNESS) {
+      msg = validate_vect(testmsg, vector_y, n, iterations_done, matrix_type);
+    }
+  }
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+
+  itmv_load_free(&m);
+  free(x);
+  free(d);
+  free(y);
+  return msg;
+}
+
+char *itmv_test8ap() {
+  return itmv_load_test("Test 8ap: n=17 t=3 loaded from CSV", TEST_CORRECTNESS,
+                        17, !UPPER_TRIANGULAR, 3, BLOCK_MAPPING, 0, LOAD_CSV);
+}
+
+char *itmv_test8aq() {
+  return itmv_load_test("Test 8aq: n=17 t=3 upper loaded from MatrixMarket",
+                        TEST_CORRECTNESS, 17, UPPER_TRIANGULAR, 3,
+                        BLOCK_CYCLIC, 2, LOAD_MATRIX_MARKET);
+}
+
+/*-------------------------------------------------------------------
+ * Run itmv_test and check the per-thread counters of the run add up to
+ * n rows and the flops of y = d + Ax per iteration, then check
+ * thread_stats_summary on counters set by hand.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_stats_test(char *testmsg, int n, int mtype, int t, int mappingtype,
+                      int cyclic_block) {
+  double flops = 0, expected, imbalance, wait_fraction;
+  long rows = 0;
+  char *msg;
+  int r;
+
+  msg = itmv_test(testmsg, TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, n, mtype,
+                  t, mappingtype, cyclic_block);
+  if (msg != NULL) {
+    return msg;
+  }
+  for (r = 0; r < thread_count; r++) {
+    rows += thread_rows[r];
+    flops += thread_flops[r];
+  }
+  expected = (mtype == UPPER_TRIANGULAR ? (double)n * (n + 1) : 2.0 * n * n) *
+             iterations_done;
+  thread_stats_summary(thread_count, 1.0, &imbalance, &wait_fraction);
+  if (rows != (long)n * iterations_done) {
+    msg = "Rows processed do not add up";
+  } else if (fabs(flops - expected) > 1e-9 * expected) {
+    msg = "Flops do not add up";
+  } else if (imbalance < 1 - 1e-9 || imbalance > thread_count + 1e-9) {
+    msg = "Imbalance out of range";
+  }
+
+  if (msg == NULL) {
+    for (r = 0; r < 4; r++) {
+      thread_compute_time[r] = r < 3 ? 1 : 3;
+      sync_wait_time[r] = r < 3 ? 1 : 0;
+    }
+    thread_stats_summary(4, 4.0, &imbalance, &wait_fraction);
+    if (fabs(imbalance - 2) > 1e-12 || fabs(wait_fraction - 0.1875) > 1e-12) {
+      msg = "Wrong imbalance or wait fraction";
+    }
+  }
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+  return msg;
+}
+
+char *itmv_test8at() {
+  return itmv_stats_test("Test 8at: n=17 t=3 upper counters blockmapping", 17,
+                         UPPER_TRIANGULAR, 3, BLOCK_MAPPING, 0);
+}
+
+char *itmv_test8au() {
+  return itmv_stats_test("Test 8au: n=17 t=3 upper counters cyclic (r=2)", 17,
+                         UPPER_TRIANGULAR, 3, BLOCK_CYCLIC, 2);
+}
+
+char *itmv_test8av() {
+  return itmv_stats_test("Test 8av: n=17 t=3 counters dynamic (r=2)", 17,
+                         !UPPER_TRIANGULAR, 3, BLOCK_DYNAMIC, 2);
+}
+
+/* The test matrix, full, as an OP_CALLBACK operator: data is the sum. */
+void test_op_prepare(itmv_op *op, const double x[]) {
+  double sum = 0;
+  int j;
+
+  for (j = 0; j < op->n; j++) {
+    sum += x[j];
+  }
+  *(double *)op->data = sum;
+}
+
+double test_op_row(const itmv_op *op, int i, const double x[]) {
+  return -(*(double *)op->data - x[i]) / op->n;
+}
+
+/*-------------------------------------------------------------------
+ * Build an operator of class kind on n rows, with d making x = 1 the
+ * solution, and run t iterations of parallel_itmv_mult with it from
+ * x = 0. OP_CONST_DIAG, OP_TOEPLITZ and OP_CALLBACK give the test matrix
+ * (full, upper triangular and full); OP_CIRCULANT and OP_LOWRANK_DIAG
+ * other contractions. For n up to MAX_TEST_MATRIX_SIZE compare y with
+ * itmv_mult_seq on the operator's dense matrix for as many iterations as
+ * the run took; for larger n, where the dense matrix would not fit, only
+ * OP_CONST_DIAG is run and y is checked against its closed form
+ * 1 - (-(n-1)/n)^k. ../common/itmv_common_test.c checks the dense
+ * matrices themselves.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_op_test(char *testmsg, int kind, int n, int t) {
+  double *A = NULL, *x0, *d, *y, *t_c = NULL, *U = NULL, *V = NULL;
+  double *diag = NULL, sum, startwtime, latency, expected;
+  int i, r, err, rank = 2;
+  char *msg = NULL;
+  itmv_op op;
+
+  matrix_dim = n;
+  no_iterations = t;
+  matrix_type = kind == OP_TOEPLITZ ? UPPER_TRIANGULAR : !UPPER_TRIANGULAR;
+  thread_mapping = BLOCK_MAPPING;
+  x0 = calloc(n, sizeof(double));
+  d = malloc(n * sizeof(double));
+  y = malloc(n * sizeof(double));
+  vector_x = malloc(n * sizeof(double));
+  vector_y = malloc(n * sizeof(double));
+  if (x0 == NULL || d == NULL || y == NULL || vector_x == NULL ||
+      vector_y == NULL) {
+    msg = "Failed space allocation";
+    print_error(testmsg, msg);
+    goto done;
+  }
+
+  if (kind == OP_CONST_DIAG) {
+    err = itmv_op_const_diag(&op, n, -1.0 / n, NULL);
+  } else if (kind == OP_TOEPLITZ) {
+    t_c = malloc((2 * n - 1) * sizeof(double));
+    for (i = 0; i < 2 * n - 1; i++) {
+      t_c[i] = i < n - 1 ? -1.0 / n : 0;
+    }
+    err = itmv_op_toeplitz(&op, n, t_c);
+  } else if (kind == OP_CIRCULANT) {
+    t_c = malloc(n * sizeof(double));
+    for (i = 0; i < n; i++) {
+      t_c[i] = -(i % 3 + 1) / (4.0 * n);
+    }
+    err = itmv_op_circulant(&op, n, t_c);
+  } else if (kind == OP_LOWRANK_DIAG) {
+    diag = malloc(n * sizeof(double));
+    U = malloc(n * rank * sizeof(double));
+    V = malloc(n * rank * sizeof(double));
+    for (i = 0; i < n; i++) {
+      diag[i] = 0.1;
+      for (r = 0; r < rank; r++) {
+        U[i * rank + r] = 0.3 * cos(i + r) / sqrt(n);
+        V[i * rank + r] = 0.3 * sin(2 * i + r + 1) / sqrt(n);
+      }
+    }
+    err = itmv_op_lowrank_diag(&op, n, rank, diag, U, V);
+  } else {
+    err = itmv_op_callback(&op, n, test_op_prepare, test_op_row, &sum);
+  }
+  if (err != 0) {
+    msg = "Failed to build the operator";
+    print_error(testmsg, msg);
+    goto done;
+  }
+
+  /* d = 1 - A1, so x = 1 solves x = d + Ax. */
+  for (i = 0; i < n; i++) {
+    y[i] = 1;
+  }
+  itmv_op_apply(&op, y, d);
+  for (i = 0; i < n; i++) {
+    d[i] = 1 - d[i];
+    vector_x[i] = 0;
+  }
+  vector_d = d;
+  matrix_op = &op;
+  startwtime = get_time();
+  parallel_itmv_mult(thread_count);
+  latency = get_time() - startwtime;
+  matrix_op = NULL;
+  printf("%s: Latency = %f sec with %d threads. Matrix dimension %d. "
+         "Iterations = %d. %e sec per iteration\n",
+         testmsg, latency, thread_count, n, iterations_done,
+         latency / iterations_done);
+
+  if (n <= MAX_TEST_MATRIX_SIZE) {
+    A = malloc(n * n * sizeof(double));
+    if (A == NULL || itmv_op_to_dense(&op, A) != 0) {
+      msg = "Failed space allocation";
+    } else {
+      itmv_mult_seq(A, x0, d, y, matrix_type, n, iterations_done);
+      for (i = 0; i < n && msg == NULL; i++) {
+        if (fabs(vector_y[i] - y[i]) > THRESHOLD) {
+          msg = "One mismatch against the dense matrix";
+        }
+      }
+    }
+  } else {
+    expected = 1 - pow(-(n - 1.0) / n, iterations_done);
+    for (i = 0; i < n && msg == NULL; i++) {
+      if (fabs(vector_y[i] - expected) > THRESHOLD) {
+        msg = "One mismatch against the closed form";
+      }
+    }
+  }
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+  itmv_op_destroy(&op);
+
+done:
+  free(A);
+  free(x0);
+  free(d);
+  free(y);
+  free(t_c);
+  free(diag);
+  free(U);
+  free(V);
+  free(vector_x);
+  free(vector_y);
+  return msg;
+}
+
+char *itmv_test8aw() {
+  return itmv_op_test("Test 8aw: n=17 t=5 constant-plus-diagonal operator",
+                      OP_CONST_DIAG, 17, 5);
+}
+
+char *itmv_test8ax() {
+  return itmv_op_test("Test 8ax: n=17 t=5 upper Toeplitz operator",
+                      OP_TOEPLITZ, 17, 5);
+}
+
+char *itmv_test8ay() {
+  return itmv_op_test("Test 8ay: n=20 t=64 circulant operator", OP_CIRCULANT,
+                      20, 64);
+}
+
+char *itmv_test8az() {
+  return itmv_op_test("Test 8az: n=17 t=64 low-rank-plus-diagonal operator",
+                      OP_LOWRANK_DIAG, 17, 64);
+}
+
+char *itmv_test8ba() {
+  return itmv_op_test("Test 8ba: n=17 t=5 callback operator", OP_CALLBACK, 17,
+                      5);
+}
+
+char *itmv_test8bb() {
+  return itmv_op_test("Test 8bb: n=1M t=64 constant-plus-diagonal operator",
+                      OP_CONST_DIAG, 1 << 20, 64);
+}
+
+/*-------------------------------------------------------------------
+ * Entry (i, j) of the banded test matrix: -(1 + (i + 2j) % 3) / 3(kl+ku+1)
+ * on the kl diagonals below the main one and the ku above, 0 elsewhere.
+ */
+double test_band_entry(int kl, int ku, int i, int j) {
+  if (j == i || j < i - kl || j > i + ku) return 0;
+  return -(1 + (i + 2 * j) % 3) / (3.0 * (kl + ku + 1));
+}
+
+/*-------------------------------------------------------------------
+ * Fill band storage with the banded test matrix and solve x = d + Ax as
+ * matrix_type BANDED with d such that x = 1. Up to MAX_TEST_MATRIX_SIZE
+ * y must match itmv_mult_seq on the dense matrix bit for bit
+ * (itmv_gs_seq within THRESHOLD for GAUSS_SEIDEL); beyond that y must be
+ * within 10 * ERROR_THRESHOLD of 1.
+ * ../common/itmv_common_test.c checks the band storage itself.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_band_test(char *testmsg, int n, int kl, int ku, int t,
+                     int mappingtype, int cyclic_block) {
+  double *A = NULL, *band, *x0, *d, *y;
+  double startwtime, latency;
+  int i, j;
+  int small = n <= MAX_TEST_MATRIX_SIZE;
+  char *msg = NULL;
+
+  matrix_dim = n;
+  no_iterations = t;
+  thread_mapping = mappingtype;
+  cyclic_blocksize = cyclic_block;
+  x0 = calloc(n, sizeof(double));
+  d = malloc(n * sizeof(double));
+  y = malloc(n * sizeof(double));
+  band = malloc(ITMV_BAND_SIZE(n, kl, ku) * sizeof(double));
+  vector_x = calloc(n, sizeof(double));
+  vector_y = malloc(n * sizeof(double));
+  if (small) {
+    A = malloc(n * n * sizeof(double));
+  }
+  if (x0 == NULL || d == NULL || y == NULL || band == NULL ||
+      vector_x == NULL || vector_y == NULL || (small && A == NULL)) {
+    msg = "Failed space allocation";
+    goto done;
+  }
+
+  /* d = 1 - A1, so x = 1 solves x = d + Ax. */
+  for (i = 0; i < n; i++) {
+    d[i] = 1;
+    for (j = i - kl > 0 ? i - kl : 0; j <= i + ku && j < n; j++) {
+      d[i] -= test_band_entry(kl, ku, i, j);
+    }
+  }
+  for (j = -kl; j <= ku; j++) {
+    for (i = 0; i < n; i++) {
+      band[(long)(j + kl) * n + i] =
+          i + j >= 0 && i + j < n ? test_band_entry(kl, ku, i, i + j) : 0;
+    }
+  }
+  if (small) {
+    for (i = 0; i < n; i++) {
+      for (j = 0; j < n; j++) {
+        A[i * n + j] = test_band_entry(kl, ku, i, j);
+      }
+    }
+  }
+
+  matrix_type = BANDED;
+  band_lower = kl;
+  band_upper = ku;
+  matrix_A = band;
+  vector_d = d;
+  startwtime = get_time();
+  parallel_itmv_mult(thread_count);
+  latency = get_time() - startwtime;
+  matrix_type = !UPPER_TRIANGULAR;
+  printf("%s: Latency = %f sec with %d threads. Matrix dimension %d. "
+         "Iterations = %d. %e sec per iteration\n",
+         testmsg, latency, thread_count, n, iterations_done,
+         latency / iterations_done);
+
+  if (small) {
+    if (mappingtype == GAUSS_SEIDEL) {
+      itmv_gs_seq(A, x0, d, y, !UPPER_TRIANGULAR, n, iterations_done,
+                  relax_omega, color_count);
+      for (i = 0; i < n && msg == NULL; i++) {
+        if (fabs(vector_y[i] - y[i]) > THRESHOLD) {
+          msg = "One mismatch against the dense matrix";
+        }
+      }
+    } else {
+      itmv_mult_seq(A, x0, d, y, !UPPER_TRIANGULAR, n, iterations_done);
+      for (i = 0; i < n && msg == NULL; i++) {
+        if (vector_y[i] != y[i]) {
+          msg = "One mismatch against the dense matrix";
+        }
+      }
+    }
+  } else {
+    for (i = 0; i < n && msg == NULL; i++) {
+      if (fabs(vector_y[i] - 1) > 10 * ERROR_THRESHOLD) {
+        msg = "Failed to reach convergence";
+      }
+    }
+  }
+
+done:
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+  free(A);
+  free(band);
+  free(x0);
+  free(d);
+  free(y);
+  free(vector_x);
+  free(vector_y);
+  return msg;
+}
+
+char *itmv_test8bc() {
+  return itmv_band_test("Test 8bc: n=100 t=64 banded (2,3) blockmapping", 100,
+                        2, 3, 64, BLOCK_MAPPING, 0);
+}
+
+char *itmv_test8bd() {
+  return itmv_band_test("Test 8bd: n=100 t=64 banded (2,3) block cyclic (r=16)",
+                        100, 2, 3, 64, BLOCK_CYCLIC, 16);
+}
+
+char *itmv_test8be() {
+  return itmv_band_test("Test 8be: n=101 t=64 banded (4,1) dynamic (r=7)", 101,
+                        4, 1, 64, BLOCK_DYNAMIC, 7);
+}
+
+char *itmv_test8bf() {
+  return itmv_band_test("Test 8bf: n=100 t=64 banded (2,3) dataflow (r=8)", 100,
+                        2, 3, 64, BLOCK_DATAFLOW, 8);
+}
+
+char *itmv_test8bg() {
+  return itmv_band_test("Test 8bg: n=100 t=64 banded (3,3) Gauss-Seidel", 100,
+                        3, 3, 64, GAUSS_SEIDEL, 0);
+}
+
+char *itmv_test8bi() {
+  return itmv_band_test("Test 8bi: n=1M t=64 banded (2,2) blockmapping",
+                        1 << 20, 2, 2, 64, BLOCK_MAPPING, 0);
+}
+
+/*-------------------------------------------------------------------
+ * Solve the banded test matrix in band storage through the context API
+ * with the given mapping. y must match itmv_mult_seq on the dense matrix
+ * bit for bit, and the context's counters must add up to the entries of
+ * the band times the iterations.
+ * If failed, return a message string. If successful, return NULL
+ */
+char *itmv_ctx_band_test(char *testmsg, int n, int kl, int ku, int t,
+                         int mappingtype, int cyclic_block) {
+  itmv_ctx ctx;
+  double *A = calloc(n * n, sizeof(double));
+  double *band = malloc(ITMV_BAND_SIZE(n, kl, ku) * sizeof(double));
+  double *x = calloc(n, sizeof(double)), *x0 = calloc(n, sizeof(double));
+  double *d = malloc(n * sizeof(double)), *y = malloc(n * sizeof(double));
+  double *y0 = malloc(n * sizeof(double));
+  double flops = 0;
+  long rows = 0;
+  int i, j, r;
+  char *msg = NULL;
+
+  if (A == NULL || band == NULL || x == NULL || x0 == NULL || d == NULL ||
+      y == NULL || y0 == NULL) {
+    msg = "Failed space allocation";
+    goto done;
+  }
+  for (i = 0; i < n; i++) {
+    d[i] = 1;
+    for (j = 0; j < n; j++) {
+      A[i * n + j] = test_band_entry(kl, ku, i, j);
+      d[i] -= A[i * n + j];
+    }
+  }
+  itmv_band_from_dense(A, n, kl, ku, band);
+  if (itmv_ctx_init(&ctx, band, x, d, y, n, BANDED, thread_count) != 0) {
+    msg = "Context rejected a banded matrix";
+    goto done;
+  }
+  ctx.band_lower = kl;
+  ctx.band_upper = ku;
+  ctx.no_iterations = t;
+  ctx.mapping = mappingtype;
+  ctx.cyclic_blocksize = cyclic_block;
+  itmv_ctx_run(&ctx);
+  itmv_ctx_destroy(&ctx);
+  printf("%s: Matrix dimension %d. Iterations = %d\n", testmsg, n,
+         ctx.iterations_done);
+
+  itmv_mult_seq(A, x0, d, y0, !UPPER_TRIANGULAR, n, ctx.iterations_done);
+  for (i = 0; i < n && msg == NULL; i++) {
+    if (y[i] != y0[i]) {
+      msg = "One mismatch against the dense matrix";
+    }
+  }
+  for (r = 0; r < thread_count; r++) {
+    rows += ctx.thread_rows[r];
+    flops += ctx.thread_flops[r];
+  }
+  if (msg == NULL &&
+      (rows != (long)n * ctx.iterations_done ||
+       flops != 2.0 * itmv_band_entries(n, kl, ku, 0, n) *
+                    ctx.iterations_done)) {
+    msg = "Counters do not add up to the band";
+  }
+
+done:
+  if (msg != NULL) {
+    print_error(testmsg, msg);
+  }
+  free(A);
+  free(band);
+  free(x);
+  free(x0);
+  free(d);
+  free(y);
+  free(y0);
+  return msg;
+}
+
+char *itmv_test8bk() {
+  return itmv_ctx_band_test(
+      "Test 8bk: n=100 t=64 banded (2,3) context, block cyclic (r=16)", 100, 2,
+      3, 64, BLOCK_CYCLIC, 16);
+}
+
 char *itmv_test_8a() {
   return itmv_test("Test 8a: n=0.5K t=8K blockmapping", !TEST_CORRECTNESS,
                    TEST_REACH_CONVERGENCE, 512, !UPPER_TRIANGULAR, 4096,
@@ -386,6 +1787,129 @@ char *itmv_test14() {
                    UPPER_TRIANGULAR, 1024, BLOCK_CYCLIC, 16);
 }
 
+char *itmv_test15() {
+  return itmv_test("Test 15: n=4K t=1K dataflow (r=16)", !TEST_CORRECTNESS,
+                   !TEST_REACH_CONVERGENCE, 4096,
+                   !UPPER_TRIANGULAR, 1024, BLOCK_DATAFLOW, 16);
+}
+
+char *itmv_test16() {
+  return itmv_test("Test 16: n=4K t=1K upper dataflow (r=16)",
+                   !TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 4096,
+                   UPPER_TRIANGULAR, 1024, BLOCK_DATAFLOW, 16);
+}
+
+char *itmv_test17() {
+  return itmv_test("Test 17: n=4K t=1K upper dynamic (r=16)",
+                   !TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 4096,
+                   UPPER_TRIANGULAR, 1024, BLOCK_DYNAMIC, 16);
+}
+
+char *itmv_test18() {
+  return itmv_test("Test 18: n=4K t=1K upper guided (r=16)",
+                   !TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 4096,
+                   UPPER_TRIANGULAR, 1024, BLOCK_GUIDED, 16);
+}
+
+char *itmv_test19() {
+  return itmv_test("Test 19: n=4K t=1K upper work stealing (r=16)",
+                   !TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 4096,
+                   UPPER_TRIANGULAR, 1024, BLOCK_STEALING, 16);
+}
+
+char *itmv_test20() {
+  return itmv_test("Test 20: n=4K t=1K async", !TEST_CORRECTNESS,
+                   !TEST_REACH_CONVERGENCE, 4096,
+                   !UPPER_TRIANGULAR, 1024, ASYNC_JACOBI, 0);
+}
+
+char *itmv_test21() {
+  return itmv_test("Test 21: n=4K t=1K upper async", !TEST_CORRECTNESS,
+                   !TEST_REACH_CONVERGENCE, 4096,
+                   UPPER_TRIANGULAR, 1024, ASYNC_JACOBI, 0);
+}
+
+char *itmv_test22() {
+  return itmv_test("Test 22: n=4K t=1K red-black Gauss-Seidel",
+                   !TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 4096,
+                   !UPPER_TRIANGULAR, 1024, GAUSS_SEIDEL, 0);
+}
+
+char *itmv_test23() {
+  return itmv_test("Test 23: n=4K t=1K upper wavefront Gauss-Seidel (r=16)",
+                   !TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 4096,
+                   UPPER_TRIANGULAR, 1024, GAUSS_SEIDEL, 16);
+}
+
+char *itmv_test24() {
+  return itmv_krylov_test("Test 24: n=0.5K t=4K auto Krylov", 512,
+                          !UPPER_TRIANGULAR, 4096, KRYLOV_AUTO);
+}
+
+char *itmv_test25() {
+  return itmv_krylov_test("Test 25: n=0.5K t=4K upper auto Krylov", 512,
+                          UPPER_TRIANGULAR, 4096, KRYLOV_AUTO);
+}
+
+char *itmv_test26() {
+  return itmv_accel_test("Test 26: n=4K t=1K Chebyshev blockmapping",
+                         !TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 4096,
+                         !UPPER_TRIANGULAR, 1024, ACCEL_CHEBYSHEV);
+}
+
+char *itmv_test27() {
+  return itmv_accel_test("Test 27: n=4K t=1K Anderson blockmapping",
+                         !TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 4096,
+                         !UPPER_TRIANGULAR, 1024, ACCEL_ANDERSON);
+}
+
+char *itmv_test28() {
+  return itmv_accel_test("Test 28: n=4K t=1K upper Anderson blockmapping",
+                         !TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 4096,
+                         UPPER_TRIANGULAR, 1024, ACCEL_ANDERSON);
+}
+
+char *itmv_test29() {
+  return itmv_panel_test("Test 29: n=4K t=1K 8 right-hand sides",
+                         !TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 4096,
+                         !UPPER_TRIANGULAR, 1024, 8);
+}
+
+char *itmv_test30() {
+  return itmv_panel_test("Test 30: n=4K t=1K upper 8 right-hand sides",
+                         !TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 4096,
+                         UPPER_TRIANGULAR, 1024, 8);
+}
+
+char *itmv_test31() {
+  return itmv_ctx_test("Test 31: n=4K t=1K two concurrent contexts",
+                       !TEST_CORRECTNESS, !TEST_REACH_CONVERGENCE, 4096,
+                       1024, 16);
+}
+
+char *itmv_test32() {
+  return itmv_batch_test("Test 32: 250 solves n=16-256 t=256 batched",
+                         !TEST_CORRECTNESS, 250, 256, ITMV_BATCH_PARALLEL_N);
+}
+
+char *itmv_test33() {
+  return itmv_mmap_test("Test 33: n=4K t=1K mapped file", !TEST_CORRECTNESS,
+                        4096, !UPPER_TRIANGULAR, 1024, BLOCK_MAPPING, 0,
+                        ITMV_MAP_POPULATE);
+}
+
+char *itmv_test34() {
+  return itmv_ooc_test("Test 34: n=4K t=16 out of core (256-row panels)",
+                       !TEST_CORRECTNESS, 4096, !UPPER_TRIANGULAR, 16,
+                       BLOCK_MAPPING, 0, 256, 2);
+}
+
+char *itmv_test35() {
+  return itmv_load_test("Test 35: n=1K t=1K loaded from CSV", !TEST_CORRECTNESS,
+                        1024, !UPPER_TRIANGULAR, 1024, BLOCK_MAPPING, 0,
+                        LOAD_CSV);
+}
+
 /*-------------------------------------------------------------------
  * Run all tests.  Ignore returned messages.
  */
@@ -400,6 +1924,61 @@ void run_all_tests(void) {
   mu_run_test(itmv_test7);
   mu_run_test(itmv_test7c);
   mu_run_test(itmv_test8);
+  mu_run_test(itmv_test8d);
+  mu_run_test(itmv_test8e);
+  mu_run_test(itmv_test8f);
+  mu_run_test(itmv_test8g);
+  mu_run_test(itmv_test8h);
+  mu_run_test(itmv_test8i);
+  mu_run_test(itmv_test8j);
+  mu_run_test(itmv_test8k);
+  mu_run_test(itmv_test8l);
+  mu_run_test(itmv_test8m);
+  mu_run_test(itmv_test8n);
+  mu_run_test(itmv_test8o);
+  mu_run_test(itmv_test8p);
+  mu_run_test(itmv_test8q);
+  mu_run_test(itmv_test8r);
+  mu_run_test(itmv_test8s);
+  mu_run_test(itmv_test8t);
+  mu_run_test(itmv_test8u);
+  mu_run_test(itmv_test8v);
+  mu_run_test(itmv_test8w);
+  mu_run_test(itmv_test8x);
+  mu_run_test(itmv_test8y);
+  mu_run_test(itmv_test8z);
+  mu_run_test(itmv_test8aa);
+  mu_run_test(itmv_test8ab);
+  mu_run_test(itmv_test8ac);
+  mu_run_test(itmv_test8ad);
+  mu_run_test(itmv_test8ae);
+  mu_run_test(itmv_test8af);
+  mu_run_test(itmv_test8ag);
+  mu_run_test(itmv_test8ah);
+  mu_run_test(itmv_test8ai);
+  mu_run_test(itmv_test8aj);
+  mu_run_test(itmv_test8ak);
+  mu_run_test(itmv_test8am);
+  mu_run_test(itmv_test8an);
+  mu_run_test(itmv_test8ao);
+  mu_run_test(itmv_test8ap);
+  mu_run_test(itmv_test8aq);
+  mu_run_test(itmv_test8at);
+  mu_run_test(itmv_test8au);
+  mu_run_test(itmv_test8av);
+  mu_run_test(itmv_test8aw);
+  mu_run_test(itmv_test8ax);
+  mu_run_test(itmv_test8ay);
+  mu_run_test(itmv_test8az);
+  mu_run_test(itmv_test8ba);
+  mu_run_test(itmv_test8bb);
+  mu_run_test(itmv_test8bc);
+  mu_run_test(itmv_test8bd);
+  mu_run_test(itmv_test8be);
+  mu_run_test(itmv_test8bf);
+  mu_run_test(itmv_test8bg);
+  mu_run_test(itmv_test8bi);
+  mu_run_test(itmv_test8bk);
 
   // mu_run_test(itmv_test_8a);
   // mu_run_test(itmv_test_8b);
@@ -411,15 +1990,37 @@ void run_all_tests(void) {
   mu_run_test(itmv_test12);
   mu_run_test(itmv_test13);
   mu_run_test(itmv_test14);
+  mu_run_test(itmv_test15);
+  mu_run_test(itmv_test16);
+  mu_run_test(itmv_test17);
+  mu_run_test(itmv_test18);
+  mu_run_test(itmv_test19);
+  mu_run_test(itmv_test20);
+  mu_run_test(itmv_test21);
+  mu_run_test(itmv_test22);
+  mu_run_test(itmv_test23);
+  mu_run_test(itmv_test24);
+  mu_run_test(itmv_test25);
+  mu_run_test(itmv_test26);
+  mu_run_test(itmv_test27);
+  mu_run_test(itmv_test28);
+  mu_run_test(itmv_test29);
+  mu_run_test(itmv_test30);
+  mu_run_test(itmv_test31);
+  mu_run_test(itmv_test32);
+  mu_run_test(itmv_test33);
+  mu_run_test(itmv_test34);
+  mu_run_test(itmv_test35);
 }
 
 /*-------------------------------------------------------------------
  * The main entrance to run all tests.
  */
 int main(int argc, char *argv[]) {
-  if (argc != 2) {
+  if (argc != 2 && argc != 3) {
     printf("incorrect # of arguments");
-    printf("./itmv_mult_test_pth  <number of threads> \n");
+    printf("./itmv_mult_test_pth  <number of threads> "
+           "[compact|scatter|physical|<cpu list>]\n");
     return 1;
   }
   thread_count = atoi(argv[1]);
@@ -427,6 +2028,10 @@ int main(int argc, char *argv[]) {
     printf("The number of threads is not positive or too big\n");
     return 1;
   }
+  if (affinity_init(argc == 3 ? argv[2] : NULL) != 0) {
+    return 1;
+  }
+  affinity_print(thread_count);
   run_all_tests();
   mu_print_test_summary("Summary:");
   return 0;
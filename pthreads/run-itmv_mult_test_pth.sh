@@ -17,3 +17,4 @@
 ./itmv_mult_test_pth 1
 ./itmv_mult_test_pth 2
 ./itmv_mult_test_pth 4
+./itmv_mult_test_pth 4 physical